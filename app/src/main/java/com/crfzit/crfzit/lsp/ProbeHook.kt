@@ -16,6 +16,7 @@ import android.os.Build
 import android.os.Process
 import com.crfzit.crfzit.data.model.CerberusMessage
 import com.google.gson.Gson
+import com.google.gson.JsonObject
 import com.google.gson.JsonParser
 import de.robv.android.xposed.IXposedHookLoadPackage
 import de.robv.android.xposed.XC_MethodHook
@@ -23,8 +24,15 @@ import de.robv.android.xposed.XC_MethodReplacement
 import de.robv.android.xposed.XposedBridge
 import de.robv.android.xposed.XposedHelpers
 import de.robv.android.xposed.callbacks.XC_LoadPackage
+import java.io.FileDescriptor
+import java.io.FileInputStream
 import java.io.IOException
 import java.io.OutputStreamWriter
+import java.lang.invoke.VarHandle
+import java.lang.reflect.Method
+import java.nio.ByteBuffer
+import java.nio.ByteOrder
+import java.nio.channels.FileChannel
 import java.nio.charset.StandardCharsets
 import java.util.concurrent.LinkedBlockingQueue
 import java.util.concurrent.TimeUnit
@@ -88,18 +96,26 @@ class ProbeHook : IXposedHookLoadPackage {
     private object CommManager {
         private val eventQueue = LinkedBlockingQueue<Pair<String, Any>>()
         private var workerThread: Thread? = null
+        private var configThread: Thread? = null
         private val gson = Gson()
         @Volatile private var isConfigInitialized = false
-        private const val CONFIG_REFRESH_INTERVAL_MS = 5 * 60 * 1000L
-
-        private fun performHandshake(): Boolean {
+        private const val MAX_EVENT_BATCH = 64
+        // 常驻的上行事件连接，只由工作线程使用；断开后在下一批发送时重连
+        private var eventSocket: LocalSocket? = null
+        private var eventWriter: OutputStreamWriter? = null
+
+        /**
+         * 配置通道：握手后保持连接，持续接收守护进程推送的增量配置。
+         * 发现序号缺口时在同一连接上请求全量；连接断开后由调用方重连，重连即全量同步。
+         * 返回握手是否成功。
+         */
+        private fun runConfigChannel(): Boolean {
             try {
                 log("Attempting handshake with daemon via UDS path ${DAEMON_SOCKET_PATH}...")
                 val helloMessage = CerberusMessage(
                     type = "event.probe_hello",
-                    payload = mapOf("pid" to Process.myPid(), "version" to TAG)
+                    payload = mapOf("role" to "config", "pid" to Process.myPid(), "version" to TAG)
                 )
-                val jsonMessage = gson.toJson(helloMessage)
 
                 LocalSocket().use { socket ->
                     // LocalSocketAddress 对于 /dev/socket/ 下的路径，可以直接使用名字，并指定 FILESYSTEM 命名空间
@@ -108,97 +124,91 @@ class ProbeHook : IXposedHookLoadPackage {
                     socket.connect(socketAddress)
 
                     val writer = OutputStreamWriter(socket.outputStream, StandardCharsets.UTF_8)
-                    writer.write(jsonMessage + "\n")
+                    writer.write(gson.toJson(helloMessage) + "\n")
                     writer.flush()
 
-                    val responseLine = socket.inputStream.bufferedReader(StandardCharsets.UTF_8).readLine()
-                    if (responseLine != null) {
-                        ConfigManager.updateConfig(responseLine)
-                        log("Handshake successful. Probe config updated.")
-                        return true
-                    } else {
+                    val reader = socket.inputStream.bufferedReader(StandardCharsets.UTF_8)
+                    val responseLine = reader.readLine()
+                    if (responseLine == null) {
                         logError("Handshake failed: Daemon closed UDS connection prematurely.")
+                        return false
+                    }
+                    // 守护进程随全量应答通过 SCM_RIGHTS 附带冻结位图的只读描述符
+                    socket.ancillaryFileDescriptors?.forEach { ConfigManager.offerBitmapFd(it) }
+                    ConfigManager.handleMessage(responseLine)
+                    isConfigInitialized = true
+                    log("Handshake successful. Probe config updated, listening for deltas.")
+
+                    while (true) {
+                        val line = reader.readLine() ?: break
+                        socket.ancillaryFileDescriptors?.forEach { ConfigManager.offerBitmapFd(it) }
+                        val gap = ConfigManager.handleMessage(line) ?: continue
+                        log("Config sequence gap (have ${gap.first}, got ${gap.second}), requesting resync.")
+                        val resync = CerberusMessage(
+                            type = "cmd.probe_resync",
+                            payload = mapOf("have_seq" to gap.first, "received_seq" to gap.second)
+                        )
+                        writer.write(gson.toJson(resync) + "\n")
+                        writer.flush()
                     }
+                    log("Config channel closed by daemon.")
+                    return true
                 }
             } catch (e: IOException) {
                 if (e.message?.contains("ECONNREFUSED", ignoreCase = true) == false &&
                     e.message?.contains("No such file or directory", ignoreCase = true) == false) {
-                    logError("Handshake IOException: ${e.message}.")
+                    logError("Config channel IOException: ${e.message}.")
                 } else {
                     log("Daemon UDS not ready during handshake attempt.")
                 }
             } catch (t: Throwable) {
-                logError("Handshake unhandled error: $t.")
+                logError("Config channel unhandled error: $t.")
             }
             return false
         }
 
         fun start() {
             if (workerThread?.isAlive == true) return
-            workerThread = Thread {
-                log("CommManager worker thread started.")
-
+            configThread = Thread {
                 var retryDelayMs = 2000L
                 val maxDelayMs = 60000L
-                while (!isConfigInitialized) {
-                    if (performHandshake()) {
-                        isConfigInitialized = true
-                    } else {
-                        try {
-                            Thread.sleep(retryDelayMs)
-                            retryDelayMs = min(retryDelayMs * 2, maxDelayMs)
-                        } catch (ie: InterruptedException) {
-                            Thread.currentThread().interrupt()
-                            break
-                        }
+                while (!Thread.currentThread().isInterrupted) {
+                    if (runConfigChannel()) retryDelayMs = 2000L
+                    try {
+                        Thread.sleep(retryDelayMs)
+                        retryDelayMs = min(retryDelayMs * 2, maxDelayMs)
+                    } catch (ie: InterruptedException) {
+                        Thread.currentThread().interrupt()
                     }
                 }
+                log("Config channel thread stopped.")
+            }.apply {
+                name = "CerberusConfigThread"
+                priority = Thread.NORM_PRIORITY - 1
+                isDaemon = true
+                start()
+            }
 
-                if (!isConfigInitialized) {
-                    logError("CommManager failed to initialize. Thread is stopping.")
+            workerThread = Thread {
+                log("CommManager worker thread started.")
+
+                try {
+                    while (!isConfigInitialized) Thread.sleep(500)
+                } catch (ie: InterruptedException) {
+                    logError("CommManager interrupted before initialization. Thread is stopping.")
                     return@Thread
                 }
 
-                log("Initialization complete. Now processing event queue with reliable periodic config refresh.")
-                var lastRefreshTime = System.currentTimeMillis()
+                log("Initialization complete. Now processing event queue.")
 
                 while (true) {
                     try {
-                        val currentTime = System.currentTimeMillis()
-                        if (currentTime - lastRefreshTime > CONFIG_REFRESH_INTERVAL_MS) {
-                            log("Scheduled config refresh triggered by timer.")
-                            if (performHandshake()) {
-                                lastRefreshTime = currentTime
-                            } else {
-                                lastRefreshTime = currentTime - CONFIG_REFRESH_INTERVAL_MS + 60000L
-                            }
-                        }
-
-                        val event = eventQueue.poll(1, TimeUnit.SECONDS)
-
-                        if (event == null) {
-                            continue
-                        }
-
-                        val (type, payload) = event
-                        val message = CerberusMessage(type = type, payload = payload)
-                        val jsonMessage = gson.toJson(message)
-
-                        try {
-                            LocalSocket().use { socket ->
-                                val socketAddress = LocalSocketAddress(DAEMON_SOCKET_PATH, LocalSocketAddress.Namespace.FILESYSTEM)
-                                socket.connect(socketAddress)
-                                OutputStreamWriter(socket.outputStream, StandardCharsets.UTF_8).use { writer ->
-                                    writer.write(jsonMessage + "\n")
-                                    writer.flush()
-                                }
-                            }
-                        } catch (e: IOException) {
-                            if (e.message?.contains("ECONNREFUSED", ignoreCase = true) == false &&
-                                e.message?.contains("No such file or directory", ignoreCase = true) == false) {
-                                logError("Daemon short-conn send error for '$type': ${e.message}")
-                            }
-                        }
+                        val first = eventQueue.poll(1, TimeUnit.SECONDS) ?: continue
+                        // 把积压的事件一并取出，合成一个批量帧发送
+                        val batch = ArrayList<Pair<String, Any>>(MAX_EVENT_BATCH)
+                        batch.add(first)
+                        eventQueue.drainTo(batch, MAX_EVENT_BATCH - 1)
+                        sendEventBatch(batch)
                     } catch (ie: InterruptedException) {
                         Thread.currentThread().interrupt()
                         break
@@ -207,6 +217,7 @@ class ProbeHook : IXposedHookLoadPackage {
                         Thread.sleep(1000)
                     }
                 }
+                closeEventChannel()
                 log("CommManager worker thread stopped.")
             }.apply {
                 name = "CerberusCommThread"
@@ -216,6 +227,89 @@ class ProbeHook : IXposedHookLoadPackage {
             }
         }
 
+        /**
+         * 批量帧中每条事件编码为定长数组 [kind, uid, user_id, arg, package_name]，
+         * kind 与守护进程 ProbeEvent::Kind 对应。无法编码的事件返回 null，按单条消息发送。
+         */
+        private fun encodeEvent(type: String, payload: Any): List<Any>? = when {
+            type == "event.app_foreground" && payload is AppInstanceKey ->
+                listOf(1, -1, payload.user_id, 0, payload.package_name)
+            type == "event.app_background" && payload is AppInstanceKey ->
+                listOf(2, -1, payload.user_id, 0, payload.package_name)
+            type == "event.app_wakeup_request_v2" && payload is Map<*, *> ->
+                (payload["uid"] as? Int)?.let { uid -> listOf(3, uid, 0, payload["type_int"] as? Int ?: 3, "") }
+            type == "cmd.proactive_unfreeze" && payload is AppInstanceKey ->
+                listOf(4, -1, payload.user_id, 0, payload.package_name)
+            else -> null
+        }
+
+        private fun sendEventBatch(batch: List<Pair<String, Any>>) {
+            val events = ArrayList<List<Any>>(batch.size)
+            val frame = StringBuilder()
+            for ((type, payload) in batch) {
+                val encoded = encodeEvent(type, payload)
+                if (encoded != null) {
+                    events.add(encoded)
+                } else {
+                    frame.append(gson.toJson(CerberusMessage(type = type, payload = payload))).append('\n')
+                }
+            }
+            if (events.isNotEmpty()) {
+                frame.append(gson.toJson(CerberusMessage(type = "event.probe_batch", payload = mapOf("e" to events)))).append('\n')
+            }
+
+            // 连接可能已被守护进程关闭（例如守护进程重启），重连后重试一次
+            for (attempt in 0..1) {
+                try {
+                    val writer = eventWriter ?: openEventChannel()
+                    writer.write(frame.toString())
+                    writer.flush()
+                    return
+                } catch (e: IOException) {
+                    closeEventChannel()
+                    if (attempt == 1 && e.message?.contains("ECONNREFUSED", ignoreCase = true) == false &&
+                        e.message?.contains("No such file or directory", ignoreCase = true) == false) {
+                        logError("Daemon event channel send error for ${batch.size} event(s): ${e.message}")
+                    }
+                }
+            }
+        }
+
+        private fun openEventChannel(): OutputStreamWriter {
+            val socket = LocalSocket()
+            try {
+                socket.connect(LocalSocketAddress(DAEMON_SOCKET_PATH, LocalSocketAddress.Namespace.FILESYSTEM))
+            } catch (e: IOException) {
+                socket.close()
+                throw e
+            }
+            val writer = OutputStreamWriter(socket.outputStream, StandardCharsets.UTF_8)
+            try {
+                // 首条消息声明为事件连接，守护进程据此清空该连接的推送订阅
+                val hello = CerberusMessage(
+                    type = "event.probe_hello",
+                    payload = mapOf("role" to "events", "pid" to Process.myPid(), "version" to TAG)
+                )
+                writer.write(gson.toJson(hello) + "\n")
+                writer.flush()
+            } catch (e: IOException) {
+                socket.close()
+                throw e
+            }
+            eventSocket = socket
+            eventWriter = writer
+            return writer
+        }
+
+        private fun closeEventChannel() {
+            try {
+                eventSocket?.close()
+            } catch (_: IOException) {
+            }
+            eventSocket = null
+            eventWriter = null
+        }
+
         fun sendEvent(type: String, payload: Any) {
             eventQueue.offer(type to payload)
         }
@@ -225,35 +319,190 @@ class ProbeHook : IXposedHookLoadPackage {
         @Volatile var isBqHooked = false
         @Volatile private var managedUids = emptySet<Int>()
         @Volatile private var frozenUids = emptySet<Int>()
+        @Volatile private var frozenBitmap: FrozenUidBitmapView? = null
+        // 已应用的配置序号；-1 表示尚未收到带序号的全量，此时忽略增量
+        private var configSeq = -1L
+        private var pendingBitmapFd: FileDescriptor? = null
+
+        // 描述符可能先于携带它的那一行被读入缓冲区，暂存到处理全量配置时再使用
+        fun offerBitmapFd(fd: FileDescriptor) {
+            pendingBitmapFd?.let { closeQuietly(it) }
+            pendingBitmapFd = fd
+        }
 
-        fun updateConfig(jsonString: String) {
-            log("Received config JSON from daemon: $jsonString")
+        /**
+         * 处理配置通道上的一条消息。返回 null 表示已应用或无需处理；
+         * 返回 (本地序号, 收到的序号) 表示增量与本地序号不衔接，调用方应请求全量。
+         */
+        fun handleMessage(jsonString: String): Pair<Long, Long>? {
             try {
-                val payload = JsonParser.parseString(jsonString)
-                    ?.asJsonObject?.getAsJsonObject("payload") ?: run {
+                val message = JsonParser.parseString(jsonString)?.asJsonObject
+                val payload = message?.getAsJsonObject("payload") ?: run {
                     logError("Failed to parse config: payload is null or not an object.")
-                    return
+                    return null
                 }
-
-                if (payload.has("managed_uids")) {
-                    val uids = payload.getAsJsonArray("managed_uids").map { it.asInt }.toSet()
-                    managedUids = uids
-                    log("Config updated. Now managing ${managedUids.size} UIDs.")
+                when (message.get("type")?.asString) {
+                    "resp.probe_init_data" -> applyFullConfig(payload)
+                    "stream.probe_config_delta" -> return applyDelta(payload)
                 }
+            } catch (e: Exception) {
+                logError("Failed to parse probe config: $e")
+            }
+            return null
+        }
+
+        private fun applyFullConfig(payload: JsonObject) {
+            log("Received full config from daemon (${payload.size()} fields).")
+            if (payload.has("managed_uids")) {
+                val uids = payload.getAsJsonArray("managed_uids").map { it.asInt }.toSet()
+                managedUids = uids
+                log("Config updated. Now managing ${managedUids.size} UIDs.")
+            }
 
-                if (payload.has("frozen_uids")) {
-                    val uids = payload.getAsJsonArray("frozen_uids").map { it.asInt }.toSet()
-                    frozenUids = uids
-                    log("State updated. Now tracking ${frozenUids.size} frozen UIDs.")
+            if (payload.has("frozen_uids")) {
+                val uids = payload.getAsJsonArray("frozen_uids").map { it.asInt }.toSet()
+                frozenUids = uids
+                log("State updated. Now tracking ${frozenUids.size} frozen UIDs.")
+            }
+            configSeq = payload.get("config_seq")?.asLong ?: -1L
+
+            val layout = payload.getAsJsonObject("frozen_uid_bitmap")
+            val bitmapFd = pendingBitmapFd
+            pendingBitmapFd = null
+            if (bitmapFd != null) {
+                try {
+                    if (layout != null) {
+                        // 每次全量都换成新映射，守护进程重启后旧映射不再更新
+                        frozenBitmap = FrozenUidBitmapView.map(bitmapFd, layout)
+                        log(if (frozenBitmap != null) "Frozen UID bitmap mapped." else "Frozen UID bitmap rejected, using list.")
+                    }
+                } finally {
+                    closeQuietly(bitmapFd)
                 }
+            }
+        }
 
-            } catch (e: Exception) {
-                logError("Failed to parse probe config: $e")
+        private fun applyDelta(payload: JsonObject): Pair<Long, Long>? {
+            val seq = payload.get("seq")?.asLong ?: return null
+            val prevSeq = payload.get("prev_seq")?.asLong ?: return null
+            if (configSeq < 0 || seq <= configSeq) return null
+            if (prevSeq != configSeq) return configSeq to seq
+
+            val added = payload.getAsJsonArray("frozen_uids_added")?.map { it.asInt }.orEmpty()
+            val removed = payload.getAsJsonArray("frozen_uids_removed")?.map { it.asInt }.orEmpty()
+            if (added.isNotEmpty() || removed.isNotEmpty()) {
+                frozenUids = (frozenUids - removed.toSet()) + added
             }
+            configSeq = seq
+            return null
         }
 
         fun isUidManaged(uid: Int): Boolean = managedUids.contains(uid)
-        fun isUidFrozen(uid: Int): Boolean = frozenUids.contains(uid)
+        fun isUidFrozen(uid: Int): Boolean = frozenBitmap?.isFrozen(uid) ?: frozenUids.contains(uid)
+
+        private fun closeQuietly(fd: FileDescriptor) {
+            try {
+                FileInputStream(fd).close()
+            } catch (_: IOException) {
+            }
+        }
+    }
+
+    /**
+     * 守护进程维护的共享内存冻结位图，布局与 daemon/cpp/frozen_uid_bitmap.h 一致。
+     * 写者使用 seqlock：sequence 为奇数或前后不一致时重读。
+     */
+    private class FrozenUidBitmapView private constructor(
+        private val buffer: ByteBuffer,
+        private val headerSize: Int,
+        private val userSlots: Int,
+        private val firstAppId: Int,
+        private val appsPerUser: Int
+    ) {
+        // 返回 null 表示该 UID 不在位图覆盖范围内，调用方应退回到 JSON 列表
+        fun isFrozen(uid: Int): Boolean? {
+            val userId = uid / PER_USER_RANGE
+            val appId = uid % PER_USER_RANGE
+            if (uid < 0 || appId < firstAppId || appId >= firstAppId + appsPerUser) return null
+            repeat(MAX_READ_ATTEMPTS) {
+                val before = buffer.getInt(SEQUENCE_OFFSET)
+                // ByteBuffer 读取没有顺序保证：两道读屏障把位图读取限定在两次序号读取之间，
+                // 与守护进程一侧的 acquire 读取与 atomic_thread_fence(acquire) 对应
+                LoadFence.acquire()
+                if (before and 1 == 0) {
+                    var result: Boolean? = null
+                    for (slot in 0 until userSlots) {
+                        val slotUser = buffer.getInt(USER_IDS_OFFSET + slot * 4)
+                        if (slotUser == -1) break
+                        if (slotUser != userId) continue
+                        val bit = slot * appsPerUser + (appId - firstAppId)
+                        val word = buffer.getLong(headerSize + (bit / 64) * 8)
+                        result = (word ushr (bit % 64)) and 1L == 1L
+                        break
+                    }
+                    LoadFence.acquire()
+                    if (buffer.getInt(SEQUENCE_OFFSET) == before) return result
+                }
+            }
+            return null
+        }
+
+        companion object {
+            private const val MAGIC = 0x42465543
+            private const val VERSION = 1
+            private const val SEQUENCE_OFFSET = 8
+            private const val USER_IDS_OFFSET = 32
+            private const val PER_USER_RANGE = 100000
+            private const val MAX_READ_ATTEMPTS = 16
+
+            fun map(fd: FileDescriptor, layout: JsonObject): FrozenUidBitmapView? {
+                return try {
+                    val size = layout.get("size").asLong
+                    // 映射在 channel 关闭后依然有效
+                    val buffer = FileInputStream(fd).channel.map(FileChannel.MapMode.READ_ONLY, 0, size)
+                        .order(ByteOrder.LITTLE_ENDIAN)
+                    val view = FrozenUidBitmapView(
+                        buffer,
+                        headerSize = layout.get("header_size").asInt,
+                        userSlots = layout.get("user_slots").asInt,
+                        firstAppId = layout.get("first_app_id").asInt,
+                        appsPerUser = layout.get("apps_per_user").asInt
+                    )
+                    if (!LoadFence.available) {
+                        logError("No load fence available, frozen UID bitmap disabled.")
+                        return null
+                    }
+                    if (buffer.getInt(0) == MAGIC && layout.get("version").asInt == VERSION) view else null
+                } catch (t: Throwable) {
+                    logError("Failed to map frozen UID bitmap: $t")
+                    null
+                }
+            }
+        }
+    }
+
+    // 位图读者用的读屏障：API 33 起用 VarHandle.acquireFence()，更早的系统反射调用 Unsafe.loadFence()。
+    // 两者都不可用时 available 为 false，位图不启用，冻结判断退回到 JSON 列表
+    private object LoadFence {
+        private val unsafeFence: Pair<Any, Method>? =
+            if (Build.VERSION.SDK_INT >= Build.VERSION_CODES.TIRAMISU) null else try {
+                val unsafeClass = Class.forName("sun.misc.Unsafe")
+                val field = unsafeClass.getDeclaredField("theUnsafe").apply { isAccessible = true }
+                Pair(field.get(null)!!, unsafeClass.getMethod("loadFence"))
+            } catch (t: Throwable) {
+                logError("Unsafe.loadFence unavailable: $t")
+                null
+            }
+
+        val available: Boolean = Build.VERSION.SDK_INT >= Build.VERSION_CODES.TIRAMISU || unsafeFence != null
+
+        fun acquire() {
+            if (Build.VERSION.SDK_INT >= Build.VERSION_CODES.TIRAMISU) {
+                VarHandle.acquireFence()
+            } else {
+                unsafeFence?.let { (unsafe, loadFence) -> loadFence.invoke(unsafe) }
+            }
+        }
     }
 
     private fun requestWakeupForUid(uid: Int, type: WakeupType) {
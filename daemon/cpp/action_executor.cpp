@@ -2,6 +2,7 @@
 #include "action_executor.h"
 #include "system_monitor.h"
 #include "adj_mapper.h"
+#include "flight_recorder.h"
 #include <android/log.h>
 #include <sys/stat.h>
 #include <sys/ioctl.h>
@@ -14,6 +15,8 @@
 #include <sstream>
 #include <csignal>
 #include <algorithm>
+#include <chrono>
+#include <climits>
 #include <fcntl.h>
 #include <vector>
 #include <optional>
@@ -38,8 +41,23 @@ ActionExecutor::~ActionExecutor() {
     cleanup_binder();
 }
 
+static int elapsed_us_since(std::chrono::steady_clock::time_point start) {
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    return static_cast<int>(std::min<long long>(us, INT32_MAX));
+}
+
 int ActionExecutor::freeze(const AppInstanceKey& key, const std::vector<int>& pids) {
     if (pids.empty()) return 0;
+    // 冻结过程中卡死或被杀时，飞行记录器里只有 FREEZE_BEGIN 而没有对应的 FREEZE_END
+    FlightRecorder& recorder = FlightRecorder::instance();
+    recorder.record(FlightRecordKind::FREEZE_BEGIN, key.second, static_cast<int>(pids.size()), 0, key.first);
+    auto start = std::chrono::steady_clock::now();
+    int result = freeze_pids(key, pids);
+    recorder.record(FlightRecordKind::FREEZE_END, key.second, elapsed_us_since(start), result, key.first);
+    return result;
+}
+
+int ActionExecutor::freeze_pids(const AppInstanceKey& key, const std::vector<int>& pids) {
     int final_result = -1;
     int binder_result = handle_binder_freeze(pids, true);
     if (binder_result == -1) {
@@ -92,6 +110,9 @@ bool ActionExecutor::unfreeze(const AppInstanceKey& key, const std::vector<int>&
     if (pids.empty()) return true;
 
     LOGI("Starting unified unfreeze for %s...", key.first.c_str());
+    FlightRecorder& recorder = FlightRecorder::instance();
+    recorder.record(FlightRecordKind::THAW_BEGIN, key.second, static_cast<int>(pids.size()), 0, key.first);
+    auto start = std::chrono::steady_clock::now();
     
     // 步骤 1: 恢复 OOM Score (不影响执行)
     adjust_oom_scores(pids, false);
@@ -109,6 +130,7 @@ bool ActionExecutor::unfreeze(const AppInstanceKey& key, const std::vector<int>&
     unfreeze_sigstop(pids);
 
     LOGI("Unified unfreeze for %s completed.", key.first.c_str());
+    recorder.record(FlightRecordKind::THAW_END, key.second, elapsed_us_since(start), 1, key.first);
     return true;
 }
 
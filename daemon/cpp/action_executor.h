@@ -43,6 +43,8 @@ public:
 
 
 private:
+    // freeze() 的实际步骤，返回值含义相同
+    int freeze_pids(const AppInstanceKey& key, const std::vector<int>& pids);
     bool initialize_binder();
     void cleanup_binder();
     int handle_binder_freeze(const std::vector<int>& pids, bool freeze);
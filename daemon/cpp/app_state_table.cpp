@@ -0,0 +1,133 @@
+// daemon/cpp/app_state_table.cpp
+#include "app_state_table.h"
+#include <android/log.h>
+#include <algorithm>
+
+#define LOG_TAG "cerberusd_app_table"
+#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+#define LOGW(...) __android_log_print(ANDROID_LOG_WARN, LOG_TAG, __VA_ARGS__)
+
+// 内核默认值 (PID_MAX_DEFAULT)，读取 pid_max 失败时使用
+constexpr size_t DEFAULT_PID_MAX = 32768;
+// pid 数组每次增长的粒度，避免逐个 pid 扩容
+constexpr size_t PID_SLOTS_GROW_STEP = 4096;
+
+PackageId PackageInterner::intern(const std::string& package_name) {
+    auto it = ids_.find(package_name);
+    if (it != ids_.end()) return it->second;
+    PackageId id = static_cast<PackageId>(names_.size());
+    names_.push_back(package_name);
+    ids_.emplace(std::string_view(names_.back()), id);
+    return id;
+}
+
+PackageId PackageInterner::lookup(std::string_view package_name) const {
+    auto it = ids_.find(package_name);
+    return it != ids_.end() ? it->second : NOT_FOUND;
+}
+
+size_t AppStateTable::read_pid_max() {
+    std::string content = SystemMonitor::read_file_once("/proc/sys/kernel/pid_max", 64);
+    try {
+        long value = std::stol(content);
+        if (value > 0) return static_cast<size_t>(value);
+    } catch (...) {}
+    LOGW("Failed to read pid_max, falling back to %zu.", DEFAULT_PID_MAX);
+    return DEFAULT_PID_MAX;
+}
+
+AppStateTable::AppStateTable(size_t expected_apps) : pid_max_(read_pid_max()) {
+    hot_.reserve(expected_apps);
+    cold_.reserve(expected_apps);
+    key_index_.reserve(expected_apps);
+    uid_index_.reserve(expected_apps);
+    pid_slots_.assign(std::min(pid_max_, PID_SLOTS_GROW_STEP), INVALID_APP_SLOT);
+    LOGI("App state table ready (expected apps: %zu, pid_max: %zu).", expected_apps, pid_max_);
+}
+
+AppSlot AppStateTable::find(const std::string& package_name, int user_id) const {
+    PackageId id = packages_.lookup(package_name);
+    if (id == PackageInterner::NOT_FOUND) return INVALID_APP_SLOT;
+    auto it = key_index_.find(make_key(id, user_id));
+    return it != key_index_.end() ? it->second : INVALID_APP_SLOT;
+}
+
+AppSlot AppStateTable::find_by_uid(int uid) const {
+    if (uid < 0) return INVALID_APP_SLOT;
+    auto it = uid_index_.find(uid);
+    return it != uid_index_.end() ? it->second : INVALID_APP_SLOT;
+}
+
+AppSlot AppStateTable::find_by_pid(int pid) const {
+    if (pid < 0 || static_cast<size_t>(pid) >= pid_slots_.size()) return INVALID_APP_SLOT;
+    return pid_slots_[pid];
+}
+
+AppSlot AppStateTable::emplace(const std::string& package_name, int user_id) {
+    PackageId id = packages_.intern(package_name);
+    uint64_t key = make_key(id, user_id);
+    auto it = key_index_.find(key);
+    if (it != key_index_.end()) return it->second;
+
+    AppSlot slot = static_cast<AppSlot>(hot_.size());
+    AppRuntimeState& app = hot_.emplace_back();
+    app.slot = slot;
+    app.package_id = id;
+    app.user_id = user_id;
+    cold_.emplace_back();
+    key_index_.emplace(key, slot);
+    return slot;
+}
+
+bool AppStateTable::key_less(AppSlot a, AppSlot b) const {
+    const AppRuntimeState& left = hot_[a];
+    const AppRuntimeState& right = hot_[b];
+    if (left.package_id != right.package_id) return packages_.name(left.package_id) < packages_.name(right.package_id);
+    return left.user_id < right.user_id;
+}
+
+void AppStateTable::set_uid(AppSlot slot, int uid) {
+    AppRuntimeState& app = hot_[slot];
+    if (app.uid == uid) return;
+    int old_uid = app.uid;
+    app.uid = uid;
+    if (old_uid >= 0) {
+        auto it = uid_index_.find(old_uid);
+        if (it != uid_index_.end() && it->second == slot) {
+            // 索引指向的包换了 UID 时改指向仍使用旧 UID 的包中键最小者，没有时才删除。
+            // 只在共享 UID 的索引包变更时扫描整表，这种情况极少
+            AppSlot next = INVALID_APP_SLOT;
+            for (const auto& candidate : hot_) {
+                if (candidate.uid == old_uid && (next == INVALID_APP_SLOT || key_less(candidate.slot, next))) next = candidate.slot;
+            }
+            if (next != INVALID_APP_SLOT) it->second = next;
+            else uid_index_.erase(it);
+        }
+    }
+    // 共享 UID 的多个包以 (包名, 用户) 最小者为准：原先的应用表是以该键排序的 std::map，
+    // 按 UID 线性查找返回的首个匹配即是它
+    if (uid >= 0) {
+        auto [it, inserted] = uid_index_.emplace(uid, slot);
+        if (!inserted && key_less(slot, it->second)) it->second = slot;
+    }
+}
+
+void AppStateTable::map_pid(int pid, AppSlot slot) {
+    if (pid < 0) return;
+    size_t index = static_cast<size_t>(pid);
+    if (index >= pid_slots_.size()) {
+        if (index >= pid_max_) {
+            // pid_max 可在运行时调大，此时放宽上限
+            LOGW("PID %d exceeds pid_max %zu, extending table.", pid, pid_max_);
+            pid_max_ = index + 1;
+        }
+        size_t new_size = std::min(pid_max_, (index / PID_SLOTS_GROW_STEP + 1) * PID_SLOTS_GROW_STEP);
+        pid_slots_.resize(new_size, INVALID_APP_SLOT);
+    }
+    pid_slots_[index] = slot;
+}
+
+void AppStateTable::unmap_pid(int pid) {
+    if (pid < 0 || static_cast<size_t>(pid) >= pid_slots_.size()) return;
+    pid_slots_[pid] = INVALID_APP_SLOT;
+}
@@ -0,0 +1,138 @@
+// daemon/cpp/app_state_table.h
+#ifndef CERBERUS_APP_STATE_TABLE_H
+#define CERBERUS_APP_STATE_TABLE_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <cstdint>
+#include <ctime>
+#include <limits>
+#include "database_manager.h"
+#include "system_monitor.h"
+
+// 应用在状态表中的稠密下标。应用一旦登记便不会被删除，因此下标在整个进程生命周期内稳定。
+using AppSlot = uint32_t;
+// 驻留 (interned) 包名的编号
+using PackageId = uint32_t;
+
+constexpr AppSlot INVALID_APP_SLOT = std::numeric_limits<AppSlot>::max();
+
+// 热数据：状态机每个 tick 都会遍历的调度字段
+struct AppRuntimeState {
+    enum class Status {
+        STOPPED,
+        RUNNING,
+        FROZEN
+    } current_status = Status::STOPPED;
+
+    enum class FreezeMethod {
+        NONE,
+        CGROUP,
+        SIG_STOP
+    } freeze_method = FreezeMethod::NONE;
+
+    AppSlot slot = INVALID_APP_SLOT;
+    PackageId package_id = 0;
+    int uid = -1;
+    int user_id = 0;
+    std::vector<int> pids;
+    AppConfig config;
+    bool is_oom_protected = false;
+    bool is_foreground = false;
+    time_t background_since = 0;
+    time_t observation_since = 0;
+    time_t undetected_since = 0;
+    int freeze_retry_count = 0;
+    bool has_rogue_structure = false;
+    int rogue_puppet_pid = -1;
+    int rogue_master_pid = -1;
+    bool has_logged_rogue_warning = false;
+    int scheduled_unfreeze_idx = -1;
+    time_t last_wakeup_timestamp = 0;
+    int wakeup_count_in_window = 0;
+    time_t last_successful_wakeup_timestamp = 0;
+};
+
+// 冷数据：仅供仪表盘/报告展示的字段，与热数据按相同下标并行存放
+struct AppDisplayState {
+    std::string app_name;
+    float cpu_usage_percent = 0.0f;
+    long mem_usage_kb = 0;
+    long swap_usage_kb = 0;
+    long long last_foreground_timestamp_ms = 0;
+    long long total_runtime_ms = 0;
+};
+
+class PackageInterner {
+public:
+    static constexpr PackageId NOT_FOUND = std::numeric_limits<PackageId>::max();
+
+    PackageId intern(const std::string& package_name);
+    PackageId lookup(std::string_view package_name) const;
+    const std::string& name(PackageId id) const { return names_[id]; }
+    size_t size() const { return names_.size(); }
+
+private:
+    // deque 保证已驻留字符串的地址稳定，索引表可以直接以 string_view 作键
+    std::deque<std::string> names_;
+    std::unordered_map<std::string_view, PackageId> ids_;
+};
+
+class AppStateTable {
+public:
+    explicit AppStateTable(size_t expected_apps = 0);
+
+    AppSlot find(const std::string& package_name, int user_id) const;
+    AppSlot find(const AppInstanceKey& key) const { return find(key.first, key.second); }
+    AppSlot find_by_uid(int uid) const;
+    AppSlot find_by_pid(int pid) const;
+
+    // 登记新应用并返回其下标；若已存在则直接返回已有下标
+    AppSlot emplace(const std::string& package_name, int user_id);
+
+    // 修改 uid 必须经由此处，以保持 uid 索引一致
+    void set_uid(AppSlot slot, int uid);
+    void map_pid(int pid, AppSlot slot);
+    void unmap_pid(int pid);
+
+    AppRuntimeState& operator[](AppSlot slot) { return hot_[slot]; }
+    const AppRuntimeState& operator[](AppSlot slot) const { return hot_[slot]; }
+    AppDisplayState& display(AppSlot slot) { return cold_[slot]; }
+    const AppDisplayState& display(AppSlot slot) const { return cold_[slot]; }
+    AppDisplayState& display(const AppRuntimeState& app) { return cold_[app.slot]; }
+    const AppDisplayState& display(const AppRuntimeState& app) const { return cold_[app.slot]; }
+
+    const std::string& package_name(const AppRuntimeState& app) const { return packages_.name(app.package_id); }
+    AppInstanceKey key_of(const AppRuntimeState& app) const { return {package_name(app), app.user_id}; }
+
+    size_t size() const { return hot_.size(); }
+    bool empty() const { return hot_.empty(); }
+
+    // 注意：emplace() 可能导致底层 vector 重新分配，遍历过程中不得登记新应用
+    std::vector<AppRuntimeState>::iterator begin() { return hot_.begin(); }
+    std::vector<AppRuntimeState>::iterator end() { return hot_.end(); }
+    std::vector<AppRuntimeState>::const_iterator begin() const { return hot_.begin(); }
+    std::vector<AppRuntimeState>::const_iterator end() const { return hot_.end(); }
+
+private:
+    static uint64_t make_key(PackageId package_id, int user_id) {
+        return (static_cast<uint64_t>(package_id) << 32) | static_cast<uint32_t>(user_id);
+    }
+    static size_t read_pid_max();
+    // 按 (包名, 用户) 比较两个应用，与原先 std::map 的遍历顺序一致
+    bool key_less(AppSlot a, AppSlot b) const;
+
+    PackageInterner packages_;
+    std::vector<AppRuntimeState> hot_;
+    std::vector<AppDisplayState> cold_;
+    std::unordered_map<uint64_t, AppSlot> key_index_;
+    std::unordered_map<int, AppSlot> uid_index_;
+    // pid -> slot 的平铺数组，按需增长，上限为 /proc/sys/kernel/pid_max
+    std::vector<AppSlot> pid_slots_;
+    size_t pid_max_;
+};
+
+#endif // CERBERUS_APP_STATE_TABLE_H
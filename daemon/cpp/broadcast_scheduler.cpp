@@ -0,0 +1,121 @@
+// daemon/cpp/broadcast_scheduler.cpp
+#include "broadcast_scheduler.h"
+#include <android/log.h>
+
+#define LOG_TAG "cerberusd_broadcast"
+#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+#define LOGD(...) __android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, __VA_ARGS__)
+
+constexpr auto STATS_REPORT_INTERVAL = std::chrono::minutes(5);
+
+BroadcastScheduler::BroadcastScheduler(std::string name, std::chrono::milliseconds window)
+    : name_(std::move(name)), window_(window) {}
+
+BroadcastScheduler::~BroadcastScheduler() {
+    stop();
+}
+
+void BroadcastScheduler::set_subscriber_check(std::function<bool()> check) {
+    has_subscribers_ = std::move(check);
+}
+
+void BroadcastScheduler::set_flush_handler(std::function<size_t()> handler) {
+    on_flush_ = std::move(handler);
+}
+
+void BroadcastScheduler::set_window(std::chrono::milliseconds window) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    window_ = window;
+}
+
+std::chrono::milliseconds BroadcastScheduler::window() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return window_;
+}
+
+void BroadcastScheduler::start() {
+    if (is_running_.exchange(true)) return;
+    last_report_time_ = std::chrono::steady_clock::now();
+    scheduler_thread_ = std::thread(&BroadcastScheduler::scheduler_thread_func, this);
+    LOGI("[%s] Broadcast scheduler started (window %lldms).", name_.c_str(), (long long)window_.count());
+}
+
+void BroadcastScheduler::stop() {
+    {
+        // 在锁内清除标志：调度线程检查条件与进入等待之间不会错过这次通知
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!is_running_.exchange(false)) return;
+    }
+    cv_.notify_all();
+    if (scheduler_thread_.joinable()) {
+        scheduler_thread_.join();
+    }
+}
+
+void BroadcastScheduler::mark_dirty() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.dirty_marks++;
+        marks_since_flush_++;
+        if (dirty_) return;
+        dirty_ = true;
+    }
+    cv_.notify_one();
+}
+
+BroadcastScheduler::Stats BroadcastScheduler::get_stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+void BroadcastScheduler::report_stats_if_due(std::chrono::steady_clock::time_point now) {
+    if (now - last_report_time_ < STATS_REPORT_INTERVAL) return;
+    last_report_time_ = now;
+    double ratio = stats_.flushes > 0 ? static_cast<double>(stats_.dirty_marks) / stats_.flushes : 0.0;
+    LOGI("[%s] marks=%llu flushes=%llu skipped(no subscriber)=%llu coalescing=%.2f:1 sent=%lluB saved~%lluB",
+         name_.c_str(),
+         (unsigned long long)stats_.dirty_marks, (unsigned long long)stats_.flushes,
+         (unsigned long long)stats_.skipped_no_subscriber, ratio,
+         (unsigned long long)stats_.bytes_sent, (unsigned long long)stats_.bytes_saved);
+}
+
+void BroadcastScheduler::scheduler_thread_func() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (is_running_) {
+        cv_.wait(lock, [this]{ return dirty_ || !is_running_; });
+        if (!is_running_) break;
+
+        // 前沿触发：距上次推送已超过窗口则立即发送，否则等到窗口结束再合并发送
+        auto due = last_flush_time_ + window_;
+        if (std::chrono::steady_clock::now() < due) {
+            cv_.wait_until(lock, due, [this]{ return !is_running_; });
+            if (!is_running_) break;
+        }
+
+        dirty_ = false;
+        uint64_t coalesced_marks = marks_since_flush_;
+        marks_since_flush_ = 0;
+        lock.unlock();
+
+        bool has_subscribers = !has_subscribers_ || has_subscribers_();
+        size_t bytes = 0;
+        if (has_subscribers && on_flush_) {
+            bytes = on_flush_();
+        }
+
+        lock.lock();
+        auto now = std::chrono::steady_clock::now();
+        last_flush_time_ = now;
+        if (has_subscribers) {
+            stats_.flushes++;
+            stats_.bytes_sent += bytes;
+            last_payload_bytes_ = bytes;
+            if (coalesced_marks > 1) stats_.bytes_saved += (coalesced_marks - 1) * bytes;
+        } else {
+            stats_.skipped_no_subscriber++;
+            stats_.bytes_saved += coalesced_marks * last_payload_bytes_;
+            LOGD("[%s] No subscribers, skipped serialisation.", name_.c_str());
+        }
+        report_stats_if_due(now);
+    }
+}
@@ -0,0 +1,67 @@
+// daemon/cpp/broadcast_scheduler.h
+#ifndef CERBERUS_BROADCAST_SCHEDULER_H
+#define CERBERUS_BROADCAST_SCHEDULER_H
+
+#include <string>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+#include <cstdint>
+
+// 将频繁的“仪表盘已变脏”通知合并为窗口期内至多一次的实际推送。
+// 没有订阅者时完全跳过序列化。
+class BroadcastScheduler {
+public:
+    struct Stats {
+        uint64_t dirty_marks = 0;      // mark_dirty() 调用次数
+        uint64_t flushes = 0;          // 实际序列化并发送的次数
+        uint64_t skipped_no_subscriber = 0;
+        uint64_t bytes_sent = 0;
+        uint64_t bytes_saved = 0;      // 被合并/跳过的推送按最近一次载荷大小估算
+    };
+
+    explicit BroadcastScheduler(std::string name, std::chrono::milliseconds window);
+    ~BroadcastScheduler();
+
+    BroadcastScheduler(const BroadcastScheduler&) = delete;
+    BroadcastScheduler& operator=(const BroadcastScheduler&) = delete;
+
+    void start();
+    void stop();
+
+    // 检查当前是否有订阅者
+    void set_subscriber_check(std::function<bool()> check);
+    // 构建并发送载荷，返回发送的字节数
+    void set_flush_handler(std::function<size_t()> handler);
+    // 新窗口从下一次推送起生效
+    void set_window(std::chrono::milliseconds window);
+    std::chrono::milliseconds window() const;
+
+    void mark_dirty();
+    Stats get_stats() const;
+
+private:
+    void scheduler_thread_func();
+    void report_stats_if_due(std::chrono::steady_clock::time_point now);
+
+    std::string name_;
+    std::chrono::milliseconds window_;
+    std::function<bool()> has_subscribers_;
+    std::function<size_t()> on_flush_;
+
+    std::atomic<bool> is_running_{false};
+    std::thread scheduler_thread_;
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    bool dirty_ = false;
+    uint64_t marks_since_flush_ = 0;
+    size_t last_payload_bytes_ = 0;
+    std::chrono::steady_clock::time_point last_flush_time_;
+    std::chrono::steady_clock::time_point last_report_time_;
+    Stats stats_;
+};
+
+#endif // CERBERUS_BROADCAST_SCHEDULER_H
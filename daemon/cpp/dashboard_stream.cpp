@@ -0,0 +1,220 @@
+// daemon/cpp/dashboard_stream.cpp
+#include "dashboard_stream.h"
+#include <android/log.h>
+#include <algorithm>
+
+#define LOG_TAG "cerberusd_dashboard_stream"
+#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+
+json DashboardStreamer::Totals::to_json() const {
+    return json{
+        {"app_count", app_count},
+        {"cpu_usage_percent", cpu_usage_percent},
+        {"mem_usage_kb", mem_usage_kb},
+        {"swap_usage_kb", swap_usage_kb}
+    };
+}
+
+bool DashboardStreamer::Totals::operator==(const Totals& other) const {
+    return app_count == other.app_count && cpu_usage_percent == other.cpu_usage_percent &&
+           mem_usage_kb == other.mem_usage_kb && swap_usage_kb == other.swap_usage_kb;
+}
+
+DashboardStreamer::Options DashboardStreamer::parse_options(const json& payload) {
+    Options options;
+    std::string sort_by = payload.value("sort_by", "");
+    if (sort_by == "cpu") options.sort_by = SortKey::CPU;
+    else if (sort_by == "mem") options.sort_by = SortKey::MEM;
+    else if (sort_by == "swap") options.sort_by = SortKey::SWAP;
+    else if (sort_by == "name") options.sort_by = SortKey::NAME;
+    int top_n = payload.value("top_n", 0);
+    options.top_n = top_n > 0 ? static_cast<size_t>(top_n) : 0;
+    return options;
+}
+
+const char* DashboardStreamer::sort_key_name(SortKey key) {
+    switch (key) {
+        case SortKey::CPU: return "cpu";
+        case SortKey::MEM: return "mem";
+        case SortKey::SWAP: return "swap";
+        case SortKey::NAME: return "name";
+        default: return "none";
+    }
+}
+
+std::string DashboardStreamer::row_key(const DashboardAppView& view) {
+    return view.package_name + ":" + std::to_string(view.user_id);
+}
+
+void DashboardStreamer::subscribe(int client_fd, const json& payload) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Session session;
+    session.options = parse_options(payload);
+    sessions_[client_fd] = std::move(session);
+    LOGI("Client fd %d subscribed to delta dashboard (sort=%s, top_n=%zu).",
+         client_fd, sort_key_name(sessions_[client_fd].options.sort_by), sessions_[client_fd].options.top_n);
+}
+
+void DashboardStreamer::unsubscribe(int client_fd) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    sessions_.erase(client_fd);
+}
+
+bool DashboardStreamer::is_subscribed(int client_fd) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return sessions_.count(client_fd) > 0;
+}
+
+std::vector<int> DashboardStreamer::subscribed_clients() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<int> fds;
+    fds.reserve(sessions_.size());
+    for (const auto& [fd, session] : sessions_) fds.push_back(fd);
+    return fds;
+}
+
+std::vector<const DashboardAppView*> DashboardStreamer::select_rows(const StateSnapshot& snapshot, const Options& options) {
+    std::vector<const DashboardAppView*> rows;
+    rows.reserve(snapshot.apps.size());
+    for (const auto& view : snapshot.apps) rows.push_back(&view);
+
+    auto comparator = [&options](const DashboardAppView* a, const DashboardAppView* b) {
+        switch (options.sort_by) {
+            case SortKey::CPU:
+                if (a->cpu_usage_percent != b->cpu_usage_percent) return a->cpu_usage_percent > b->cpu_usage_percent;
+                break;
+            case SortKey::MEM:
+                if (a->mem_usage_kb != b->mem_usage_kb) return a->mem_usage_kb > b->mem_usage_kb;
+                break;
+            case SortKey::SWAP:
+                if (a->swap_usage_kb != b->swap_usage_kb) return a->swap_usage_kb > b->swap_usage_kb;
+                break;
+            case SortKey::NAME:
+                if (a->app_name != b->app_name) return a->app_name < b->app_name;
+                break;
+            default:
+                break;
+        }
+        // 排序值相同时按 row_key 的组成（包名、用户）排，否则同值的行会随快照中的顺序在补丁之间来回换位
+        if (a->package_name != b->package_name) return a->package_name < b->package_name;
+        return a->user_id < b->user_id;
+    };
+    size_t limit = options.top_n > 0 ? std::min(options.top_n, rows.size()) : rows.size();
+    if (options.sort_by != SortKey::NONE) {
+        // 只需要前 N 行时使用 partial_sort，避免对全部应用排序
+        std::partial_sort(rows.begin(), rows.begin() + limit, rows.end(), comparator);
+    }
+    rows.resize(limit);
+    return rows;
+}
+
+DashboardStreamer::Totals DashboardStreamer::compute_totals(const StateSnapshot& snapshot) {
+    Totals totals;
+    totals.app_count = snapshot.apps.size();
+    for (const auto& view : snapshot.apps) {
+        totals.cpu_usage_percent += view.cpu_usage_percent;
+        totals.mem_usage_kb += view.mem_usage_kb;
+        totals.swap_usage_kb += view.swap_usage_kb;
+    }
+    return totals;
+}
+
+json DashboardStreamer::next_message(int client_fd, const StateSnapshot& snapshot) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = sessions_.find(client_fd);
+    if (it == sessions_.end()) return nullptr;
+    Session& session = it->second;
+    // 比基线旧的快照（并发路径先后取到的快照）不产生补丁，版本不会倒退
+    if (session.has_baseline && snapshot.version <= session.version) return nullptr;
+
+    auto selected = select_rows(snapshot, session.options);
+    Totals totals = compute_totals(snapshot);
+    json global_stats = snapshot.global_stats ? snapshot.global_stats->to_json() : json::object();
+
+    std::vector<std::string> order;
+    std::unordered_map<std::string, json> rows;
+    order.reserve(selected.size());
+    rows.reserve(selected.size());
+    for (const auto* view : selected) {
+        std::string key = row_key(*view);
+        order.push_back(key);
+        rows.emplace(std::move(key), view->to_json());
+    }
+
+    json message;
+    if (!session.has_baseline) {
+        json rows_json = json::array();
+        for (const auto& key : order) rows_json.push_back(rows[key]);
+        message = {
+            {"type", "stream.dashboard_snapshot"},
+            {"payload", {
+                {"version", snapshot.version},
+                {"sort_by", sort_key_name(session.options.sort_by)},
+                {"top_n", session.options.top_n},
+                {"global_stats", global_stats},
+                {"totals", totals.to_json()},
+                {"apps_runtime_state", rows_json}
+            }}
+        };
+    } else {
+        json patch = {
+            {"base_version", session.version},
+            {"version", snapshot.version}
+        };
+        if (global_stats != session.global_stats) patch["global_stats"] = global_stats;
+        if (!(totals == session.totals)) patch["totals"] = totals.to_json();
+        if (order != session.order) patch["order"] = order;
+
+        json upserts = json::array();
+        for (const auto& key : order) {
+            const json& current = rows[key];
+            auto old_it = session.rows.find(key);
+            if (old_it == session.rows.end()) {
+                upserts.push_back(current);
+                continue;
+            }
+            // 只携带变化的字段，身份字段始终保留以便客户端定位
+            json changed = {
+                {"package_name", current["package_name"]},
+                {"user_id", current["user_id"]}
+            };
+            bool has_change = false;
+            for (auto field = current.begin(); field != current.end(); ++field) {
+                auto old_field = old_it->second.find(field.key());
+                if (old_field == old_it->second.end() || *old_field != field.value()) {
+                    changed[field.key()] = field.value();
+                    has_change = true;
+                }
+            }
+            for (auto field = old_it->second.begin(); field != old_it->second.end(); ++field) {
+                if (!current.contains(field.key())) {
+                    changed[field.key()] = nullptr;
+                    has_change = true;
+                }
+            }
+            if (has_change) upserts.push_back(std::move(changed));
+        }
+        if (!upserts.empty()) patch["upserts"] = std::move(upserts);
+
+        json removes = json::array();
+        for (const auto& key : session.order) {
+            if (rows.find(key) == rows.end()) removes.push_back(key);
+        }
+        if (!removes.empty()) patch["removes"] = std::move(removes);
+
+        if (patch.size() == 2) {
+            // 版本号前进了，但对该客户端可见的内容没有任何变化。什么都不发送，基线版本也保持不变，
+            // 下一条补丁的 base_version 仍是客户端手里的版本
+            return nullptr;
+        }
+        message = {{"type", "stream.dashboard_patch"}, {"payload", std::move(patch)}};
+    }
+
+    session.has_baseline = true;
+    session.version = snapshot.version;
+    session.order = std::move(order);
+    session.rows = std::move(rows);
+    session.global_stats = std::move(global_stats);
+    session.totals = totals;
+    return message;
+}
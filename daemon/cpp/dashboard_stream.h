@@ -0,0 +1,71 @@
+// daemon/cpp/dashboard_stream.h
+#ifndef CERBERUS_DASHBOARD_STREAM_H
+#define CERBERUS_DASHBOARD_STREAM_H
+
+#include <nlohmann/json.hpp>
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <mutex>
+#include <cstdint>
+#include "state_manager.h"
+
+using json = nlohmann::json;
+
+// 增量仪表盘协议：
+//   客户端发送 cmd.dashboard_subscribe {sort_by, top_n} 后，先收到一条 stream.dashboard_snapshot，
+//   此后每次推送为 stream.dashboard_patch，只携带变化的字段。
+//   补丁中的 base_version 与客户端本地版本不符时，客户端应重新订阅以获取完整快照。
+// 未订阅的旧客户端继续接收完整的 stream.dashboard_update。
+class DashboardStreamer {
+public:
+    enum class SortKey { NONE, CPU, MEM, SWAP, NAME };
+
+    struct Options {
+        SortKey sort_by = SortKey::NONE;
+        size_t top_n = 0; // 0 表示不截断
+    };
+
+    // 订阅或重新订阅：会丢弃该客户端的基线，下一条消息为完整快照
+    void subscribe(int client_fd, const json& payload);
+    void unsubscribe(int client_fd);
+    bool is_subscribed(int client_fd) const;
+    std::vector<int> subscribed_clients() const;
+
+    // 生成发给该客户端的下一条消息；快照版本不比基线新或没有任何差异时返回 null。
+    // 返回 json 而非文本，由 UdsServer 按该连接协商的编码序列化
+    json next_message(int client_fd, const StateSnapshot& snapshot);
+
+private:
+    struct Totals {
+        size_t app_count = 0;
+        double cpu_usage_percent = 0.0;
+        long long mem_usage_kb = 0;
+        long long swap_usage_kb = 0;
+
+        json to_json() const;
+        bool operator==(const Totals& other) const;
+    };
+
+    struct Session {
+        Options options;
+        bool has_baseline = false;
+        uint64_t version = 0;
+        std::vector<std::string> order;
+        std::unordered_map<std::string, json> rows;
+        json global_stats;
+        Totals totals;
+    };
+
+    static Options parse_options(const json& payload);
+    static const char* sort_key_name(SortKey key);
+    static std::string row_key(const DashboardAppView& view);
+    static std::vector<const DashboardAppView*> select_rows(const StateSnapshot& snapshot, const Options& options);
+    static Totals compute_totals(const StateSnapshot& snapshot);
+
+    mutable std::mutex mutex_;
+    std::map<int, Session> sessions_;
+};
+
+#endif // CERBERUS_DASHBOARD_STREAM_H
@@ -0,0 +1,351 @@
+// daemon/cpp/flight_recorder.cpp
+#include "flight_recorder.h"
+#include <android/log.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <cstdio>
+#include <algorithm>
+#include <chrono>
+#include <initializer_list>
+#include <new>
+
+#define LOG_TAG "cerberusd_flight_recorder"
+#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+#define LOGW(...) __android_log_print(ANDROID_LOG_WARN, LOG_TAG, __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+
+using namespace flight_recorder_layout;
+
+// 校验和之前的定长字段：timestamp_ms 到 value
+constexpr size_t SLOT_FIXED_BYTES = offsetof(FlightSlotBody, text);
+constexpr char FIELD_SEPARATOR = '\x1f';
+
+// 每次吸收 8 字节的 FNV 变体：记录在热路径上，逐字节的 FNV-1a 占了写入开销的大半
+static uint64_t mix_bytes(const void* data, size_t size, uint64_t hash) {
+    const auto* bytes = static_cast<const uint8_t*>(data);
+    for (; size >= 8; bytes += 8, size -= 8) {
+        uint64_t word;
+        std::memcpy(&word, bytes, 8);
+        hash = (hash ^ word) * 0x100000001b3ULL;
+        hash ^= hash >> 29;
+    }
+    for (; size > 0; ++bytes, --size) hash = (hash ^ *bytes) * 0x100000001b3ULL;
+    return hash;
+}
+
+static uint32_t slot_checksum(uint64_t seq, const FlightSlotBody& body) {
+    FlightSlotBody fixed;
+    std::memcpy(&fixed, &body, SLOT_FIXED_BYTES);
+    fixed.checksum = 0;
+    uint64_t hash = mix_bytes(&seq, sizeof(seq), 0xcbf29ce484222325ULL);
+    hash = mix_bytes(&fixed, SLOT_FIXED_BYTES, hash);
+    hash = mix_bytes(body.text, std::min<size_t>(body.text_len, FLIGHT_TEXT_BYTES), hash);
+    return static_cast<uint32_t>(hash ^ (hash >> 32));
+}
+
+static long long wall_clock_ms() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()
+    ).count();
+}
+
+// 以分隔符拼接各段写入 out，超出 FLIGHT_TEXT_BYTES 时在 UTF-8 字符边界截断
+static size_t pack_text(std::initializer_list<std::string_view> parts, char* out, bool& truncated) {
+    size_t len = 0;
+    truncated = false;
+    bool first = true;
+    for (std::string_view part : parts) {
+        if (!first) {
+            if (len == FLIGHT_TEXT_BYTES) { truncated = true; break; }
+            out[len++] = FIELD_SEPARATOR;
+        }
+        first = false;
+        size_t room = FLIGHT_TEXT_BYTES - len;
+        if (part.size() <= room) {
+            std::memcpy(out + len, part.data(), part.size());
+            len += part.size();
+            continue;
+        }
+        size_t cut = room;
+        while (cut > 0 && (static_cast<uint8_t>(part[cut]) & 0xC0) == 0x80) --cut;
+        std::memcpy(out + len, part.data(), cut);
+        len += cut;
+        truncated = true;
+        break;
+    }
+    return len;
+}
+
+// --- FlightRecorder ---
+
+FlightRecorder& FlightRecorder::instance() {
+    // 不析构：退出阶段仍在运行的线程可能继续记录
+    static FlightRecorder* recorder = new FlightRecorder();
+    return *recorder;
+}
+
+FlightRecorder::~FlightRecorder() {
+    if (mapping_) munmap(mapping_, mapping_size_);
+    if (fd_ != -1) close(fd_);
+}
+
+bool FlightRecorder::open(const std::string& path, uint32_t capacity) {
+    capacity = std::clamp<uint32_t>(capacity, 16, MAX_CAPACITY);
+    recovered_ = decode(path);
+
+    fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd_ == -1) {
+        LOGE("Failed to open flight recorder %s: %s", path.c_str(), strerror(errno));
+        return false;
+    }
+    // 上一次运行的内容已在 recovered_ 中，截断后重新扩展得到全零的文件，所有槽位的 seq 都是 0
+    size_t size = HEADER_SIZE + static_cast<size_t>(capacity) * SLOT_SIZE;
+    if (ftruncate(fd_, 0) == -1 || ftruncate(fd_, static_cast<off_t>(size)) == -1) {
+        LOGE("Failed to size flight recorder: %s", strerror(errno));
+        return false;
+    }
+    mapping_ = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (mapping_ == MAP_FAILED) {
+        mapping_ = nullptr;
+        LOGE("mmap of flight recorder failed: %s", strerror(errno));
+        return false;
+    }
+    mapping_size_ = size;
+
+    auto* header = new (mapping_) FlightRecorderHeader{};
+    header->magic = MAGIC;
+    header->version = VERSION;
+    header->header_size = HEADER_SIZE;
+    header->slot_size = SLOT_SIZE;
+    header->capacity = capacity;
+    header->pid = getpid();
+    header->started_ms = wall_clock_ms();
+    header->clean_shutdown.store(0, std::memory_order_relaxed);
+    header->next_seq.store(0, std::memory_order_relaxed);
+    header->log_persisted_pos.store(0, std::memory_order_relaxed);
+    slots_ = reinterpret_cast<FlightSlot*>(static_cast<char*>(mapping_) + HEADER_SIZE);
+    capacity_ = capacity;
+    std::atomic_thread_fence(std::memory_order_release);
+    header_ = header;
+    record(FlightRecordKind::DAEMON_START, header->pid, 0, 0, {});
+    LOGI("Flight recorder ready (%zu bytes, %u slots).", size, capacity);
+    return true;
+}
+
+void FlightRecorder::mark_clean_shutdown() {
+    if (header_) header_->clean_shutdown.store(1, std::memory_order_release);
+}
+
+uint64_t FlightRecorder::next_seq() const {
+    return header_ ? header_->next_seq.load(std::memory_order_acquire) : 0;
+}
+
+uint64_t FlightRecorder::write_slot(FlightRecordKind kind, long long timestamp_ms, int level, int a, int b, int64_t value,
+                                    std::string_view part1, std::string_view part2, std::string_view part3) {
+    if (!header_) return 0;
+    FlightSlotBody body;
+    body.timestamp_ms = timestamp_ms;
+    body.kind = static_cast<uint8_t>(kind);
+    body.level = static_cast<uint8_t>(level);
+    body.a = a;
+    body.b = b;
+    body.value = value;
+    bool truncated;
+    size_t len = kind == FlightRecordKind::LOG ? pack_text({part1, part2, part3}, body.text, truncated)
+                                                : pack_text({part1}, body.text, truncated);
+    body.text_len = static_cast<uint8_t>(len);
+    body.truncated = truncated ? 1 : 0;
+
+    uint64_t seq = header_->next_seq.fetch_add(1, std::memory_order_relaxed) + 1;
+    body.checksum = slot_checksum(seq, body);
+    FlightSlot& slot = slots_[(seq - 1) % capacity_];
+    // 先作废旧内容再覆写；中途被杀时槽位的 seq 为 0 或与内容不符，解码时都会丢弃
+    slot.seq.store(0, std::memory_order_relaxed);
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+    std::memcpy(&slot.body, &body, SLOT_FIXED_BYTES + len);
+    slot.seq.store(seq, std::memory_order_release);
+    return seq;
+}
+
+uint64_t FlightRecorder::record(FlightRecordKind kind, int a, int b, int64_t value, std::string_view text, int level) {
+    if (!header_) return 0;
+    return write_slot(kind, wall_clock_ms(), level, a, b, value, text, {}, {});
+}
+
+void FlightRecorder::record_log(long long timestamp_ms, LogLevel level, std::string_view category, std::string_view package_name,
+                                int user_id, std::string_view message, uint64_t queue_pos) {
+    if (!header_) return;
+    write_slot(FlightRecordKind::LOG, timestamp_ms, static_cast<int>(level), user_id, 0, static_cast<int64_t>(queue_pos),
+               category, package_name, message);
+}
+
+void FlightRecorder::mark_log_persisted(uint64_t queue_pos_end) {
+    if (header_) header_->log_persisted_pos.store(queue_pos_end, std::memory_order_release);
+}
+
+FlightRecovery FlightRecorder::decode(const std::string& path) {
+    FlightRecovery recovery;
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) return recovery;
+    struct stat st;
+    if (fstat(fd, &st) == -1 || static_cast<size_t>(st.st_size) < HEADER_SIZE) {
+        close(fd);
+        return recovery;
+    }
+    size_t size = static_cast<size_t>(st.st_size);
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) return recovery;
+
+    const auto* header = static_cast<const FlightRecorderHeader*>(mapping);
+    uint32_t capacity = header->capacity;
+    if (header->magic != MAGIC || header->version != VERSION || header->slot_size != SLOT_SIZE ||
+        capacity == 0 || capacity > MAX_CAPACITY || size < HEADER_SIZE + static_cast<size_t>(capacity) * SLOT_SIZE) {
+        LOGW("Flight recorder %s has an unknown layout, ignoring it.", path.c_str());
+        munmap(mapping, size);
+        return recovery;
+    }
+    recovery.found = true;
+    recovery.clean_shutdown = header->clean_shutdown.load(std::memory_order_relaxed) != 0;
+    recovery.pid = header->pid;
+    recovery.started_ms = header->started_ms;
+    recovery.next_seq = header->next_seq.load(std::memory_order_relaxed);
+    recovery.log_persisted_pos = header->log_persisted_pos.load(std::memory_order_relaxed);
+
+    const auto* slots = reinterpret_cast<const FlightSlot*>(static_cast<const char*>(mapping) + HEADER_SIZE);
+    for (uint32_t i = 0; i < capacity; ++i) {
+        const FlightSlot& slot = slots[i];
+        uint64_t seq = slot.seq.load(std::memory_order_acquire);
+        if (seq == 0) {
+            // 从未写过的槽位；已分配过 seq 的说明写到一半
+            if (i < recovery.next_seq) recovery.torn++;
+            continue;
+        }
+        const FlightSlotBody& body = slot.body;
+        if ((seq - 1) % capacity != i || seq > recovery.next_seq || body.text_len > FLIGHT_TEXT_BYTES ||
+            slot_checksum(seq, body) != body.checksum) {
+            recovery.torn++;
+            continue;
+        }
+        FlightRecord record;
+        record.seq = seq;
+        record.timestamp_ms = body.timestamp_ms;
+        record.kind = static_cast<FlightRecordKind>(body.kind);
+        record.level = body.level;
+        record.a = body.a;
+        record.b = body.b;
+        record.value = body.value;
+        record.truncated = body.truncated != 0;
+        record.text.assign(body.text, body.text_len);
+        recovery.records.push_back(std::move(record));
+    }
+    munmap(mapping, size);
+    std::sort(recovery.records.begin(), recovery.records.end(),
+              [](const FlightRecord& x, const FlightRecord& y) { return x.seq < y.seq; });
+    return recovery;
+}
+
+static std::string format_ms(int us) {
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.1fms", us / 1000.0);
+    return buffer;
+}
+
+std::vector<LogEntry> FlightRecorder::to_log_entries(const FlightRecovery& recovery) {
+    std::vector<LogEntry> entries;
+    if (!recovery.found || recovery.records.empty()) return entries;
+    const std::string category = "飞行记录";
+
+    size_t lost_logs = 0;
+    std::vector<LogEntry> recovered;
+    for (const auto& record : recovery.records) {
+        std::string suffix = record.truncated ? "…" : "";
+        switch (record.kind) {
+            case FlightRecordKind::LOG: {
+                // 已写入段文件的日志不再重复
+                if (static_cast<uint64_t>(record.value) < recovery.log_persisted_pos) break;
+                size_t first = record.text.find(FIELD_SEPARATOR);
+                size_t second = first == std::string::npos ? std::string::npos : record.text.find(FIELD_SEPARATOR, first + 1);
+                LogEntry entry{record.timestamp_ms, static_cast<LogLevel>(record.level), category, record.text + suffix, "", record.a};
+                if (second != std::string::npos) {
+                    entry.category = record.text.substr(0, first);
+                    entry.package_name = record.text.substr(first + 1, second - first - 1);
+                    entry.message = record.text.substr(second + 1) + suffix;
+                }
+                recovered.push_back(std::move(entry));
+                lost_logs++;
+                break;
+            }
+            case FlightRecordKind::DAEMON_START:
+                recovered.push_back({record.timestamp_ms, LogLevel::EVENT, category, "守护进程启动 (PID " + std::to_string(record.a) + ")", "", 0});
+                break;
+            case FlightRecordKind::FREEZE_BEGIN:
+                recovered.push_back({record.timestamp_ms, LogLevel::INFO, category, "开始冻结 (" + std::to_string(record.b) + " 个进程)", record.text, record.a});
+                break;
+            case FlightRecordKind::FREEZE_END:
+                recovered.push_back({record.timestamp_ms, LogLevel::INFO, category,
+                                     "冻结结束，结果 " + std::to_string(record.value) + "，用时 " + format_ms(record.b), record.text, record.a});
+                break;
+            case FlightRecordKind::THAW_BEGIN:
+                recovered.push_back({record.timestamp_ms, LogLevel::INFO, category, "开始解冻 (" + std::to_string(record.b) + " 个进程)", record.text, record.a});
+                break;
+            case FlightRecordKind::THAW_END:
+                recovered.push_back({record.timestamp_ms, LogLevel::INFO, category,
+                                     std::string(record.value ? "解冻完成" : "解冻失败") + "，用时 " + format_ms(record.b), record.text, record.a});
+                break;
+            case FlightRecordKind::LOCK_WAIT:
+                recovered.push_back({record.timestamp_ms, LogLevel::WARN, category, "等待 " + record.text + suffix + " " + format_ms(record.b), "", 0});
+                break;
+            case FlightRecordKind::IPC_COMMAND:
+                recovered.push_back({record.timestamp_ms, LogLevel::INFO, category,
+                                     "收到 " + record.text + suffix + " (fd " + std::to_string(record.a) + ", " + std::to_string(record.b) + " 字节)", "", 0});
+                break;
+            default:
+                break;
+        }
+    }
+
+    std::string summary = "上次运行 (PID " + std::to_string(recovery.pid) + ") 未正常退出，从飞行记录器恢复 " +
+                          std::to_string(recovered.size()) + " 条记录，其中 " + std::to_string(lost_logs) + " 条日志未及落盘";
+    if (recovery.torn > 0) summary += "，" + std::to_string(recovery.torn) + " 条写入中断";
+    entries.push_back({wall_clock_ms(), LogLevel::WARN, category, summary, "", 0});
+    std::move(recovered.begin(), recovered.end(), std::back_inserter(entries));
+    return entries;
+}
+
+// --- RecordedMutex ---
+
+void RecordedMutex::lock() {
+    if (try_lock()) return;
+    auto start = std::chrono::steady_clock::now();
+    mutex_.lock();
+    auto waited_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    acquisitions_.fetch_add(1, std::memory_order_relaxed);
+    contended_.fetch_add(1, std::memory_order_relaxed);
+    total_wait_us_.fetch_add(static_cast<uint64_t>(waited_us), std::memory_order_relaxed);
+    if (static_cast<uint64_t>(waited_us) > max_wait_us_.load(std::memory_order_relaxed)) {
+        max_wait_us_.store(static_cast<uint64_t>(waited_us), std::memory_order_relaxed);
+    }
+    if (waited_us >= threshold_us_) {
+        FlightRecorder::instance().record(FlightRecordKind::LOCK_WAIT, 0, static_cast<int>(std::min<long long>(waited_us, INT32_MAX)), 0, name_);
+    }
+}
+
+bool RecordedMutex::try_lock() {
+    if (!mutex_.try_lock()) return false;
+    acquisitions_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+RecordedMutex::Stats RecordedMutex::get_stats() const {
+    Stats stats;
+    stats.acquisitions = acquisitions_.load(std::memory_order_relaxed);
+    stats.contended = contended_.load(std::memory_order_relaxed);
+    stats.total_wait_us = total_wait_us_.load(std::memory_order_relaxed);
+    stats.max_wait_us = max_wait_us_.load(std::memory_order_relaxed);
+    return stats;
+}
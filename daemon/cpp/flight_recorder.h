@@ -0,0 +1,186 @@
+// daemon/cpp/flight_recorder.h
+#ifndef CERBERUS_FLIGHT_RECORDER_H
+#define CERBERUS_FLIGHT_RECORDER_H
+
+#include "logger.h"
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// 崩溃后仍可读取的飞行记录器：固定大小的文件以 MAP_SHARED 映射，记录只是对映射内存的普通写入，
+// 不经过任何系统调用。进程被杀或崩溃时，已写入的页仍在页缓存中，重启后由下一个进程解码。
+//
+// 布局（小端，偏移单位为字节）：
+//   [0,   128)  FlightRecorderHeader
+//   [128, ...)  capacity 个 128 字节的 FlightSlot，第 seq 条记录写在 (seq - 1) % capacity
+// 写者先以 fetch_add 取得 seq，把槽位的 seq 清零后写入内容，最后以 release 写回 seq。
+// 校验和覆盖 seq 与内容，写到一半被杀的槽位（包括编译器重排后残留旧 seq 的情况）解码时丢弃。
+namespace flight_recorder_layout {
+constexpr uint32_t MAGIC = 0x524C4643;  // "CFLR"
+constexpr uint16_t VERSION = 1;
+constexpr uint32_t HEADER_SIZE = 128;
+constexpr uint32_t SLOT_SIZE = 128;
+constexpr uint32_t DEFAULT_CAPACITY = 4096;
+constexpr uint32_t MAX_CAPACITY = 1u << 20;
+} // namespace flight_recorder_layout
+
+enum class FlightRecordKind : uint8_t {
+    DAEMON_START = 1,   // a = pid
+    LOG = 2,            // level / a = user_id / value = 日志队列位置，文本为 分类 \x1f 包名 \x1f 消息
+    FREEZE_BEGIN = 3,   // a = user_id，b = 进程数，文本为包名
+    FREEZE_END = 4,     // a = user_id，b = 用时（微秒），value = freeze() 的返回值
+    THAW_BEGIN = 5,
+    THAW_END = 6,       // value = unfreeze() 是否成功
+    LOCK_WAIT = 7,      // b = 等待（微秒），文本为锁名
+    IPC_COMMAND = 8     // a = 客户端 fd，b = 消息字节数，文本为消息类型
+};
+
+struct FlightRecorderHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t header_size;
+    uint32_t slot_size;
+    uint32_t capacity;
+    int32_t pid;
+    uint32_t reserved;
+    int64_t started_ms;
+    // 正常退出时置 1；下次启动读到 0 说明上一次运行是被杀或崩溃的
+    std::atomic<uint32_t> clean_shutdown;
+    uint32_t reserved2[7];
+    alignas(64) std::atomic<uint64_t> next_seq;
+    // 日志写入线程已写入段文件的队列位置（不含），之前的 LOG 记录无需恢复
+    std::atomic<uint64_t> log_persisted_pos;
+};
+static_assert(sizeof(FlightRecorderHeader) <= flight_recorder_layout::HEADER_SIZE, "header exceeds reserved space");
+
+constexpr size_t FLIGHT_TEXT_BYTES = 88;
+
+// 校验和覆盖 seq、text 之前的定长字段与 text 的前 text_len 字节
+struct FlightSlotBody {
+    int64_t timestamp_ms;
+    uint32_t checksum;
+    uint8_t kind;
+    uint8_t level;
+    uint8_t text_len;
+    uint8_t truncated;
+    int32_t a;
+    int32_t b;
+    int64_t value;
+    char text[FLIGHT_TEXT_BYTES];
+};
+
+struct FlightSlot {
+    std::atomic<uint64_t> seq;  // 0 表示空槽或正在写
+    FlightSlotBody body;
+};
+static_assert(sizeof(FlightSlot) == flight_recorder_layout::SLOT_SIZE, "slot layout changed");
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "records in a shared mapping require lock-free atomics");
+
+// 解码出的一条记录
+struct FlightRecord {
+    uint64_t seq = 0;
+    long long timestamp_ms = 0;
+    FlightRecordKind kind = FlightRecordKind::LOG;
+    int level = 0;
+    int a = 0;
+    int b = 0;
+    int64_t value = 0;
+    bool truncated = false;
+    std::string text;
+};
+
+// 解码一个记录文件的结果，records 按 seq 升序
+struct FlightRecovery {
+    bool found = false;
+    bool clean_shutdown = false;
+    int pid = 0;
+    long long started_ms = 0;
+    uint64_t next_seq = 0;
+    uint64_t log_persisted_pos = 0;
+    size_t torn = 0;            // 已分配 seq 但内容不完整（写入中断或校验失败）而丢弃的槽位
+    std::vector<FlightRecord> records;
+};
+
+class FlightRecorder {
+public:
+    // 守护进程唯一的记录器，main 在其他线程开始记录之前 open；未打开时各记录函数直接返回
+    static FlightRecorder& instance();
+
+    FlightRecorder() = default;
+    ~FlightRecorder();
+
+    FlightRecorder(const FlightRecorder&) = delete;
+    FlightRecorder& operator=(const FlightRecorder&) = delete;
+
+    // 先解码 path 中上一次运行留下的记录（见 recovered()），再清空并映射为本次运行的记录器。
+    // 文件不存在或容量不同时重建
+    bool open(const std::string& path, uint32_t capacity = flight_recorder_layout::DEFAULT_CAPACITY);
+    bool is_open() const { return header_ != nullptr; }
+    const FlightRecovery& recovered() const { return recovered_; }
+    void mark_clean_shutdown();
+
+    // 返回本条记录的 seq，未打开时返回 0。不分配内存，文本超出 FLIGHT_TEXT_BYTES 时截断
+    uint64_t record(FlightRecordKind kind, int a, int b, int64_t value, std::string_view text, int level = 0);
+    void record_log(long long timestamp_ms, LogLevel level, std::string_view category, std::string_view package_name,
+                    int user_id, std::string_view message, uint64_t queue_pos);
+    void mark_log_persisted(uint64_t queue_pos_end);
+    uint64_t next_seq() const;
+
+    // 只读映射并解码文件，不修改内容
+    static FlightRecovery decode(const std::string& path);
+    // 上一次运行未能落盘的内容转成日志：一条汇总，加上按时间排列的记录
+    static std::vector<LogEntry> to_log_entries(const FlightRecovery& recovery);
+
+private:
+    uint64_t write_slot(FlightRecordKind kind, long long timestamp_ms, int level, int a, int b, int64_t value,
+                        std::string_view part1, std::string_view part2, std::string_view part3);
+
+    int fd_ = -1;
+    void* mapping_ = nullptr;
+    size_t mapping_size_ = 0;
+    FlightRecorderHeader* header_ = nullptr;
+    FlightSlot* slots_ = nullptr;
+    uint32_t capacity_ = 0;
+    FlightRecovery recovered_;
+};
+
+// 等待超过阈值时写一条 LOCK_WAIT 记录的互斥锁。无竞争时只多一次 try_lock，
+// 可直接替换 std::mutex 用于 std::lock_guard / std::unique_lock
+class RecordedMutex {
+public:
+    // 自创建以来的累计值；contended 为 try_lock 失败、需要阻塞等待的次数
+    struct Stats {
+        uint64_t acquisitions = 0;
+        uint64_t contended = 0;
+        uint64_t total_wait_us = 0;
+        uint64_t max_wait_us = 0;
+    };
+
+    explicit RecordedMutex(const char* name, uint32_t threshold_us = 1000) : name_(name), threshold_us_(threshold_us) {}
+
+    RecordedMutex(const RecordedMutex&) = delete;
+    RecordedMutex& operator=(const RecordedMutex&) = delete;
+
+    void lock();
+    bool try_lock();
+    void unlock() { mutex_.unlock(); }
+
+    // 不加锁读取，各计数之间不保证同一时刻
+    Stats get_stats() const;
+
+private:
+    std::mutex mutex_;
+    const char* name_;
+    uint32_t threshold_us_;
+    // 只在持有 mutex_ 时写入；原子类型只为让 get_stats() 可以并发读取
+    std::atomic<uint64_t> acquisitions_{0};
+    std::atomic<uint64_t> contended_{0};
+    std::atomic<uint64_t> total_wait_us_{0};
+    std::atomic<uint64_t> max_wait_us_{0};
+};
+
+#endif // CERBERUS_FLIGHT_RECORDER_H
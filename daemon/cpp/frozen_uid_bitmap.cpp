@@ -0,0 +1,276 @@
+// daemon/cpp/frozen_uid_bitmap.cpp
+#include "frozen_uid_bitmap.h"
+#include <android/log.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <cstdio>
+#include <new>
+#include <thread>
+#include <algorithm>
+
+#define LOG_TAG "cerberusd_frozen_bitmap"
+#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+#define LOGW(...) __android_log_print(ANDROID_LOG_WARN, LOG_TAG, __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#endif
+#ifndef MFD_ALLOW_SEALING
+#define MFD_ALLOW_SEALING 0x0002U
+#endif
+#ifndef F_ADD_SEALS
+#define F_ADD_SEALS 1033
+#define F_SEAL_SEAL 0x0001
+#define F_SEAL_SHRINK 0x0002
+#define F_SEAL_GROW 0x0004
+#endif
+
+using namespace frozen_uid_layout;
+
+// 读者在 sequence 持续变化时的自旋上限，超过后让出 CPU
+constexpr int SEQLOCK_SPIN_BEFORE_YIELD = 64;
+
+static int create_memfd(const char* name) {
+    // 较旧的 NDK 头文件不声明 memfd_create，直接走系统调用
+    return static_cast<int>(syscall(__NR_memfd_create, name, MFD_CLOEXEC | MFD_ALLOW_SEALING));
+}
+
+FrozenUidBitmap::~FrozenUidBitmap() {
+    if (mapping_) munmap(mapping_, TOTAL_SIZE);
+    if (reader_fd_ != -1) close(reader_fd_);
+    if (memfd_ != -1) close(memfd_);
+}
+
+bool FrozenUidBitmap::create() {
+    memfd_ = create_memfd("cerberus_frozen_uids");
+    if (memfd_ == -1) {
+        LOGE("memfd_create failed: %s", strerror(errno));
+        return false;
+    }
+    if (ftruncate(memfd_, TOTAL_SIZE) == -1) {
+        LOGE("ftruncate of frozen bitmap failed: %s", strerror(errno));
+        return false;
+    }
+    // 固定大小，探针映射后不会因对端截断而 SIGBUS
+    if (fcntl(memfd_, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) == -1) {
+        LOGW("Failed to seal frozen bitmap memfd: %s", strerror(errno));
+    }
+
+    // 经 /proc 重新打开得到一个只读的打开文件描述，探针拿到后无法以可写方式映射
+    char proc_path[64];
+    snprintf(proc_path, sizeof(proc_path), "/proc/self/fd/%d", memfd_);
+    reader_fd_ = open(proc_path, O_RDONLY | O_CLOEXEC);
+    if (reader_fd_ == -1) {
+        LOGE("Failed to reopen frozen bitmap read-only: %s", strerror(errno));
+        return false;
+    }
+
+    mapping_ = mmap(nullptr, TOTAL_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, memfd_, 0);
+    if (mapping_ == MAP_FAILED) {
+        mapping_ = nullptr;
+        LOGE("mmap of frozen bitmap failed: %s", strerror(errno));
+        return false;
+    }
+
+    auto* header = new (mapping_) FrozenUidBitmapHeader{};
+    header->magic = MAGIC;
+    header->version = VERSION;
+    header->header_size = HEADER_SIZE;
+    header->sequence.store(0, std::memory_order_relaxed);
+    header->user_slots = MAX_USER_SLOTS;
+    header->apps_per_user = APPS_PER_USER;
+    header->first_app_id = FIRST_APP_ID;
+    header->frozen_count.store(0, std::memory_order_relaxed);
+    for (auto& user_id : header->user_ids) user_id.store(-1, std::memory_order_relaxed);
+    words_ = reinterpret_cast<std::atomic<uint64_t>*>(static_cast<char*>(mapping_) + HEADER_SIZE);
+    for (uint32_t i = 0; i < WORD_COUNT; ++i) new (&words_[i]) std::atomic<uint64_t>(0);
+    shadow_.assign(WORD_COUNT, 0);
+    std::atomic_thread_fence(std::memory_order_release);
+    header_ = header;
+    LOGI("Frozen UID bitmap ready (%zu bytes, %u user slots).", TOTAL_SIZE, MAX_USER_SLOTS);
+    return true;
+}
+
+long FrozenUidBitmap::bit_index_for(int uid) {
+    if (uid < 0) return -1;
+    int user_id = uid / PER_USER_RANGE;
+    int app_id = uid % PER_USER_RANGE;
+    if (app_id < FIRST_APP_ID || app_id >= FIRST_APP_ID + APPS_PER_USER) return -1;
+
+    for (uint32_t slot = 0; slot < MAX_USER_SLOTS; ++slot) {
+        int32_t current = header_->user_ids[slot].load(std::memory_order_relaxed);
+        if (current == user_id) return static_cast<long>(slot) * APPS_PER_USER + (app_id - FIRST_APP_ID);
+        if (current == -1) {
+            // 调用方处于写临界区内，读者要么看到完整的新槽位，要么重试
+            header_->user_ids[slot].store(user_id, std::memory_order_relaxed);
+            return static_cast<long>(slot) * APPS_PER_USER + (app_id - FIRST_APP_ID);
+        }
+    }
+    if (!slots_full_logged_) {
+        LOGW("Frozen bitmap user slots exhausted, user %d falls back to the JSON list.", user_id);
+        slots_full_logged_ = true;
+    }
+    return -1;
+}
+
+void FrozenUidBitmap::update(const std::vector<int>& frozen_uids) {
+    if (!header_) return;
+    std::lock_guard<std::mutex> lock(write_mutex_);
+
+    auto slot_of = [this](int user_id) -> int {
+        for (uint32_t slot = 0; slot < MAX_USER_SLOTS; ++slot) {
+            int32_t current = header_->user_ids[slot].load(std::memory_order_relaxed);
+            if (current == user_id) return static_cast<int>(slot);
+            if (current == -1) break;
+        }
+        return -1;
+    };
+
+    // 先在本地算出新位图，和上次写出的结果一致时直接返回，不打扰读者
+    std::vector<uint64_t> next(WORD_COUNT, 0);
+    bool needs_new_slot = false;
+    uint32_t count = 0;
+    for (int uid : frozen_uids) {
+        if (uid < 0) continue;
+        int app_id = uid % PER_USER_RANGE;
+        if (app_id < FIRST_APP_ID || app_id >= FIRST_APP_ID + APPS_PER_USER) continue;
+        int slot = slot_of(uid / PER_USER_RANGE);
+        if (slot < 0) {
+            needs_new_slot = true;
+            continue;
+        }
+        size_t bit = static_cast<size_t>(slot) * APPS_PER_USER + (app_id - FIRST_APP_ID);
+        uint64_t mask = 1ULL << (bit % 64);
+        if (!(next[bit / 64] & mask)) {
+            next[bit / 64] |= mask;
+            ++count;
+        }
+    }
+    if (!needs_new_slot && next == shadow_) return;
+
+    uint32_t seq = header_->sequence.load(std::memory_order_relaxed);
+    header_->sequence.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    if (needs_new_slot) {
+        for (int uid : frozen_uids) {
+            long bit = bit_index_for(uid);
+            if (bit < 0) continue;
+            uint64_t mask = 1ULL << (bit % 64);
+            if (!(next[bit / 64] & mask)) {
+                next[bit / 64] |= mask;
+                ++count;
+            }
+        }
+    }
+    for (uint32_t i = 0; i < WORD_COUNT; ++i) {
+        if (next[i] != shadow_[i]) words_[i].store(next[i], std::memory_order_relaxed);
+    }
+    header_->frozen_count.store(count, std::memory_order_relaxed);
+
+    header_->sequence.store(seq + 2, std::memory_order_release);
+    shadow_.swap(next);
+}
+
+json FrozenUidBitmap::describe() const {
+    return {
+        {"version", VERSION},
+        {"size", TOTAL_SIZE},
+        {"header_size", HEADER_SIZE},
+        {"user_slots", MAX_USER_SLOTS},
+        {"first_app_id", FIRST_APP_ID},
+        {"apps_per_user", APPS_PER_USER}
+    };
+}
+
+FrozenUidBitmapReader::~FrozenUidBitmapReader() {
+    if (mapping_) munmap(const_cast<void*>(mapping_), mapping_size_);
+}
+
+bool FrozenUidBitmapReader::attach(int fd) {
+    struct stat st {};
+    if (fstat(fd, &st) == -1 || static_cast<size_t>(st.st_size) < TOTAL_SIZE) return false;
+    void* mapping = mmap(nullptr, TOTAL_SIZE, PROT_READ, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED) return false;
+    const auto* header = static_cast<const FrozenUidBitmapHeader*>(mapping);
+    if (header->magic != MAGIC || header->version != VERSION || header->header_size != HEADER_SIZE ||
+        header->user_slots != MAX_USER_SLOTS || header->apps_per_user != static_cast<uint32_t>(APPS_PER_USER)) {
+        munmap(mapping, TOTAL_SIZE);
+        return false;
+    }
+    mapping_ = mapping;
+    mapping_size_ = TOTAL_SIZE;
+    header_ = header;
+    words_ = reinterpret_cast<const std::atomic<uint64_t>*>(static_cast<const char*>(mapping) + HEADER_SIZE);
+    return true;
+}
+
+template <typename Fn>
+void FrozenUidBitmapReader::read_consistent(Fn&& fn) const {
+    for (int attempt = 0;; ++attempt) {
+        uint32_t before = header_->sequence.load(std::memory_order_acquire);
+        if ((before & 1) == 0) {
+            fn();
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (header_->sequence.load(std::memory_order_relaxed) == before) return;
+        }
+        retries_.fetch_add(1, std::memory_order_relaxed);
+        if (attempt >= SEQLOCK_SPIN_BEFORE_YIELD) std::this_thread::yield();
+    }
+}
+
+std::optional<bool> FrozenUidBitmapReader::is_frozen(int uid) const {
+    if (!header_ || uid < 0) return std::nullopt;
+    int user_id = uid / PER_USER_RANGE;
+    int app_id = uid % PER_USER_RANGE;
+    if (app_id < FIRST_APP_ID || app_id >= FIRST_APP_ID + APPS_PER_USER) return std::nullopt;
+
+    std::optional<bool> result;
+    read_consistent([&] {
+        result.reset();
+        for (uint32_t slot = 0; slot < MAX_USER_SLOTS; ++slot) {
+            int32_t current = header_->user_ids[slot].load(std::memory_order_relaxed);
+            if (current == -1) break;
+            if (current != user_id) continue;
+            size_t bit = static_cast<size_t>(slot) * APPS_PER_USER + (app_id - FIRST_APP_ID);
+            result = (words_[bit / 64].load(std::memory_order_relaxed) >> (bit % 64)) & 1ULL;
+            break;
+        }
+    });
+    return result;
+}
+
+std::vector<int> FrozenUidBitmapReader::frozen_uids() const {
+    std::vector<int> uids;
+    if (!header_) return uids;
+    read_consistent([&] {
+        uids.clear();
+        int32_t users[MAX_USER_SLOTS];
+        for (uint32_t slot = 0; slot < MAX_USER_SLOTS; ++slot) {
+            users[slot] = header_->user_ids[slot].load(std::memory_order_relaxed);
+        }
+        for (uint32_t i = 0; i < WORD_COUNT; ++i) {
+            uint64_t word = words_[i].load(std::memory_order_relaxed);
+            while (word) {
+                int offset = __builtin_ctzll(word);
+                word &= word - 1;
+                size_t bit = static_cast<size_t>(i) * 64 + offset;
+                int32_t user_id = users[bit / APPS_PER_USER];
+                if (user_id < 0) continue;
+                uids.push_back(user_id * PER_USER_RANGE + FIRST_APP_ID + static_cast<int>(bit % APPS_PER_USER));
+            }
+        }
+    });
+    std::sort(uids.begin(), uids.end());
+    return uids;
+}
+
+uint32_t FrozenUidBitmapReader::sequence() const {
+    return header_ ? header_->sequence.load(std::memory_order_acquire) : 0;
+}
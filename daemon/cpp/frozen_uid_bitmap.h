@@ -0,0 +1,123 @@
+// daemon/cpp/frozen_uid_bitmap.h
+#ifndef CERBERUS_FROZEN_UID_BITMAP_H
+#define CERBERUS_FROZEN_UID_BITMAP_H
+
+#include <nlohmann/json.hpp>
+#include <atomic>
+#include <mutex>
+#include <optional>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+using json = nlohmann::json;
+
+// 共享内存中的冻结 UID 位图，供探针以 O(1) 查询某个 UID 当前是否被冻结，无需解析任何消息。
+// 内存由 memfd 提供，守护进程是唯一写者，只读描述符通过 UDS 的 SCM_RIGHTS 交给探针。
+//
+// 布局（小端，偏移单位为字节）：
+//   [0,   128)  FrozenUidBitmapHeader
+//   [128, ...)  位图，uint64 字数组。bit 下标 = 用户槽位 * APPS_PER_USER + (appid - FIRST_APP_ID)
+// UID = user_id * 100000 + appid，只收录应用 UID（appid 位于 [10000, 20000)）。
+// 用户 ID 在首次出现时分配槽位（含分身等 999 之类的大编号用户），槽位分配后不再变化。
+//
+// 一致性采用 seqlock：写者在修改前后各把 sequence 加一（修改期间为奇数），
+// 读者读取前后的 sequence 相等且为偶数时读到的数据才有效，否则重试。
+namespace frozen_uid_layout {
+constexpr uint32_t MAGIC = 0x42465543;  // "CUFB"
+constexpr uint16_t VERSION = 1;
+constexpr uint32_t HEADER_SIZE = 128;
+constexpr uint32_t MAX_USER_SLOTS = 16;
+constexpr int FIRST_APP_ID = 10000;
+constexpr int APPS_PER_USER = 10000;
+constexpr int PER_USER_RANGE = 100000;
+constexpr uint32_t BIT_COUNT = MAX_USER_SLOTS * APPS_PER_USER;
+constexpr uint32_t WORD_COUNT = (BIT_COUNT + 63) / 64;
+constexpr size_t TOTAL_SIZE = HEADER_SIZE + WORD_COUNT * sizeof(uint64_t);
+} // namespace frozen_uid_layout
+
+struct FrozenUidBitmapHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t header_size;
+    std::atomic<uint32_t> sequence;
+    uint32_t user_slots;
+    uint32_t apps_per_user;
+    uint32_t first_app_id;
+    std::atomic<uint32_t> frozen_count;
+    uint32_t reserved;
+    std::atomic<int32_t> user_ids[frozen_uid_layout::MAX_USER_SLOTS]; // 未使用的槽位为 -1
+};
+static_assert(sizeof(FrozenUidBitmapHeader) <= frozen_uid_layout::HEADER_SIZE, "header exceeds reserved space");
+static_assert(std::atomic<uint32_t>::is_always_lock_free && std::atomic<uint64_t>::is_always_lock_free,
+              "seqlock in shared memory requires lock-free atomics");
+
+// 守护进程侧的唯一写者
+class FrozenUidBitmap {
+public:
+    FrozenUidBitmap() = default;
+    ~FrozenUidBitmap();
+
+    FrozenUidBitmap(const FrozenUidBitmap&) = delete;
+    FrozenUidBitmap& operator=(const FrozenUidBitmap&) = delete;
+
+    // 创建并映射 memfd，失败时返回 false，调用方应退回到 JSON 列表
+    bool create();
+    bool is_valid() const { return header_ != nullptr; }
+
+    // 以完整的冻结 UID 集合更新位图，只写出发生变化的字；集合未变化时不触碰 sequence
+    void update(const std::vector<int>& frozen_uids);
+
+    // 交给探针的只读描述符（仍归本对象所有，发送方需自行 dup）
+    int reader_fd() const { return reader_fd_; }
+    // 随描述符一起下发的布局说明
+    json describe() const;
+
+private:
+    // 返回 UID 对应的 bit 下标；非应用 UID 或用户槽位耗尽时返回 -1
+    long bit_index_for(int uid);
+
+    int memfd_ = -1;
+    int reader_fd_ = -1;
+    void* mapping_ = nullptr;
+    FrozenUidBitmapHeader* header_ = nullptr;
+    std::atomic<uint64_t>* words_ = nullptr;
+
+    std::mutex write_mutex_;
+    // 上一次写出的位图，用于比较差异
+    std::vector<uint64_t> shadow_;
+    bool slots_full_logged_ = false;
+};
+
+// 只读映射一个位图描述符的读者，探针侧逻辑的 C++ 参考实现，也用于测试
+class FrozenUidBitmapReader {
+public:
+    FrozenUidBitmapReader() = default;
+    ~FrozenUidBitmapReader();
+
+    FrozenUidBitmapReader(const FrozenUidBitmapReader&) = delete;
+    FrozenUidBitmapReader& operator=(const FrozenUidBitmapReader&) = delete;
+
+    // 映射描述符并校验头部；描述符由调用方继续持有
+    bool attach(int fd);
+    bool is_attached() const { return header_ != nullptr; }
+
+    // UID 的用户不在位图中或不是应用 UID 时返回 nullopt，调用方应视为未知
+    std::optional<bool> is_frozen(int uid) const;
+    // 一致地读出全部冻结 UID（同一个 sequence 下）
+    std::vector<int> frozen_uids() const;
+    uint32_t sequence() const;
+    uint64_t retries() const { return retries_.load(std::memory_order_relaxed); }
+
+private:
+    template <typename Fn>
+    void read_consistent(Fn&& fn) const;
+
+    const void* mapping_ = nullptr;
+    size_t mapping_size_ = 0;
+    const FrozenUidBitmapHeader* header_ = nullptr;
+    const std::atomic<uint64_t>* words_ = nullptr;
+    mutable std::atomic<uint64_t> retries_{0};
+};
+
+#endif // CERBERUS_FROZEN_UID_BITMAP_H
@@ -0,0 +1,185 @@
+// daemon/cpp/json_writer.cpp
+#include "json_writer.h"
+#include <nlohmann/json.hpp>
+#include <array>
+#include <charconv>
+#include <cmath>
+
+// 合法 UTF-8 序列的长度（Unicode 表 3-7：拒绝超长编码、代理区与超出 U+10FFFF 的码点），非法时返回 0
+static size_t utf8_sequence_length(const unsigned char* p, size_t available) {
+    unsigned char lead = p[0];
+    auto cont = [&](size_t i, unsigned char lo = 0x80, unsigned char hi = 0xBF) {
+        return i < available && p[i] >= lo && p[i] <= hi;
+    };
+    if (lead >= 0xC2 && lead <= 0xDF) return cont(1) ? 2 : 0;
+    if (lead == 0xE0) return cont(1, 0xA0) && cont(2) ? 3 : 0;
+    if ((lead >= 0xE1 && lead <= 0xEC) || lead == 0xEE || lead == 0xEF) return cont(1) && cont(2) ? 3 : 0;
+    if (lead == 0xED) return cont(1, 0x80, 0x9F) && cont(2) ? 3 : 0;
+    if (lead == 0xF0) return cont(1, 0x90) && cont(2) && cont(3) ? 4 : 0;
+    if (lead >= 0xF1 && lead <= 0xF3) return cont(1) && cont(2) && cont(3) ? 4 : 0;
+    if (lead == 0xF4) return cont(1, 0x80, 0x8F) && cont(2) && cont(3) ? 4 : 0;
+    return 0;
+}
+
+void JsonWriter::before_value() {
+    if (after_key_) {
+        after_key_ = false;
+        return;
+    }
+    if (depth_ == 0) return;
+    uint64_t bit = uint64_t{1} << (depth_ - 1);
+    if (has_items_ & bit) out_.push_back(',');
+    has_items_ |= bit;
+}
+
+JsonWriter& JsonWriter::begin_object() {
+    before_value();
+    out_.push_back('{');
+    ++depth_;
+    has_items_ &= ~(uint64_t{1} << (depth_ - 1));
+    return *this;
+}
+
+JsonWriter& JsonWriter::end_object() {
+    --depth_;
+    out_.push_back('}');
+    return *this;
+}
+
+JsonWriter& JsonWriter::begin_array() {
+    before_value();
+    out_.push_back('[');
+    ++depth_;
+    has_items_ &= ~(uint64_t{1} << (depth_ - 1));
+    return *this;
+}
+
+JsonWriter& JsonWriter::end_array() {
+    --depth_;
+    out_.push_back(']');
+    return *this;
+}
+
+JsonWriter& JsonWriter::key(std::string_view name) {
+    before_value();
+    write_escaped(name);
+    out_.push_back(':');
+    after_key_ = true;
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(std::string_view text) {
+    before_value();
+    write_escaped(text);
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(bool flag) {
+    before_value();
+    out_.append(flag ? "true" : "false");
+    return *this;
+}
+
+JsonWriter& JsonWriter::signed_value(long long number) {
+    before_value();
+    char buffer[24];
+    auto result = std::to_chars(buffer, buffer + sizeof(buffer), number);
+    out_.append(buffer, result.ptr - buffer);
+    return *this;
+}
+
+JsonWriter& JsonWriter::unsigned_value(unsigned long long number) {
+    before_value();
+    char buffer[24];
+    auto result = std::to_chars(buffer, buffer + sizeof(buffer), number);
+    out_.append(buffer, result.ptr - buffer);
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(double number) {
+    before_value();
+    if (!std::isfinite(number)) {
+        out_.append("null");
+        return *this;
+    }
+    // 与 dump() 使用同一个格式化函数
+    std::array<char, 64> buffer;
+    char* end = nlohmann::detail::to_chars(buffer.data(), buffer.data() + buffer.size(), number);
+    out_.append(buffer.data(), end - buffer.data());
+    return *this;
+}
+
+JsonWriter& JsonWriter::null_value() {
+    before_value();
+    out_.append("null");
+    return *this;
+}
+
+JsonWriter& JsonWriter::raw(std::string_view json_text) {
+    before_value();
+    out_.append(json_text.data(), json_text.size());
+    return *this;
+}
+
+void JsonWriter::write_escaped(std::string_view text) {
+    static const char HEX[] = "0123456789abcdef";
+    const auto* bytes = reinterpret_cast<const unsigned char*>(text.data());
+    size_t size = text.size();
+    const size_t string_start = out_.size();
+    out_.push_back('"');
+    size_t run_start = 0;
+    size_t i = 0;
+    while (i < size) {
+        unsigned char c = bytes[i];
+        if (c >= 0x20 && c != '"' && c != '\\' && c < 0x80) {
+            ++i;
+            continue;
+        }
+        if (c >= 0x80) {
+            size_t length = utf8_sequence_length(bytes + i, size - i);
+            if (length == 0) {
+                // 撤销本字符串已写出的部分，由 dump() 按其规则处理（抛出 type_error 316）
+                out_.resize(string_start);
+                out_.append(nlohmann::json(std::string(text)).dump());
+                return;
+            }
+            i += length;
+            continue;
+        }
+        out_.append(text.data() + run_start, i - run_start);
+        switch (c) {
+            case '\b': out_.append("\\b"); break;
+            case '\t': out_.append("\\t"); break;
+            case '\n': out_.append("\\n"); break;
+            case '\f': out_.append("\\f"); break;
+            case '\r': out_.append("\\r"); break;
+            case '"': out_.append("\\\""); break;
+            case '\\': out_.append("\\\\"); break;
+            default: {
+                char escape[6] = {'\\', 'u', '0', '0', HEX[c >> 4], HEX[c & 0xF]};
+                out_.append(escape, sizeof(escape));
+                break;
+            }
+        }
+        ++i;
+        run_start = i;
+    }
+    out_.append(text.data() + run_start, size - run_start);
+    out_.push_back('"');
+}
+
+std::string JsonWriter::take() {
+    std::string text = std::move(out_);
+    out_.clear();
+    has_items_ = 0;
+    depth_ = 0;
+    after_key_ = false;
+    return text;
+}
+
+void JsonWriter::reset() {
+    out_.clear();
+    has_items_ = 0;
+    depth_ = 0;
+    after_key_ = false;
+}
@@ -0,0 +1,70 @@
+// daemon/cpp/json_writer.h
+#ifndef CERBERUS_JSON_WRITER_H
+#define CERBERUS_JSON_WRITER_H
+
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <cstddef>
+
+// 不经 nlohmann::json DOM、直接写出 JSON 文本的流式写出器，输出与 json::dump() 逐字节一致：
+//   - 对象的键须由调用方按字典序写出（nlohmann::json 以 std::map 存放对象成员）；
+//   - 浮点数先转为 double，再以与 dump() 相同的最短往返格式输出，非有限值输出 null；
+//   - 字符串的转义规则相同，非 ASCII 字节按 UTF-8 原样输出；遇到非法 UTF-8 时交给 dump() 处理，
+//     因此同样抛出 json::type_error。
+// 写出的文本可以 take() 取走直接作为发送帧（避免再复制一次），也可以 reset() 后复用缓冲区。
+class JsonWriter {
+public:
+    JsonWriter() = default;
+    explicit JsonWriter(size_t reserve_bytes) { out_.reserve(reserve_bytes); }
+
+    JsonWriter& begin_object();
+    JsonWriter& end_object();
+    JsonWriter& begin_array();
+    JsonWriter& end_array();
+    JsonWriter& key(std::string_view name);
+
+    JsonWriter& value(std::string_view text);
+    JsonWriter& value(const std::string& text) { return value(std::string_view(text)); }
+    JsonWriter& value(const char* text) { return value(std::string_view(text)); }
+    JsonWriter& value(bool flag);
+    JsonWriter& value(int number) { return signed_value(number); }
+    JsonWriter& value(long number) { return signed_value(number); }
+    JsonWriter& value(long long number) { return signed_value(number); }
+    JsonWriter& value(unsigned int number) { return unsigned_value(number); }
+    JsonWriter& value(unsigned long number) { return unsigned_value(number); }
+    JsonWriter& value(unsigned long long number) { return unsigned_value(number); }
+    JsonWriter& value(double number);
+    JsonWriter& value(float number) { return value(static_cast<double>(number)); }
+    JsonWriter& null_value();
+    // 插入一段已序列化的 JSON 值（例如缓存的子对象），不做校验
+    JsonWriter& raw(std::string_view json_text);
+
+    template <typename T>
+    JsonWriter& field(std::string_view name, const T& field_value) {
+        key(name);
+        return value(field_value);
+    }
+
+    const std::string& str() const { return out_; }
+    size_t size() const { return out_.size(); }
+    // 取走已写出的文本，写出器回到初始状态
+    std::string take();
+    // 清空内容并保留容量
+    void reset();
+
+private:
+    // 在写出一个值之前补上逗号
+    void before_value();
+    JsonWriter& signed_value(long long number);
+    JsonWriter& unsigned_value(unsigned long long number);
+    void write_escaped(std::string_view text);
+
+    std::string out_;
+    // 第 i 位表示第 i 层容器中是否已有元素，决定下一个元素前是否需要逗号；嵌套不超过 64 层
+    uint64_t has_items_ = 0;
+    int depth_ = 0;
+    bool after_key_ = false;
+};
+
+#endif // CERBERUS_JSON_WRITER_H
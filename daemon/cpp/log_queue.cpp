@@ -0,0 +1,130 @@
+// daemon/cpp/log_queue.cpp
+#include "log_queue.h"
+#include <android/log.h>
+#include <cstring>
+#include <thread>
+
+#define LOG_TAG "cerberusd_log_queue"
+#define LOGW(...) __android_log_print(ANDROID_LOG_WARN, LOG_TAG, __VA_ARGS__)
+
+// --- LogStringTable ---
+
+static std::atomic<uint64_t> g_next_table_instance{1};
+
+namespace {
+struct InternCache {
+    uint64_t owner = 0;
+    std::unordered_map<std::string_view, uint32_t> ids;  // 键指向表内条目
+};
+thread_local InternCache t_intern_cache;
+const std::string EMPTY_STRING;
+const std::string OVERFLOW_STRING = "<overflow>";
+}
+
+LogStringTable::LogStringTable()
+    : instance_id_(g_next_table_instance.fetch_add(1, std::memory_order_relaxed)),
+      entries_(new std::atomic<const std::string*>[CAPACITY]) {
+    for (uint32_t i = 0; i < CAPACITY; ++i) entries_[i].store(nullptr, std::memory_order_relaxed);
+}
+
+LogStringTable::~LogStringTable() {
+    for (uint32_t i = 0; i < CAPACITY; ++i) delete entries_[i].load(std::memory_order_relaxed);
+}
+
+uint32_t LogStringTable::intern(std::string_view text) {
+    if (text.empty()) return 0;
+    InternCache& cache = t_intern_cache;
+    if (cache.owner != instance_id_) {
+        cache.ids.clear();
+        cache.owner = instance_id_;
+    }
+    auto it = cache.ids.find(text);
+    if (it != cache.ids.end()) return it->second;
+    uint32_t id = intern_slow(text);
+    // 溢出 ID 没有对应条目，不缓存（键会指向调用方的临时串）
+    if (id != OVERFLOW_ID) cache.ids.emplace(lookup(id), id);
+    return id;
+}
+
+uint32_t LogStringTable::intern_slow(std::string_view text) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = ids_.find(text);
+    if (it != ids_.end()) return it->second;
+    uint32_t id = count_.load(std::memory_order_relaxed);
+    if (id >= OVERFLOW_ID) {
+        if (id == OVERFLOW_ID) {
+            LOGW("Log string table is full, further categories/packages are recorded as <overflow>.");
+            count_.store(OVERFLOW_ID + 1, std::memory_order_release);
+        }
+        return OVERFLOW_ID;
+    }
+    const std::string* stored = new std::string(text);
+    entries_[id].store(stored, std::memory_order_release);
+    count_.store(id + 1, std::memory_order_release);
+    ids_.emplace(*stored, id);
+    return id;
+}
+
+const std::string& LogStringTable::lookup(uint32_t id) const {
+    if (id == 0 || id >= CAPACITY) return EMPTY_STRING;
+    if (id == OVERFLOW_ID) return OVERFLOW_STRING;
+    const std::string* text = entries_[id].load(std::memory_order_acquire);
+    return text ? *text : EMPTY_STRING;
+}
+
+// --- LogQueue ---
+
+static size_t round_up_pow2(size_t value) {
+    size_t result = 2;
+    while (result < value) result <<= 1;
+    return result;
+}
+
+LogQueue::LogQueue(size_t capacity)
+    : capacity_(round_up_pow2(capacity)), mask_(capacity_ - 1), slots_(new LogSlot[capacity_]) {
+    for (size_t i = 0; i < capacity_; ++i) {
+        slots_[i].sequence.store(i, std::memory_order_relaxed);
+        slots_[i].overflow = nullptr;
+    }
+}
+
+LogQueue::~LogQueue() {
+    for (size_t i = 0; i < capacity_; ++i) delete slots_[i].overflow;
+}
+
+uint64_t LogQueue::push(long long timestamp_ms, LogLevel level, uint32_t category_id, uint32_t package_id,
+                        int user_id, std::string_view message) {
+    uint64_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+    LogSlot* slot;
+    for (;;) {
+        slot = &slots_[pos & mask_];
+        uint64_t seq = slot->sequence.load(std::memory_order_acquire);
+        int64_t diff = static_cast<int64_t>(seq) - static_cast<int64_t>(pos);
+        if (diff == 0) {
+            if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+        } else if (diff < 0) {
+            // 队列已满：等消费者取走一圈之前的条目
+            full_waits_.fetch_add(1, std::memory_order_relaxed);
+            std::this_thread::yield();
+            pos = enqueue_pos_.load(std::memory_order_relaxed);
+        } else {
+            pos = enqueue_pos_.load(std::memory_order_relaxed);
+        }
+    }
+
+    slot->timestamp_ms = timestamp_ms;
+    slot->category_id = category_id;
+    slot->package_id = package_id;
+    slot->user_id = user_id;
+    slot->level = static_cast<uint8_t>(level);
+    if (message.size() <= LogSlot::INLINE_MESSAGE_BYTES) {
+        std::memcpy(slot->message, message.data(), message.size());
+        slot->message_len = static_cast<uint16_t>(message.size());
+        slot->overflow = nullptr;
+    } else {
+        slot->message_len = 0;
+        slot->overflow = new std::string(message);
+    }
+    slot->sequence.store(pos + 1, std::memory_order_release);
+    return pos;
+}
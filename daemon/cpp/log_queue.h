@@ -0,0 +1,115 @@
+// daemon/cpp/log_queue.h
+#ifndef CERBERUS_LOG_QUEUE_H
+#define CERBERUS_LOG_QUEUE_H
+
+#include "logger.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <cstdint>
+#include <cstddef>
+
+// 分类与包名的驻留表：字符串换成从 1 开始的 ID，0 表示空串。
+// 生产者先查线程局部缓存，命中时不加锁；未命中才进入全局锁分配新 ID（不同的分类与包名只有几百个）。
+// 条目只增不删、地址不变，两级映射都以指向条目的 string_view 为键，查找时不构造临时串；
+// lookup() 可在任意线程无锁调用，只要 ID 来自 intern() 的返回值。
+class LogStringTable {
+public:
+    static constexpr uint32_t CAPACITY = 65536;
+    // 表满后新字符串统一映射到这个 ID，lookup 返回 "<overflow>"
+    static constexpr uint32_t OVERFLOW_ID = CAPACITY - 1;
+
+    LogStringTable();
+    ~LogStringTable();
+    LogStringTable(const LogStringTable&) = delete;
+    LogStringTable& operator=(const LogStringTable&) = delete;
+
+    uint32_t intern(std::string_view text);
+    const std::string& lookup(uint32_t id) const;
+    size_t size() const { return count_.load(std::memory_order_acquire); }
+
+private:
+    uint32_t intern_slow(std::string_view text);
+
+    // 实例编号，线程局部缓存据此判断是否属于本表
+    const uint64_t instance_id_;
+    std::unique_ptr<std::atomic<const std::string*>[]> entries_;
+    std::atomic<uint32_t> count_{1};
+    std::mutex mutex_;
+    std::unordered_map<std::string_view, uint32_t> ids_;
+};
+
+// 队列中的定长条目。短消息直接放在内联缓冲区，超长的才单独分配
+struct alignas(64) LogSlot {
+    static constexpr size_t INLINE_MESSAGE_BYTES = 200;
+
+    std::atomic<uint64_t> sequence;
+    long long timestamp_ms;
+    uint32_t category_id;
+    uint32_t package_id;
+    int32_t user_id;
+    uint16_t message_len;
+    uint8_t level;
+    std::string* overflow;  // 非空时消息在这里，消费者取走并释放
+    char message[INLINE_MESSAGE_BYTES];
+
+    std::string_view message_view() const {
+        return overflow ? std::string_view(*overflow) : std::string_view(message, message_len);
+    }
+};
+static_assert(sizeof(LogSlot) == 256, "log slot should stay four cache lines");
+
+// 有界无锁多生产者单消费者队列（Vyukov 环形队列，每个槽位带序号）。
+// 生产者以 CAS 领取全局递增的位置号，写入槽位后发布；消费者按位置号顺序取出，
+// 因此位置号就是日志进入队列的全局顺序。LogEntry::seq 不取自位置号：Logger 在风暴合并之后
+// 才按写出顺序连续分配 seq，位置号只用来标记已落盘与仍在合并窗口中的条目。
+// 队列满时生产者让出 CPU 等待消费者腾出槽位（不丢日志），并计入 full_waits。
+class LogQueue {
+public:
+    explicit LogQueue(size_t capacity);
+    ~LogQueue();
+    LogQueue(const LogQueue&) = delete;
+    LogQueue& operator=(const LogQueue&) = delete;
+
+    // 生产者调用，返回领取到的位置号
+    uint64_t push(long long timestamp_ms, LogLevel level, uint32_t category_id, uint32_t package_id,
+                  int user_id, std::string_view message);
+
+    // 消费者调用：按位置号顺序取出至多 max_entries 条已发布的条目，对每条调用 fn(position, slot)。
+    // 遇到已领取但尚未发布的槽位即停止，保证顺序
+    template <typename Fn>
+    size_t drain(size_t max_entries, Fn&& fn) {
+        size_t taken = 0;
+        while (taken < max_entries) {
+            LogSlot& slot = slots_[dequeue_pos_ & mask_];
+            if (slot.sequence.load(std::memory_order_acquire) != dequeue_pos_ + 1) break;
+            fn(dequeue_pos_, static_cast<const LogSlot&>(slot));
+            delete slot.overflow;
+            slot.overflow = nullptr;
+            slot.sequence.store(dequeue_pos_ + capacity_, std::memory_order_release);
+            ++dequeue_pos_;
+            ++taken;
+        }
+        return taken;
+    }
+
+    // 消费者调用：下一个位置是否已发布
+    bool has_ready() const {
+        return slots_[dequeue_pos_ & mask_].sequence.load(std::memory_order_acquire) == dequeue_pos_ + 1;
+    }
+    size_t capacity() const { return capacity_; }
+    uint64_t full_waits() const { return full_waits_.load(std::memory_order_relaxed); }
+
+private:
+    const size_t capacity_;
+    const size_t mask_;
+    std::unique_ptr<LogSlot[]> slots_;
+    alignas(64) std::atomic<uint64_t> enqueue_pos_{0};
+    alignas(64) uint64_t dequeue_pos_ = 0;
+    std::atomic<uint64_t> full_waits_{0};
+};
+
+#endif // CERBERUS_LOG_QUEUE_H
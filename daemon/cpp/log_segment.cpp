@@ -0,0 +1,830 @@
+// daemon/cpp/log_segment.cpp
+#include "log_segment.h"
+#include "text_search.h"
+#include <android/log.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <climits>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <cerrno>
+#include <filesystem>
+#include <fstream>
+
+#define LOG_TAG "cerberusd_log_segment"
+#define LOGW(...) __android_log_print(ANDROID_LOG_WARN, LOG_TAG, __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+
+namespace fs = std::filesystem;
+using namespace log_segment_layout;
+
+static uint32_t fnv1a(const void* data, size_t size, uint32_t hash = 2166136261u) {
+    const auto* bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static uint32_t record_checksum(const LogRecordHeader& header, const void* payload) {
+    LogRecordHeader copy = header;
+    copy.checksum = 0;
+    return fnv1a(payload, header.payload_len, fnv1a(&copy, sizeof(copy)));
+}
+
+static bool is_entry_kind(uint8_t kind) {
+    return kind == static_cast<uint8_t>(LogRecordKind::ENTRY) || kind == static_cast<uint8_t>(LogRecordKind::ENTRY_REPEATED);
+}
+
+// 日志记录的消息文本（ENTRY_REPEATED 跳过前缀）
+static std::string_view record_message(const LogRecordHeader* header) {
+    const char* payload = reinterpret_cast<const char*>(header + 1);
+    if (header->kind == static_cast<uint8_t>(LogRecordKind::ENTRY_REPEATED)) {
+        if (header->payload_len < sizeof(LogRepeatInfo)) return {};
+        return std::string_view(payload + sizeof(LogRepeatInfo), header->payload_len - sizeof(LogRepeatInfo));
+    }
+    return std::string_view(payload, header->payload_len);
+}
+
+static uint32_t level_bit(int level) {
+    return level >= 0 && level < 32 ? (1u << level) : 0;
+}
+
+// --- LogSegmentWriter ---
+
+LogSegmentWriter::~LogSegmentWriter() {
+    close();
+}
+
+bool LogSegmentWriter::open(const std::string& path) {
+    close();
+    path_ = path;
+    fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    counters_.open_calls.fetch_add(1, std::memory_order_relaxed);
+    if (fd_ < 0) {
+        LOGE("Failed to open log segment %s: %s", path.c_str(), strerror(errno));
+        return false;
+    }
+    if (!load_existing()) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool LogSegmentWriter::load_existing() {
+    struct stat st {};
+    if (fstat(fd_, &st) != 0) return false;
+    if (st.st_size == 0) {
+        LogSegmentFileHeader header {};
+        header.magic = FILE_MAGIC;
+        header.version = VERSION;
+        header.header_size = sizeof(LogSegmentFileHeader);
+        header.created_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        if (!write_fully(reinterpret_cast<const char*>(&header), sizeof(header))) return false;
+        data_end_ = sizeof(header);
+        return true;
+    }
+
+    // 复用读者的校验与重建逻辑，再去掉尾部或撕裂的记录，从有效数据末尾继续追加
+    LogSegmentReader reader;
+    if (!reader.open(path_)) {
+        LOGE("Log segment %s is not a valid segment, refusing to append.", path_.c_str());
+        return false;
+    }
+    strings_ = reader.strings_;
+    for (size_t i = 0; i < strings_.size(); ++i) string_ids_.emplace(strings_[i], static_cast<uint32_t>(i + 1));
+    index_ = reader.index_;
+    if (reader.trigrams_) {
+        trigrams_.assign(reader.trigrams_, reader.trigrams_ + index_.size() * TRIGRAM_BLOOM_BYTES);
+    } else {
+        // 未封存或旧版封存的段没有三字节组索引，按块重新计算
+        trigrams_.assign(index_.size() * TRIGRAM_BLOOM_BYTES, 0);
+        std::vector<uint64_t> offsets;
+        for (size_t b = 0; b < index_.size(); ++b) {
+            reader.block_entries(b, offsets);
+            for (uint64_t offset : offsets) {
+                const auto* header = reinterpret_cast<const LogRecordHeader*>(reader.data_ + offset);
+                text_search::add_trigrams(record_message(header), trigrams_.data() + b * TRIGRAM_BLOOM_BYTES, TRIGRAM_BLOOM_BYTES);
+            }
+        }
+    }
+    entry_count_ = reader.entry_count_;
+    min_ts_ = reader.min_ts_;
+    max_ts_ = reader.max_ts_;
+    level_mask_ = reader.level_mask_;
+    data_end_ = reader.data_end_;
+    if (static_cast<uint64_t>(st.st_size) != data_end_ && ftruncate(fd_, static_cast<off_t>(data_end_)) != 0) {
+        LOGE("Failed to truncate log segment %s: %s", path_.c_str(), strerror(errno));
+        return false;
+    }
+    return lseek(fd_, static_cast<off_t>(data_end_), SEEK_SET) >= 0;
+}
+
+uint32_t LogSegmentWriter::intern(const std::string& text) {
+    if (text.empty()) return NO_STRING;
+    auto it = string_ids_.find(text);
+    if (it != string_ids_.end()) return it->second;
+    std::string_view stored(text.data(), std::min<size_t>(text.size(), MAX_STRING_BYTES));
+    uint32_t id = static_cast<uint32_t>(strings_.size() + 1);
+    strings_.emplace_back(stored);
+    string_ids_.emplace(text, id);
+    append_record(LogRecordKind::STRING_DEF, id, stored);
+    return id;
+}
+
+void LogSegmentWriter::append_record(LogRecordKind kind, uint32_t string_id, std::string_view payload) {
+    LogRecordHeader header {};
+    header.kind = static_cast<uint8_t>(kind);
+    header.payload_len = static_cast<uint32_t>(payload.size());
+    header.string_id = string_id;
+    header.checksum = record_checksum(header, payload.data());
+    pending_.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    pending_.append(payload.data(), payload.size());
+    data_end_ += sizeof(header) + payload.size();
+}
+
+bool LogSegmentWriter::write_fully(const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t written = ::write(fd_, data, size);
+        counters_.write_calls.fetch_add(1, std::memory_order_relaxed);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        counters_.bytes_written.fetch_add(static_cast<uint64_t>(written), std::memory_order_relaxed);
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+bool LogSegmentWriter::writev_fully(std::vector<iovec>& iov) {
+    size_t first = 0;
+    while (first < iov.size()) {
+        int count = static_cast<int>(std::min<size_t>(iov.size() - first, IOV_MAX));
+        ssize_t written = ::writev(fd_, iov.data() + first, count);
+        counters_.write_calls.fetch_add(1, std::memory_order_relaxed);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        counters_.bytes_written.fetch_add(static_cast<uint64_t>(written), std::memory_order_relaxed);
+        // 部分写出时跳过已写完的片段，并调整写了一半的那一段
+        size_t remaining = static_cast<size_t>(written);
+        while (first < iov.size() && remaining >= iov[first].iov_len) {
+            remaining -= iov[first].iov_len;
+            ++first;
+        }
+        if (remaining > 0) {
+            iov[first].iov_base = static_cast<char*>(iov[first].iov_base) + remaining;
+            iov[first].iov_len -= remaining;
+        }
+    }
+    return true;
+}
+
+std::string_view LogSegmentWriter::encode_entry(const LogEntry& entry) {
+    if (entry_count_ % INDEX_INTERVAL == 0) {
+        LogSegmentIndexEntry block {};
+        block.offset = data_end_;
+        block.min_ts = entry.timestamp_ms;
+        block.max_ts = entry.timestamp_ms;
+        index_.push_back(block);
+        trigrams_.resize(trigrams_.size() + TRIGRAM_BLOOM_BYTES, 0);
+    }
+    uint32_t category_id = intern(entry.category);
+    uint32_t package_id = intern(entry.package_name);
+
+    const bool repeated = entry.repeat_count > 1;
+    LogRecordHeader header {};
+    header.timestamp_ms = entry.timestamp_ms;
+    header.kind = static_cast<uint8_t>(repeated ? LogRecordKind::ENTRY_REPEATED : LogRecordKind::ENTRY);
+    header.level = static_cast<uint8_t>(entry.level);
+    header.category_id = static_cast<uint16_t>(category_id <= 0xFFFF ? category_id : NO_STRING);
+    header.string_id = package_id;
+    header.user_id = entry.user_id;
+    header.seq = static_cast<uint32_t>(entry.seq);
+    std::string_view message(entry.message.data(), std::min<size_t>(entry.message.size(), MAX_MESSAGE_BYTES));
+    if (repeated) {
+        // 前缀紧跟定长头放进 pending_，消息仍单独引用；FNV-1a 可以分段累加，结果与连续载荷相同
+        LogRepeatInfo info {};
+        info.first_timestamp_ms = entry.first_timestamp_ms;
+        info.repeat_count = entry.repeat_count;
+        header.payload_len = static_cast<uint32_t>(sizeof(info) + message.size());
+        LogRecordHeader copy = header;
+        header.checksum = fnv1a(message.data(), message.size(), fnv1a(&info, sizeof(info), fnv1a(&copy, sizeof(copy))));
+        pending_.append(reinterpret_cast<const char*>(&header), sizeof(header));
+        pending_.append(reinterpret_cast<const char*>(&info), sizeof(info));
+    } else {
+        header.payload_len = static_cast<uint32_t>(message.size());
+        header.checksum = record_checksum(header, message.data());
+        pending_.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    }
+    data_end_ += sizeof(header) + header.payload_len;
+    text_search::add_trigrams(message, trigrams_.data() + (index_.size() - 1) * TRIGRAM_BLOOM_BYTES, TRIGRAM_BLOOM_BYTES);
+
+    LogSegmentIndexEntry& block = index_.back();
+    block.min_ts = std::min<int64_t>(block.min_ts, entry.timestamp_ms);
+    block.max_ts = std::max<int64_t>(block.max_ts, entry.timestamp_ms);
+    block.count++;
+    block.level_mask |= level_bit(header.level);
+    block.package_bloom |= 1ULL << (package_id % 64);
+    min_ts_ = entry_count_ == 0 ? entry.timestamp_ms : std::min<int64_t>(min_ts_, entry.timestamp_ms);
+    max_ts_ = entry_count_ == 0 ? entry.timestamp_ms : std::max<int64_t>(max_ts_, entry.timestamp_ms);
+    level_mask_ |= level_bit(header.level);
+    entry_count_++;
+    return message;
+}
+
+void LogSegmentWriter::append(const LogEntry& entry) {
+    if (fd_ < 0) return;
+    std::string_view message = encode_entry(entry);
+    pending_.append(message.data(), message.size());
+}
+
+bool LogSegmentWriter::flush() {
+    if (fd_ < 0) return false;
+    if (pending_.empty()) return true;
+    bool ok = write_fully(pending_.data(), pending_.size());
+    pending_.clear();
+    if (!ok) {
+        // 部分写出后内存中的偏移与文件不再一致，关闭后由调用方重新 open()，届时按校验和截掉残缺记录
+        LOGE("Failed to write log segment %s: %s", path_.c_str(), strerror(errno));
+        close();
+    }
+    return ok;
+}
+
+bool LogSegmentWriter::write_batch(const std::deque<LogEntry>& entries) {
+    if (!flush()) return false;
+    if (entries.empty()) return true;
+    // 先按上界预留，保证编码过程中 pending_ 不会重新分配，iovec 里指向它的指针一直有效
+    size_t bound = 0;
+    for (const auto& entry : entries) {
+        bound += 3 * sizeof(LogRecordHeader) + sizeof(LogRepeatInfo) + entry.category.size() + entry.package_name.size();
+    }
+    pending_.reserve(bound);
+    iov_.clear();
+    size_t emitted = 0;
+    for (const auto& entry : entries) {
+        std::string_view message = encode_entry(entry);
+        // 本条之前新增的 STRING_DEF 与本条的定长头在 pending_ 中连续，作为一个片段；消息直接引用原字符串
+        iov_.push_back({pending_.data() + emitted, pending_.size() - emitted});
+        emitted = pending_.size();
+        if (!message.empty()) iov_.push_back({const_cast<char*>(message.data()), message.size()});
+    }
+    bool ok = writev_fully(iov_);
+    pending_.clear();
+    counters_.batches.fetch_add(1, std::memory_order_relaxed);
+    counters_.entries.fetch_add(entries.size(), std::memory_order_relaxed);
+    if (!ok) {
+        LOGE("Failed to write log segment %s: %s", path_.c_str(), strerror(errno));
+        close();
+    }
+    return ok;
+}
+
+bool LogSegmentWriter::sync() {
+    if (fd_ < 0) return false;
+    counters_.fsync_calls.fetch_add(1, std::memory_order_relaxed);
+    return fdatasync(fd_) == 0;
+}
+
+LogWriterStats LogSegmentWriter::stats() const {
+    return {
+        counters_.open_calls.load(std::memory_order_relaxed),
+        counters_.close_calls.load(std::memory_order_relaxed),
+        counters_.write_calls.load(std::memory_order_relaxed),
+        counters_.fsync_calls.load(std::memory_order_relaxed),
+        counters_.bytes_written.load(std::memory_order_relaxed),
+        counters_.batches.load(std::memory_order_relaxed),
+        counters_.entries.load(std::memory_order_relaxed)
+    };
+}
+
+bool LogSegmentWriter::seal() {
+    if (fd_ < 0) return false;
+    if (!flush()) return false;
+    std::string tail;
+    LogSegmentTrailer trailer {};
+    trailer.magic = TRAILER_MAGIC;
+    trailer.version = VERSION;
+    trailer.data_end = data_end_;
+    trailer.index_offset = data_end_;
+    trailer.index_count = static_cast<uint32_t>(index_.size());
+    tail.append(reinterpret_cast<const char*>(index_.data()), index_.size() * sizeof(LogSegmentIndexEntry));
+    trailer.strings_offset = data_end_ + tail.size();
+    trailer.string_count = static_cast<uint32_t>(strings_.size());
+    for (const auto& text : strings_) {
+        uint16_t length = static_cast<uint16_t>(text.size());
+        tail.append(reinterpret_cast<const char*>(&length), sizeof(length));
+        tail.append(text);
+    }
+    if (trigrams_.size() == index_.size() * TRIGRAM_BLOOM_BYTES) {
+        LogTrigramSectionHeader section {};
+        section.magic = TRIGRAM_MAGIC;
+        section.bloom_bytes = TRIGRAM_BLOOM_BYTES;
+        section.block_count = static_cast<uint32_t>(index_.size());
+        tail.append(reinterpret_cast<const char*>(&section), sizeof(section));
+        tail.append(reinterpret_cast<const char*>(trigrams_.data()), trigrams_.size());
+    }
+    trailer.entry_count = entry_count_;
+    trailer.min_ts = min_ts_;
+    trailer.max_ts = max_ts_;
+    trailer.level_mask = level_mask_;
+    trailer.checksum = fnv1a(&trailer, sizeof(trailer), fnv1a(tail.data(), tail.size()));
+    tail.append(reinterpret_cast<const char*>(&trailer), sizeof(trailer));
+    bool ok = write_fully(tail.data(), tail.size());
+    if (!ok) LOGE("Failed to seal log segment %s: %s", path_.c_str(), strerror(errno));
+    close();
+    return ok;
+}
+
+void LogSegmentWriter::close() {
+    if (fd_ >= 0) {
+        flush();
+        ::close(fd_);
+        counters_.close_calls.fetch_add(1, std::memory_order_relaxed);
+    }
+    fd_ = -1;
+    pending_.clear();
+    data_end_ = 0;
+    entry_count_ = 0;
+    min_ts_ = max_ts_ = 0;
+    level_mask_ = 0;
+    string_ids_.clear();
+    strings_.clear();
+    index_.clear();
+    trigrams_.clear();
+}
+
+// --- LogSegmentReader ---
+
+LogSegmentReader::~LogSegmentReader() {
+    if (data_) munmap(const_cast<uint8_t*>(data_), size_);
+}
+
+bool LogSegmentReader::open(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    struct stat st {};
+    bool ok = fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= sizeof(LogSegmentFileHeader);
+    if (ok) {
+        void* mapping = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED) {
+            ok = false;
+        } else {
+            data_ = static_cast<const uint8_t*>(mapping);
+            size_ = static_cast<size_t>(st.st_size);
+        }
+    }
+    ::close(fd);
+    if (!ok) return false;
+
+    LogSegmentFileHeader header;
+    std::memcpy(&header, data_, sizeof(header));
+    if (header.magic != FILE_MAGIC || header.version != VERSION) return false;
+    sealed_ = load_trailer();
+    if (!sealed_) data_end_ = scan_records();
+    if (!index_.empty()) {
+        first_seq_ = block_first_seq(0);
+        std::vector<uint64_t> offsets;
+        block_entries(index_.size() - 1, offsets);
+        if (!offsets.empty()) last_seq_ = reinterpret_cast<const LogRecordHeader*>(data_ + offsets.back())->seq;
+    }
+    return true;
+}
+
+bool LogSegmentReader::load_trailer() {
+    if (size_ < sizeof(LogSegmentFileHeader) + sizeof(LogSegmentTrailer)) return false;
+    LogSegmentTrailer trailer;
+    std::memcpy(&trailer, data_ + size_ - sizeof(trailer), sizeof(trailer));
+    if (trailer.magic != TRAILER_MAGIC || trailer.version != VERSION) return false;
+    uint64_t tail_end = size_ - sizeof(trailer);
+    if (trailer.data_end < sizeof(LogSegmentFileHeader) || trailer.index_offset != trailer.data_end ||
+        trailer.strings_offset < trailer.index_offset || trailer.strings_offset > tail_end ||
+        trailer.index_offset + static_cast<uint64_t>(trailer.index_count) * sizeof(LogSegmentIndexEntry) != trailer.strings_offset) {
+        return false;
+    }
+    uint32_t expected = trailer.checksum;
+    trailer.checksum = 0;
+    uint32_t actual = fnv1a(&trailer, sizeof(trailer), fnv1a(data_ + trailer.index_offset, tail_end - trailer.index_offset));
+    if (actual != expected) return false;
+
+    index_.resize(trailer.index_count);
+    std::memcpy(index_.data(), data_ + trailer.index_offset, index_.size() * sizeof(LogSegmentIndexEntry));
+    strings_.reserve(trailer.string_count);
+    uint64_t pos = trailer.strings_offset;
+    for (uint32_t i = 0; i < trailer.string_count; ++i) {
+        uint16_t length;
+        if (pos + sizeof(length) > tail_end) return false;
+        std::memcpy(&length, data_ + pos, sizeof(length));
+        pos += sizeof(length);
+        if (pos + length > tail_end) return false;
+        strings_.emplace_back(reinterpret_cast<const char*>(data_ + pos), length);
+        pos += length;
+    }
+    // 字符串表之后若还有数据，是三字节组索引节；格式不符时只是不用它
+    LogTrigramSectionHeader section;
+    if (pos + sizeof(section) <= tail_end) {
+        std::memcpy(&section, data_ + pos, sizeof(section));
+        if (section.magic == TRIGRAM_MAGIC && section.bloom_bytes == TRIGRAM_BLOOM_BYTES &&
+            section.block_count == trailer.index_count &&
+            pos + sizeof(section) + static_cast<uint64_t>(section.block_count) * TRIGRAM_BLOOM_BYTES == tail_end) {
+            trigrams_ = data_ + pos + sizeof(section);
+        }
+    }
+    data_end_ = trailer.data_end;
+    entry_count_ = trailer.entry_count;
+    min_ts_ = trailer.min_ts;
+    max_ts_ = trailer.max_ts;
+    level_mask_ = trailer.level_mask;
+    return true;
+}
+
+uint64_t LogSegmentReader::scan_records() {
+    uint64_t pos = sizeof(LogSegmentFileHeader);
+    uint64_t block_start = pos;
+    index_.clear();
+    strings_.clear();
+    trigrams_ = nullptr;
+    entry_count_ = 0;
+    while (pos + sizeof(LogRecordHeader) <= size_) {
+        LogRecordHeader header;
+        std::memcpy(&header, data_ + pos, sizeof(header));
+        uint64_t end = pos + sizeof(header) + header.payload_len;
+        if (end > size_ || record_checksum(header, data_ + pos + sizeof(header)) != header.checksum) break;
+        const char* payload = reinterpret_cast<const char*>(data_ + pos + sizeof(header));
+        if (header.kind == static_cast<uint8_t>(LogRecordKind::STRING_DEF)) {
+            if (header.string_id != strings_.size() + 1) break;
+            strings_.emplace_back(payload, header.payload_len);
+        } else if (is_entry_kind(header.kind)) {
+            if (entry_count_ % INDEX_INTERVAL == 0) {
+                LogSegmentIndexEntry block {};
+                block.offset = block_start;
+                block.min_ts = block.max_ts = header.timestamp_ms;
+                index_.push_back(block);
+            }
+            LogSegmentIndexEntry& block = index_.back();
+            block.min_ts = std::min<int64_t>(block.min_ts, header.timestamp_ms);
+            block.max_ts = std::max<int64_t>(block.max_ts, header.timestamp_ms);
+            block.count++;
+            block.level_mask |= level_bit(header.level);
+            block.package_bloom |= 1ULL << (header.string_id % 64);
+            min_ts_ = entry_count_ == 0 ? header.timestamp_ms : std::min<int64_t>(min_ts_, header.timestamp_ms);
+            max_ts_ = entry_count_ == 0 ? header.timestamp_ms : std::max<int64_t>(max_ts_, header.timestamp_ms);
+            level_mask_ |= level_bit(header.level);
+            entry_count_++;
+            block_start = end;
+        } else {
+            break;
+        }
+        pos = end;
+    }
+    return pos;
+}
+
+const LogRecordHeader* LogSegmentReader::record_at(uint64_t offset) const {
+    if (offset + sizeof(LogRecordHeader) > data_end_) return nullptr;
+    const auto* header = reinterpret_cast<const LogRecordHeader*>(data_ + offset);
+    if (offset + sizeof(LogRecordHeader) + header->payload_len > data_end_) return nullptr;
+    return header;
+}
+
+const std::string& LogSegmentReader::string_of(uint32_t id) const {
+    static const std::string EMPTY;
+    return id != NO_STRING && id <= strings_.size() ? strings_[id - 1] : EMPTY;
+}
+
+uint64_t LogSegmentReader::block_end(size_t block) const {
+    return block + 1 < index_.size() ? index_[block + 1].offset : data_end_;
+}
+
+void LogSegmentReader::block_entries(size_t block, std::vector<uint64_t>& offsets) const {
+    offsets.clear();
+    uint64_t end = block_end(block);
+    for (uint64_t pos = index_[block].offset; pos < end;) {
+        const LogRecordHeader* header = record_at(pos);
+        if (!header) break;
+        if (is_entry_kind(header->kind)) offsets.push_back(pos);
+        pos += sizeof(LogRecordHeader) + header->payload_len;
+    }
+}
+
+uint64_t LogSegmentReader::block_first_seq(size_t block) const {
+    // 块开头至多是几条 STRING_DEF，很快就能走到第一条 ENTRY
+    for (uint64_t pos = index_[block].offset;;) {
+        const LogRecordHeader* header = record_at(pos);
+        if (!header) return 0;
+        if (is_entry_kind(header->kind)) return header->seq;
+        pos += sizeof(LogRecordHeader) + header->payload_len;
+    }
+}
+
+void LogSegmentReader::read_all(std::vector<LogEntry>& out) const {
+    std::vector<uint64_t> offsets;
+    for (size_t b = 0; b < index_.size(); ++b) {
+        block_entries(b, offsets);
+        for (uint64_t offset : offsets) out.push_back(decode_entry(reinterpret_cast<const LogRecordHeader*>(data_ + offset)));
+    }
+}
+
+LogEntry LogSegmentReader::decode_entry(const LogRecordHeader* header) const {
+    LogEntry entry {
+        .timestamp_ms = header->timestamp_ms,
+        .level = static_cast<LogLevel>(header->level),
+        .category = string_of(header->category_id),
+        .message = std::string(record_message(header)),
+        .package_name = string_of(header->string_id),
+        .user_id = header->user_id,
+        .seq = header->seq
+    };
+    if (header->kind == static_cast<uint8_t>(LogRecordKind::ENTRY_REPEATED) && header->payload_len >= sizeof(LogRepeatInfo)) {
+        LogRepeatInfo info;
+        std::memcpy(&info, header + 1, sizeof(info));
+        entry.repeat_count = info.repeat_count;
+        entry.first_timestamp_ms = info.first_timestamp_ms;
+    }
+    return entry;
+}
+
+void LogSegmentReader::query(const LogQuery& query, std::vector<LogEntry>& out, LogQueryStats* stats) const {
+    LogQueryStats local;
+    LogQueryStats& s = stats ? *stats : local;
+    s.blocks_total += index_.size();
+
+    uint32_t package_id = NO_STRING;
+    if (!query.package_name.empty()) {
+        auto it = std::find(strings_.begin(), strings_.end(), query.package_name);
+        if (it == strings_.end()) {
+            s.blocks_skipped += index_.size();
+            return;
+        }
+        package_id = static_cast<uint32_t>(it - strings_.begin() + 1);
+    }
+    const bool limited = query.limit > 0 && !query.since_ts;
+    const uint64_t package_bit = 1ULL << (package_id % 64);
+
+    std::vector<uint64_t> offsets;
+    offsets.reserve(INDEX_INTERVAL);
+    size_t visited = 0;
+    bool done = false;
+    for (size_t b = index_.size(); b-- > 0 && !done;) {
+        if (limited && out.size() >= static_cast<size_t>(query.limit)) break;
+        const LogSegmentIndexEntry& block = index_[b];
+        if (query.since_ts && block.max_ts <= *query.since_ts && !query.before_ts) break;
+        visited++;
+        if ((query.before_ts && block.min_ts >= *query.before_ts) ||
+            (query.since_ts && block.max_ts <= *query.since_ts) ||
+            !(block.level_mask & query.level_mask) ||
+            (package_id != NO_STRING && !(block.package_bloom & package_bit))) {
+            s.blocks_skipped++;
+            continue;
+        }
+
+        block_entries(b, offsets);
+        for (auto it = offsets.rbegin(); it != offsets.rend(); ++it) {
+            if (limited && out.size() >= static_cast<size_t>(query.limit)) break;
+            const auto* header = reinterpret_cast<const LogRecordHeader*>(data_ + *it);
+            s.records_examined++;
+            long long timestamp = header->timestamp_ms;
+            if (query.before_ts && timestamp >= *query.before_ts) continue;
+            if (query.since_ts && timestamp <= *query.since_ts) {
+                if (!query.before_ts) {
+                    done = true;
+                    break;
+                }
+                continue;
+            }
+            if (!(level_bit(header->level) & query.level_mask)) continue;
+            if (package_id != NO_STRING && header->string_id != package_id) continue;
+            s.records_decoded++;
+            out.push_back(decode_entry(header));
+        }
+    }
+    // 未访问的块（因条数已满或时间已早于 since 而提前结束）也计为跳过
+    s.blocks_skipped += index_.size() - visited;
+}
+
+bool LogSegmentReader::search(const LogFilter& filter, uint64_t after_seq, uint64_t before_seq, bool older, size_t limit,
+                              std::vector<LogEntry>& out, LogQueryStats* stats) const {
+    LogQueryStats local;
+    LogQueryStats& s = stats ? *stats : local;
+    s.blocks_total += index_.size();
+    if (limit == 0 || index_.empty()) return limit == 0;
+
+    // 包名与分类先换成段内 ID，之后只比较定长头；段内没有出现过的名字直接判定整段不命中
+    uint32_t package_id = NO_STRING;
+    if (!filter.package_name.empty()) {
+        auto it = std::find(strings_.begin(), strings_.end(), filter.package_name);
+        if (it == strings_.end()) {
+            s.blocks_skipped += index_.size();
+            return false;
+        }
+        package_id = static_cast<uint32_t>(it - strings_.begin() + 1);
+    }
+    std::vector<uint32_t> category_ids;
+    for (const auto& category : filter.categories) {
+        auto it = std::find(strings_.begin(), strings_.end(), category);
+        if (it != strings_.end()) category_ids.push_back(static_cast<uint32_t>(it - strings_.begin() + 1));
+    }
+    if (!filter.categories.empty() && category_ids.empty()) {
+        s.blocks_skipped += index_.size();
+        return false;
+    }
+    const uint64_t package_bit = 1ULL << (package_id % 64);
+
+    const std::string_view needle = filter.text;
+    const bool use_trigrams = !needle.empty() && trigrams_ && text_options_.trigram_index;
+    const std::vector<uint32_t> needle_bits = use_trigrams ? text_search::trigram_bits(needle, TRIGRAM_BLOOM_BYTES)
+                                                           : std::vector<uint32_t>();
+    auto find_text = text_options_.simd ? text_search::find_simd : text_search::find_scalar;
+    std::vector<uint64_t> hits;  // 块内关键字出现的文件偏移，升序
+
+    std::vector<uint64_t> offsets;
+    offsets.reserve(INDEX_INTERVAL);
+    size_t visited = 0;
+    const size_t start_size = out.size();
+    bool reached_limit = false;
+    const size_t block_count = index_.size();
+    for (size_t i = 0; i < block_count && !reached_limit; ++i) {
+        size_t b = older ? block_count - 1 - i : i;
+        // 段内 seq 单调递增，块的 seq 范围由相邻块的首条 seq 确定
+        uint64_t block_lo = block_first_seq(b);
+        uint64_t block_hi = b + 1 < block_count ? block_first_seq(b + 1) - 1 : last_seq_;
+        if (older ? block_hi <= after_seq : block_lo >= before_seq) break;
+        visited++;
+        const LogSegmentIndexEntry& block = index_[b];
+        if ((older ? block_lo >= before_seq : block_hi <= after_seq) ||
+            (filter.since_ts && block.max_ts < *filter.since_ts) ||
+            (filter.until_ts && block.min_ts >= *filter.until_ts) ||
+            !(block.level_mask & filter.level_mask) ||
+            (package_id != NO_STRING && !(block.package_bloom & package_bit))) {
+            s.blocks_skipped++;
+            continue;
+        }
+        if (!needle_bits.empty() && !text_search::bloom_may_contain(trigrams_ + b * TRIGRAM_BLOOM_BYTES, needle_bits)) {
+            s.blocks_skipped++;
+            s.blocks_trigram_skipped++;
+            continue;
+        }
+        if (!needle.empty()) {
+            // 对整块的原始字节做一次子串扫描：没有命中就不必逐条看记录；
+            // 落在定长头或跨越记录边界的命中在下面按消息区间排除
+            hits.clear();
+            std::string_view raw(reinterpret_cast<const char*>(data_ + block.offset), block_end(b) - block.offset);
+            for (size_t pos = find_text(raw, needle, 0); pos != text_search::npos; pos = find_text(raw, needle, pos + 1)) {
+                hits.push_back(block.offset + pos);
+            }
+            if (hits.empty()) continue;
+        }
+
+        block_entries(b, offsets);
+        auto visit = [&](uint64_t offset) {
+            const auto* header = reinterpret_cast<const LogRecordHeader*>(data_ + offset);
+            s.records_examined++;
+            if (header->seq <= after_seq || header->seq >= before_seq) return;
+            if (filter.since_ts && header->timestamp_ms < *filter.since_ts) return;
+            if (filter.until_ts && header->timestamp_ms >= *filter.until_ts) return;
+            if (!(level_bit(header->level) & filter.level_mask)) return;
+            if (package_id != NO_STRING && header->string_id != package_id) return;
+            if (!category_ids.empty() &&
+                std::find(category_ids.begin(), category_ids.end(), header->category_id) == category_ids.end()) return;
+            if (!needle.empty()) {
+                std::string_view message = record_message(header);
+                uint64_t message_begin = static_cast<uint64_t>(reinterpret_cast<const uint8_t*>(message.data()) - data_);
+                auto hit = std::lower_bound(hits.begin(), hits.end(), message_begin);
+                if (hit == hits.end() || *hit + needle.size() > message_begin + message.size()) return;
+            }
+            s.records_decoded++;
+            out.push_back(decode_entry(header));
+            reached_limit = out.size() - start_size >= limit;
+        };
+        if (older) {
+            for (auto it = offsets.rbegin(); it != offsets.rend() && !reached_limit; ++it) visit(*it);
+        } else {
+            for (auto it = offsets.begin(); it != offsets.end() && !reached_limit; ++it) visit(*it);
+        }
+    }
+    s.blocks_skipped += block_count - visited;
+    return reached_limit;
+}
+
+// --- 旧版 JSON 行文件与转换 ---
+
+namespace log_segment {
+
+static bool has_suffix(const std::string& text, const char* suffix) {
+    size_t length = std::strlen(suffix);
+    return text.size() >= length && text.compare(text.size() - length, length, suffix) == 0;
+}
+
+bool is_segment_file(const std::string& filename) {
+    return filename.rfind("fct_", 0) == 0 && has_suffix(filename, ".seg");
+}
+
+bool is_legacy_file(const std::string& filename) {
+    return filename.rfind("fct_", 0) == 0 && has_suffix(filename, ".log");
+}
+
+bool parse_legacy_line(const std::string& line, LogEntry& out) {
+    json j = json::parse(line, nullptr, false);
+    if (!j.is_object()) return false;
+    try {
+        out.timestamp_ms = j.value("ts", 0LL);
+        out.level = static_cast<LogLevel>(j.value("lvl", 0));
+        out.category = j.value("cat", "");
+        out.message = j.value("msg", "");
+        out.package_name = j.value("pkg", "");
+        out.user_id = j.value("uid", -1);
+    } catch (const json::exception&) {
+        return false;
+    }
+    return true;
+}
+
+void query_legacy_file(const std::string& path, const LogQuery& query, std::vector<LogEntry>& out, LogQueryStats* stats) {
+    std::ifstream log_file(path);
+    if (!log_file.is_open()) return;
+    std::vector<std::string> lines;
+    std::string line;
+    while (std::getline(log_file, line)) {
+        lines.push_back(line);
+    }
+
+    for (auto it = lines.rbegin(); it != lines.rend(); ++it) {
+        if (query.limit > 0 && out.size() >= static_cast<size_t>(query.limit) && !query.since_ts) break;
+        LogEntry entry;
+        if (stats) {
+            stats->records_examined++;
+            stats->records_decoded++;
+        }
+        if (!parse_legacy_line(*it, entry)) continue;
+        if (query.before_ts && entry.timestamp_ms >= *query.before_ts) continue;
+        if (query.since_ts && entry.timestamp_ms <= *query.since_ts) {
+            if (!query.before_ts) break;
+            continue;
+        }
+        if (!(level_bit(static_cast<int>(entry.level)) & query.level_mask)) continue;
+        if (!query.package_name.empty() && entry.package_name != query.package_name) continue;
+        out.push_back(std::move(entry));
+    }
+}
+
+// 先写临时文件并封存，再改名替换目标文件
+static long write_sealed_segment(std::vector<LogEntry>& entries, const std::string& segment_path, uint64_t first_seq) {
+    std::string temp_path = segment_path + ".tmp";
+    std::error_code ec;
+    fs::remove(temp_path, ec);
+    LogSegmentWriter writer;
+    if (!writer.open(temp_path)) return -1;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        entries[i].seq = first_seq + i;
+        writer.append(entries[i]);
+        if ((i + 1) % INDEX_INTERVAL == 0 && !writer.flush()) break;
+    }
+    if (!writer.seal()) {
+        fs::remove(temp_path, ec);
+        return -1;
+    }
+    fs::rename(temp_path, segment_path, ec);
+    if (ec) {
+        LOGE("Failed to rename log segment %s: %s", segment_path.c_str(), ec.message().c_str());
+        fs::remove(temp_path, ec);
+        return -1;
+    }
+    return static_cast<long>(entries.size());
+}
+
+long convert_legacy_file(const std::string& legacy_path, const std::string& segment_path, uint64_t first_seq) {
+    std::ifstream input(legacy_path);
+    if (!input.is_open()) return -1;
+    std::vector<LogEntry> entries;
+    std::string line;
+    LogEntry entry;
+    while (std::getline(input, line)) {
+        if (parse_legacy_line(line, entry)) entries.push_back(entry);
+    }
+    return write_sealed_segment(entries, segment_path, first_seq);
+}
+
+long resequence_segment(const std::string& segment_path, uint64_t first_seq) {
+    std::vector<LogEntry> entries;
+    {
+        LogSegmentReader reader;
+        if (!reader.open(segment_path)) return -1;
+        entries.reserve(reader.entry_count());
+        // 旧段的 seq 全为 0，不能按 seq 区间扫描，按文件顺序整段读出
+        reader.read_all(entries);
+    }
+    return write_sealed_segment(entries, segment_path, first_seq);
+}
+
+} // namespace log_segment
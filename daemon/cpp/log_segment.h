@@ -0,0 +1,300 @@
+// daemon/cpp/log_segment.h
+#ifndef CERBERUS_LOG_SEGMENT_H
+#define CERBERUS_LOG_SEGMENT_H
+
+#include "logger.h"
+#include <nlohmann/json.hpp>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <deque>
+#include <atomic>
+#include <sys/uio.h>
+#include <optional>
+#include <cstdint>
+#include <cstddef>
+
+using json = nlohmann::json;
+
+// 只追加的二进制日志段（fct_YYYY-MM-DD_N.seg）。
+//
+// 布局（小端）：
+//   [0, 32)                 LogSegmentFileHeader
+//   [32, data_end)          记录序列，每条为 32 字节的 LogRecordHeader + payload_len 字节的载荷
+//   [data_end, 文件末尾)     封存后的尾部：稀疏时间索引、字符串表、三字节组索引、LogSegmentTrailer（固定在最后 72 字节）
+//
+// 记录有三种：
+//   ENTRY           一条日志；时间戳、级别、分类 ID、包名 ID、用户 ID 都在定长头中，载荷只有消息文本
+//   ENTRY_REPEATED  风暴合并的汇总日志；载荷为 LogRepeatInfo 加消息文本，其余同 ENTRY
+//   STRING_DEF      定义段内字符串表的一项（ID 在 string_id，载荷为字符串），总在第一次引用之前写入
+// 因此按时间、级别或包名筛选时只需读定长头，消息文本只在命中时解码。
+//
+// 每 INDEX_INTERVAL 条日志为一个块，稀疏索引记录块的起始偏移、时间范围、级别掩码与包名布隆位，
+// 查询据此整块跳过。三字节组索引为每块一个 TRIGRAM_BLOOM_BYTES 字节的布隆过滤器，覆盖块内全部消息文本，
+// 全文检索据此跳过不可能包含关键字的块；它位于字符串表与 LogSegmentTrailer 之间，没有这一节的旧段照常读取。未封存的段（写入中或崩溃后）没有尾部，读者顺序扫描记录并在内存中重建同样的索引；
+// 每条记录带校验和，撕裂的尾部记录被忽略。
+namespace log_segment_layout {
+constexpr uint32_t FILE_MAGIC = 0x47534C43;     // "CLSG"
+constexpr uint32_t TRAILER_MAGIC = 0x46534C43;  // "CLSF"
+constexpr uint16_t VERSION = 1;
+constexpr uint32_t INDEX_INTERVAL = 64;
+constexpr uint32_t MAX_STRING_BYTES = 0xFFFF;
+constexpr uint32_t MAX_MESSAGE_BYTES = 64 * 1024;
+constexpr uint32_t NO_STRING = 0;
+constexpr uint32_t TRIGRAM_MAGIC = 0x47544C43;  // "CLTG"
+constexpr uint32_t TRIGRAM_BLOOM_BYTES = 512;
+} // namespace log_segment_layout
+
+enum class LogRecordKind : uint8_t {
+    ENTRY = 1,
+    STRING_DEF = 2,
+    ENTRY_REPEATED = 3
+};
+
+struct LogSegmentFileHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t header_size;
+    int64_t created_ms;
+    uint8_t reserved[16];
+};
+static_assert(sizeof(LogSegmentFileHeader) == 32, "file header layout");
+
+struct LogRecordHeader {
+    int64_t timestamp_ms;
+    uint32_t payload_len;
+    uint8_t kind;           // LogRecordKind
+    uint8_t level;          // LogLevel
+    uint16_t category_id;   // 字符串表 ID
+    uint32_t string_id;     // ENTRY: 包名 ID（0 表示无）；STRING_DEF: 被定义的 ID
+    int32_t user_id;
+    uint32_t checksum;      // 头（本字段置 0）与载荷的 FNV-1a
+    uint32_t seq;           // ENTRY: LogEntry::seq 的低 32 位，段内单调递增；STRING_DEF: 0
+};
+static_assert(sizeof(LogRecordHeader) == 32, "record header layout");
+
+// ENTRY_REPEATED 载荷的前缀
+struct LogRepeatInfo {
+    int64_t first_timestamp_ms;
+    uint32_t repeat_count;
+    uint32_t reserved;
+};
+static_assert(sizeof(LogRepeatInfo) == 16, "repeat info layout");
+
+struct LogSegmentIndexEntry {
+    uint64_t offset;        // 块内第一条记录（可能是 STRING_DEF）的偏移
+    int64_t min_ts;
+    int64_t max_ts;
+    uint32_t count;         // 块内 ENTRY 与 ENTRY_REPEATED 条数
+    uint32_t level_mask;    // 1 << level
+    uint64_t package_bloom; // 1 << (包名 ID % 64)，0 号（无包名）也计入
+};
+static_assert(sizeof(LogSegmentIndexEntry) == 40, "index entry layout");
+
+struct LogSegmentTrailer {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t reserved0;
+    uint32_t index_count;
+    uint32_t string_count;
+    uint64_t index_offset;
+    uint64_t strings_offset;
+    uint64_t data_end;
+    uint64_t entry_count;
+    int64_t min_ts;
+    int64_t max_ts;
+    uint32_t level_mask;
+    uint32_t checksum;      // 索引、字符串表与本结构（本字段置 0）的 FNV-1a
+};
+static_assert(sizeof(LogSegmentTrailer) == 72, "trailer layout");
+
+// 三字节组索引节的头，其后是 block_count 个 bloom_bytes 字节的过滤器，与稀疏索引的块一一对应
+struct LogTrigramSectionHeader {
+    uint32_t magic;
+    uint32_t bloom_bytes;
+    uint32_t block_count;
+    uint32_t reserved;
+};
+static_assert(sizeof(LogTrigramSectionHeader) == 16, "trigram section layout");
+
+// 日志页查询条件，时间语义与旧版 get_logs_from_file 相同：
+//   从新到旧返回至多 limit 条；before 之后（含）的跳过；
+//   遇到不晚于 since 的记录时，无 before 则停止，有 before 则跳过；给出 since 时不受 limit 限制
+struct LogQuery {
+    int limit = 50;
+    std::optional<long long> before_ts;
+    std::optional<long long> since_ts;
+    uint32_t level_mask = 0xFFFFFFFFu;  // 1 << LogLevel
+    std::string package_name;           // 为空时不筛选
+};
+
+struct LogQueryStats {
+    size_t blocks_total = 0;
+    size_t blocks_skipped = 0;
+    size_t blocks_trigram_skipped = 0;  // blocks_skipped 中由三字节组索引排除的块
+    size_t records_examined = 0;  // 读取了定长头的日志条数
+    size_t records_decoded = 0;   // 解码了消息文本的日志条数
+};
+
+// 写入者的系统调用与字节计数（跨 open/close 累计）
+struct LogWriterStats {
+    uint64_t open_calls = 0;
+    uint64_t close_calls = 0;
+    uint64_t write_calls = 0;     // write 与 writev
+    uint64_t fsync_calls = 0;
+    uint64_t bytes_written = 0;
+    uint64_t batches = 0;         // write_batch 次数
+    uint64_t entries = 0;         // write_batch 写出的日志条数
+};
+
+// 全文检索的实现选择，默认即最快的组合；基准以此对比各实现
+struct LogTextSearchOptions {
+    bool simd = true;           // 否则用逐字节扫描
+    bool trigram_index = true;  // 否则不用三字节组索引跳块
+};
+
+// 段写入者。打开已有的段时会去掉尾部（封存的段）或截掉撕裂的记录（未封存的段）后继续追加
+class LogSegmentWriter {
+public:
+    LogSegmentWriter() = default;
+    ~LogSegmentWriter();
+
+    LogSegmentWriter(const LogSegmentWriter&) = delete;
+    LogSegmentWriter& operator=(const LogSegmentWriter&) = delete;
+
+    bool open(const std::string& path);
+    bool is_open() const { return fd_ >= 0; }
+    const std::string& path() const { return path_; }
+    uint64_t entry_count() const { return entry_count_; }
+    // 当前段的数据字节数（不含封存后的尾部）
+    uint64_t size_bytes() const { return data_end_; }
+
+    // 编码进内部缓冲区，flush() 时一次写出；写出失败时关闭，需重新 open()
+    void append(const LogEntry& entry);
+    bool flush();
+    // 组提交：整批编码后以一次 writev 写出（超过 IOV_MAX 个片段时分几次），消息文本不复制；
+    // 写出失败时关闭，需重新 open()
+    bool write_batch(const std::deque<LogEntry>& entries);
+    // fdatasync 已写出的数据
+    bool sync();
+    LogWriterStats stats() const;
+    // 写出尾部并关闭；封存后的段仍可再次 open() 继续追加
+    bool seal();
+    // 不写尾部直接关闭（已追加的记录仍可被顺序扫描读出）
+    void close();
+
+private:
+    uint32_t intern(const std::string& text);
+    void append_record(LogRecordKind kind, uint32_t string_id, std::string_view payload);
+    // 把一条日志所需的 STRING_DEF 与定长头追加到 pending_ 并更新索引，返回（截断后的）消息文本
+    std::string_view encode_entry(const LogEntry& entry);
+    bool load_existing();
+    bool write_fully(const char* data, size_t size);
+    bool writev_fully(std::vector<iovec>& iov);
+
+    struct Counters {
+        std::atomic<uint64_t> open_calls{0};
+        std::atomic<uint64_t> close_calls{0};
+        std::atomic<uint64_t> write_calls{0};
+        std::atomic<uint64_t> fsync_calls{0};
+        std::atomic<uint64_t> bytes_written{0};
+        std::atomic<uint64_t> batches{0};
+        std::atomic<uint64_t> entries{0};
+    };
+
+    int fd_ = -1;
+    std::string path_;
+    std::string pending_;
+    uint64_t data_end_ = 0;   // 已写入加上缓冲区中的数据末尾偏移
+    uint64_t entry_count_ = 0;
+    int64_t min_ts_ = 0;
+    int64_t max_ts_ = 0;
+    uint32_t level_mask_ = 0;
+    std::unordered_map<std::string, uint32_t> string_ids_;
+    std::vector<std::string> strings_;  // strings_[id - 1]
+    std::vector<LogSegmentIndexEntry> index_;
+    std::vector<uint8_t> trigrams_;     // 每块 TRIGRAM_BLOOM_BYTES 字节
+    std::vector<iovec> iov_;
+    Counters counters_;
+};
+
+// 段读取者：只读映射整个文件，按索引定位块
+class LogSegmentReader {
+public:
+    LogSegmentReader() = default;
+    ~LogSegmentReader();
+
+    LogSegmentReader(const LogSegmentReader&) = delete;
+    LogSegmentReader& operator=(const LogSegmentReader&) = delete;
+
+    bool open(const std::string& path);
+    bool is_sealed() const { return sealed_; }
+    uint64_t entry_count() const { return entry_count_; }
+    int64_t min_ts() const { return min_ts_; }
+    int64_t max_ts() const { return max_ts_; }
+    // 段内第一条与最后一条日志的 seq，空段为 0
+    uint64_t first_seq() const { return first_seq_; }
+    uint64_t last_seq() const { return last_seq_; }
+    // 封存时写出了三字节组索引（未封存的段与旧版封存段没有）
+    bool has_trigram_index() const { return trigrams_ != nullptr; }
+    void set_text_search_options(const LogTextSearchOptions& options) { text_options_ = options; }
+
+    void query(const LogQuery& query, std::vector<LogEntry>& out, LogQueryStats* stats = nullptr) const;
+    // 在 seq 区间 (after_seq, before_seq) 内按筛选条件扫描，older 为 true 时从新到旧，否则从旧到新；
+    // 命中的日志追加到 out，至多 limit 条，返回是否因达到 limit 而停止。
+    // 有消息关键字时先用三字节组索引排除块，再对块的原始字节整体做一次子串扫描，只检查含命中位置的记录
+    bool search(const LogFilter& filter, uint64_t after_seq, uint64_t before_seq, bool older, size_t limit,
+                std::vector<LogEntry>& out, LogQueryStats* stats = nullptr) const;
+    // 按文件顺序读出全部日志
+    void read_all(std::vector<LogEntry>& out) const;
+
+private:
+    friend class LogSegmentWriter;
+    bool load_trailer();
+    // 未封存的段：顺序校验记录并重建索引与字符串表，返回有效数据的末尾偏移
+    uint64_t scan_records();
+    const LogRecordHeader* record_at(uint64_t offset) const;
+    const std::string& string_of(uint32_t id) const;
+    // 块内第一条 ENTRY 记录的 seq
+    uint64_t block_first_seq(size_t block) const;
+    // 收集块内全部 ENTRY 记录的偏移（按文件顺序）
+    void block_entries(size_t block, std::vector<uint64_t>& offsets) const;
+    LogEntry decode_entry(const LogRecordHeader* header) const;
+    // 块的记录区间 [offset, end)
+    uint64_t block_end(size_t block) const;
+
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+    bool sealed_ = false;
+    uint64_t data_end_ = 0;
+    uint64_t entry_count_ = 0;
+    uint32_t level_mask_ = 0;
+    int64_t min_ts_ = 0;
+    int64_t max_ts_ = 0;
+    uint64_t first_seq_ = 0;
+    uint64_t last_seq_ = 0;
+    std::vector<std::string> strings_;
+    std::vector<LogSegmentIndexEntry> index_;
+    const uint8_t* trigrams_ = nullptr;  // 指向映射中的三字节组索引节
+    LogTextSearchOptions text_options_;
+};
+
+namespace log_segment {
+
+bool is_segment_file(const std::string& filename);
+bool is_legacy_file(const std::string& filename);
+
+// 旧版 JSON 行文件（{"ts","lvl","cat","msg","pkg","uid"}）的单行解析
+bool parse_legacy_line(const std::string& line, LogEntry& out);
+// 按 LogQuery 读取旧版 JSON 行文件：读入全部行，从最后一行起逐行解析
+void query_legacy_file(const std::string& path, const LogQuery& query, std::vector<LogEntry>& out, LogQueryStats* stats = nullptr);
+// 把旧版 JSON 行文件转换为封存的段，先写临时文件再改名，日志依次分配从 first_seq 开始的序号；
+// 返回转换的条数，失败返回 -1
+long convert_legacy_file(const std::string& legacy_path, const std::string& segment_path, uint64_t first_seq);
+// 按文件顺序为段内日志重新分配从 first_seq 开始的序号并封存（用于引入序号之前写出的段）；返回条数，失败返回 -1
+long resequence_segment(const std::string& segment_path, uint64_t first_seq);
+
+} // namespace log_segment
+
+#endif // CERBERUS_LOG_SEGMENT_H
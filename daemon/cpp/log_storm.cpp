@@ -0,0 +1,138 @@
+// daemon/cpp/log_storm.cpp
+#include "log_storm.h"
+#include <algorithm>
+
+// --- LogStormAggregator ---
+
+LogStormAggregator::LogStormAggregator(const LogStormConfig& config) {
+    std::deque<LogEntry> unused;
+    set_config(config, unused);
+}
+
+void LogStormAggregator::set_config(const LogStormConfig& config, std::deque<LogEntry>& out) {
+    flush_all(out);
+    config_ = config;
+    config_.passthrough = std::max<uint32_t>(config_.passthrough, 1);
+    config_.max_keys = std::clamp<size_t>(config_.max_keys, 1, MAX_TRACKED_KEYS);
+    if (config_.window_ms <= 0) config_.enabled = false;
+}
+
+std::string LogStormAggregator::message_template(std::string_view message) {
+    std::string result;
+    result.reserve(message.size());
+    for (size_t i = 0; i < message.size(); ++i) {
+        if (message[i] >= '0' && message[i] <= '9') {
+            while (i + 1 < message.size() && message[i + 1] >= '0' && message[i + 1] <= '9') ++i;
+            result.push_back('#');
+        } else {
+            result.push_back(message[i]);
+        }
+    }
+    return result;
+}
+
+std::string LogStormAggregator::make_key(const LogEntry& entry) const {
+    std::string key;
+    key.reserve(entry.category.size() + entry.package_name.size() + entry.message.size() + 16);
+    key.append(std::to_string(static_cast<int>(entry.level))).push_back('\x1f');
+    key.append(std::to_string(entry.user_id)).push_back('\x1f');
+    key.append(entry.category).push_back('\x1f');
+    key.append(entry.package_name).push_back('\x1f');
+    key.append(message_template(entry.message));
+    return key;
+}
+
+void LogStormAggregator::close_window(Window& window, std::deque<LogEntry>& out) {
+    if (window.merged == 0) return;
+    LogEntry summary = std::move(window.latest);
+    summary.first_timestamp_ms = window.first_merged_ms;
+    summary.repeat_count = window.merged;
+    out.push_back(std::move(summary));
+    stats_.summaries++;
+    window.merged = 0;
+}
+
+void LogStormAggregator::add(LogEntry&& entry, std::deque<LogEntry>& out, uint64_t source_pos) {
+    stats_.events++;
+    int level = static_cast<int>(entry.level);
+    if (!config_.enabled || (level >= 0 && level < 32 && ((1u << level) & config_.exempt_level_mask))) {
+        stats_.passed++;
+        out.push_back(std::move(entry));
+        return;
+    }
+
+    std::string key = make_key(entry);
+    auto it = windows_.find(key);
+    // 窗口已过（或时钟回拨）时先写出旧窗口的汇总，本条开启新窗口
+    if (it != windows_.end() &&
+        (entry.timestamp_ms - it->second.start_ms >= config_.window_ms || entry.timestamp_ms < it->second.start_ms)) {
+        close_window(it->second, out);
+        windows_.erase(it);
+        it = windows_.end();
+    }
+    if (it == windows_.end()) {
+        if (windows_.size() >= config_.max_keys) {
+            auto oldest = std::min_element(windows_.begin(), windows_.end(), [](const auto& a, const auto& b) {
+                return a.second.start_ms < b.second.start_ms;
+            });
+            close_window(oldest->second, out);
+            windows_.erase(oldest);
+        }
+        Window& window = windows_[std::move(key)];
+        window.start_ms = entry.timestamp_ms;
+        window.seen = 1;
+        stats_.passed++;
+        out.push_back(std::move(entry));
+        return;
+    }
+
+    Window& window = it->second;
+    if (++window.seen <= config_.passthrough) {
+        stats_.passed++;
+        out.push_back(std::move(entry));
+        return;
+    }
+    if (window.merged == 0) {
+        window.first_merged_ms = entry.timestamp_ms;
+        window.first_merged_pos = source_pos;
+    }
+    window.merged++;
+    stats_.merged++;
+    window.latest = std::move(entry);
+}
+
+void LogStormAggregator::flush_expired(long long now_ms, std::deque<LogEntry>& out) {
+    for (auto it = windows_.begin(); it != windows_.end();) {
+        if (now_ms - it->second.start_ms >= config_.window_ms) {
+            close_window(it->second, out);
+            it = windows_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void LogStormAggregator::flush_all(std::deque<LogEntry>& out) {
+    for (auto& [key, window] : windows_) close_window(window, out);
+    windows_.clear();
+}
+
+std::optional<long long> LogStormAggregator::next_deadline_ms() const {
+    std::optional<long long> deadline;
+    for (const auto& [key, window] : windows_) {
+        // 没有合并内容的窗口到期时无需写出，只是被丢弃，不必为它唤醒
+        if (window.merged == 0) continue;
+        long long end = window.start_ms + config_.window_ms;
+        if (!deadline || end < *deadline) deadline = end;
+    }
+    return deadline;
+}
+
+std::optional<uint64_t> LogStormAggregator::oldest_held_pos() const {
+    std::optional<uint64_t> oldest;
+    for (const auto& [key, window] : windows_) {
+        if (window.merged == 0) continue;
+        if (!oldest || window.first_merged_pos < *oldest) oldest = window.first_merged_pos;
+    }
+    return oldest;
+}
@@ -0,0 +1,84 @@
+// daemon/cpp/log_storm.h
+#ifndef CERBERUS_LOG_STORM_H
+#define CERBERUS_LOG_STORM_H
+
+#include "logger.h"
+#include <deque>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <cstdint>
+
+// 日志风暴合并的阈值
+struct LogStormConfig {
+    bool enabled = true;
+    // 从某个键第一次出现算起的合并窗口
+    long long window_ms = 30000;
+    // 每个窗口内原样写出的前几次（至少 1，保证第一次出现从不延迟）
+    uint32_t passthrough = 1;
+    // 同时跟踪的键数，超出时最早开始的窗口提前结束
+    size_t max_keys = 256;
+    // 这些级别不参与合并（1 << LogLevel），默认是 Doze 报告
+    uint32_t exempt_level_mask = (1u << static_cast<int>(LogLevel::BATCH_PARENT)) |
+                                 (1u << static_cast<int>(LogLevel::REPORT));
+};
+
+struct LogStormStats {
+    uint64_t events = 0;        // 输入的日志条数
+    uint64_t passed = 0;        // 原样写出的条数
+    uint64_t merged = 0;        // 被并入汇总条目的条数
+    uint64_t summaries = 0;     // 写出的汇总条目数
+};
+
+// 日志风暴合并器。(级别, 分类, 包名, 用户, 消息模板) 相同的日志在一个窗口内只原样写出前 passthrough 条，
+// 其余合并为窗口结束时写出的一条汇总：repeat_count 为合并的条数，first_timestamp_ms / timestamp_ms
+// 为其中第一次与最后一次的时间，消息取最后一次。消息模板把数字串替换为 '#'，
+// 因此只有 PID、错误码等数字不同的消息视为同一种。
+// 非线程安全，由 Logger 的写入线程在锁内调用。
+class LogStormAggregator {
+public:
+    // 窗口内一条输入至多产生两条输出（被挤掉的旧窗口的汇总 + 本条），另加到期时的 max_keys 条汇总
+    static constexpr size_t MAX_TRACKED_KEYS = 512;
+
+    explicit LogStormAggregator(const LogStormConfig& config = {});
+
+    // 切换配置前先把进行中的窗口全部写出
+    void set_config(const LogStormConfig& config, std::deque<LogEntry>& out);
+    const LogStormConfig& config() const { return config_; }
+
+    // 处理一条日志，需要写出的（本条或被提前结束的窗口的汇总）按顺序追加到 out。
+    // source_pos 为该条在日志队列中的位置，只用于 oldest_held_pos()
+    void add(LogEntry&& entry, std::deque<LogEntry>& out, uint64_t source_pos = 0);
+    // 结束 now_ms 时已满 window_ms 的窗口
+    void flush_expired(long long now_ms, std::deque<LogEntry>& out);
+    void flush_all(std::deque<LogEntry>& out);
+    // 最早到期的窗口结束时间；没有进行中的窗口时为空
+    std::optional<long long> next_deadline_ms() const;
+    // 已被合并、还未随汇总写出的条目中最早的 source_pos；没有时为空。
+    // 调用方只能把此位置之前的输入视为已落盘
+    std::optional<uint64_t> oldest_held_pos() const;
+    size_t tracked_keys() const { return windows_.size(); }
+    const LogStormStats& stats() const { return stats_; }
+
+    static std::string message_template(std::string_view message);
+
+private:
+    struct Window {
+        long long start_ms = 0;
+        uint32_t seen = 0;
+        uint32_t merged = 0;
+        long long first_merged_ms = 0;
+        uint64_t first_merged_pos = 0;
+        LogEntry latest;
+    };
+
+    std::string make_key(const LogEntry& entry) const;
+    void close_window(Window& window, std::deque<LogEntry>& out);
+
+    LogStormConfig config_;
+    std::unordered_map<std::string, Window> windows_;
+    LogStormStats stats_;
+};
+
+#endif // CERBERUS_LOG_STORM_H
@@ -1,5 +1,10 @@
 // daemon/cpp/logger.cpp
 #include "logger.h"
+#include "log_segment.h"
+#include "log_queue.h"
+#include "log_storm.h"
+#include "text_search.h"
+#include "flight_recorder.h"
 #include <fstream>
 #include <filesystem>
 #include <chrono>
@@ -19,9 +24,18 @@
 
 namespace fs = std::filesystem;
 
-const int MAX_LOG_LINES_PER_FILE = 200;
+// 段文件按稀疏索引跳块读取，单个文件可以比旧版 JSON 行文件大得多
+const size_t MAX_LOG_LINES_PER_FILE = 4096;
+const uint64_t MAX_LOG_BYTES_PER_FILE = 1024 * 1024;
 const int MAX_LOG_FILES_PER_DAY = 3;
 const int MAX_LOG_RETENTION_DAYS = 3;
+// 无锁队列的槽位数；写入线程跟不上时生产者才会等待
+const size_t LOG_QUEUE_CAPACITY = 4096;
+// 每批从队列取出的条数。合并器每条输入至多产生两条输出，另有切换配置与窗口到期时的汇总，
+// 整批仍不超过尾部缓冲区容量，被缓冲区淘汰的条目必然属于已写出的批次
+const size_t LOG_DRAIN_BATCH = 256;
+static_assert(2 * LOG_DRAIN_BATCH + 2 * LogStormAggregator::MAX_TRACKED_KEYS <= Logger::TAIL_CAPACITY,
+              "a drained batch must fit in the tail ring");
 
 // --- LogEntry (无变化) ---
 json LogEntry::to_json() const {
@@ -33,28 +47,62 @@ json LogEntry::to_json() const {
     };
     if (!package_name.empty()) j["package_name"] = package_name;
     if (user_id != -1) j["user_id"] = user_id;
+    if (repeat_count > 1) {
+        j["repeat_count"] = repeat_count;
+        j["first_timestamp"] = first_timestamp_ms;
+    }
     return j;
 }
 
+// 键按字典序写出，与 to_json() 的 std::map 顺序一致
+void LogEntry::write_json(JsonWriter& writer) const {
+    writer.begin_object().field("category", category);
+    if (repeat_count > 1) writer.field("first_timestamp", first_timestamp_ms);
+    writer.field("level", static_cast<int>(level))
+          .field("message", message);
+    if (!package_name.empty()) writer.field("package_name", package_name);
+    if (repeat_count > 1) writer.field("repeat_count", repeat_count);
+    writer.field("timestamp", timestamp_ms);
+    if (user_id != -1) writer.field("user_id", user_id);
+    writer.end_object();
+}
+
+bool LogFilter::matches(const LogEntry& entry) const {
+    if (since_ts && entry.timestamp_ms < *since_ts) return false;
+    if (until_ts && entry.timestamp_ms >= *until_ts) return false;
+    int level = static_cast<int>(entry.level);
+    if (level < 0 || level >= 32 || !((1u << level) & level_mask)) return false;
+    if (!package_name.empty() && entry.package_name != package_name) return false;
+    if (!categories.empty() && std::find(categories.begin(), categories.end(), entry.category) == categories.end()) return false;
+    if (!text.empty() && text_search::find(entry.message, text) == text_search::npos) return false;
+    return true;
+}
+
 // --- Singleton and Constructor/Destructor (无变化) ---
 std::shared_ptr<Logger> Logger::instance_ = nullptr;
 std::mutex Logger::instance_mutex_;
 
 std::shared_ptr<Logger> Logger::get_instance(const std::string& log_dir_path) {
     std::lock_guard<std::mutex> lock(instance_mutex_);
-    if (!instance_) {
-        struct make_shared_enabler : public Logger {
-            make_shared_enabler(const std::string& path) : Logger(path) {}
-        };
-        instance_ = std::make_shared<make_shared_enabler>(log_dir_path);
-    }
+    if (!instance_) instance_ = create(log_dir_path);
     return instance_;
 }
+
+std::shared_ptr<Logger> Logger::create(const std::string& log_dir_path) {
+    struct make_shared_enabler : public Logger {
+        make_shared_enabler(const std::string& path) : Logger(path) {}
+    };
+    return std::make_shared<make_shared_enabler>(log_dir_path);
+}
 Logger::Logger(const std::string& log_dir_path)
-    : log_dir_path_(log_dir_path), is_running_(true) {
+    : log_dir_path_(log_dir_path), segment_writer_(std::make_unique<LogSegmentWriter>()),
+      strings_(std::make_unique<LogStringTable>()), log_queue_(std::make_unique<LogQueue>(LOG_QUEUE_CAPACITY)),
+      storm_(std::make_unique<LogStormAggregator>()), is_running_(true) {
     if (!fs::exists(log_dir_path_)) {
         fs::create_directories(log_dir_path_);
     }
+    // 在接受任何日志之前完成迁移，新日志的 seq 接在磁盘上最后一条之后
+    next_seq_ = prepare_log_files();
     writer_thread_ = std::thread(&Logger::writer_thread_func, this);
 }
 Logger::~Logger() {
@@ -62,6 +110,9 @@ Logger::~Logger() {
 }
 void Logger::stop() {
     if (!is_running_.exchange(false)) return;
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+    }
     cv_.notify_one();
     if (writer_thread_.joinable()) {
         writer_thread_.join();
@@ -71,33 +122,149 @@ void Logger::log(LogLevel level, const std::string& category, const std::string&
     long long timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(
         std::chrono::system_clock::now().time_since_epoch()
     ).count();
-    LogEntry entry{timestamp, level, category, message, package_name, user_id};
-
-    {
-        std::lock_guard<std::mutex> lock(queue_mutex_);
-        log_queue_.push_back(entry);
-    }
-    cv_.notify_one();
+    enqueue(timestamp, level, category, message, package_name, user_id);
+    wake_writer();
 }
 void Logger::log_batch(const std::vector<LogEntry>& entries) {
     if (entries.empty()) return;
+    for (const auto& entry : entries) {
+        enqueue(entry.timestamp_ms, entry.level, entry.category, entry.message, entry.package_name, entry.user_id);
+    }
+    wake_writer();
+}
+
+void Logger::enqueue(long long timestamp_ms, LogLevel level, const std::string& category, const std::string& message,
+                     const std::string& package_name, int user_id) {
+    uint64_t pos = log_queue_->push(timestamp_ms, level, strings_->intern(category), strings_->intern(package_name), user_id, message);
+    // 同时写入飞行记录器，进程在写入线程落盘之前被杀时由下次启动补回
+    FlightRecorder::instance().record_log(timestamp_ms, level, category, package_name, user_id, message, pos);
+}
+
+void Logger::wake_writer() {
+    // 与写入线程的 writer_waiting_ 置位配对：要么它看到新条目不睡，要么这里看到它在等而唤醒它
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (writer_waiting_.load(std::memory_order_relaxed) && writer_waiting_.exchange(false)) {
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+        cv_.notify_one();
+    }
+}
+
+void Logger::drain_queue(std::deque<LogEntry>& batch) {
+    long long now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()
+    ).count();
+    {
+        std::lock_guard<std::mutex> lock(storm_mutex_);
+        std::move(storm_pending_.begin(), storm_pending_.end(), std::back_inserter(batch));
+        storm_pending_.clear();
+        // 窗口的第一次出现在 add() 中原样写出，被合并的只在窗口结束时以一条汇总写出
+        log_queue_->drain(LOG_DRAIN_BATCH, [&](uint64_t pos, const LogSlot& slot) {
+            drained_pos_ = pos + 1;
+            storm_->add(LogEntry{slot.timestamp_ms, static_cast<LogLevel>(slot.level),
+                                 strings_->lookup(slot.category_id), std::string(slot.message_view()),
+                                 strings_->lookup(slot.package_id), slot.user_id}, batch, pos);
+        });
+        storm_->flush_expired(now_ms, batch);
+        if (!is_running_ && !log_queue_->has_ready()) storm_->flush_all(batch);
+        // 仍在窗口里的条目只有飞行记录器中的副本，落盘位置停在其中最早的一条之前
+        auto held_pos = storm_->oldest_held_pos();
+        persistable_pos_ = held_pos ? std::min(*held_pos, drained_pos_) : drained_pos_;
+    }
+    if (batch.empty()) return;
+    // seq 在合并之后分配，尾部缓冲区内仍然连续
     {
-        std::lock_guard<std::mutex> lock(queue_mutex_);
-        for(const auto& entry : entries) {
-            log_queue_.push_back(entry);
+        std::lock_guard<std::mutex> lock(tail_mutex_);
+        for (auto& entry : batch) {
+            entry.seq = next_seq_++;
+            if (tail_.size() >= Logger::TAIL_CAPACITY) {
+                tail_.pop_front();
+            }
+            tail_.emplace_back(entry.seq, entry);
         }
     }
+    notify_tail_listener();
+}
+
+std::optional<long long> Logger::storm_deadline_ms() const {
+    std::lock_guard<std::mutex> lock(storm_mutex_);
+    return storm_pending_.empty() ? storm_->next_deadline_ms() : std::optional<long long>(0);
+}
+
+void Logger::set_storm_config(const LogStormConfig& config) {
+    {
+        std::lock_guard<std::mutex> lock(storm_mutex_);
+        storm_->set_config(config, storm_pending_);
+    }
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+    }
     cv_.notify_one();
 }
 
+LogStormConfig Logger::storm_config() const {
+    std::lock_guard<std::mutex> lock(storm_mutex_);
+    return storm_->config();
+}
+
+LogStormStats Logger::storm_stats() const {
+    std::lock_guard<std::mutex> lock(storm_mutex_);
+    return storm_->stats();
+}
+
+void Logger::notify_tail_listener() {
+    std::function<void()> listener;
+    {
+        std::lock_guard<std::mutex> lock(tail_mutex_);
+        listener = tail_listener_;
+    }
+    if (listener) listener();
+}
+
+void Logger::set_tail_listener(std::function<void()> listener) {
+    std::lock_guard<std::mutex> lock(tail_mutex_);
+    tail_listener_ = std::move(listener);
+}
+
+uint64_t Logger::latest_log_seq() const {
+    std::lock_guard<std::mutex> lock(tail_mutex_);
+    return next_seq_ - 1;
+}
+
+LogTailBatch Logger::read_log_tail(uint64_t after_seq, uint64_t up_to_seq, size_t max_entries) const {
+    LogTailBatch batch;
+    batch.cursor = after_seq;
+    std::lock_guard<std::mutex> lock(tail_mutex_);
+    if (tail_.empty()) return batch;
+
+    // 缓冲区内 seq 连续，可以直接按下标定位
+    uint64_t first_seq = tail_.front().first;
+    uint64_t last_seq = std::min(up_to_seq, tail_.back().first);
+    uint64_t start_seq = after_seq + 1;
+    if (start_seq < first_seq) {
+        batch.truncated = true;
+        start_seq = first_seq;
+    }
+    if (start_seq > last_seq) return batch;
+
+    uint64_t count = last_seq - start_seq + 1;
+    if (count > max_entries) {
+        count = max_entries;
+        batch.has_more = true;
+    }
+    batch.entries.reserve(count);
+    auto begin = tail_.begin() + (start_seq - first_seq);
+    batch.entries.assign(begin, begin + count);
+    batch.cursor = batch.entries.back().first;
+    return batch;
+}
+
 std::vector<std::string> Logger::get_log_files() const {
     std::vector<std::string> files;
     try {
         for (const auto& entry : fs::directory_iterator(log_dir_path_)) {
             if (entry.is_regular_file()) {
                 std::string filename = entry.path().filename().string();
-                // [修正] 使用 C++17 兼容的 rfind 方法替代 ends_with
-                if (filename.rfind("fct_", 0) == 0 && (filename.length() >= 4 && filename.rfind(".log") == filename.length() - 4)) {
+                if (log_segment::is_segment_file(filename) || log_segment::is_legacy_file(filename)) {
                     files.push_back(filename);
                 }
             }
@@ -112,58 +279,196 @@ std::vector<std::string> Logger::get_log_files() const {
 std::vector<LogEntry> Logger::get_logs_from_file(const std::string& filename, int limit,
                                                  std::optional<long long> before_timestamp_ms,
                                                  std::optional<long long> since_timestamp_ms) const {
+    LogQuery query;
+    query.limit = limit;
+    query.before_ts = before_timestamp_ms;
+    query.since_ts = since_timestamp_ms;
+    return get_logs_from_file(filename, query);
+}
+
+std::vector<LogEntry> Logger::get_logs_from_file(const std::string& filename, const LogQuery& query) const {
     std::vector<LogEntry> results;
     fs::path file_path = fs::path(log_dir_path_) / filename;
 
     if (!fs::exists(file_path)) {
         LOGW("Log file not found: %s", filename.c_str());
+    } else if (log_segment::is_segment_file(filename)) {
+        LogSegmentReader reader;
+        if (reader.open(file_path)) {
+            reader.query(query, results);
+        } else {
+            LOGW("Invalid log segment: %s", filename.c_str());
+        }
     } else {
-        std::ifstream log_file(file_path);
-        if (log_file.is_open()) {
-            std::vector<std::string> lines;
-            std::string line;
-            while (std::getline(log_file, line)) {
-                lines.push_back(line);
-            }
+        log_segment::query_legacy_file(file_path, query, results);
+    }
+
+    if (query.since_ts.has_value()) {
+        std::sort(results.begin(), results.end(), [](const auto& a, const auto& b) {
+            return a.timestamp_ms < b.timestamp_ms;
+        });
+    }
 
-            for (auto it = lines.rbegin(); it != lines.rend(); ++it) {
-                if (limit > 0 && results.size() >= limit && !since_timestamp_ms) break;
-                try {
-                    json j = json::parse(*it);
-                    long long timestamp = j.value("ts", 0LL);
-                    if (before_timestamp_ms.has_value() && timestamp >= before_timestamp_ms.value()) continue;
-                    if (since_timestamp_ms.has_value() && timestamp <= since_timestamp_ms.value()) {
-                        if (!before_timestamp_ms.has_value()) break;
-                        else continue;
-                    }
-                    results.push_back({
-                        .timestamp_ms = timestamp,
-                        .level = static_cast<LogLevel>(j.value("lvl", 0)),
-                        .category = j.value("cat", ""),
-                        .message = j.value("msg", ""),
-                        .package_name = j.value("pkg", ""),
-                        .user_id = j.value("uid", -1)
-                    });
-                } catch (...) { /* ignore */ }
+    return results;
+}
+
+uint64_t Logger::prepare_log_files() {
+    auto files = get_log_files();
+    std::reverse(files.begin(), files.end());   // 从旧到新，seq 按此顺序连续分配
+    uint64_t next_seq = 1;
+    for (const auto& filename : files) {
+        fs::path file_path = fs::path(log_dir_path_) / filename;
+        std::error_code ec;
+        if (log_segment::is_legacy_file(filename)) {
+            fs::path segment_path = file_path;
+            segment_path.replace_extension(".seg");
+            // 上次转换已改名成功但未来得及删除旧文件，段文件随后按段处理
+            if (fs::exists(segment_path, ec)) {
+                fs::remove(file_path, ec);
+                continue;
+            }
+            long converted = log_segment::convert_legacy_file(file_path, segment_path, next_seq);
+            if (converted < 0) {
+                LOGW("Failed to convert legacy log file %s, keeping it as is.", filename.c_str());
+                continue;
             }
+            next_seq += converted;
+            fs::remove(file_path, ec);
+            LOGI("Converted legacy log file %s (%ld entries) to segment.", filename.c_str(), converted);
+            continue;
+        }
+
+        LogSegmentReader reader;
+        if (!reader.open(file_path) || reader.entry_count() == 0) continue;
+        if (reader.first_seq() >= next_seq) {
+            next_seq = reader.last_seq() + 1;
+            continue;
         }
+        // 引入序号之前写出的段（seq 全为 0）或序号与前面的文件重叠：按文件顺序重新编号
+        long resequenced = log_segment::resequence_segment(file_path, next_seq);
+        if (resequenced < 0) {
+            LOGW("Failed to resequence log segment %s.", filename.c_str());
+            continue;
+        }
+        next_seq += resequenced;
+        LOGI("Resequenced log segment %s (%ld entries).", filename.c_str(), resequenced);
     }
+    return next_seq;
+}
 
-    if (since_timestamp_ms.has_value()) {
-        {
-            std::lock_guard<std::mutex> lock(queue_mutex_);
-            for(const auto& entry : log_queue_) {
-                if (entry.timestamp_ms > since_timestamp_ms.value()) {
-                    results.push_back(entry);
-                }
+std::optional<uint64_t> Logger::search_segments(const LogFilter& filter, uint64_t after_seq, uint64_t before_seq, bool older,
+                                                size_t limit, std::vector<LogEntry>& out, LogSearchStats& stats,
+                                                std::optional<std::chrono::steady_clock::time_point> deadline) const {
+    auto files = get_log_files();   // 从新到旧
+    if (!older) std::reverse(files.begin(), files.end());
+    const size_t start_size = out.size();
+    // 已完整扫描过的 seq 边界，预算用尽时作为续查的游标
+    uint64_t scanned_to = older ? before_seq : after_seq;
+    bool searched_any = false;  // 至少检索一个文件，保证续查总有进展
+    for (const auto& filename : files) {
+        if (searched_any && deadline && std::chrono::steady_clock::now() >= *deadline) {
+            stats.budget_exhausted = true;
+            return scanned_to;
+        }
+        // 未能转换的旧版文件没有 seq，不参与游标检索
+        if (!log_segment::is_segment_file(filename)) continue;
+        LogSegmentReader reader;
+        if (!reader.open(fs::path(log_dir_path_) / filename) || reader.entry_count() == 0) continue;
+        stats.files_opened++;
+        // 文件之间 seq 按文件名顺序递增，越过区间的一端即可停止
+        if (older ? reader.last_seq() <= after_seq : reader.first_seq() >= before_seq) break;
+        uint64_t file_bound = older ? std::max(reader.first_seq(), after_seq) : std::min(reader.last_seq(), before_seq);
+        if ((older ? reader.first_seq() >= before_seq : reader.last_seq() <= after_seq) ||
+            (filter.since_ts && reader.max_ts() < *filter.since_ts) ||
+            (filter.until_ts && reader.min_ts() >= *filter.until_ts)) {
+            if (older ? file_bound < scanned_to : file_bound > scanned_to) scanned_to = file_bound;
+            continue;
+        }
+        LogQueryStats segment_stats;
+        bool full = reader.search(filter, after_seq, before_seq, older, limit - (out.size() - start_size), out, &segment_stats);
+        stats.blocks_total += segment_stats.blocks_total;
+        stats.blocks_skipped += segment_stats.blocks_skipped;
+        stats.blocks_trigram_skipped += segment_stats.blocks_trigram_skipped;
+        stats.records_examined += segment_stats.records_examined;
+        stats.records_decoded += segment_stats.records_decoded;
+        if (full) return std::nullopt;
+        searched_any = true;
+        if (older ? file_bound < scanned_to : file_bound > scanned_to) scanned_to = file_bound;
+    }
+    return std::nullopt;
+}
+
+LogSearchPage Logger::search_logs(const LogSearchRequest& request) const {
+    LogSearchPage page;
+    const auto started = std::chrono::steady_clock::now();
+    std::optional<std::chrono::steady_clock::time_point> deadline;
+    if (request.budget_ms > 0) deadline = started + std::chrono::milliseconds(request.budget_ms);
+    const bool older = request.direction == LogDirection::OLDER;
+    const size_t want = request.limit + 1;  // 多取一条用于判断 has_more
+    uint64_t after_seq = !older && request.cursor ? *request.cursor : 0;
+    uint64_t before_seq = older && request.cursor ? *request.cursor : UINT64_MAX;
+
+    // 先在锁内取出尾部缓冲区中的命中：它覆盖 [ring_first, next_seq_) 的全部日志，这一段不读磁盘，
+    // 更早的到段文件中找。写入线程每批不超过缓冲区容量，被淘汰的条目都已写出；仍在无锁队列中的日志这一次查不到
+    std::vector<LogEntry> ring_hits;
+    uint64_t ring_first;
+    {
+        std::lock_guard<std::mutex> lock(tail_mutex_);
+        ring_first = tail_.empty() ? next_seq_ : tail_.front().first;
+        auto scan = [&](const std::pair<uint64_t, LogEntry>& item) {
+            if (item.first <= after_seq || item.first >= before_seq) return true;
+            page.stats.ring_entries_scanned++;
+            if (request.filter.matches(item.second)) ring_hits.push_back(item.second);
+            return ring_hits.size() < want;
+        };
+        if (older) {
+            for (auto it = tail_.rbegin(); it != tail_.rend() && it->first > after_seq; ++it) {
+                if (!scan(*it)) break;
+            }
+        } else {
+            for (auto it = tail_.begin(); it != tail_.end() && it->first < before_seq; ++it) {
+                if (!scan(*it)) break;
             }
         }
-        std::sort(results.begin(), results.end(), [](const auto& a, const auto& b) {
-            return a.timestamp_ms < b.timestamp_ms;
-        });
     }
 
-    return results;
+    std::optional<uint64_t> scanned_to;
+    if (older) {
+        page.entries = std::move(ring_hits);
+        if (page.entries.size() < want) {
+            scanned_to = search_segments(request.filter, after_seq, std::min(before_seq, ring_first), true,
+                                         want - page.entries.size(), page.entries, page.stats, deadline);
+        }
+    } else {
+        // 磁盘上的部分都早于缓冲区，先放在前面；预算用尽时磁盘还没查完，缓冲区的命中留给后续页
+        scanned_to = search_segments(request.filter, after_seq, std::min(before_seq, ring_first), false, want,
+                                     page.entries, page.stats, deadline);
+        for (auto& entry : ring_hits) {
+            if (scanned_to || page.entries.size() >= want) break;
+            page.entries.push_back(std::move(entry));
+        }
+    }
+
+    if (page.entries.size() > request.limit) {
+        page.entries.resize(request.limit);
+        page.has_more = true;
+    }
+    if (page.entries.empty()) {
+        page.older_cursor = request.cursor;
+        page.newer_cursor = request.cursor;
+    } else {
+        page.older_cursor = older ? page.entries.back().seq : page.entries.front().seq;
+        page.newer_cursor = older ? page.entries.front().seq : page.entries.back().seq;
+    }
+    if (scanned_to) {
+        // 预算用尽：本页不满，但扫描方向上的游标推进到已扫描的边界，下一页从那里继续
+        page.has_more = true;
+        if (older) page.older_cursor = *scanned_to;
+        else page.newer_cursor = *scanned_to;
+    }
+    page.stats.elapsed_us = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - started).count());
+    return page;
 }
 
 void Logger::manage_log_files() {
@@ -205,18 +510,23 @@ void Logger::manage_log_files() {
         }
     }
 
+}
+
+void Logger::resume_latest_segment() {
+    // 只续写未封存的段（上次异常退出时的段）。封存的段去掉尾部会截短文件，正在映射它的查询线程可能因此 SIGBUS，
+    // 所以与旧版文件、损坏的段一样交给轮转新建。这是唯一一次读取已有文件，之后的轮转只看写入者的计数
     auto latest_files = get_log_files();
-    if (latest_files.empty()) {
-        current_log_file_path_ = "";
-        current_log_line_count_ = 0;
-    } else {
-        current_log_file_path_ = fs::path(log_dir_path_) / latest_files[0];
-        std::ifstream ifs(current_log_file_path_);
-        current_log_line_count_ = std::count(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>(), '\n');
+    current_log_file_path_ = "";
+    if (latest_files.empty() || !log_segment::is_segment_file(latest_files[0])) return;
+    std::string latest_path = fs::path(log_dir_path_) / latest_files[0];
+    {
+        LogSegmentReader reader;
+        if (!reader.open(latest_path) || reader.is_sealed()) return;
     }
+    if (segment_writer_->open(latest_path)) current_log_file_path_ = latest_path;
 }
 
-void Logger::rotate_log_file_if_needed(size_t new_entries_count) {
+bool Logger::rotate_log_file_if_needed(size_t new_entries_count) {
     time_t now = time(nullptr);
     tm ltm = {};
     localtime_r(&now, &ltm);
@@ -224,68 +534,119 @@ void Logger::rotate_log_file_if_needed(size_t new_entries_count) {
     strftime(date_buf, sizeof(date_buf), "%Y-%m-%d", &ltm);
     std::string current_date_str(date_buf);
 
-    bool needs_new_file = false;
-    if (current_log_file_path_.empty() || 
-        current_log_file_path_.find(current_date_str) == std::string::npos ||
-        (current_log_line_count_ + new_entries_count > MAX_LOG_LINES_PER_FILE)) {
-        needs_new_file = true;
-    }
-
-    if (needs_new_file) {
-        manage_log_files();
-        auto files = get_log_files();
-
-        int next_index = 1;
-        if (!files.empty() && files[0].find(current_date_str) != std::string::npos) {
-            try {
-                std::string last_file = files[0];
-                size_t underscore_pos = last_file.rfind('_');
-                size_t dot_pos = last_file.rfind('.');
-                int last_index = std::stoi(last_file.substr(underscore_pos + 1, dot_pos - underscore_pos - 1));
-                next_index = last_index + 1;
-            } catch (...) {
-                next_index = 1;
-            }
+    // 条数与字节数都取自写入者维护的计数，不重新读文件
+    if (segment_writer_->is_open() &&
+        current_log_file_path_.find(current_date_str) != std::string::npos &&
+        segment_writer_->entry_count() + new_entries_count <= MAX_LOG_LINES_PER_FILE &&
+        segment_writer_->size_bytes() < MAX_LOG_BYTES_PER_FILE) {
+        return true;
+    }
+
+    if (segment_writer_->is_open()) {
+        if (fsync_interval_ms_.load(std::memory_order_relaxed) > 0) segment_writer_->sync();
+        segment_writer_->seal();
+    }
+    manage_log_files();
+    auto files = get_log_files();
+
+    int next_index = 1;
+    if (!files.empty() && files[0].find(current_date_str) != std::string::npos) {
+        try {
+            std::string last_file = files[0];
+            size_t underscore_pos = last_file.rfind('_');
+            size_t dot_pos = last_file.rfind('.');
+            int last_index = std::stoi(last_file.substr(underscore_pos + 1, dot_pos - underscore_pos - 1));
+            next_index = last_index + 1;
+        } catch (...) {
+            next_index = 1;
         }
-        std::string new_filename = "fct_" + current_date_str + "_" + std::to_string(next_index) + ".log";
-        current_log_file_path_ = fs::path(log_dir_path_) / new_filename;
-        current_log_line_count_ = 0;
-        LOGI("Rotating to new log file: %s", new_filename.c_str());
     }
+    std::string new_filename = "fct_" + current_date_str + "_" + std::to_string(next_index) + ".seg";
+    current_log_file_path_ = fs::path(log_dir_path_) / new_filename;
+    LOGI("Rotating to new log file: %s", new_filename.c_str());
+    if (!segment_writer_->open(current_log_file_path_)) {
+        LOGE("Failed to open log file for writing: %s", current_log_file_path_.c_str());
+        current_log_file_path_.clear();
+        return false;
+    }
+    return true;
+}
+
+void Logger::set_fsync_interval_ms(long long interval_ms) {
+    fsync_interval_ms_.store(interval_ms, std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+    }
+    cv_.notify_one();
+}
+
+LogWriterStats Logger::writer_stats() const {
+    return segment_writer_->stats();
 }
 
 void Logger::writer_thread_func() {
     manage_log_files();
+    resume_latest_segment();
 
-    while (is_running_) {
-        std::unique_lock<std::mutex> lock(queue_mutex_);
-        cv_.wait(lock, [this]{ return !log_queue_.empty() || !is_running_; });
-
-        if (!is_running_ && log_queue_.empty()) break;
+    // 定时落盘：写出后不立即 fsync，距上次同步满 fsync_interval_ms_ 时才同步一次；
+    // 之后没有新日志时也会按时醒来补上
+    auto last_sync = std::chrono::steady_clock::now();
+    bool unsynced = false;
+    // 下一次需要主动醒来的时间：定时同步，或合并器的窗口到期
+    auto wake_deadline = [&]() -> std::optional<std::chrono::steady_clock::time_point> {
+        std::optional<std::chrono::steady_clock::time_point> deadline;
+        long long interval_ms = fsync_interval_ms_.load(std::memory_order_relaxed);
+        if (unsynced && interval_ms > 0) deadline = last_sync + std::chrono::milliseconds(interval_ms);
+        if (auto storm_ms = storm_deadline_ms()) {
+            long long now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::system_clock::now().time_since_epoch()
+            ).count();
+            auto storm = std::chrono::steady_clock::now() + std::chrono::milliseconds(std::max(0LL, *storm_ms - now_ms));
+            if (!deadline || storm < *deadline) deadline = storm;
+        }
+        return deadline;
+    };
+    for (;;) {
+        if (!log_queue_->has_ready()) {
+            std::unique_lock<std::mutex> lock(wake_mutex_);
+            while (is_running_ && !log_queue_->has_ready()) {
+                // 先声明在等，再复查队列，与 wake_writer() 的屏障配对
+                writer_waiting_.store(true, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (log_queue_->has_ready()) break;
+                if (auto deadline = wake_deadline()) {
+                    if (cv_.wait_until(lock, *deadline) == std::cv_status::timeout) break;
+                } else {
+                    cv_.wait(lock);
+                }
+            }
+            writer_waiting_.store(false, std::memory_order_relaxed);
+        }
 
         std::deque<LogEntry> temp_queue;
-        temp_queue.swap(log_queue_);
-        lock.unlock();
+        drain_queue(temp_queue);
+        if (!is_running_ && temp_queue.empty()) break;
 
-        if (temp_queue.empty()) continue;
-        
-        rotate_log_file_if_needed(temp_queue.size());
-
-        std::ofstream log_file(current_log_file_path_, std::ios_base::app);
-        if (!log_file.is_open()) {
-            LOGE("Failed to open log file for writing: %s", current_log_file_path_.c_str());
-            continue;
+        // 整批一次 writev；写出失败时写入者已关闭，下一批轮转到新文件
+        if (!temp_queue.empty() && rotate_log_file_if_needed(temp_queue.size()) &&
+            segment_writer_->write_batch(temp_queue)) {
+            unsynced = true;
+            FlightRecorder::instance().mark_log_persisted(persistable_pos_);
         }
 
-        for (const auto& entry : temp_queue) {
-            json file_json = {
-                {"ts", entry.timestamp_ms}, {"lvl", static_cast<int>(entry.level)},
-                {"cat", entry.category}, {"msg", entry.message}
-            };
-            if (!entry.package_name.empty()) file_json["pkg"] = entry.package_name;
-            if (entry.user_id != -1) file_json["uid"] = entry.user_id;
-            log_file << file_json.dump() << std::endl;
+        long long interval_ms = fsync_interval_ms_.load(std::memory_order_relaxed);
+        auto now = std::chrono::steady_clock::now();
+        if (interval_ms <= 0) {
+            unsynced = false;
+        } else if (unsynced && now - last_sync >= std::chrono::milliseconds(interval_ms)) {
+            segment_writer_->sync();
+            last_sync = now;
+            unsynced = false;
         }
-        current_log_line_count_ += temp_queue.size();
     }
-}
\ No newline at end of file
+    // 正常退出时封存当前段，下次启动读取时可直接使用索引
+    if (segment_writer_->is_open()) {
+        if (fsync_interval_ms_.load(std::memory_order_relaxed) > 0) segment_writer_->sync();
+        segment_writer_->seal();
+    }
+}
@@ -12,6 +12,10 @@
 #include <nlohmann/json.hpp>
 #include <memory>
 #include <optional>
+#include <functional>
+#include <cstdint>
+#include <chrono>
+#include "json_writer.h"
 
 using json = nlohmann::json;
 
@@ -40,13 +44,90 @@ struct LogEntry {
     std::string message;
     std::string package_name;
     int user_id;
+    // 全局单调递增的日志序号，跨重启延续并随日志写入段文件；0 表示尚未分配
+    uint64_t seq = 0;
+    // 风暴合并的汇总条目代表的日志条数，timestamp_ms 为其中最后一次、first_timestamp_ms 为第一次；普通日志为 1
+    uint32_t repeat_count = 1;
+    long long first_timestamp_ms = 0;
 
     json to_json() const;
+    // 与 to_json().dump() 逐字节一致
+    void write_json(JsonWriter& writer) const;
 };
 
+// 内存尾部环形缓冲区的一次读取结果。seq 为日志的单调递增序号，客户端以其作为游标
+struct LogTailBatch {
+    std::vector<std::pair<uint64_t, LogEntry>> entries; // 按 seq 升序
+    uint64_t cursor = 0;      // 本批覆盖到的最后一个 seq，下次从这里继续
+    bool truncated = false;   // 请求的起点已被环形缓冲区淘汰，中间存在缺口
+    bool has_more = false;    // 因条数上限截断，cursor 之后还有数据
+};
+
+// 跨文件日志检索的筛选条件，各项同时满足才算命中
+struct LogFilter {
+    std::optional<long long> since_ts;      // 含
+    std::optional<long long> until_ts;      // 不含
+    uint32_t level_mask = 0xFFFFFFFFu;      // 1 << LogLevel
+    std::vector<std::string> categories;    // 为空时不筛选
+    std::string package_name;               // 为空时不筛选
+    std::string text;                       // 消息子串（区分大小写），为空时不筛选
+
+    bool matches(const LogEntry& entry) const;
+};
+
+enum class LogDirection {
+    OLDER,  // 从游标向更早的日志翻页，结果按 seq 降序
+    NEWER   // 从游标向更新的日志翻页，结果按 seq 升序
+};
+
+struct LogSearchRequest {
+    LogFilter filter;
+    LogDirection direction = LogDirection::OLDER;
+    // 不含游标本身；未给出时 OLDER 从最新一条开始，NEWER 从最早一条开始
+    std::optional<uint64_t> cursor;
+    size_t limit = 200;
+    // 大于 0 时，扫描段文件超过这么久就在文件边界停下，返回已找到的部分并把游标指向已扫描的边界
+    long long budget_ms = 0;
+};
+
+struct LogSearchStats {
+    size_t ring_entries_scanned = 0;
+    size_t files_opened = 0;
+    size_t blocks_total = 0;
+    size_t blocks_skipped = 0;
+    size_t blocks_trigram_skipped = 0;
+    size_t records_examined = 0;
+    size_t records_decoded = 0;
+    bool budget_exhausted = false;
+    uint64_t elapsed_us = 0;
+};
+
+struct LogSearchPage {
+    std::vector<LogEntry> entries;
+    // 本页最早与最新一条的 seq，分别作为 OLDER / NEWER 方向下一页的游标；本页为空时沿用请求的游标
+    std::optional<uint64_t> older_cursor;
+    std::optional<uint64_t> newer_cursor;
+    bool has_more = false;      // 请求方向上是否还有更多命中
+    LogSearchStats stats;
+};
+
+class LogSegmentWriter;
+class LogQueue;
+class LogStringTable;
+class LogStormAggregator;
+struct LogStormConfig;
+struct LogStormStats;
+struct LogQuery;
+struct LogWriterStats;
+
 class Logger : public std::enable_shared_from_this<Logger> {
 public:
+    // 内存尾部缓冲区保留的最近日志条数，供实时推送与游标回填使用
+    static constexpr size_t TAIL_CAPACITY = 2000;
+
     static std::shared_ptr<Logger> get_instance(const std::string& log_dir_path);
+    // 不注册为全局实例的独立日志器
+    static std::shared_ptr<Logger> create(const std::string& log_dir_path);
     ~Logger();
 
     Logger(const Logger&) = delete;
@@ -60,28 +141,89 @@ public:
     std::vector<LogEntry> get_logs_from_file(const std::string& filename, int limit,
                                              std::optional<long long> before_timestamp_ms,
                                              std::optional<long long> since_timestamp_ms) const;
+    // 按级别掩码与包名筛选的日志页；.seg 段按稀疏索引跳块读取，旧版 .log 文件逐行解析
+    std::vector<LogEntry> get_logs_from_file(const std::string& filename, const LogQuery& query) const;
     
+    // 跨所有保留的日志文件与内存尾部缓冲区检索：尾部缓冲区覆盖的最近日志不读磁盘，
+    // 更早的按文件名从新到旧（或从旧到新）逐个段文件跳块扫描
+    LogSearchPage search_logs(const LogSearchRequest& request) const;
+
     std::vector<std::string> get_log_files() const;
+    const std::string& log_dir() const { return log_dir_path_; }
     void stop();
 
+    // 实时日志尾部：写入线程取出每批日志后、写盘之前放入内存环形缓冲区，读取不访问磁盘
+    uint64_t latest_log_seq() const;
+    // 读取 (after_seq, up_to_seq] 区间内最早的至多 max_entries 条
+    LogTailBatch read_log_tail(uint64_t after_seq, uint64_t up_to_seq, size_t max_entries) const;
+    // 大于 0 时写入线程至多每隔这么久 fdatasync 一次当前段；0（默认）不主动同步
+    void set_fsync_interval_ms(long long interval_ms);
+    // 写入线程的系统调用与写出字节计数
+    LogWriterStats writer_stats() const;
+    // 日志风暴合并的阈值；进行中的窗口按旧配置结束后才生效
+    LogStormConfig storm_config() const;
+    void set_storm_config(const LogStormConfig& config);
+    LogStormStats storm_stats() const;
+
+    // 有新日志进入尾部缓冲区时回调（在写入线程上执行，应只做轻量通知）
+    void set_tail_listener(std::function<void()> listener);
+
 private:
     explicit Logger(const std::string& log_dir_path);
     void writer_thread_func();
+    // 按每天的文件数与保留天数清理旧文件
     void manage_log_files();
-    void rotate_log_file_if_needed(size_t new_entries_count);
+    // 启动时续写上次未封存的段
+    void resume_latest_segment();
+    // 需要时封存当前段并打开新段，返回写入者是否可用
+    bool rotate_log_file_if_needed(size_t new_entries_count);
+    // 把目录中旧版 JSON 行日志转换为段文件，并为没有序号的段补上序号；返回下一个可用的 seq
+    uint64_t prepare_log_files();
+    // 在 (after_seq, before_seq) 区间内按方向扫描段文件，至多追加 limit 条。
+    // 超过 deadline 时在文件边界停下，返回已扫描到的 seq 边界（OLDER 为下界，NEWER 为上界）
+    std::optional<uint64_t> search_segments(const LogFilter& filter, uint64_t after_seq, uint64_t before_seq, bool older,
+                                            size_t limit, std::vector<LogEntry>& out, LogSearchStats& stats,
+                                            std::optional<std::chrono::steady_clock::time_point> deadline) const;
+    // 写入无锁队列；队列位置号决定 seq，写入顺序与 seq 顺序一致
+    void enqueue(long long timestamp_ms, LogLevel level, const std::string& category, const std::string& message,
+                 const std::string& package_name, int user_id);
+    // 写入线程可能在等待时才唤醒它，生产者平时不碰互斥锁
+    void wake_writer();
+    // 从队列取出一批已发布的日志，经风暴合并后分配 seq 并放入尾部缓冲区
+    void drain_queue(std::deque<LogEntry>& batch);
+    // 合并器最早需要写出汇总的时间（墙钟毫秒）
+    std::optional<long long> storm_deadline_ms() const;
+    void notify_tail_listener();
     
     static std::shared_ptr<Logger> instance_;
     static std::mutex instance_mutex_;
 
     std::string log_dir_path_;
     std::string current_log_file_path_;
-    int current_log_line_count_ = 0;
+    // 只由写入线程访问（stats() 除外）
+    std::unique_ptr<LogSegmentWriter> segment_writer_;
+    std::atomic<long long> fsync_interval_ms_{0};
 
-    std::deque<LogEntry> log_queue_;
-    mutable std::mutex queue_mutex_;
+    // 分类与包名在入队时换成驻留 ID，写入线程取出时再还原
+    std::unique_ptr<LogStringTable> strings_;
+    std::unique_ptr<LogQueue> log_queue_;
+    // 合并器由写入线程使用，锁只防配置更新与统计读取
+    std::unique_ptr<LogStormAggregator> storm_;
+    std::deque<LogEntry> storm_pending_;  // 切换配置时提前结束的窗口的汇总，等写入线程取走
+    uint64_t drained_pos_ = 0;            // 已从队列取出的位置（不含），写入线程专用
+    uint64_t persistable_pos_ = 0;        // 本批写出后可标记为已落盘的位置（不含），写入线程专用
+    mutable std::mutex storm_mutex_;
+    std::mutex wake_mutex_;
     std::condition_variable cv_;
+    std::atomic<bool> writer_waiting_{false};
     std::thread writer_thread_;
     std::atomic<bool> is_running_;
+
+    std::deque<std::pair<uint64_t, LogEntry>> tail_;
+    // 下一条进入尾部缓冲区的 seq，由写入线程推进
+    uint64_t next_seq_ = 1;
+    mutable std::mutex tail_mutex_;
+    std::function<void()> tail_listener_;
 };
 
 #endif // CERBERUS_LOGGER_H
\ No newline at end of file
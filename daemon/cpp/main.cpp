@@ -11,15 +11,31 @@
 #include <android/log.h>
 #include "logger.h"
 #include "time_series_database.h"
+#include "broadcast_scheduler.h"
+#include "dashboard_stream.h"
+#include "wire_codec.h"
+#include "worker_pool.h"
+#include "probe_config_stream.h"
+#include "message_dispatch.h"
+#include "json_writer.h"
+#include "log_segment.h"
+#include "log_storm.h"
+#include "flight_recorder.h"
 #include <csignal>
 #include <thread>
 #include <chrono>
 #include <memory>
 #include <atomic>
+#include <cstdint>
 #include <filesystem>
 #include <mutex>
+#include <set>
+#include <array>
+#include <algorithm>
 #include <unistd.h>
 #include <fstream>
+#include <cstring>
+#include <string_view>
 
 #define LOG_TAG "cerberusd_main_v37_final_ipc"
 #define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
@@ -40,6 +56,38 @@ static std::atomic<bool> g_is_running = true;
 std::atomic<int> g_probe_fd = -1;
 static std::thread g_worker_thread;
 std::atomic<int> g_top_app_refresh_tickets = 0;
+static std::unique_ptr<BroadcastScheduler> g_dashboard_scheduler;
+static std::unique_ptr<BroadcastScheduler> g_log_scheduler;
+// 日志流已推送到的 seq；订阅回填与批量推送都在 g_log_stream_mutex 下进行，保证两者首尾相接
+static uint64_t g_log_stream_cursor = 0;
+static std::mutex g_log_stream_mutex;
+// 订阅时的首条快照与定时推送的补丁都在 g_dashboard_stream_mutex 下取快照、生成并入队，
+// 保证每个连接上消息的顺序与基线版本一致
+static DashboardStreamer g_dashboard_streamer;
+static std::mutex g_dashboard_stream_mutex;
+static std::unique_ptr<WorkerPool> g_query_pool;
+// 探针配置的基线与序号；增量推送与全量应答都在 g_probe_config_mutex 下进行，保证全量之后的增量序号衔接
+static ProbeConfigStream g_probe_config_stream;
+static std::mutex g_probe_config_mutex;
+
+// 仪表盘推送的默认合并窗口：窗口内的多次状态变化只序列化并发送一次，可由 cmd.set_dashboard_window 调整
+constexpr auto DASHBOARD_COALESCE_WINDOW = std::chrono::milliseconds(250);
+// 日志流：合并窗口与单批条数上限（回填条数见 message_dispatch.h）
+constexpr auto LOG_STREAM_WINDOW = std::chrono::milliseconds(200);
+constexpr size_t LOG_STREAM_MAX_BATCH = 200;
+// 重查询线程池：线程数与排队上限
+constexpr size_t QUERY_POOL_THREADS = 2;
+constexpr size_t QUERY_POOL_MAX_QUEUE = 32;
+// 跨文件日志检索的默认与最大页大小
+constexpr size_t LOG_SEARCH_DEFAULT_LIMIT = 200;
+constexpr size_t LOG_SEARCH_MAX_LIMIT = 1000;
+// 单次日志检索扫描段文件的时间预算，超出后返回部分结果与续查游标
+constexpr long long LOG_SEARCH_BUDGET_MS = 150;
+constexpr long long LOG_SEARCH_MAX_BUDGET_MS = 2000;
+// 日志段至多每隔这么久 fdatasync 一次，限定掉电时丢失的日志范围
+constexpr long long LOG_FSYNC_INTERVAL_MS = 10000;
+
+void handle_client_message(int client_fd, std::string_view message_str);
 
 void handle_rekernel_signal(const ReKernelSignalEvent& event) {
     if (g_state_manager) {
@@ -53,158 +101,496 @@ void handle_rekernel_binder(const ReKernelBinderEvent& event) {
 }
 
 
-void handle_client_message(int client_fd, const std::string& message_str) {
-    try {
-        json msg = json::parse(message_str);
-        std::string type = msg.value("type", "");
-
-        if (type == "hello.ui") {
-            g_server->identify_client_as_ui(client_fd);
-            if (g_state_manager) {
-                json payload = g_state_manager->get_dashboard_payload();
-                g_server->send_message(client_fd, json{{"type", "stream.dashboard_update"}, {"payload", payload}}.dump());
-            }
-            return;
-        }
+// 仪表盘推送 {"payload": ..., "type": "stream.dashboard_update"}，直接流式写出。
+// 按上一次的长度预留缓冲区，整段文本之后直接成为发送帧
+static std::string dashboard_update_text(const StateSnapshot* snapshot) {
+    static std::atomic<size_t> size_hint{4096};
+    JsonWriter writer(size_hint.load(std::memory_order_relaxed));
+    writer.begin_object().key("payload");
+    write_dashboard_payload(writer, snapshot);
+    writer.field("type", "stream.dashboard_update").end_object();
+    size_hint.store(writer.size() + writer.size() / 8, std::memory_order_relaxed);
+    return writer.take();
+}
 
-        if (type == "event.probe_hello") {
-            g_probe_fd = client_fd;
-            LOGI("Probe connected with fd %d. Immediately sending full probe config.", client_fd);
-            if (g_state_manager) {
-                json payload = g_state_manager->get_probe_config_payload();
-                g_server->send_message(client_fd, json{
-                    {"type", "resp.probe_init_data"},
-                    {"payload", payload}
-                }.dump());
-                LOGI("Sent full config to Probe.");
-            }
-            return;
-        }
-        
-        if (type == "query.get_logs") {
-            const auto& payload_json = msg.value("payload", json::object());
-            std::string filename = payload_json.value("filename", "");
-            long long before_ts = payload_json.value("before", 0LL);
-            long long since_ts = payload_json.value("since", 0LL);
-            int limit = payload_json.value("limit", 50);
-
-            std::vector<LogEntry> logs;
-            if (!filename.empty()) {
-                logs = g_logger->get_logs_from_file(filename, limit,
-                    before_ts > 0 ? std::optional(before_ts) : std::nullopt,
-                    since_ts > 0 ? std::optional(since_ts) : std::nullopt);
-            }
+static json make_log_stream_message(const LogTailBatch& batch, bool backfill) {
+    json entries = json::array();
+    for (const auto& [seq, entry] : batch.entries) {
+        json j = entry.to_json();
+        j["seq"] = seq;
+        entries.push_back(std::move(j));
+    }
+    return json{{"type", "stream.logs"}, {"payload", {
+        {"backfill", backfill},
+        {"cursor", batch.cursor},
+        {"truncated", batch.truncated},
+        {"entries", std::move(entries)}
+    }}};
+}
 
-            json log_array = json::array();
-            for(const auto& log : logs) { log_array.push_back(log.to_json()); }
+// 调用方须持有 g_log_stream_mutex。回填区间为 (客户端游标, 当前推送位置]，
+// 之后的日志由 flush_log_stream 接续推送；未提供游标时回填最近 log_backfill 条
+static void send_log_backfill(int client_fd, const json& payload) {
+    uint64_t up_to = g_log_stream_cursor;
+    LogBackfillRange range = parse_log_backfill_range(payload, up_to);
+    LogTailBatch batch = g_logger->read_log_tail(range.after_seq, up_to, LOG_BACKFILL_MAX);
+    batch.truncated = payload.contains("log_cursor") && (batch.truncated || range.truncated);
+    batch.cursor = up_to;
+    g_server->send_json(client_fd, make_log_stream_message(batch, true));
+}
 
-            g_server->send_message(client_fd, json{
-                {"type", "resp.get_logs"},
-                {"req_id", msg.value("req_id", "")},
-                {"payload", log_array}
-            }.dump());
-            return;
+// 握手或探针报告序号缺口时下发全量配置。先把基线推进到最新快照并向其他探针推送增量，
+// 再以同一快照构建全量，两者序号一致
+static void send_probe_full_config(int client_fd) {
+    std::lock_guard<std::mutex> lock(g_probe_config_mutex);
+    auto snapshot = g_state_manager->get_snapshot();
+    json message;
+    if (snapshot) {
+        json delta = g_probe_config_stream.advance(*snapshot);
+        if (!delta.is_null()) {
+            g_server->publish(TOPIC_PROBE_CONFIG, [&delta] { return delta; }, {client_fd});
         }
+        message = g_probe_config_stream.full_message(*snapshot);
+    } else {
+        message = json{{"type", "resp.probe_init_data"}, {"payload", build_probe_config_payload(nullptr)}};
+    }
 
-        if (type == "query.get_log_files") {
-            auto files = g_logger->get_log_files();
-            g_server->send_message(client_fd, json{
-                {"type", "resp.get_log_files"},
-                {"req_id", msg.value("req_id", "")},
-                {"payload", files}
-            }.dump());
+    // 冻结位图的只读描述符随全量应答一起下发，探针之后直接查共享内存
+    const FrozenUidBitmap* bitmap = g_state_manager->frozen_uid_bitmap();
+    if (bitmap) {
+        message["payload"]["frozen_uid_bitmap"] = bitmap->describe();
+        if (g_server->send_json_with_fd(client_fd, message, bitmap->reader_fd()) > 0) {
+            LOGI("Sent full config (seq %llu) and frozen UID bitmap to Probe.", (unsigned long long)g_probe_config_stream.sequence());
             return;
         }
+        message["payload"].erase("frozen_uid_bitmap");
+    }
+    g_server->send_json(client_fd, message);
+    LOGI("Sent full config (seq %llu) to Probe.", (unsigned long long)g_probe_config_stream.sequence());
+}
 
-        if (type == "query.get_history_stats") {
-            auto records = g_ts_db->get_all_records();
-            json record_array = json::array();
-            for(const auto& record : records) { record_array.push_back(record.to_json()); }
-            g_server->send_message(client_fd, json{ {"type", "resp.history_stats"}, {"req_id", msg.value("req_id", "")}, {"payload", record_array} }.dump());
-            return;
-        }
 
-        if (type == "query.get_adj_rules_content") {
-            std::string content = SystemMonitor::read_file_once("/data/adb/cerberus/adj_rules.json", 16 * 1024);
-            g_server->send_message(client_fd, json{
-                {"type", "resp.adj_rules_content"},
-                {"req_id", msg.value("req_id", "")},
-                {"payload", {{"content", content}}}
-            }.dump());
-            return;
-        }
+// 载荷中可选的 levels（LogLevel 整数数组）转为级别掩码，未给出时不筛选
+static uint32_t level_mask_from_json(const json& payload_json) {
+    auto levels = payload_json.find("levels");
+    if (levels == payload_json.end() || !levels->is_array()) return 0xFFFFFFFFu;
+    uint32_t mask = 0;
+    for (const auto& level : *levels) {
+        if (level.is_number_integer() && level.get<int>() >= 0 && level.get<int>() < 32) mask |= 1u << level.get<int>();
+    }
+    return mask;
+}
 
-        if (type == "query.get_data_app_packages") {
-            auto packages = g_sys_monitor->get_data_app_packages();
-            g_server->send_message(client_fd, json{
-                {"type", "resp.data_app_packages"},
-                {"req_id", msg.value("req_id", "")},
-                {"payload", packages}
-            }.dump());
-            return;
+// query.search_logs 的载荷：direction（"older" / "newer"）、cursor、limit、since、until、levels、categories、package_name、text、budget_ms
+static LogSearchRequest parse_log_search_request(const json& payload_json) {
+    LogSearchRequest request;
+    request.direction = payload_json.value("direction", "older") == "newer" ? LogDirection::NEWER : LogDirection::OLDER;
+    auto cursor = payload_json.find("cursor");
+    if (cursor != payload_json.end() && cursor->is_number_unsigned()) request.cursor = cursor->get<uint64_t>();
+    int limit = payload_json.value("limit", static_cast<int>(LOG_SEARCH_DEFAULT_LIMIT));
+    request.limit = static_cast<size_t>(std::clamp(limit, 1, static_cast<int>(LOG_SEARCH_MAX_LIMIT)));
+    long long since_ts = payload_json.value("since", 0LL);
+    long long until_ts = payload_json.value("until", 0LL);
+    if (since_ts > 0) request.filter.since_ts = since_ts;
+    if (until_ts > 0) request.filter.until_ts = until_ts;
+    request.filter.level_mask = level_mask_from_json(payload_json);
+    auto categories = payload_json.find("categories");
+    if (categories != payload_json.end() && categories->is_array()) {
+        for (const auto& category : *categories) {
+            if (category.is_string()) request.filter.categories.push_back(category.get<std::string>());
         }
+    }
+    request.filter.package_name = payload_json.value("package_name", "");
+    request.filter.text = payload_json.value("text", "");
+    request.budget_ms = std::clamp(payload_json.value("budget_ms", LOG_SEARCH_BUDGET_MS), 1LL, LOG_SEARCH_MAX_BUDGET_MS);
+    return request;
+}
 
-        if (type == "cmd.set_adj_rules_content") {
-            const auto& payload = msg.value("payload", json::object());
-            std::string content = payload.value("content", "");
-            if (!content.empty()) {
-                std::string path = "/data/adb/cerberus/adj_rules.json";
-                std::ofstream ofs(path);
-                if (ofs.is_open()) {
-                    ofs << content;
-                    LOGI("OOM rules content updated from UI.");
-                    if (g_state_manager) g_state_manager->reload_adj_rules();
-                } else {
-                    LOGE("Failed to open '%s' to write new adj rules.", path.c_str());
-                }
-            }
-            return;
+static void write_optional_cursor(JsonWriter& writer, std::string_view name, const std::optional<uint64_t>& cursor) {
+    writer.key(name);
+    if (cursor) writer.value(static_cast<unsigned long long>(*cursor));
+    else writer.null_value();
+}
+
+// 日志页与历史统计这类大列表应答直接流式写出完整消息（含 req_id），不经 DOM。
+// 返回 false 表示该查询不走流式路径，由 build_query_response 处理
+static bool write_streamed_query_response(const std::string& type, const json& payload_json, const std::string& req_id, JsonWriter& writer) {
+    if (type == "query.get_logs") {
+        std::string filename = payload_json.value("filename", "");
+        long long before_ts = payload_json.value("before", 0LL);
+        long long since_ts = payload_json.value("since", 0LL);
+        LogQuery query;
+        query.limit = payload_json.value("limit", 50);
+        if (before_ts > 0) query.before_ts = before_ts;
+        if (since_ts > 0) query.since_ts = since_ts;
+        // 可选筛选：levels 为 LogLevel 整数数组，package_name 为包名
+        query.level_mask = level_mask_from_json(payload_json);
+        query.package_name = payload_json.value("package_name", "");
+
+        std::vector<LogEntry> logs;
+        if (!filename.empty()) {
+            logs = g_logger->get_logs_from_file(filename, query);
         }
 
-        if (!g_state_manager) return;
+        writer.begin_object().key("payload").begin_array();
+        for (const auto& log : logs) log.write_json(writer);
+        writer.end_array().field("req_id", req_id).field("type", "resp.get_logs").end_object();
+        return true;
+    }
+    if (type == "query.search_logs") {
+        LogSearchPage page = g_logger->search_logs(parse_log_search_request(payload_json));
+        writer.begin_object().key("payload").begin_object().key("entries").begin_array();
+        for (const auto& log : page.entries) log.write_json(writer);
+        writer.end_array().field("has_more", page.has_more);
+        write_optional_cursor(writer, "newer_cursor", page.newer_cursor);
+        write_optional_cursor(writer, "older_cursor", page.older_cursor);
+        writer.key("stats").begin_object()
+              .field("blocks_skipped", page.stats.blocks_skipped)
+              .field("blocks_total", page.stats.blocks_total)
+              .field("blocks_trigram_skipped", page.stats.blocks_trigram_skipped)
+              .field("budget_exhausted", page.stats.budget_exhausted)
+              .field("elapsed_us", page.stats.elapsed_us)
+              .field("files_opened", page.stats.files_opened)
+              .field("records_decoded", page.stats.records_decoded)
+              .field("records_examined", page.stats.records_examined)
+              .field("ring_entries_scanned", page.stats.ring_entries_scanned)
+              .end_object();
+        writer.end_object().field("req_id", req_id).field("type", "resp.search_logs").end_object();
+        return true;
+    }
+    if (type == "query.get_history_stats") {
+        // since / limit 可选，只序列化范围内最新的样本
+        long long since_ts = payload_json.value("since", 0LL);
+        long long limit = payload_json.value("limit", 0LL);
+        writer.begin_object().key("payload");
+        g_ts_db->write_records(writer, since_ts, limit > 0 ? static_cast<size_t>(limit) : SIZE_MAX);
+        writer.field("req_id", req_id).field("type", "resp.history_stats").end_object();
+        return true;
+    }
+    if (type == "query.get_metrics_history") {
+        // 默认最近 30 分钟；resolution 可指定 raw / 1m / 15m，其余按跨度自动选择
+        long long now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        long long since_ts = payload_json.value("since", now_ms - MetricsRollup::RAW_SPAN_MS);
+        std::string resolution_text = payload_json.value("resolution", "auto");
+        RollupResolution resolution = RollupResolution::AUTO;
+        if (resolution_text == "raw") resolution = RollupResolution::RAW;
+        else if (resolution_text == "1m") resolution = RollupResolution::MINUTE;
+        else if (resolution_text == "15m") resolution = RollupResolution::QUARTER_HOUR;
+        writer.begin_object().key("payload");
+        g_ts_db->write_history(writer, since_ts, resolution, now_ms);
+        writer.field("req_id", req_id).field("type", "resp.metrics_history").end_object();
+        return true;
+    }
+    return false;
+}
 
-        if (type == "event.app_wakeup_request_v2") {
-            g_state_manager->on_wakeup_request_from_probe(msg.at("payload"));
-        } else if (type == "cmd.proactive_unfreeze") {
-            g_state_manager->on_proactive_unfreeze_request(msg.at("payload"));
-        } else if (type == "event.app_foreground") {
-            g_state_manager->on_app_foreground_event(msg.at("payload"));
-        } else if (type == "event.app_background") {
-            g_state_manager->on_app_background_event(msg.at("payload"));
-        }
-        else if (type == "cmd.request_temp_unfreeze_pkg") {
-            g_state_manager->on_temp_unfreeze_request_by_pkg(msg.at("payload"));
-        } else if (type == "cmd.request_temp_unfreeze_uid") {
-            g_state_manager->on_temp_unfreeze_request_by_uid(msg.at("payload"));
-        } else if (type == "cmd.request_temp_unfreeze_pid") {
-            g_state_manager->on_temp_unfreeze_request_by_pid(msg.at("payload"));
-        }
-        else if (type == "event.app_wakeup_request") {
-            g_state_manager->on_wakeup_request(msg.at("payload"));
-        } else if (type == "cmd.set_policy") {
-            if (g_state_manager->on_config_changed_from_ui(msg.at("payload"))) {
-                notify_probe_of_config_change();
+// 在工作线程上执行，返回完整的应答消息（不含 req_id，由调用方补上）
+static json build_query_response(const std::string& type) {
+    if (type == "query.get_log_files") {
+        return json{{"type", "resp.get_log_files"}, {"payload", g_logger->get_log_files()}};
+    }
+    if (type == "query.get_adj_rules_content") {
+        std::string content = SystemMonitor::read_file_once("/data/adb/cerberus/adj_rules.json", 16 * 1024);
+        return json{{"type", "resp.adj_rules_content"}, {"payload", {{"content", content}}}};
+    }
+    if (type == "query.get_data_app_packages") {
+        return json{{"type", "resp.data_app_packages"}, {"payload", g_sys_monitor->get_data_app_packages()}};
+    }
+    if (type == "query.get_all_policies") {
+        return json{{"type", "resp.all_policies"}, {"payload", g_state_manager ? g_state_manager->get_full_config_for_ui() : json::object()}};
+    }
+    return json{{"type", "resp.error"}, {"payload", {{"request_type", type}, {"reason", "unknown_query"}}}};
+}
+
+// 需要读文件、扫描目录或大量序列化的查询，交给工作线程池执行，避免阻塞事件循环上的其他客户端与探针。
+// 应答通过 req_id 与请求对应，客户端可以连续发出多个请求并乱序接收应答
+static void handle_heavy_query(int client_fd, const MessageEnvelope& envelope) {
+    uint64_t conn_id = g_server->connection_id(client_fd);
+    std::string type(envelope.type());
+    std::string req_id = envelope.req_id();
+    json payload = envelope.payload_json();
+    bool accepted = g_query_pool && g_query_pool->submit([client_fd, conn_id, type, req_id, payload] {
+        json response;
+        try {
+            JsonWriter writer;
+            if (write_streamed_query_response(type, payload, req_id, writer)) {
+                g_server->send_json_text(client_fd, conn_id, writer.take());
+                return;
             }
-            g_top_app_refresh_tickets = 1;
-        }
-        else if (type == "cmd.set_master_config") {
-            MasterConfig cfg;
-            const auto& payload = msg.at("payload");
-            cfg.standard_timeout_sec = payload.value("standard_timeout_sec", 90);
-            cfg.is_timed_unfreeze_enabled = payload.value("is_timed_unfreeze_enabled", true);
-            cfg.timed_unfreeze_interval_sec = payload.value("timed_unfreeze_interval_sec", 1800);
-            g_state_manager->update_master_config(cfg);
+            response = build_query_response(type);
+        } catch (const std::exception& e) {
+            LOGE("Query %s failed: %s", type.c_str(), e.what());
+            response = json{{"type", "resp.error"}, {"payload", {{"request_type", type}, {"reason", "internal_error"}}}};
         }
-        else if (type == "query.refresh_dashboard") {
-            broadcast_dashboard_update();
-        } else if (type == "query.get_all_policies") {
-            json payload = g_state_manager->get_full_config_for_ui();
-            g_server->send_message(client_fd, json{{"type", "resp.all_policies"}, {"req_id", msg.value("req_id", "")}, {"payload", payload}}.dump());
-        } 
-        else if (type == "cmd.reload_adj_rules") { 
-            if (g_state_manager) g_state_manager->reload_adj_rules();
+        response["req_id"] = req_id;
+        g_server->send_json(client_fd, conn_id, response);
+    });
+    if (!accepted) {
+        g_server->send_json(client_fd, json{
+            {"type", "resp.error"},
+            {"req_id", req_id},
+            {"payload", {{"request_type", type}, {"reason", "busy"}}}
+        });
+    }
+}
+
+// 把载荷解码为 Request 后交给 Fn；缺少载荷或格式不符时记录并丢弃
+template <typename Request, void (*Fn)(const Request&)>
+static void typed_handler(int, const MessageEnvelope& envelope) {
+    Request request;
+    if (!decode_payload(envelope.payload_text(), request)) {
+        LOGE("Malformed or missing payload for %.*s", (int)envelope.type().size(), envelope.type().data());
+        return;
+    }
+    Fn(request);
+}
+
+static void handle_hello_ui(int client_fd, const MessageEnvelope&) {
+    g_server->identify_client_as_ui(client_fd);
+    if (g_state_manager) {
+        auto snapshot = g_state_manager->get_snapshot();
+        g_server->send_json_text(client_fd, dashboard_update_text(snapshot.get()));
+    }
+}
+
+static void handle_hello_encoding(int client_fd, const MessageEnvelope& envelope) {
+    // 客户端按偏好顺序给出可接受的编码，例如 {"accept": ["msgpack", "cbor"]}。
+    // 应答 resp.encoding 仍以 JSON 行发送；客户端收到应答前不得发送二进制帧。
+    WireEncoding encoding = wire_codec::negotiate(envelope.payload_json().value("accept", json::array()));
+    g_server->switch_client_encoding(client_fd, encoding, json{
+        {"type", "resp.encoding"},
+        {"req_id", envelope.req_id()},
+        {"payload", {{"encoding", wire_codec::encoding_name(encoding)}, {"max_frame_bytes", MAX_WIRE_FRAME_BYTES}}}
+    });
+}
+
+static void handle_subscription(int client_fd, const MessageEnvelope& envelope) {
+    json payload = envelope.payload_json();
+    bool subscribe = envelope.type() == "cmd.subscribe";
+    uint32_t topics = parse_push_topics(payload.value("topics", json::array()));
+    bool wants_logs = subscribe && (topics & TOPIC_LOGS) && g_logger;
+    std::unique_lock<std::mutex> log_lock(g_log_stream_mutex, std::defer_lock);
+    if (wants_logs) {
+        log_lock.lock();
+        // 此前无人订阅时推送位置停在旧处，直接跳到最新，积压部分由回填覆盖
+        if (!g_server->has_subscribers(TOPIC_LOGS)) g_log_stream_cursor = g_logger->latest_log_seq();
+    }
+    if (subscribe) {
+        g_server->subscribe(client_fd, topics);
+    } else {
+        g_server->unsubscribe(client_fd, topics);
+    }
+    g_server->send_json(client_fd, json{
+        {"type", "resp.subscriptions"},
+        {"req_id", envelope.req_id()},
+        {"payload", {{"topics", push_topic_names(g_server->subscriptions(client_fd))}}}
+    });
+    if (wants_logs) send_log_backfill(client_fd, payload);
+}
+
+static void handle_probe_hello(int client_fd, const MessageEnvelope& envelope) {
+    // 探针有两条连接，握手时声明角色：events 为只上行的常驻事件连接，不接收任何推送；
+    // 未声明角色的按配置连接处理
+    if (envelope.has_payload() && envelope.payload_json().value("role", "") == "events") {
+        g_server->set_subscriptions(client_fd, 0);
+        LOGI("Probe event channel connected with fd %d.", client_fd);
+        return;
+    }
+    g_probe_fd = client_fd;
+    // 探针只关心配置推送，不接收仪表盘、统计等面向 UI 的主题
+    g_server->set_subscriptions(client_fd, TOPIC_PROBE_CONFIG);
+    LOGI("Probe connected with fd %d. Immediately sending full probe config.", client_fd);
+    if (g_state_manager) send_probe_full_config(client_fd);
+}
+
+static void handle_probe_resync(int client_fd, const MessageEnvelope& envelope) {
+    json payload = envelope.payload_json();
+    LOGW("Probe fd %d reported config sequence gap (has %llu, got %llu), resending full config.", client_fd,
+         (unsigned long long)payload.value("have_seq", 0ULL), (unsigned long long)payload.value("received_seq", 0ULL));
+    if (g_state_manager) send_probe_full_config(client_fd);
+}
+
+static void on_set_adj_rules_content(const AdjRulesContentRequest& request) {
+    if (request.content.empty()) return;
+    std::string path = "/data/adb/cerberus/adj_rules.json";
+    std::ofstream ofs(path);
+    if (ofs.is_open()) {
+        ofs << request.content;
+        LOGI("OOM rules content updated from UI.");
+        if (g_state_manager) g_state_manager->reload_adj_rules();
+    } else {
+        LOGE("Failed to open '%s' to write new adj rules.", path.c_str());
+    }
+}
+
+static void handle_probe_batch(int, const MessageEnvelope& envelope) {
+    std::vector<ProbeEvent> events;
+    parse_probe_event_batch(envelope.payload_json(), events);
+    if (!events.empty()) g_state_manager->on_probe_event_batch(events);
+}
+
+static void on_probe_wakeup(const ProbeWakeupRequest& request) {
+    g_state_manager->on_wakeup_request_from_probe(request.uid, request.type_int);
+}
+static void on_proactive_unfreeze(const AppTargetRequest& request) {
+    g_state_manager->on_proactive_unfreeze_request(request.package_name, request.user_id);
+}
+static void on_app_foreground(const AppTargetRequest& request) {
+    g_state_manager->on_app_foreground_event(request.package_name, request.user_id);
+}
+static void on_app_background(const AppTargetRequest& request) {
+    g_state_manager->on_app_background_event(request.package_name, request.user_id);
+}
+static void on_temp_unfreeze_pkg(const AppTargetRequest& request) {
+    g_state_manager->on_temp_unfreeze_request_by_pkg(request.package_name);
+}
+static void on_temp_unfreeze_uid(const UidRequest& request) {
+    g_state_manager->on_temp_unfreeze_request_by_uid(request.uid);
+}
+static void on_temp_unfreeze_pid(const PidRequest& request) {
+    g_state_manager->on_temp_unfreeze_request_by_pid(request.pid);
+}
+static void on_legacy_wakeup(const AppTargetRequest& request) {
+    g_state_manager->on_wakeup_request(request.package_name, request.user_id);
+}
+
+static void handle_set_policy(int, const MessageEnvelope& envelope) {
+    if (!envelope.has_payload()) {
+        LOGE("cmd.set_policy without payload ignored.");
+        return;
+    }
+    if (g_state_manager->on_config_changed_from_ui(envelope.payload_json())) {
+        notify_probe_of_config_change();
+    }
+    g_top_app_refresh_tickets = 1;
+}
+
+static void on_set_master_config(const MasterConfigRequest& request) {
+    MasterConfig cfg;
+    cfg.standard_timeout_sec = request.standard_timeout_sec;
+    cfg.is_timed_unfreeze_enabled = request.is_timed_unfreeze_enabled;
+    cfg.timed_unfreeze_interval_sec = request.timed_unfreeze_interval_sec;
+    g_state_manager->update_master_config(cfg);
+}
+
+static void handle_refresh_dashboard(int, const MessageEnvelope&) {
+    broadcast_dashboard_update();
+}
+
+static void handle_dashboard_subscribe(int client_fd, const MessageEnvelope& envelope) {
+    std::lock_guard<std::mutex> lock(g_dashboard_stream_mutex);
+    g_dashboard_streamer.subscribe(client_fd, envelope.payload_json());
+    if (auto snapshot = g_state_manager->get_snapshot()) {
+        json first = g_dashboard_streamer.next_message(client_fd, *snapshot);
+        if (!first.is_null()) g_server->send_json(client_fd, first);
+    }
+}
+
+static void handle_dashboard_unsubscribe(int client_fd, const MessageEnvelope&) {
+    g_dashboard_streamer.unsubscribe(client_fd);
+}
+
+static void handle_reload_adj_rules(int, const MessageEnvelope&) {
+    g_state_manager->reload_adj_rules();
+}
+
+// 载荷：enabled、window_ms、passthrough、max_keys、exempt_levels（级别数组），只含要修改的项，
+// 未给出的项沿用当前生效的配置；任一项不合法时整条拒绝并回复 resp.error
+static void handle_set_log_storm_config(int client_fd, const MessageEnvelope& envelope) {
+    if (!envelope.has_payload()) {
+        LOGE("cmd.set_log_storm_config without payload ignored.");
+        return;
+    }
+    LogStormConfig config = g_logger->storm_config();
+    std::string bad_field;
+    if (!parse_log_storm_config(envelope.payload_json(), config, bad_field)) {
+        LOGE("cmd.set_log_storm_config rejected: invalid '%s'.", bad_field.c_str());
+        g_server->send_json(client_fd, json{
+            {"type", "resp.error"},
+            {"req_id", envelope.req_id()},
+            {"payload", {{"request_type", "cmd.set_log_storm_config"}, {"reason", "invalid_payload"}, {"field", bad_field}}}
+        });
+        return;
+    }
+    g_logger->set_storm_config(config);
+    LOGI("Log storm config: enabled=%d window=%lldms passthrough=%u max_keys=%zu",
+         config.enabled, config.window_ms, config.passthrough, config.max_keys);
+}
+
+// 载荷：window_ms，仪表盘推送的合并窗口；越界或类型不符时拒绝并回复 resp.error
+static void handle_set_dashboard_window(int client_fd, const MessageEnvelope& envelope) {
+    if (!envelope.has_payload()) {
+        LOGE("cmd.set_dashboard_window without payload ignored.");
+        return;
+    }
+    long long window_ms = 0;
+    std::string bad_field;
+    if (!parse_dashboard_window(envelope.payload_json(), window_ms, bad_field)) {
+        LOGE("cmd.set_dashboard_window rejected: invalid '%s'.", bad_field.c_str());
+        g_server->send_json(client_fd, json{
+            {"type", "resp.error"},
+            {"req_id", envelope.req_id()},
+            {"payload", {{"request_type", "cmd.set_dashboard_window"}, {"reason", "invalid_payload"}, {"field", bad_field}}}
+        });
+        return;
+    }
+    g_dashboard_scheduler->set_window(std::chrono::milliseconds(window_ms));
+    LOGI("Dashboard coalesce window: %lldms", window_ms);
+}
+
+// 消息类型到处理函数的静态表，编译期生成完美哈希。
+// 顺序沿用原先 if/else 链的比较顺序
+static constexpr std::array MESSAGE_ROUTE_LIST{
+    MessageRoute{"hello.ui", handle_hello_ui, false},
+    MessageRoute{"hello.encoding", handle_hello_encoding, false},
+    MessageRoute{"cmd.subscribe", handle_subscription, false},
+    MessageRoute{"cmd.unsubscribe", handle_subscription, false},
+    MessageRoute{"query.get_logs", handle_heavy_query, false},
+    MessageRoute{"query.get_log_files", handle_heavy_query, false},
+    MessageRoute{"query.search_logs", handle_heavy_query, false},
+    MessageRoute{"query.get_history_stats", handle_heavy_query, false},
+    MessageRoute{"query.get_metrics_history", handle_heavy_query, false},
+    MessageRoute{"query.get_adj_rules_content", handle_heavy_query, false},
+    MessageRoute{"query.get_data_app_packages", handle_heavy_query, false},
+    MessageRoute{"query.get_all_policies", handle_heavy_query, false},
+    MessageRoute{"event.probe_hello", handle_probe_hello, false},
+    MessageRoute{"cmd.probe_resync", handle_probe_resync, false},
+    MessageRoute{"cmd.set_adj_rules_content", typed_handler<AdjRulesContentRequest, on_set_adj_rules_content>, false},
+    MessageRoute{"event.probe_batch", handle_probe_batch, true},
+    MessageRoute{"event.app_wakeup_request_v2", typed_handler<ProbeWakeupRequest, on_probe_wakeup>, true},
+    MessageRoute{"cmd.proactive_unfreeze", typed_handler<AppTargetRequest, on_proactive_unfreeze>, true},
+    MessageRoute{"event.app_foreground", typed_handler<AppTargetRequest, on_app_foreground>, true},
+    MessageRoute{"event.app_background", typed_handler<AppTargetRequest, on_app_background>, true},
+    MessageRoute{"cmd.request_temp_unfreeze_pkg", typed_handler<AppTargetRequest, on_temp_unfreeze_pkg>, true},
+    MessageRoute{"cmd.request_temp_unfreeze_uid", typed_handler<UidRequest, on_temp_unfreeze_uid>, true},
+    MessageRoute{"cmd.request_temp_unfreeze_pid", typed_handler<PidRequest, on_temp_unfreeze_pid>, true},
+    MessageRoute{"event.app_wakeup_request", typed_handler<AppTargetRequest, on_legacy_wakeup>, true},
+    MessageRoute{"cmd.set_policy", handle_set_policy, true},
+    MessageRoute{"cmd.set_master_config", typed_handler<MasterConfigRequest, on_set_master_config>, true},
+    MessageRoute{"query.refresh_dashboard", handle_refresh_dashboard, true},
+    MessageRoute{"cmd.dashboard_subscribe", handle_dashboard_subscribe, true},
+    MessageRoute{"cmd.dashboard_unsubscribe", handle_dashboard_unsubscribe, true},
+    MessageRoute{"cmd.reload_adj_rules", handle_reload_adj_rules, true},
+    MessageRoute{"cmd.set_log_storm_config", handle_set_log_storm_config, false},
+    MessageRoute{"cmd.set_dashboard_window", handle_set_dashboard_window, false},
+};
+static constexpr StaticRouteTable<MessageRoute, MESSAGE_ROUTE_LIST.size()> MESSAGE_ROUTES(MESSAGE_ROUTE_LIST);
+static_assert(MESSAGE_ROUTES.is_perfect(), "duplicate message type or no collision-free seed for the route table");
+
+void handle_client_message(int client_fd, std::string_view message_str) {
+    try {
+        MessageEnvelope envelope;
+        envelope.parse(message_str);
+        const MessageRoute* route = MESSAGE_ROUTES.find(envelope.type());
+        if (!route) {
+            LOGD("Ignoring message with unknown type '%.*s'.", (int)envelope.type().size(), envelope.type().data());
+            return;
         }
-    } catch (const json::exception& e) { LOGE("JSON Error: %s in msg: %s", e.what(), message_str.c_str()); }
+        if (route->requires_state && !g_state_manager) return;
+        FlightRecorder::instance().record(FlightRecordKind::IPC_COMMAND, client_fd, static_cast<int>(message_str.size()), 0, envelope.type());
+        route->handler(client_fd, envelope);
+    } catch (const json::exception& e) { LOGE("JSON Error: %s in msg: %.*s", e.what(), (int)message_str.size(), message_str.data()); }
 }
 
 void handle_client_disconnect(int client_fd) {
@@ -212,25 +598,71 @@ void handle_client_disconnect(int client_fd) {
     if (client_fd == g_probe_fd.load()) {
         g_probe_fd = -1;
     }
+    g_dashboard_streamer.unsubscribe(client_fd);
+}
+static size_t flush_dashboard_update() {
+    if (!g_server || !g_state_manager) return 0;
+    LOGD("Broadcasting dashboard update...");
+    std::lock_guard<std::mutex> lock(g_dashboard_stream_mutex);
+    // 旧协议客户端：完整载荷；已订阅增量协议的客户端不重复接收
+    auto delta_clients = g_dashboard_streamer.subscribed_clients();
+    std::set<int> excluded(delta_clients.begin(), delta_clients.end());
+    size_t bytes_sent = g_server->publish_text(TOPIC_DASHBOARD, [] {
+        auto snapshot = g_state_manager->get_snapshot();
+        return dashboard_update_text(snapshot.get());
+    }, excluded);
+    // 增量协议客户端：按各自的排序/截断基线生成补丁
+    auto snapshot = g_state_manager->get_snapshot();
+    if (snapshot) {
+        for (int fd : delta_clients) {
+            if (!(g_server->subscriptions(fd) & TOPIC_DASHBOARD)) continue;
+            json message = g_dashboard_streamer.next_message(fd, *snapshot);
+            if (message.is_null()) continue;
+            bytes_sent += g_server->send_json(fd, message);
+        }
+    }
+    return bytes_sent;
+}
+static size_t flush_log_stream() {
+    if (!g_server || !g_logger) return 0;
+    std::lock_guard<std::mutex> lock(g_log_stream_mutex);
+    LogTailBatch batch = g_logger->read_log_tail(g_log_stream_cursor, UINT64_MAX, LOG_STREAM_MAX_BATCH);
+    if (batch.entries.empty()) return 0;
+    g_log_stream_cursor = batch.cursor;
+    size_t bytes = g_server->publish(TOPIC_LOGS, [&batch] { return make_log_stream_message(batch, false); });
+    // 单批有上限，剩余部分留到下一个窗口，日志风暴时不会产生超大推送
+    if (batch.has_more) g_log_scheduler->mark_dirty();
+    return bytes;
 }
 void broadcast_dashboard_update() {
-    if (g_server && g_server->has_clients() && g_state_manager) {
-        LOGD("Broadcasting dashboard update...");
-        json payload = g_state_manager->get_dashboard_payload();
-        g_server->broadcast_message_except(json{{"type", "stream.dashboard_update"}, {"payload", payload}}.dump(), g_probe_fd.load());
+    if (g_dashboard_scheduler) {
+        g_dashboard_scheduler->mark_dirty();
     }
 }
+// 只推送相对上次的差异；没有探针在线时不推进基线，下次握手的全量会覆盖这段变化
 void notify_probe_of_config_change() {
-    int probe_fd = g_probe_fd.load();
-    if (g_server && probe_fd != -1 && g_state_manager) {
-        json payload = g_state_manager->get_probe_config_payload();
-        g_server->send_message(probe_fd, json{
-            {"type", "resp.probe_init_data"},
-            {"payload", payload}
-        }.dump());
-        LOGI("Hot-reloaded full config to Probe.");
+    if (!g_server || !g_state_manager) return;
+    if (!g_server->has_subscribers(TOPIC_PROBE_CONFIG)) return;
+    std::lock_guard<std::mutex> lock(g_probe_config_mutex);
+    auto snapshot = g_state_manager->get_snapshot();
+    if (!snapshot) return;
+    json delta = g_probe_config_stream.advance(*snapshot);
+    if (delta.is_null()) return;
+    size_t bytes = g_server->publish(TOPIC_PROBE_CONFIG, [&delta] { return delta; });
+    if (bytes > 0) {
+        LOGI("Sent probe config delta #%llu (%zu bytes).", (unsigned long long)g_probe_config_stream.sequence(), bytes);
     }
 }
+void broadcast_doze_event(bool entered_deep_doze) {
+    if (!g_server) return;
+    g_server->publish(TOPIC_DOZE, [entered_deep_doze] {
+        return json{{"type", "stream.doze_event"}, {"payload", {
+            {"event", entered_deep_doze ? "entered_deep_doze" : "exited_deep_doze"},
+            {"timestamp_ms", std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count()}
+        }}};
+    });
+}
 void signal_handler(int signum) {
     LOGW("Signal %d received, shutting down...", signum);
     g_is_running = false;
@@ -307,6 +739,8 @@ void worker_thread_func() {
             heartbeat_countdown = 7;
         }
 
+        // 每个 tick 结束时发布一次只读快照，刷新倒计时与资源占用
+        g_state_manager->publish_snapshot();
         if (state_changed) {
             broadcast_dashboard_update();
         }
@@ -328,6 +762,8 @@ int main(int argc, char *argv[]) {
     const std::string DB_PATH = DATA_DIR + "/cerberus.db";
     const std::string LOG_DIR = DATA_DIR + "/logs";
     const std::string ADJ_RULES_PATH = DATA_DIR + "/adj_rules.json"; 
+    const std::string FLIGHT_RECORDER_PATH = DATA_DIR + "/flight_recorder.bin";
+    const std::string METRICS_DIR = DATA_DIR + "/metrics";
     
     // [核心修改] UDS 地址指向 /dev/socket/
     const std::string DAEMON_UDS_PATH = "/dev/socket/cerberusd";
@@ -343,6 +779,10 @@ int main(int argc, char *argv[]) {
         return 1;
     }
 
+    // 先于其他线程打开，之后的日志、冻结解冻、锁等待与 IPC 都会写入记录器
+    FlightRecorder& flight_recorder = FlightRecorder::instance();
+    flight_recorder.open(FLIGHT_RECORDER_PATH);
+
     auto db_manager = std::make_shared<DatabaseManager>(DB_PATH);
     g_sys_monitor = std::make_shared<SystemMonitor>();
     auto adj_mapper = std::make_shared<AdjMapper>(ADJ_RULES_PATH);
@@ -350,7 +790,16 @@ int main(int argc, char *argv[]) {
     auto memory_butler = std::make_shared<MemoryButler>();
 
     g_logger = Logger::get_instance(LOG_DIR);
+    g_logger->set_fsync_interval_ms(LOG_FSYNC_INTERVAL_MS);
+    // 上一次运行被杀或崩溃时，把记录器里的决策轨迹与未及落盘的日志补进日志
+    const FlightRecovery& previous_run = flight_recorder.recovered();
+    if (previous_run.found && !previous_run.clean_shutdown) {
+        LOGW("Previous run (PID %d) did not shut down cleanly, recovered %zu flight records (%zu torn).",
+             previous_run.pid, previous_run.records.size(), previous_run.torn);
+        g_logger->log_batch(FlightRecorder::to_log_entries(previous_run));
+    }
     g_ts_db = TimeSeriesDatabase::get_instance();
+    g_ts_db->open_rollups(METRICS_DIR);
     g_state_manager = std::make_shared<StateManager>(db_manager, g_sys_monitor, action_executor, g_logger, g_ts_db, adj_mapper, memory_butler);
 
     g_rekernel_client = std::make_unique<ReKernelClient>();
@@ -369,16 +818,40 @@ int main(int argc, char *argv[]) {
     g_server = std::make_unique<UdsServer>(DAEMON_UDS_PATH, DAEMON_TCP_PORT);
     g_server->set_message_handler(handle_client_message);
     g_server->set_disconnect_handler(handle_client_disconnect);
+
+    g_dashboard_scheduler = std::make_unique<BroadcastScheduler>("dashboard", DASHBOARD_COALESCE_WINDOW);
+    g_dashboard_scheduler->set_subscriber_check([] {
+        return g_server && g_server->has_subscribers(TOPIC_DASHBOARD);
+    });
+    g_dashboard_scheduler->set_flush_handler(flush_dashboard_update);
+    g_dashboard_scheduler->start();
+
+    g_log_scheduler = std::make_unique<BroadcastScheduler>("logs", LOG_STREAM_WINDOW);
+    g_log_scheduler->set_subscriber_check([] {
+        return g_server && g_server->has_subscribers(TOPIC_LOGS);
+    });
+    g_log_scheduler->set_flush_handler(flush_log_stream);
+    g_log_scheduler->start();
+    g_logger->set_tail_listener([] { g_log_scheduler->mark_dirty(); });
+
+    g_query_pool = std::make_unique<WorkerPool>("query", QUERY_POOL_THREADS, QUERY_POOL_MAX_QUEUE);
+    g_query_pool->start();
+
     g_server->run();
 
     g_is_running = false;
     if(g_worker_thread.joinable()) g_worker_thread.join();
+    g_dashboard_scheduler->stop();
+    g_logger->set_tail_listener(nullptr);
+    g_log_scheduler->stop();
+    g_query_pool->stop();
 
     g_sys_monitor->stop_top_app_monitor();
     g_sys_monitor->stop_network_snapshot_thread();
 
     if (g_rekernel_client) g_rekernel_client->stop();
 
+    flight_recorder.mark_clean_shutdown();
     LOGI("Cerberus Daemon has shut down cleanly.");
     return 0;
 }
\ No newline at end of file
@@ -34,6 +34,7 @@ using Task = std::variant<
 // --- 全局函数声明 ---
 void broadcast_dashboard_update();
 void notify_probe_of_config_change();
+void broadcast_doze_event(bool entered_deep_doze);
 
 // 如果您暂时不使用 schedule_task，可以注释掉它以避免潜在的未定义引用错误
 // void schedule_task(Task task); 
@@ -0,0 +1,344 @@
+// daemon/cpp/message_dispatch.cpp
+#include "message_dispatch.h"
+#include "state_manager.h"
+#include "log_storm.h"
+#include <algorithm>
+#include <optional>
+
+namespace {
+
+// cmd.set_log_storm_config 接受的取值范围
+constexpr uint64_t LOG_STORM_MIN_WINDOW_MS = 1000;
+constexpr uint64_t LOG_STORM_MAX_WINDOW_MS = 10 * 60 * 1000;
+constexpr uint64_t LOG_STORM_MAX_PASSTHROUGH = 1000;
+// cmd.set_dashboard_window 接受的合并窗口范围
+constexpr uint64_t DASHBOARD_MIN_WINDOW_MS = 50;
+constexpr uint64_t DASHBOARD_MAX_WINDOW_MS = 5000;
+
+// 顶层扫描器：只识别 JSON 的结构字符，不校验数字与字面量的细节。
+// payload 的合法性由其后的解析负责，其余顶层字段的值只需能被跳过
+struct Cursor {
+    const char* pos;
+    const char* end;
+
+    void skip_whitespace() {
+        while (pos < end && (*pos == ' ' || *pos == '\t' || *pos == '\n' || *pos == '\r')) ++pos;
+    }
+    bool consume(char c) {
+        if (pos >= end || *pos != c) return false;
+        ++pos;
+        return true;
+    }
+};
+
+// 读取以 '"' 开头的字符串，out 为引号内的原始内容，escaped 表示其中是否含转义
+bool read_string(Cursor& cursor, std::string_view& out, bool& escaped) {
+    if (!cursor.consume('"')) return false;
+    const char* begin = cursor.pos;
+    escaped = false;
+    while (cursor.pos < cursor.end) {
+        char c = *cursor.pos;
+        if (c == '"') {
+            out = std::string_view(begin, cursor.pos - begin);
+            ++cursor.pos;
+            return true;
+        }
+        if (c == '\\') {
+            escaped = true;
+            cursor.pos += 2;
+            continue;
+        }
+        ++cursor.pos;
+    }
+    return false;
+}
+
+bool skip_value(Cursor& cursor) {
+    if (cursor.pos >= cursor.end) return false;
+    char c = *cursor.pos;
+    std::string_view ignored;
+    bool escaped = false;
+    if (c == '"') return read_string(cursor, ignored, escaped);
+    if (c == '{' || c == '[') {
+        int depth = 0;
+        while (cursor.pos < cursor.end) {
+            c = *cursor.pos;
+            if (c == '"') {
+                if (!read_string(cursor, ignored, escaped)) return false;
+                continue;
+            }
+            if (c == '{' || c == '[') {
+                ++depth;
+            } else if (c == '}' || c == ']') {
+                if (--depth == 0) {
+                    ++cursor.pos;
+                    return true;
+                }
+            }
+            ++cursor.pos;
+        }
+        return false;
+    }
+    // 数字与 true/false/null
+    const char* begin = cursor.pos;
+    while (cursor.pos < cursor.end) {
+        c = *cursor.pos;
+        if (c == ',' || c == '}' || c == ']' || c == ' ' || c == '\t' || c == '\n' || c == '\r') break;
+        ++cursor.pos;
+    }
+    return cursor.pos > begin;
+}
+
+} // namespace
+
+bool MessageEnvelope::scan(std::string_view text) {
+    Cursor cursor{text.data(), text.data() + text.size()};
+    cursor.skip_whitespace();
+    if (!cursor.consume('{')) return false;
+    cursor.skip_whitespace();
+    if (cursor.consume('}')) {
+        cursor.skip_whitespace();
+        return cursor.pos == cursor.end;
+    }
+    while (true) {
+        std::string_view key;
+        bool escaped = false;
+        if (!read_string(cursor, key, escaped) || escaped) return false;
+        cursor.skip_whitespace();
+        if (!cursor.consume(':')) return false;
+        cursor.skip_whitespace();
+
+        if (key == "type" || key == "req_id") {
+            // 非字符串或含转义时交给完整解析，保持与 msg.value() 相同的报错行为
+            std::string_view value;
+            if (cursor.pos >= cursor.end || *cursor.pos != '"') return false;
+            if (!read_string(cursor, value, escaped) || escaped) return false;
+            if (key == "type") {
+                type_ = value;
+            } else {
+                req_id_.assign(value.data(), value.size());
+            }
+        } else if (key == "payload") {
+            const char* begin = cursor.pos;
+            if (!skip_value(cursor)) return false;
+            payload_ = std::string_view(begin, cursor.pos - begin);
+        } else if (!skip_value(cursor)) {
+            return false;
+        }
+
+        cursor.skip_whitespace();
+        if (cursor.consume(',')) {
+            cursor.skip_whitespace();
+            continue;
+        }
+        if (!cursor.consume('}')) return false;
+        break;
+    }
+    cursor.skip_whitespace();
+    return cursor.pos == cursor.end;
+}
+
+void MessageEnvelope::parse(std::string_view text) {
+    type_ = {};
+    payload_ = {};
+    req_id_.clear();
+    fallback_ = false;
+    if (scan(text)) return;
+
+    type_ = {};
+    payload_ = {};
+    req_id_.clear();
+    fallback_ = true;
+    json msg = json::parse(text);
+    owned_type_ = msg.value("type", "");
+    req_id_ = msg.value("req_id", "");
+    auto it = msg.find("payload");
+    owned_payload_ = it != msg.end() ? it->dump() : std::string();
+    type_ = owned_type_;
+    payload_ = owned_payload_;
+}
+
+json MessageEnvelope::payload_json() const {
+    if (payload_.empty()) return json::object();
+    return json::parse(payload_);
+}
+
+void PayloadBinder::add(std::string_view key, Kind kind, void* target) {
+    if (count_ >= MAX_BINDINGS) return;
+    bindings_[count_++] = Binding{key, kind, target};
+}
+
+const PayloadBinder::Binding* PayloadBinder::find(std::string_view key) const {
+    for (size_t i = 0; i < count_; ++i) {
+        if (bindings_[i].key == key) return &bindings_[i];
+    }
+    return nullptr;
+}
+
+// 只在第一层对象上赋值；深度以进入的容器计，根对象内部为 1
+class FlatPayloadSax {
+public:
+    using number_integer_t = json::number_integer_t;
+    using number_unsigned_t = json::number_unsigned_t;
+    using number_float_t = json::number_float_t;
+    using string_t = json::string_t;
+    using binary_t = json::binary_t;
+
+    explicit FlatPayloadSax(const PayloadBinder& binder) : binder_(binder) {}
+
+    bool null() { return scalar(); }
+    bool boolean(bool value) {
+        if (!scalar()) return false;
+        if (current_ && current_->kind == PayloadBinder::Kind::BOOL) *static_cast<bool*>(current_->target) = value;
+        return true;
+    }
+    bool number_integer(number_integer_t value) { return integer(static_cast<long long>(value)); }
+    bool number_unsigned(number_unsigned_t value) { return integer(static_cast<long long>(value)); }
+    bool number_float(number_float_t value, const string_t&) { return integer(static_cast<long long>(value)); }
+    bool string(string_t& value) {
+        if (!scalar()) return false;
+        if (current_ && current_->kind == PayloadBinder::Kind::STRING) *static_cast<std::string*>(current_->target) = std::move(value);
+        return true;
+    }
+    bool binary(binary_t&) { return scalar(); }
+    bool start_object(std::size_t) { return enter(); }
+    bool key(string_t& name) {
+        current_ = depth_ == 1 ? binder_.find(name) : nullptr;
+        return true;
+    }
+    bool end_object() { --depth_; return true; }
+    bool start_array(std::size_t) { return depth_ == 0 ? false : enter(); }
+    bool end_array() { --depth_; return true; }
+    bool parse_error(std::size_t, const std::string&, const nlohmann::detail::exception&) { return false; }
+
+private:
+    // 根不是对象时中止解析
+    bool scalar() { return depth_ > 0; }
+    bool enter() {
+        current_ = nullptr;
+        ++depth_;
+        return true;
+    }
+    bool integer(long long value) {
+        if (!scalar()) return false;
+        if (!current_) return true;
+        if (current_->kind == PayloadBinder::Kind::INT) *static_cast<int*>(current_->target) = static_cast<int>(value);
+        else if (current_->kind == PayloadBinder::Kind::INT64) *static_cast<long long*>(current_->target) = value;
+        return true;
+    }
+
+    const PayloadBinder& binder_;
+    const PayloadBinder::Binding* current_ = nullptr;
+    int depth_ = 0;
+};
+
+bool PayloadBinder::parse(std::string_view payload_text) {
+    if (payload_text.empty()) return false;
+    FlatPayloadSax sax(*this);
+    return json::sax_parse(payload_text.begin(), payload_text.end(), &sax);
+}
+
+void parse_probe_event_batch(const json& payload, std::vector<ProbeEvent>& out) {
+    const auto it = payload.find("e");
+    if (it == payload.end() || !it->is_array()) return;
+    out.reserve(it->size());
+    for (const auto& item : *it) {
+        if (!item.is_array() || item.size() < 5 || !item[0].is_number_integer() || !item[4].is_string()) continue;
+        int kind = item[0].get<int>();
+        if (kind < static_cast<int>(ProbeEvent::Kind::FOREGROUND) || kind > static_cast<int>(ProbeEvent::Kind::PROACTIVE_START)) continue;
+        ProbeEvent event;
+        event.kind = static_cast<ProbeEvent::Kind>(kind);
+        event.uid = item[1].is_number_integer() ? item[1].get<int>() : -1;
+        event.user_id = item[2].is_number_integer() ? item[2].get<int>() : 0;
+        event.arg = item[3].is_number_integer() ? item[3].get<int>() : 0;
+        event.package_name = item[4].get<std::string>();
+        out.push_back(std::move(event));
+    }
+}
+
+// 只接受 [min, max] 内的整数；负数不会被转换成很大的无符号数
+static std::optional<uint64_t> bounded_integer(const json& value, uint64_t min, uint64_t max) {
+    if (!value.is_number_integer()) return std::nullopt;
+    if (!value.is_number_unsigned() && value.get<int64_t>() < 0) return std::nullopt;
+    uint64_t number = value.get<uint64_t>();
+    if (number < min || number > max) return std::nullopt;
+    return number;
+}
+
+bool parse_log_storm_config(const json& payload, LogStormConfig& config, std::string& bad_field) {
+    if (!payload.is_object()) {
+        bad_field = "payload";
+        return false;
+    }
+    LogStormConfig parsed = config;
+    for (auto it = payload.begin(); it != payload.end(); ++it) {
+        const std::string& key = it.key();
+        const json& value = it.value();
+        bool valid = true;
+        if (key == "enabled") {
+            valid = value.is_boolean();
+            if (valid) parsed.enabled = value.get<bool>();
+        } else if (key == "window_ms") {
+            auto number = bounded_integer(value, LOG_STORM_MIN_WINDOW_MS, LOG_STORM_MAX_WINDOW_MS);
+            valid = number.has_value();
+            if (valid) parsed.window_ms = static_cast<long long>(*number);
+        } else if (key == "passthrough") {
+            auto number = bounded_integer(value, 1, LOG_STORM_MAX_PASSTHROUGH);
+            valid = number.has_value();
+            if (valid) parsed.passthrough = static_cast<uint32_t>(*number);
+        } else if (key == "max_keys") {
+            auto number = bounded_integer(value, 1, LogStormAggregator::MAX_TRACKED_KEYS);
+            valid = number.has_value();
+            if (valid) parsed.max_keys = static_cast<size_t>(*number);
+        } else if (key == "exempt_levels") {
+            valid = value.is_array();
+            uint32_t mask = 0;
+            for (size_t i = 0; valid && i < value.size(); ++i) {
+                auto level = bounded_integer(value[i], 0, static_cast<uint64_t>(LogLevel::BATCH_PARENT));
+                valid = level.has_value();
+                if (valid) mask |= 1u << *level;
+            }
+            if (valid) parsed.exempt_level_mask = mask;
+        }
+        // 未知字段忽略，便于 UI 与守护进程分别升级
+        if (!valid) {
+            bad_field = key;
+            return false;
+        }
+    }
+    config = parsed;
+    return true;
+}
+
+bool parse_dashboard_window(const json& payload, long long& window_ms, std::string& bad_field) {
+    if (!payload.is_object() || !payload.contains("window_ms")) {
+        bad_field = payload.is_object() ? "window_ms" : "payload";
+        return false;
+    }
+    auto number = bounded_integer(payload["window_ms"], DASHBOARD_MIN_WINDOW_MS, DASHBOARD_MAX_WINDOW_MS);
+    if (!number) {
+        bad_field = "window_ms";
+        return false;
+    }
+    window_ms = static_cast<long long>(*number);
+    return true;
+}
+
+LogBackfillRange parse_log_backfill_range(const json& payload, uint64_t up_to_seq) {
+    LogBackfillRange range;
+    if (payload.contains("log_cursor")) {
+        range.after_seq = payload.value("log_cursor", 0ULL);
+        if (range.after_seq > up_to_seq) {
+            // 游标来自守护进程重启之前，序号已重新开始
+            range.after_seq = up_to_seq > LOG_BACKFILL_DEFAULT ? up_to_seq - LOG_BACKFILL_DEFAULT : 0;
+            range.truncated = true;
+        } else if (up_to_seq - range.after_seq > LOG_BACKFILL_MAX) {
+            range.after_seq = up_to_seq - LOG_BACKFILL_MAX;
+            range.truncated = true;
+        }
+    } else {
+        size_t backfill = std::min<size_t>(payload.value("log_backfill", LOG_BACKFILL_DEFAULT), LOG_BACKFILL_MAX);
+        range.after_seq = up_to_seq > backfill ? up_to_seq - backfill : 0;
+    }
+    return range;
+}
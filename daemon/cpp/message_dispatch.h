@@ -0,0 +1,244 @@
+// daemon/cpp/message_dispatch.h
+#ifndef CERBERUS_MESSAGE_DISPATCH_H
+#define CERBERUS_MESSAGE_DISPATCH_H
+
+#include <nlohmann/json.hpp>
+#include <array>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+using json = nlohmann::json;
+
+struct ProbeEvent;
+struct LogStormConfig;
+
+// 消息信封：顶层的 type / req_id / payload。
+// 快速路径只扫描一遍顶层对象，不构建 DOM，type 与 payload 以 string_view 指向原始文本；
+// 顶层字段含转义或类型不符等扫描不了的情况回退到完整解析，此时文本由本对象持有。
+// 视图在原始文本与本对象都有效期间有效。
+class MessageEnvelope {
+public:
+    MessageEnvelope() = default;
+    MessageEnvelope(const MessageEnvelope&) = delete;
+    MessageEnvelope& operator=(const MessageEnvelope&) = delete;
+
+    // 与 json::parse 一样，文本不是合法 JSON 时抛出 json::exception
+    void parse(std::string_view text);
+
+    std::string_view type() const { return type_; }
+    const std::string& req_id() const { return req_id_; }
+    // payload 值的原始 JSON 文本，消息不含 payload 时为空
+    std::string_view payload_text() const { return payload_; }
+    bool has_payload() const { return !payload_.empty(); }
+    // 按需把 payload 解析为 DOM；消息不含 payload 时返回空对象
+    json payload_json() const;
+    bool used_fallback() const { return fallback_; }
+
+private:
+    bool scan(std::string_view text);
+
+    std::string_view type_;
+    std::string_view payload_;
+    std::string req_id_;
+    std::string owned_type_;
+    std::string owned_payload_;
+    bool fallback_ = false;
+};
+
+// 把载荷对象的顶层标量字段绑定到请求结构体的成员上，以 SAX 方式解析并直接写入，不构建 DOM。
+// 嵌套的对象与数组被跳过；字段类型不符时保留成员的默认值。
+class PayloadBinder {
+public:
+    void field(std::string_view key, int& out) { add(key, Kind::INT, &out); }
+    void field(std::string_view key, long long& out) { add(key, Kind::INT64, &out); }
+    void field(std::string_view key, bool& out) { add(key, Kind::BOOL, &out); }
+    void field(std::string_view key, std::string& out) { add(key, Kind::STRING, &out); }
+
+    // 载荷为空、不是对象或不是合法 JSON 时返回 false
+    bool parse(std::string_view payload_text);
+
+private:
+    friend class FlatPayloadSax;
+    enum class Kind { INT, INT64, BOOL, STRING };
+    struct Binding {
+        std::string_view key;
+        Kind kind = Kind::INT;
+        void* target = nullptr;
+    };
+    static constexpr size_t MAX_BINDINGS = 8;
+
+    void add(std::string_view key, Kind kind, void* target);
+    const Binding* find(std::string_view key) const;
+
+    std::array<Binding, MAX_BINDINGS> bindings_{};
+    size_t count_ = 0;
+};
+
+// 请求结构体需提供 void bind(PayloadBinder&)，在其中声明各字段对应的键名
+template <typename Request>
+bool decode_payload(std::string_view payload_text, Request& request) {
+    PayloadBinder binder;
+    request.bind(binder);
+    return binder.parse(payload_text);
+}
+
+// ---- 各消息的载荷结构 ----
+
+// event.app_foreground / event.app_background / cmd.proactive_unfreeze /
+// event.app_wakeup_request / cmd.request_temp_unfreeze_pkg
+struct AppTargetRequest {
+    std::string package_name;
+    int user_id = 0;
+    void bind(PayloadBinder& binder) {
+        binder.field("package_name", package_name);
+        binder.field("user_id", user_id);
+    }
+};
+
+// event.app_wakeup_request_v2
+struct ProbeWakeupRequest {
+    int uid = -1;
+    int type_int = 3;
+    void bind(PayloadBinder& binder) {
+        binder.field("uid", uid);
+        binder.field("type_int", type_int);
+    }
+};
+
+// cmd.request_temp_unfreeze_uid
+struct UidRequest {
+    int uid = -1;
+    void bind(PayloadBinder& binder) { binder.field("uid", uid); }
+};
+
+// cmd.request_temp_unfreeze_pid
+struct PidRequest {
+    int pid = -1;
+    void bind(PayloadBinder& binder) { binder.field("pid", pid); }
+};
+
+// cmd.set_master_config，缺省值与 MasterConfig 一致
+struct MasterConfigRequest {
+    int standard_timeout_sec = 90;
+    bool is_timed_unfreeze_enabled = true;
+    int timed_unfreeze_interval_sec = 1800;
+    void bind(PayloadBinder& binder) {
+        binder.field("standard_timeout_sec", standard_timeout_sec);
+        binder.field("is_timed_unfreeze_enabled", is_timed_unfreeze_enabled);
+        binder.field("timed_unfreeze_interval_sec", timed_unfreeze_interval_sec);
+    }
+};
+
+// cmd.set_adj_rules_content
+struct AdjRulesContentRequest {
+    std::string content;
+    void bind(PayloadBinder& binder) { binder.field("content", content); }
+};
+
+// 批量事件帧 event.probe_batch {"e": [[kind, uid, user_id, arg, package_name], ...]}。
+// 每条事件是定长数组，省去逐条的 type 与键名；格式不符的条目被跳过
+void parse_probe_event_batch(const json& payload, std::vector<ProbeEvent>& out);
+
+// cmd.set_log_storm_config：在 config（调用方传入当前生效的配置）上覆盖载荷中出现的字段。
+// 任一字段类型不符或越界（负数、小数、字符串等）时整条拒绝，返回 false 且 config 不变，bad_field 为出错的键名
+bool parse_log_storm_config(const json& payload, LogStormConfig& config, std::string& bad_field);
+// cmd.set_dashboard_window {"window_ms": N}：N 须为 [50, 5000] 内的整数，否则返回 false 且 window_ms 不变
+bool parse_dashboard_window(const json& payload, long long& window_ms, std::string& bad_field);
+
+// 订阅日志主题时的回填：默认与最大条数
+constexpr size_t LOG_BACKFILL_DEFAULT = 50;
+constexpr size_t LOG_BACKFILL_MAX = 500;
+
+// 回填区间 (after_seq, up_to_seq]；truncated 表示客户端游标之后的部分日志不会补发
+struct LogBackfillRange {
+    uint64_t after_seq = 0;
+    bool truncated = false;
+};
+// 按订阅载荷确定回填区间，up_to_seq 为当前推送位置。
+// 带 log_cursor 时从游标接续：游标超过推送位置（来自守护进程重启之前）时只回填最近的默认条数，
+// 与推送位置相差超过上限时只回填最近的上限条，两种情况都标记 truncated；
+// 不带游标时回填最近 log_backfill 条（缺省为默认条数，不超过上限），不标记 truncated
+LogBackfillRange parse_log_backfill_range(const json& payload, uint64_t up_to_seq);
+
+// ---- 分发表 ----
+
+using MessageHandler = void (*)(int client_fd, const MessageEnvelope& envelope);
+
+struct MessageRoute {
+    std::string_view type;
+    MessageHandler handler = nullptr;
+    // 需要 StateManager 就绪才能处理
+    bool requires_state = false;
+};
+
+namespace message_dispatch {
+
+// 带种子的 32 位 FNV-1a，末尾再混合一次高位，使低位对种子足够敏感
+constexpr uint32_t hash_type(std::string_view text, uint32_t seed) {
+    uint32_t hash = 2166136261u ^ (seed * 0x9E3779B9u);
+    for (char c : text) {
+        hash ^= static_cast<uint8_t>(c);
+        hash *= 16777619u;
+    }
+    return hash ^ (hash >> 15);
+}
+
+constexpr size_t slot_count_for(size_t entries) {
+    size_t slots = 1;
+    while (slots < entries * 4) slots <<= 1;
+    return slots;
+}
+
+} // namespace message_dispatch
+
+// 编译期构建的完美哈希表：在不少于 4 倍条目数的 2 的幂个槽位中搜索一个让所有条目互不冲突的种子，
+// 查找只需一次哈希、一次下标与一次字符串比较。条目类型须有 std::string_view type 成员。
+// 条目重复或找不到种子时 is_perfect() 为 false，定义处应以 static_assert 检查。
+template <typename Entry, size_t N>
+class StaticRouteTable {
+public:
+    static_assert(N > 0 && N < 255, "slot indices are stored as uint8_t");
+    static constexpr size_t SLOTS = message_dispatch::slot_count_for(N);
+    static constexpr uint32_t MAX_SEED_ATTEMPTS = 4096;
+
+    constexpr explicit StaticRouteTable(const std::array<Entry, N>& entries) : entries_(entries) {
+        for (uint32_t seed = 1; seed <= MAX_SEED_ATTEMPTS; ++seed) {
+            if (try_seed(seed)) {
+                seed_ = seed;
+                return;
+            }
+        }
+    }
+
+    constexpr bool is_perfect() const { return seed_ != 0; }
+    constexpr uint32_t seed() const { return seed_; }
+    constexpr const std::array<Entry, N>& entries() const { return entries_; }
+
+    const Entry* find(std::string_view type) const {
+        uint8_t index = slots_[message_dispatch::hash_type(type, seed_) & (SLOTS - 1)];
+        if (index == 0) return nullptr;
+        const Entry& entry = entries_[index - 1];
+        return entry.type == type ? &entry : nullptr;
+    }
+
+private:
+    constexpr bool try_seed(uint32_t seed) {
+        std::array<uint8_t, SLOTS> slots{};
+        for (size_t i = 0; i < N; ++i) {
+            size_t slot = message_dispatch::hash_type(entries_[i].type, seed) & (SLOTS - 1);
+            if (slots[slot] != 0) return false;
+            slots[slot] = static_cast<uint8_t>(i + 1);
+        }
+        slots_ = slots;
+        return true;
+    }
+
+    std::array<Entry, N> entries_{};
+    std::array<uint8_t, SLOTS> slots_{};  // 条目下标 + 1，0 表示空槽
+    uint32_t seed_ = 0;
+};
+
+#endif // CERBERUS_MESSAGE_DISPATCH_H
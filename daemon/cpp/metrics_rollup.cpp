@@ -0,0 +1,476 @@
+// daemon/cpp/metrics_rollup.cpp
+#include "metrics_rollup.h"
+#include "time_series_database.h"
+#include <android/log.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <filesystem>
+
+#define LOG_TAG "cerberusd_rollup"
+#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+#define LOGW(...) __android_log_print(ANDROID_LOG_WARN, LOG_TAG, __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+
+namespace fs = std::filesystem;
+using namespace metrics_rollup_layout;
+
+static uint32_t fnv1a(const void* data, size_t size) {
+    const auto* bytes = static_cast<const uint8_t*>(data);
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static long long bucket_floor(long long timestamp_ms, long long resolution_ms) {
+    return timestamp_ms - timestamp_ms % resolution_ms;
+}
+
+static RollupFileHeader make_header(uint32_t resolution_ms, uint32_t capacity, uint64_t generation, uint64_t count) {
+    RollupFileHeader header{};
+    header.magic = MAGIC;
+    header.version = VERSION;
+    header.bucket_size = BUCKET_SIZE;
+    header.resolution_ms = resolution_ms;
+    header.capacity = capacity;
+    header.generation = generation;
+    header.count = count;
+    header.checksum = fnv1a(&header, offsetof(RollupFileHeader, checksum));
+    return header;
+}
+
+static bool write_fully(int fd, const void* data, size_t size, off_t offset) {
+    const auto* bytes = static_cast<const uint8_t*>(data);
+    while (size > 0) {
+        ssize_t written = pwrite(fd, bytes, size, offset);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        bytes += written;
+        size -= static_cast<size_t>(written);
+        offset += written;
+    }
+    return true;
+}
+
+// msync 要求页对齐的起始地址
+static void sync_range(uint8_t* base, size_t offset, size_t length) {
+    static const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_t aligned = offset & ~(page_size - 1);
+    msync(base + aligned, offset + length - aligned, MS_SYNC);
+}
+
+// --- RollupFile ---
+
+RollupFile::~RollupFile() {
+    close();
+}
+
+uint32_t RollupFile::bucket_checksum(const RollupBucket& bucket) {
+    RollupBucket copy = bucket;
+    copy.checksum = 0;
+    return fnv1a(&copy, sizeof(copy));
+}
+
+const RollupBucket* RollupFile::buckets() const {
+    return reinterpret_cast<const RollupBucket*>(base_ + HEADER_SIZE);
+}
+
+bool RollupFile::open(const std::string& path, uint32_t resolution_ms, uint32_t retention) {
+    close();
+    path_ = path;
+    resolution_ms_ = resolution_ms;
+    retention_ = std::max<uint32_t>(retention, 1);
+    capacity_ = 2 * retention_;
+    stats_ = RollupFileStats{};
+    fd_ = ::open(path_.c_str(), O_RDWR | O_CLOEXEC);
+    if (fd_ != -1 && map_existing()) return true;
+    if (fd_ != -1) LOGW("Rollup file %s is unusable, recreating.", path_.c_str());
+    stats_.recreated = true;
+    return create(1, nullptr, 0);
+}
+
+void RollupFile::close() {
+    if (base_) munmap(base_, mapping_size_);
+    if (fd_ != -1) ::close(fd_);
+    base_ = nullptr;
+    fd_ = -1;
+    mapping_size_ = 0;
+    count_ = 0;
+    generation_ = 0;
+}
+
+bool RollupFile::map_existing() {
+    size_t size = HEADER_SIZE + static_cast<size_t>(capacity_) * BUCKET_SIZE;
+    struct stat st;
+    if (fstat(fd_, &st) == -1 || static_cast<size_t>(st.st_size) != size) return false;
+    void* mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (mapping == MAP_FAILED) {
+        LOGE("mmap of %s failed: %s", path_.c_str(), strerror(errno));
+        return false;
+    }
+
+    const RollupFileHeader* best = nullptr;
+    int valid = 0;
+    for (uint32_t slot = 0; slot < 2; ++slot) {
+        const auto* header = reinterpret_cast<const RollupFileHeader*>(static_cast<uint8_t*>(mapping) + slot * HEADER_SLOT_SIZE);
+        if (header->magic != MAGIC || header->version != VERSION || header->bucket_size != BUCKET_SIZE ||
+            header->resolution_ms != resolution_ms_ || header->capacity != capacity_ || header->count > capacity_ ||
+            header->checksum != fnv1a(header, offsetof(RollupFileHeader, checksum))) {
+            continue;
+        }
+        valid++;
+        if (!best || header->generation > best->generation) best = header;
+    }
+    if (!best) {
+        munmap(mapping, size);
+        return false;
+    }
+    base_ = static_cast<uint8_t*>(mapping);
+    mapping_size_ = size;
+    generation_ = best->generation;
+    count_ = static_cast<size_t>(best->count);
+    // 两个副本平时都有效，只剩一份说明提交头部时被打断或损坏
+    if (valid == 1) stats_.used_backup_header = true;
+
+    size_t good = 0;
+    while (good < count_ && buckets()[good].checksum == bucket_checksum(buckets()[good]) &&
+           (good == 0 || buckets()[good].start_ms > buckets()[good - 1].start_ms)) {
+        good++;
+    }
+    if (good < count_) {
+        LOGW("Rollup file %s: dropping %zu corrupt buckets after #%zu.", path_.c_str(), count_ - good, good);
+        stats_.dropped_buckets += count_ - good;
+        commit(good);
+    }
+    return true;
+}
+
+bool RollupFile::create(uint64_t generation, const RollupBucket* keep, size_t keep_count) {
+    std::string tmp_path = path_ + ".tmp";
+    int fd = ::open(tmp_path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd == -1) {
+        LOGE("Failed to create %s: %s", tmp_path.c_str(), strerror(errno));
+        return false;
+    }
+    size_t size = HEADER_SIZE + static_cast<size_t>(capacity_) * BUCKET_SIZE;
+    // 两个副本都写入，较旧的一份 generation 小 1，内容相同
+    RollupFileHeader headers[2];
+    headers[generation % 2] = make_header(resolution_ms_, capacity_, generation, keep_count);
+    headers[(generation + 1) % 2] = make_header(resolution_ms_, capacity_, generation - 1, keep_count);
+    bool ok = ftruncate(fd, static_cast<off_t>(size)) == 0 &&
+              (keep_count == 0 || write_fully(fd, keep, keep_count * BUCKET_SIZE, HEADER_SIZE)) &&
+              write_fully(fd, headers, sizeof(headers), 0) &&
+              fsync(fd) == 0;
+    ::close(fd);
+    if (!ok || rename(tmp_path.c_str(), path_.c_str()) != 0) {
+        LOGE("Failed to write %s: %s", path_.c_str(), strerror(errno));
+        unlink(tmp_path.c_str());
+        return false;
+    }
+
+    RollupFileStats stats = stats_;
+    close();
+    stats_ = stats;
+    fd_ = ::open(path_.c_str(), O_RDWR | O_CLOEXEC);
+    return fd_ != -1 && map_existing();
+}
+
+bool RollupFile::commit(size_t count) {
+    generation_++;
+    RollupFileHeader header = make_header(resolution_ms_, capacity_, generation_, count);
+    size_t offset = (generation_ % 2) * HEADER_SLOT_SIZE;
+    std::memcpy(base_ + offset, &header, sizeof(header));
+    sync_range(base_, offset, sizeof(header));
+    count_ = count;
+    return true;
+}
+
+bool RollupFile::compact() {
+    size_t keep_count = std::min<size_t>(retention_, count_);
+    if (!create(generation_ + 1, buckets() + (count_ - keep_count), keep_count)) return false;
+    stats_.compactions++;
+    return true;
+}
+
+bool RollupFile::append(const RollupBucket& bucket) {
+    if (!base_) return false;
+    if (count_ > 0 && bucket.start_ms <= at(count_ - 1).start_ms) return false;
+    if (count_ >= capacity_ && !compact()) return false;
+
+    RollupBucket stored = bucket;
+    stored.checksum = bucket_checksum(stored);
+    size_t offset = HEADER_SIZE + count_ * BUCKET_SIZE;
+    std::memcpy(base_ + offset, &stored, sizeof(stored));
+    // 桶先落盘，之后的头部才把它计入 count
+    sync_range(base_, offset, sizeof(stored));
+    commit(count_ + 1);
+    stats_.appends++;
+    return true;
+}
+
+size_t RollupFile::lower_bound(long long since_ms) const {
+    if (!base_) return 0;
+    const RollupBucket* begin = buckets();
+    return std::lower_bound(begin, begin + count_, since_ms,
+                            [](const RollupBucket& bucket, long long ts) { return bucket.start_ms < ts; }) - begin;
+}
+
+size_t RollupFile::truncate_from(long long since_ms) {
+    if (!base_) return 0;
+    size_t keep = lower_bound(since_ms);
+    size_t removed = count_ - keep;
+    if (removed == 0) return 0;
+    // 头部的 count 之后的桶视为不存在，之后的追加直接覆盖
+    commit(keep);
+    stats_.truncated_buckets += removed;
+    return removed;
+}
+
+// --- RollupAccumulator ---
+
+void RollupAccumulator::reset(long long bucket_start_ms) {
+    start_ms = bucket_start_ms;
+    samples = 0;
+    charging = 0;
+    screen_on = 0;
+    for (auto& stat : stats) stat = Stat{0.0, 0.0, 0.0, 0};
+}
+
+static void add_value(RollupAccumulator::Stat& stat, double value) {
+    if (stat.count == 0) {
+        stat.min = value;
+        stat.max = value;
+    } else {
+        stat.min = std::min(stat.min, value);
+        stat.max = std::max(stat.max, value);
+    }
+    stat.sum += value;
+    stat.count++;
+}
+
+void RollupAccumulator::add_sample(const MetricsRecord& record) {
+    samples++;
+    if (record.is_charging) charging++;
+    if (record.is_screen_on) screen_on++;
+    add_value(stats[ROLLUP_CPU_USAGE], record.total_cpu_usage_percent);
+    add_value(stats[ROLLUP_MEM_AVAILABLE_KB], static_cast<double>(record.mem_available_kb));
+    add_value(stats[ROLLUP_SWAP_USED_KB], static_cast<double>(record.swap_total_kb - record.swap_free_kb));
+    if (record.battery_level >= 0) add_value(stats[ROLLUP_BATTERY_LEVEL], record.battery_level);
+    add_value(stats[ROLLUP_BATTERY_TEMP], record.battery_temp_celsius);
+    add_value(stats[ROLLUP_BATTERY_POWER], record.battery_power_watt);
+}
+
+void RollupAccumulator::merge(const RollupBucket& bucket) {
+    samples += bucket.sample_count;
+    charging += bucket.charging_samples;
+    screen_on += bucket.screen_on_samples;
+    for (int i = 0; i < ROLLUP_METRIC_COUNT; ++i) {
+        const RollupStat& from = bucket.stats[i];
+        if (from.count == 0) continue;
+        Stat& stat = stats[i];
+        stat.min = stat.count == 0 ? from.min : std::min<double>(stat.min, from.min);
+        stat.max = stat.count == 0 ? from.max : std::max<double>(stat.max, from.max);
+        stat.sum += static_cast<double>(from.avg) * from.count;
+        stat.count += from.count;
+    }
+}
+
+RollupBucket RollupAccumulator::seal() const {
+    RollupBucket bucket{};
+    bucket.start_ms = start_ms;
+    bucket.sample_count = samples;
+    bucket.charging_samples = charging;
+    bucket.screen_on_samples = screen_on;
+    for (int i = 0; i < ROLLUP_METRIC_COUNT; ++i) {
+        const Stat& stat = stats[i];
+        if (stat.count == 0) continue;
+        bucket.stats[i] = RollupStat{static_cast<float>(stat.min), static_cast<float>(stat.max),
+                                     static_cast<float>(stat.sum / stat.count), stat.count};
+    }
+    return bucket;
+}
+
+// --- MetricsRollup ---
+
+bool MetricsRollup::open(const std::string& dir) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::error_code ec;
+    fs::create_directories(dir, ec);
+    if (!minute_file_.open(dir + "/rollup_1m.bin", MINUTE_MS, MINUTE_RETENTION) ||
+        !quarter_file_.open(dir + "/rollup_15m.bin", QUARTER_HOUR_MS, QUARTER_HOUR_RETENTION)) {
+        LOGE("Failed to open metrics rollups in %s.", dir.c_str());
+        minute_file_.close();
+        quarter_file_.close();
+        return false;
+    }
+    minute_acc_.start_ms = -1;
+    quarter_acc_.start_ms = -1;
+    restore_quarter();
+    LOGI("Metrics rollups ready: %zu 1m buckets, %zu 15m buckets.", minute_file_.size(), quarter_file_.size());
+    return true;
+}
+
+// 15 分钟桶由 1 分钟桶汇总而来，重启前或截断后仍在文件中的那部分从 1 分钟文件补回
+void MetricsRollup::restore_quarter() {
+    if (minute_file_.size() == 0) return;
+    long long quarter_start = bucket_floor(minute_file_.at(minute_file_.size() - 1).start_ms, QUARTER_HOUR_MS);
+    if (quarter_file_.size() > 0 && quarter_file_.at(quarter_file_.size() - 1).start_ms >= quarter_start) return;
+    quarter_acc_.reset(quarter_start);
+    for (size_t i = minute_file_.lower_bound(quarter_start); i < minute_file_.size(); ++i) quarter_acc_.merge(minute_file_.at(i));
+}
+
+void MetricsRollup::close() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    minute_file_.close();
+    quarter_file_.close();
+    minute_acc_.start_ms = -1;
+    quarter_acc_.start_ms = -1;
+}
+
+bool MetricsRollup::is_open() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return minute_file_.is_open();
+}
+
+void MetricsRollup::add_sample(const MetricsRecord& record) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!minute_file_.is_open()) return;
+    long long start = bucket_floor(record.timestamp_ms, MINUTE_MS);
+    bool has_latest = minute_acc_.is_open() || minute_file_.size() > 0;
+    long long latest = minute_acc_.is_open() ? minute_acc_.start_ms
+                     : has_latest ? minute_file_.at(minute_file_.size() - 1).start_ms : 0;
+    if (has_latest && start + CLOCK_JUMP_THRESHOLD_MS < latest) restart_after_clock_jump(start, latest);
+    if (minute_acc_.is_open() && start > minute_acc_.start_ms) seal_minute();
+    if (!minute_acc_.is_open()) {
+        if (minute_file_.size() > 0 && start <= minute_file_.at(minute_file_.size() - 1).start_ms) {
+            dropped_samples_++;
+            return;
+        }
+        minute_acc_.reset(start);
+    }
+    minute_acc_.add_sample(record);
+}
+
+// 回拨之前的桶按错误的时钟记录，留着会让之后的桶因不再递增而追加失败（重启后则是样本全部丢弃），
+// 直到时钟追上为止。未封口的桶同样落在错误的时间段内，直接丢弃
+void MetricsRollup::restart_after_clock_jump(long long minute_start, long long latest_start) {
+    minute_acc_.start_ms = -1;
+    quarter_acc_.start_ms = -1;
+    size_t minutes = minute_file_.truncate_from(minute_start);
+    size_t quarters = quarter_file_.truncate_from(bucket_floor(minute_start, QUARTER_HOUR_MS));
+    restore_quarter();
+    clock_jumps_++;
+    LOGW("Wall clock jumped back %llds, truncated %zu 1m and %zu 15m rollup buckets.",
+         (latest_start - minute_start) / 1000, minutes, quarters);
+}
+
+void MetricsRollup::seal_minute() {
+    RollupBucket minute = minute_acc_.seal();
+    minute_acc_.start_ms = -1;
+    if (!minute_file_.append(minute)) LOGW("Failed to append 1m rollup bucket %lld.", static_cast<long long>(minute.start_ms));
+
+    long long quarter_start = bucket_floor(minute.start_ms, QUARTER_HOUR_MS);
+    if (quarter_acc_.is_open() && quarter_start > quarter_acc_.start_ms) {
+        RollupBucket quarter = quarter_acc_.seal();
+        quarter_acc_.start_ms = -1;
+        if (!quarter_file_.append(quarter)) LOGW("Failed to append 15m rollup bucket %lld.", static_cast<long long>(quarter.start_ms));
+    }
+    if (!quarter_acc_.is_open()) {
+        if (quarter_file_.size() > 0 && quarter_start <= quarter_file_.at(quarter_file_.size() - 1).start_ms) return;
+        quarter_acc_.reset(quarter_start);
+    }
+    quarter_acc_.merge(minute);
+}
+
+RollupResolution MetricsRollup::choose_resolution(long long since_ms, long long now_ms, long long raw_oldest_ms) {
+    long long span = now_ms - since_ms;
+    // 重启后原始环还没填满时，改用持久化的 1 分钟桶
+    if (span <= RAW_SPAN_MS && raw_oldest_ms <= since_ms + MINUTE_MS) return RollupResolution::RAW;
+    if (span <= static_cast<long long>(MINUTE_RETENTION) * MINUTE_MS) return RollupResolution::MINUTE;
+    return RollupResolution::QUARTER_HOUR;
+}
+
+const char* MetricsRollup::resolution_name(RollupResolution resolution) {
+    switch (resolution) {
+        case RollupResolution::RAW: return "raw";
+        case RollupResolution::MINUTE: return "1m";
+        case RollupResolution::QUARTER_HOUR: return "15m";
+        default: return "auto";
+    }
+}
+
+long long MetricsRollup::resolution_ms(RollupResolution resolution) {
+    switch (resolution) {
+        case RollupResolution::RAW: return RAW_INTERVAL_MS;
+        case RollupResolution::MINUTE: return MINUTE_MS;
+        case RollupResolution::QUARTER_HOUR: return QUARTER_HOUR_MS;
+        default: return 0;
+    }
+}
+
+const RollupFile& MetricsRollup::file_for(RollupResolution resolution) const {
+    return resolution == RollupResolution::QUARTER_HOUR ? quarter_file_ : minute_file_;
+}
+
+const RollupAccumulator& MetricsRollup::accumulator_for(RollupResolution resolution) const {
+    return resolution == RollupResolution::QUARTER_HOUR ? quarter_acc_ : minute_acc_;
+}
+
+static void write_stat(JsonWriter& writer, std::string_view name, const RollupStat& stat) {
+    writer.key(name);
+    if (stat.count == 0) {
+        writer.null_value();
+        return;
+    }
+    writer.begin_object().field("avg", stat.avg).field("max", stat.max).field("min", stat.min).end_object();
+}
+
+// 键按字典序写出
+static void write_bucket(JsonWriter& writer, const RollupBucket& bucket) {
+    double samples = std::max<uint32_t>(bucket.sample_count, 1);
+    writer.begin_object();
+    write_stat(writer, "battery_level", bucket.stats[ROLLUP_BATTERY_LEVEL]);
+    write_stat(writer, "battery_power_watt", bucket.stats[ROLLUP_BATTERY_POWER]);
+    write_stat(writer, "battery_temp_celsius", bucket.stats[ROLLUP_BATTERY_TEMP]);
+    writer.field("charging_ratio", bucket.charging_samples / samples);
+    write_stat(writer, "cpu_usage_percent", bucket.stats[ROLLUP_CPU_USAGE]);
+    write_stat(writer, "mem_available_kb", bucket.stats[ROLLUP_MEM_AVAILABLE_KB]);
+    writer.field("samples", bucket.sample_count)
+          .field("screen_on_ratio", bucket.screen_on_samples / samples);
+    write_stat(writer, "swap_used_kb", bucket.stats[ROLLUP_SWAP_USED_KB]);
+    writer.field("timestamp", static_cast<long long>(bucket.start_ms)).end_object();
+}
+
+void MetricsRollup::write_buckets(JsonWriter& writer, RollupResolution resolution, long long since_ms) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const RollupFile& file = file_for(resolution);
+    const RollupAccumulator& open_bucket = accumulator_for(resolution);
+    writer.begin_array();
+    for (size_t i = file.lower_bound(since_ms); i < file.size(); ++i) write_bucket(writer, file.at(i));
+    if (open_bucket.is_open() && open_bucket.samples > 0 && open_bucket.start_ms >= since_ms) write_bucket(writer, open_bucket.seal());
+    writer.end_array();
+}
+
+json MetricsRollup::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto file_stats = [](const RollupFile& file) {
+        const RollupFileStats& stats = file.stats();
+        return json{
+            {"buckets", file.size()}, {"appends", stats.appends}, {"compactions", stats.compactions},
+            {"recreated", stats.recreated}, {"used_backup_header", stats.used_backup_header}, {"dropped_buckets", stats.dropped_buckets},
+            {"truncated_buckets", stats.truncated_buckets}
+        };
+    };
+    return json{{"1m", file_stats(minute_file_)}, {"15m", file_stats(quarter_file_)}, {"dropped_samples", dropped_samples_},
+                {"clock_jumps", clock_jumps_}};
+}
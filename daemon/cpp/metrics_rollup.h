@@ -0,0 +1,207 @@
+// daemon/cpp/metrics_rollup.h
+#ifndef CERBERUS_METRICS_ROLLUP_H
+#define CERBERUS_METRICS_ROLLUP_H
+
+#include "json_writer.h"
+#include <nlohmann/json.hpp>
+#include <mutex>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+using json = nlohmann::json;
+
+struct MetricsRecord;
+
+// 持久化的降采样历史：原始样本只在 TimeSeriesDatabase 的环里保留约 30 分钟，
+// 这里把它们汇总为 1 分钟桶（保留 24 小时）与 15 分钟桶（保留 30 天），每个指标记录 min/max/avg。
+//
+// 每个分辨率一个文件，以 MAP_SHARED 映射，布局（小端，偏移单位为字节）：
+//   [0,   64)   头部副本 0
+//   [64,  128)  头部副本 1
+//   [128, ...)  capacity 个 128 字节的 RollupBucket，按 start_ms 严格递增顺序追加，写入后不再修改
+// 追加时先写桶并 msync，再把 generation + 1 的头部写进另一个副本并 msync。两个副本各带校验和，
+// 打开时取校验通过且 generation 最大的一份，其 count 之后的桶（追加到一半）忽略。
+// 文件写满 capacity = 2 × retention 个桶后，把最新的 retention 个写入临时文件再 rename 替换
+namespace metrics_rollup_layout {
+constexpr uint32_t MAGIC = 0x4D524C43;  // "CLRM"
+constexpr uint16_t VERSION = 1;
+constexpr uint32_t HEADER_SLOT_SIZE = 64;
+constexpr uint32_t HEADER_SIZE = 2 * HEADER_SLOT_SIZE;
+constexpr uint32_t BUCKET_SIZE = 128;
+} // namespace metrics_rollup_layout
+
+enum RollupMetric : uint8_t {
+    ROLLUP_CPU_USAGE = 0,
+    ROLLUP_MEM_AVAILABLE_KB,
+    ROLLUP_SWAP_USED_KB,
+    ROLLUP_BATTERY_LEVEL,       // 电量未知（-1）的样本不计入
+    ROLLUP_BATTERY_TEMP,
+    ROLLUP_BATTERY_POWER,
+    ROLLUP_METRIC_COUNT
+};
+
+enum class RollupResolution : uint8_t { AUTO, RAW, MINUTE, QUARTER_HOUR };
+
+struct RollupStat {
+    float min;
+    float max;
+    float avg;
+    uint32_t count;             // 0 表示桶内没有该指标的样本
+};
+
+struct RollupBucket {
+    int64_t start_ms;
+    uint32_t sample_count;
+    uint32_t charging_samples;
+    uint32_t screen_on_samples;
+    uint32_t checksum;          // 覆盖除本字段外的全部内容
+    RollupStat stats[ROLLUP_METRIC_COUNT];
+    uint8_t reserved[8];
+};
+static_assert(sizeof(RollupBucket) == metrics_rollup_layout::BUCKET_SIZE, "bucket layout changed");
+
+struct RollupFileHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t bucket_size;
+    uint32_t resolution_ms;
+    uint32_t capacity;
+    uint64_t generation;        // 每次提交加一，两个副本交替写入
+    uint64_t count;             // 已提交的桶数
+    uint32_t checksum;          // 覆盖之前的字段
+    uint8_t reserved[28];
+};
+static_assert(sizeof(RollupFileHeader) == metrics_rollup_layout::HEADER_SLOT_SIZE, "header layout changed");
+
+// 打开文件时的修复情况与运行期计数
+struct RollupFileStats {
+    uint64_t appends = 0;
+    uint64_t compactions = 0;
+    bool recreated = false;             // 文件不存在、不可识别或参数不同而重建
+    bool used_backup_header = false;    // 较新的头部副本损坏，回退到另一份
+    size_t dropped_buckets = 0;         // 已提交但校验失败或顺序错误而截掉的桶
+    size_t truncated_buckets = 0;       // 墙钟回拨后被 truncate_from 截掉的桶
+};
+
+// 单个分辨率的追加文件
+class RollupFile {
+public:
+    RollupFile() = default;
+    ~RollupFile();
+
+    RollupFile(const RollupFile&) = delete;
+    RollupFile& operator=(const RollupFile&) = delete;
+
+    bool open(const std::string& path, uint32_t resolution_ms, uint32_t retention);
+    void close();
+    bool is_open() const { return base_ != nullptr; }
+
+    // bucket.start_ms 必须大于最后一个桶；校验和由这里填写
+    bool append(const RollupBucket& bucket);
+    size_t size() const { return count_; }
+    const RollupBucket& at(size_t i) const { return buckets()[i]; }
+    // 第一个 start_ms >= since_ms 的桶
+    size_t lower_bound(long long since_ms) const;
+    // 截掉 start_ms >= since_ms 的桶，返回截掉的个数
+    size_t truncate_from(long long since_ms);
+    uint32_t resolution_ms() const { return resolution_ms_; }
+    const RollupFileStats& stats() const { return stats_; }
+
+    static uint32_t bucket_checksum(const RollupBucket& bucket);
+
+private:
+    const RollupBucket* buckets() const;
+    bool create(uint64_t generation, const RollupBucket* keep, size_t keep_count);
+    bool map_existing();
+    bool commit(size_t count);
+    bool compact();
+
+    std::string path_;
+    int fd_ = -1;
+    uint8_t* base_ = nullptr;
+    size_t mapping_size_ = 0;
+    uint32_t resolution_ms_ = 0;
+    uint32_t retention_ = 0;
+    uint32_t capacity_ = 0;
+    uint64_t generation_ = 0;
+    size_t count_ = 0;
+    RollupFileStats stats_;
+};
+
+// 正在汇总中的桶，用 double 累加，封口时转成 RollupBucket
+struct RollupAccumulator {
+    long long start_ms = -1;    // -1 表示没有打开的桶
+    uint32_t samples = 0;
+    uint32_t charging = 0;
+    uint32_t screen_on = 0;
+    struct Stat {
+        double min;
+        double max;
+        double sum;
+        uint32_t count;
+    } stats[ROLLUP_METRIC_COUNT];
+
+    bool is_open() const { return start_ms >= 0; }
+    void reset(long long bucket_start_ms);
+    void add_sample(const MetricsRecord& record);
+    // 合并一个更细粒度的桶，avg 按样本数加权
+    void merge(const RollupBucket& bucket);
+    RollupBucket seal() const;
+};
+
+class MetricsRollup {
+public:
+    static constexpr long long RAW_INTERVAL_MS = 2000;
+    static constexpr long long RAW_SPAN_MS = 30LL * 60 * 1000;
+    static constexpr long long MINUTE_MS = 60LL * 1000;
+    static constexpr long long QUARTER_HOUR_MS = 15 * MINUTE_MS;
+    static constexpr uint32_t MINUTE_RETENTION = 24 * 60;
+    static constexpr uint32_t QUARTER_HOUR_RETENTION = 30 * 24 * 4;
+    // 墙钟回拨超过这个时长视为时钟被校正（开机时 RTC 超前、之后由 NTP 拨回），而不是样本乱序
+    static constexpr long long CLOCK_JUMP_THRESHOLD_MS = QUARTER_HOUR_MS;
+
+    MetricsRollup() = default;
+    MetricsRollup(const MetricsRollup&) = delete;
+    MetricsRollup& operator=(const MetricsRollup&) = delete;
+
+    // 打开 dir 下两个分辨率的文件，并由已持久化的 1 分钟桶恢复尚未封口的 15 分钟桶。
+    // 未封口的 1 分钟桶只在内存中，重启时丢失（至多 1 分钟）
+    bool open(const std::string& dir);
+    void close();
+    bool is_open() const;
+
+    // 样本按 timestamp_ms 归入桶；早于当前桶的样本（小幅时钟回拨）并入当前桶，
+    // 重启后早于最后一个已持久化桶的样本丢弃。
+    // 比最新的桶早 CLOCK_JUMP_THRESHOLD_MS 以上时视为时钟被校正：丢弃未封口的桶，
+    // 截掉文件中不早于新时间的桶，从新时间重新开始汇总
+    void add_sample(const MetricsRecord& record);
+
+    // 按查询跨度自动选择：30 分钟以内且原始环覆盖 since 时用原始样本，24 小时以内用 1 分钟桶，否则用 15 分钟桶。
+    // raw_oldest_ms 为原始环中最旧样本的时间戳，环为空时传 LLONG_MAX
+    static RollupResolution choose_resolution(long long since_ms, long long now_ms, long long raw_oldest_ms);
+    static const char* resolution_name(RollupResolution resolution);
+    static long long resolution_ms(RollupResolution resolution);
+
+    // 写出 start_ms >= since_ms 的桶组成的 JSON 数组，末尾包含尚未封口的桶
+    void write_buckets(JsonWriter& writer, RollupResolution resolution, long long since_ms) const;
+    json stats() const;
+
+private:
+    void seal_minute();
+    // 由已持久化的 1 分钟桶恢复尚未封口的 15 分钟桶
+    void restore_quarter();
+    void restart_after_clock_jump(long long minute_start, long long latest_start);
+    const RollupFile& file_for(RollupResolution resolution) const;
+    const RollupAccumulator& accumulator_for(RollupResolution resolution) const;
+
+    mutable std::mutex mutex_;
+    RollupFile minute_file_;
+    RollupFile quarter_file_;
+    RollupAccumulator minute_acc_;
+    RollupAccumulator quarter_acc_;
+    uint64_t dropped_samples_ = 0;
+    uint64_t clock_jumps_ = 0;
+};
+
+#endif // CERBERUS_METRICS_ROLLUP_H
@@ -0,0 +1,83 @@
+// daemon/cpp/probe_config_stream.cpp
+#include "probe_config_stream.h"
+#include <algorithm>
+#include <iterator>
+
+// 把有序集合 next 相对 current 的差异写入 added/removed，返回是否有变化
+static bool diff_sets(const std::set<int>& current, const std::set<int>& next, json& added, json& removed) {
+    std::vector<int> plus, minus;
+    std::set_difference(next.begin(), next.end(), current.begin(), current.end(), std::back_inserter(plus));
+    std::set_difference(current.begin(), current.end(), next.begin(), next.end(), std::back_inserter(minus));
+    added = plus;
+    removed = minus;
+    return !plus.empty() || !minus.empty();
+}
+
+json ProbeConfigStream::advance(const StateSnapshot& snapshot) {
+    if (has_baseline_ && snapshot.version <= snapshot_version_) return nullptr;
+
+    json payload = json::object();
+    bool changed = false;
+
+    json master_config = master_config_to_json(snapshot.master_config);
+    if (master_config != master_config_) {
+        payload["master_config"] = master_config;
+        master_config_ = std::move(master_config);
+        changed = true;
+    }
+
+    if (snapshot.policies != policies_source_) {
+        std::map<PolicyKey, json> next;
+        json upserts = json::array();
+        if (snapshot.policies) {
+            for (const auto& config : *snapshot.policies) {
+                PolicyKey key{config.package_name, config.user_id};
+                json entry = app_config_to_json(config);
+                auto it = policies_.find(key);
+                if (it == policies_.end() || it->second != entry) upserts.push_back(entry);
+                next.emplace(std::move(key), std::move(entry));
+            }
+        }
+        json removes = json::array();
+        for (const auto& [key, entry] : policies_) {
+            if (next.count(key) == 0) removes.push_back({{"package_name", key.first}, {"user_id", key.second}});
+        }
+        if (!upserts.empty()) payload["policies_upsert"] = std::move(upserts);
+        if (!removes.empty()) payload["policies_removed"] = std::move(removes);
+        changed = changed || payload.contains("policies_upsert") || payload.contains("policies_removed");
+        policies_.swap(next);
+        policies_source_ = snapshot.policies;
+    }
+
+    std::set<int> frozen_uids(snapshot.frozen_uids.begin(), snapshot.frozen_uids.end());
+    json added, removed;
+    if (diff_sets(frozen_uids_, frozen_uids, added, removed)) {
+        payload["frozen_uids_added"] = std::move(added);
+        payload["frozen_uids_removed"] = std::move(removed);
+        frozen_uids_.swap(frozen_uids);
+        changed = true;
+    }
+    std::set<int> frozen_pids(snapshot.frozen_pids.begin(), snapshot.frozen_pids.end());
+    if (diff_sets(frozen_pids_, frozen_pids, added, removed)) {
+        payload["frozen_pids_added"] = std::move(added);
+        payload["frozen_pids_removed"] = std::move(removed);
+        frozen_pids_.swap(frozen_pids);
+        changed = true;
+    }
+
+    snapshot_version_ = snapshot.version;
+    bool first = !has_baseline_;
+    has_baseline_ = true;
+    // 首次建立基线时还没有任何探针持有旧状态，不必发出增量
+    if (!changed || first) return nullptr;
+
+    payload["prev_seq"] = seq_;
+    payload["seq"] = ++seq_;
+    return json{{"type", "stream.probe_config_delta"}, {"payload", std::move(payload)}};
+}
+
+json ProbeConfigStream::full_message(const StateSnapshot& snapshot) const {
+    json payload = build_probe_config_payload(&snapshot);
+    payload["config_seq"] = seq_;
+    return json{{"type", "resp.probe_init_data"}, {"payload", std::move(payload)}};
+}
@@ -0,0 +1,46 @@
+// daemon/cpp/probe_config_stream.h
+#ifndef CERBERUS_PROBE_CONFIG_STREAM_H
+#define CERBERUS_PROBE_CONFIG_STREAM_H
+
+#include <nlohmann/json.hpp>
+#include <string>
+#include <map>
+#include <set>
+#include <memory>
+#include <utility>
+#include <cstdint>
+#include "state_manager.h"
+
+using json = nlohmann::json;
+
+// 探针配置的增量协议：
+//   握手 (event.probe_hello) 或 cmd.probe_resync 时下发 resp.probe_init_data，载荷带 config_seq；
+//   此后每次变化推送 stream.probe_config_delta {seq, prev_seq, ...}，只携带变化的应用策略与冻结集合差异。
+//   探针本地序号不等于 prev_seq 时说明中间有遗漏，应发送 cmd.probe_resync 重新获取全量。
+// 增量内容均为“最终状态”（upsert / 加入 / 移除），重复应用同一条是幂等的。
+//
+// 所有探针连接共享同一条基线与序号；本类不加锁，由调用方串行化推进与全量构建，
+// 以保证全量与其后的增量在每个连接上按序入队。
+class ProbeConfigStream {
+public:
+    // 把基线推进到该快照；有变化时返回分配了新序号的增量消息，否则返回 null
+    json advance(const StateSnapshot& snapshot);
+    // 以基线所在的快照构建全量应答，调用前应先以同一快照 advance()
+    json full_message(const StateSnapshot& snapshot) const;
+    uint64_t sequence() const { return seq_; }
+
+private:
+    using PolicyKey = std::pair<std::string, int>;
+
+    bool has_baseline_ = false;
+    uint64_t seq_ = 0;
+    uint64_t snapshot_version_ = 0;
+    json master_config_;
+    // 策略列表只在配置变化时重建，指针未变时跳过逐项比较
+    std::shared_ptr<const std::vector<AppConfig>> policies_source_;
+    std::map<PolicyKey, json> policies_;
+    std::set<int> frozen_uids_;
+    std::set<int> frozen_pids_;
+};
+
+#endif // CERBERUS_PROBE_CONFIG_STREAM_H
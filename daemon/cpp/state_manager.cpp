@@ -23,6 +23,8 @@
 namespace fs = std::filesystem;
 using json = nlohmann::json;
 const double NETWORK_THRESHOLD_KBPS = 500.0;
+// state_mutex_ 等待统计的汇报间隔
+constexpr auto STATE_LOCK_REPORT_INTERVAL = std::chrono::minutes(5);
 
 static std::string status_to_string(const AppRuntimeState& app, const MasterConfig& master_config) {
     if (app.current_status == AppRuntimeState::Status::STOPPED) return "未运行";
@@ -128,11 +130,18 @@ StateManager::StateManager(std::shared_ptr<DatabaseManager> db,
                            std::shared_ptr<TimeSeriesDatabase> ts_db,
                            std::shared_ptr<AdjMapper> adj_mapper,
                            std::shared_ptr<MemoryButler> mem_butler)
-    : db_manager_(db), sys_monitor_(sys), action_executor_(act), logger_(logger), ts_db_(ts_db), adj_mapper_(adj_mapper), memory_butler_(mem_butler) {
+    : db_manager_(db), sys_monitor_(sys), action_executor_(act), logger_(logger), ts_db_(ts_db), adj_mapper_(adj_mapper), memory_butler_(mem_butler),
+      initial_package_uid_map_(sys->get_all_installed_packages()),
+      apps_(initial_package_uid_map_.size()) {
     LOGI("StateManager Initializing...");
     unfrozen_timeline_.resize(3600 * 2, 0);
     master_config_ = db_manager_->get_master_config().value_or(MasterConfig{});
     doze_manager_ = std::make_unique<DozeManager>(logger_, action_executor_);
+    frozen_uid_bitmap_ = std::make_unique<FrozenUidBitmap>();
+    if (!frozen_uid_bitmap_->create()) {
+        LOGW("Frozen UID bitmap unavailable, probe will rely on the frozen_uids list.");
+        frozen_uid_bitmap_.reset();
+    }
     LOGI("Loaded master config: standard_timeout=%ds, timed_unfreeze_enabled=%d, timed_unfreeze_interval=%ds",
         master_config_.standard_timeout_sec, master_config_.is_timed_unfreeze_enabled, master_config_.timed_unfreeze_interval_sec);
 
@@ -473,10 +482,8 @@ StateManager::StateManager(std::shared_ptr<DatabaseManager> db,
         "org.protonaosp.deviceconfig.auto_generated_rro_product__"
       };
 
-    initial_package_uid_map_ = sys_monitor_->get_all_installed_packages();
-
     load_all_configs();
-    next_scan_iterator_ = managed_apps_.begin();
+    next_scan_slot_ = 0;
     last_battery_level_info_ = std::nullopt;
     LOGI("StateManager Initialized. Ready for warmup.");
 }
@@ -490,31 +497,35 @@ void StateManager::reload_adj_rules() {
 
 void StateManager::initial_full_scan_and_warmup() {
     LOGI("Starting initial full scan and data warmup...");
-    std::lock_guard<std::mutex> lock(state_mutex_);
+    std::unique_lock<RecordedMutex> lock(state_mutex_);
     reconcile_process_state_full();
     int warmed_up_count = 0;
-    for (auto& [key, app] : managed_apps_) {
+    for (auto& app : apps_) {
         if (!app.pids.empty()) {
-            sys_monitor_->update_app_stats(app.pids, app.mem_usage_kb, app.swap_usage_kb, app.cpu_usage_percent);
+            auto& display = apps_.display(app);
+            sys_monitor_->update_app_stats(app.pids, display.mem_usage_kb, display.swap_usage_kb, display.cpu_usage_percent);
             warmed_up_count++;
         }
     }
+    PendingSnapshot pending = capture_snapshot_nolock();
+    lock.unlock();
+    finish_snapshot(std::move(pending));
     LOGI("Warmup complete. Populated initial stats for %d running app instances.", warmed_up_count);
     logger_->log(LogLevel::EVENT, "Daemon", "启动预热完成，已填充初始数据");
 }
 
 bool StateManager::perform_staggered_stats_scan() {
-    std::lock_guard<std::mutex> lock(state_mutex_);
-    if (managed_apps_.empty()) return false;
+    std::lock_guard<RecordedMutex> lock(state_mutex_);
+    if (apps_.empty()) return false;
     const int APPS_PER_TICK = 2;
     for (int i = 0; i < APPS_PER_TICK; ++i) {
-        if (next_scan_iterator_ == managed_apps_.end()) next_scan_iterator_ = managed_apps_.begin();
-        if (next_scan_iterator_ == managed_apps_.end()) break;
-        auto& app = next_scan_iterator_->second;
+        if (next_scan_slot_ >= apps_.size()) next_scan_slot_ = 0;
+        auto& app = apps_[next_scan_slot_];
         if (!app.pids.empty()) {
-            sys_monitor_->update_app_stats(app.pids, app.mem_usage_kb, app.swap_usage_kb, app.cpu_usage_percent);
+            auto& display = apps_.display(app);
+            sys_monitor_->update_app_stats(app.pids, display.mem_usage_kb, display.swap_usage_kb, display.cpu_usage_percent);
         }
-        ++next_scan_iterator_;
+        ++next_scan_slot_;
     }
     return true;
 }
@@ -537,23 +548,26 @@ bool StateManager::handle_top_app_change_fast() {
 
 void StateManager::process_new_metrics(const MetricsRecord& record) {
     update_memory_health(record);
-    std::lock_guard<std::mutex> lock(state_mutex_);
+    report_state_lock_stats_if_due();
+    std::lock_guard<RecordedMutex> lock(state_mutex_);
     auto doze_event = doze_manager_->process_metrics(record);
     if (doze_event == DozeManager::DozeEvent::ENTERED_DEEP_DOZE) {
         doze_start_process_info_.clear();
-        for (const auto& [key, app] : managed_apps_) {
+        for (const auto& app : apps_) {
             for (int pid : app.pids) {
                 doze_start_process_info_[pid] = {
                     .start_jiffies = sys_monitor_->get_total_cpu_jiffies_for_pids({pid}),
                     .process_name = sys_monitor_->get_app_name_from_pid(pid),
-                    .package_name = app.package_name,
+                    .package_name = apps_.package_name(app),
                     .user_id = app.user_id
                 };
             }
         }
+        broadcast_doze_event(true);
     } else if (doze_event == DozeManager::DozeEvent::EXITED_DEEP_DOZE) {
         generate_doze_exit_report();
         doze_start_process_info_.clear();
+        broadcast_doze_event(false);
     }
     if (last_metrics_record_) {
         handle_charging_state_change(*last_metrics_record_, record);
@@ -562,6 +576,17 @@ void StateManager::process_new_metrics(const MetricsRecord& record) {
     last_metrics_record_ = record;
 }
 
+void StateManager::report_state_lock_stats_if_due() {
+    auto now = std::chrono::steady_clock::now();
+    if (now - last_lock_report_time_ < STATE_LOCK_REPORT_INTERVAL) return;
+    last_lock_report_time_ = now;
+    RecordedMutex::Stats stats = state_mutex_.get_stats();
+    double avg_wait_us = stats.contended > 0 ? static_cast<double>(stats.total_wait_us) / stats.contended : 0.0;
+    LOGI("[state_mutex_] acquisitions=%llu contended=%llu avg_wait=%.0fus max_wait=%lluus",
+         static_cast<unsigned long long>(stats.acquisitions), static_cast<unsigned long long>(stats.contended),
+         avg_wait_us, static_cast<unsigned long long>(stats.max_wait_us));
+}
+
 void StateManager::update_memory_health(const MetricsRecord& record) {
     if (record.mem_total_kb <= 0) return;
     double available_mem_percent = 100.0 * static_cast<double>(record.mem_available_kb) / record.mem_total_kb;
@@ -591,10 +616,10 @@ void StateManager::run_memory_butler_tasks() {
     logger_->log(LogLevel::WARN, "内存管家", "可用内存严重不足，启动内存整理流程");
     std::vector<std::tuple<AppInstanceKey, time_t, std::vector<int>>> candidates;
     {
-        std::lock_guard<std::mutex> lock(state_mutex_);
-        for (const auto& [key, app] : managed_apps_) {
+        std::lock_guard<RecordedMutex> lock(state_mutex_);
+        for (const auto& app : apps_) {
             if (!app.is_foreground && !app.pids.empty() && app.background_since > 0) {
-                candidates.emplace_back(key, app.background_since, app.pids);
+                candidates.emplace_back(apps_.key_of(app), app.background_since, app.pids);
             }
         }
     }
@@ -661,8 +686,8 @@ void StateManager::generate_doze_exit_report() {
             if (cpu_seconds > 0.01) {
                 AppInstanceKey key = {base_package_name, start_record.user_id};
                 if (grouped_activities.find(key) == grouped_activities.end()) {
-                    auto it = managed_apps_.find(key);
-                    grouped_activities[key].app_name = (it != managed_apps_.end() && !it->second.app_name.empty()) ? it->second.app_name : key.first;
+                    AppSlot slot = apps_.find(key);
+                    grouped_activities[key].app_name = (slot != INVALID_APP_SLOT && !apps_.display(slot).app_name.empty()) ? apps_.display(slot).app_name : key.first;
                     grouped_activities[key].package_name = key.first;
                     grouped_activities[key].user_id = key.second;
                 }
@@ -736,9 +761,9 @@ bool StateManager::unfreeze_and_observe_nolock(AppRuntimeState& app, const std::
     cancel_timed_unfreeze(app);
     if (app.current_status == AppRuntimeState::Status::FROZEN) {
         std::string msg = "因 " + reason + " 而解冻";
-        logger_->log(LogLevel::ACTION_UNFREEZE, "解冻", msg, app.package_name, app.user_id);
+        logger_->log(LogLevel::ACTION_UNFREEZE, "解冻", msg, apps_.package_name(app), app.user_id);
         
-        action_executor_->unfreeze({app.package_name, app.user_id}, app.pids);
+        action_executor_->unfreeze({apps_.package_name(app), app.user_id}, app.pids);
         
         app.current_status = AppRuntimeState::Status::RUNNING;
         app.freeze_method = AppRuntimeState::FreezeMethod::NONE;
@@ -759,7 +784,7 @@ bool StateManager::unfreeze_and_observe_nolock(AppRuntimeState& app, const std::
             case WakeupPolicy::UNFREEZE_UNTIL_BACKGROUND:
                 app.observation_since = 0;
                 app.background_since = 0;
-                LOGI("Smart Unfreeze: %s un-frozen by policy until next background event.", app.package_name.c_str());
+                LOGI("Smart Unfreeze: %s un-frozen by policy until next background event.", apps_.package_name(app).c_str());
                 return true;
             default:
                 observation_seconds = 10;
@@ -767,14 +792,14 @@ bool StateManager::unfreeze_and_observe_nolock(AppRuntimeState& app, const std::
         }
         if (observation_seconds > 0) {
             app.observation_since = now - (10 - observation_seconds);
-            LOGI("Smart Unfreeze: %s gets %ds observation for %s.", app.package_name.c_str(), observation_seconds, reason.c_str());
+            LOGI("Smart Unfreeze: %s gets %ds observation for %s.", apps_.package_name(app).c_str(), observation_seconds, reason.c_str());
         }
         app.background_since = 0;
         app.freeze_retry_count = 0;
         return true;
     } else {
         LOGD("UNFREEZE [%s]: Request for %s ignored. Reason: App not frozen (current state: %d).",
-            reason.c_str(), app.package_name.c_str(), static_cast<int>(app.current_status));
+            reason.c_str(), apps_.package_name(app).c_str(), static_cast<int>(app.current_status));
         return false;
     }
 }
@@ -816,18 +841,18 @@ void StateManager::handle_process_death(int pid, const std::string& reason) {
     bool state_changed = false;
     AppRuntimeState* app = nullptr;
     {
-        std::lock_guard<std::mutex> lock(state_mutex_);
-        auto it = pid_to_app_map_.find(pid);
-        if (it == pid_to_app_map_.end()) {
+        std::lock_guard<RecordedMutex> lock(state_mutex_);
+        AppSlot slot = apps_.find_by_pid(pid);
+        if (slot == INVALID_APP_SLOT) {
             LOGI("Process Death: PID %d not found in our records. Ignoring.", pid);
             return;
         }
-        app = it->second;
-        logger_->log(LogLevel::WARN, "进程消亡", "进程 " + std::to_string(pid) + " 已消亡，原因: " + reason, app->package_name, app->user_id);
+        app = &apps_[slot];
+        logger_->log(LogLevel::WARN, "进程消亡", "进程 " + std::to_string(pid) + " 已消亡，原因: " + reason, apps_.package_name(*app), app->user_id);
         action_executor_->remove_oom_protection_records(pid);
         remove_pid_from_app(pid);
         if (app->pids.empty()) {
-            LOGI("Process Death: App %s has no more active PIDs. Marking as STOPPED.", app->package_name.c_str());
+            LOGI("Process Death: App %s has no more active PIDs. Marking as STOPPED.", apps_.package_name(*app).c_str());
             app->current_status = AppRuntimeState::Status::STOPPED;
             app->freeze_method = AppRuntimeState::FreezeMethod::NONE;
             app->background_since = 0;
@@ -837,6 +862,7 @@ void StateManager::handle_process_death(int pid, const std::string& reason) {
         state_changed = true;
     }
     if (state_changed) {
+        publish_snapshot();
         broadcast_dashboard_update();
         notify_probe_of_config_change();
     }
@@ -852,10 +878,10 @@ void StateManager::on_signal_from_rekernel(const ReKernelSignalEvent& event) {
     }
     bool state_changed = false;
     {
-        std::lock_guard<std::mutex> lock(state_mutex_);
-        auto it = pid_to_app_map_.find(event.dest_pid);
-        if (it != pid_to_app_map_.end()) {
-            AppRuntimeState* app = it->second;
+        std::lock_guard<RecordedMutex> lock(state_mutex_);
+        AppSlot slot = apps_.find_by_pid(event.dest_pid);
+        if (slot != INVALID_APP_SLOT) {
+            AppRuntimeState* app = &apps_[slot];
             if (app && app->current_status == AppRuntimeState::Status::FROZEN) {
                 WakeupPolicy policy = decide_wakeup_policy_for_kernel(event);
                 if (policy == WakeupPolicy::IGNORE) return;
@@ -864,7 +890,7 @@ void StateManager::on_signal_from_rekernel(const ReKernelSignalEvent& event) {
                 else app->wakeup_count_in_window++;
                 app->last_wakeup_timestamp = now;
                 if (app->wakeup_count_in_window > 5) {
-                    LOGW("Throttling: Kernel SIGNAL for %s ignored. Triggered %d times in last 60s.", app->package_name.c_str(), app->wakeup_count_in_window);
+                    LOGW("Throttling: Kernel SIGNAL for %s ignored. Triggered %d times in last 60s.", apps_.package_name(*app).c_str(), app->wakeup_count_in_window);
                     return;
                 }
                 std::stringstream reason_ss;
@@ -876,6 +902,7 @@ void StateManager::on_signal_from_rekernel(const ReKernelSignalEvent& event) {
         }
     }
     if (state_changed) {
+        publish_snapshot();
         broadcast_dashboard_update();
         notify_probe_of_config_change();
     }
@@ -884,14 +911,14 @@ void StateManager::on_signal_from_rekernel(const ReKernelSignalEvent& event) {
 void StateManager::on_binder_from_rekernel(const ReKernelBinderEvent& event) {
     bool state_changed = false;
     {
-        std::lock_guard<std::mutex> lock(state_mutex_);
-        auto it = pid_to_app_map_.find(event.target_pid);
-        if (it != pid_to_app_map_.end()) {
-            AppRuntimeState* app = it->second;
+        std::lock_guard<RecordedMutex> lock(state_mutex_);
+        AppSlot slot = apps_.find_by_pid(event.target_pid);
+        if (slot != INVALID_APP_SLOT) {
+            AppRuntimeState* app = &apps_[slot];
             if (app && app->current_status == AppRuntimeState::Status::FROZEN) {
                 const time_t now = time(nullptr);
                 if (now - app->last_successful_wakeup_timestamp <= 2) {
-                    LOGD("Debounce: Ignoring kernel BINDER for %s, likely part of recent wakeup burst.", app->package_name.c_str());
+                    LOGD("Debounce: Ignoring kernel BINDER for %s, likely part of recent wakeup burst.", apps_.package_name(*app).c_str());
                     return;
                 }
                 WakeupPolicy policy = decide_wakeup_policy_for_kernel(event);
@@ -900,13 +927,13 @@ void StateManager::on_binder_from_rekernel(const ReKernelBinderEvent& event) {
                 else app->wakeup_count_in_window++;
                 app->last_wakeup_timestamp = now;
                 if (app->wakeup_count_in_window > 10) {
-                    LOGW("Throttling: Whitelisted Kernel BINDER for %s ignored. Triggered %d times in last 60s.", app->package_name.c_str(), app->wakeup_count_in_window);
-                    logger_->log(LogLevel::WARN, "节流阀", "白名单Binder唤醒过于频繁，已临时忽略", app->package_name, app->user_id);
+                    LOGW("Throttling: Whitelisted Kernel BINDER for %s ignored. Triggered %d times in last 60s.", apps_.package_name(*app).c_str(), app->wakeup_count_in_window);
+                    logger_->log(LogLevel::WARN, "节流阀", "白名单Binder唤醒过于频繁，已临时忽略", apps_.package_name(*app), app->user_id);
                     return;
                 }
                 std::stringstream reason_ss;
                 reason_ss << "白名单内核Binder (RPC:" << (event.rpc_name.empty() ? "N/A" : event.rpc_name) << ", Code:" << event.code << ")";
-                logger_->log(LogLevel::INFO, "内核事件", reason_ss.str(), app->package_name, app->user_id);
+                logger_->log(LogLevel::INFO, "内核事件", reason_ss.str(), apps_.package_name(*app), app->user_id);
                 if (unfreeze_and_observe_nolock(*app, "Whitelisted Kernel Binder", policy)) {
                     app->last_successful_wakeup_timestamp = now;
                     state_changed = true;
@@ -915,58 +942,93 @@ void StateManager::on_binder_from_rekernel(const ReKernelBinderEvent& event) {
         }
     }
     if (state_changed) {
+        publish_snapshot();
         broadcast_dashboard_update();
         notify_probe_of_config_change();
     }
 }
 
-void StateManager::on_wakeup_request_from_probe(const json& payload) {
+bool StateManager::handle_probe_wakeup_nolock(int uid, int event_type_int) {
+    WakeupPolicy event_type = WakeupPolicy::STANDARD_OBSERVATION;
+    if (event_type_int == 0) event_type = WakeupPolicy::FROM_NOTIFICATION;
+    else if (event_type_int == 1) event_type = WakeupPolicy::FROM_FCM;
+    LOGD("Received wakeup request from probe for UID: %d, Type: %d", uid, event_type_int);
+    AppSlot slot = apps_.find_by_uid(uid);
+    if (slot == INVALID_APP_SLOT) {
+        LOGW("Wakeup request for unknown UID: %d", uid);
+        return false;
+    }
+    AppRuntimeState* target_app = &apps_[slot];
+    const time_t now = time(nullptr);
+    if (now - target_app->last_wakeup_timestamp > 60) target_app->wakeup_count_in_window = 1;
+    else target_app->wakeup_count_in_window++;
+    target_app->last_wakeup_timestamp = now;
+    if (target_app->wakeup_count_in_window > 10) {
+        LOGW("Throttling: Probe wakeup for %s ignored. Triggered %d times in last 60s.", apps_.package_name(*target_app).c_str(), target_app->wakeup_count_in_window);
+        logger_->log(LogLevel::WARN, "节流阀", "Probe唤醒过于频繁，已临时忽略", apps_.package_name(*target_app), target_app->user_id);
+        return false;
+    }
+    WakeupPolicy policy = decide_wakeup_policy_for_probe(event_type);
+    return unfreeze_and_observe_nolock(*target_app, "Probe Request", policy);
+}
+
+bool StateManager::handle_proactive_unfreeze_nolock(const std::string& package_name, int user_id) {
+    LOGD("PROACTIVE: Received unfreeze request for %s (user %d)", package_name.c_str(), user_id);
+    AppSlot slot = apps_.find(package_name, user_id);
+    if (slot == INVALID_APP_SLOT || apps_[slot].current_status != AppRuntimeState::Status::FROZEN) return false;
+    return unfreeze_and_observe_nolock(apps_[slot], "PROACTIVE_START", WakeupPolicy::FROM_PROBE_START);
+}
+
+void StateManager::on_probe_event_batch(const std::vector<ProbeEvent>& events) {
     bool state_changed = false;
-    try {
-        int uid = payload.value("uid", -1);
-        if (uid < 0) return;
-        auto event_type_int = payload.value("type_int", 3);
-        WakeupPolicy event_type = WakeupPolicy::STANDARD_OBSERVATION;
-        if (event_type_int == 0) event_type = WakeupPolicy::FROM_NOTIFICATION;
-        else if (event_type_int == 1) event_type = WakeupPolicy::FROM_FCM;
-        LOGD("Received wakeup request from probe for UID: %d, Type: %d", uid, event_type_int);
-        std::lock_guard<std::mutex> lock(state_mutex_);
-        AppRuntimeState* target_app = nullptr;
-        for (auto& [key, app] : managed_apps_) {
-            if (app.uid == uid) {
-                target_app = &app;
-                break;
-            }
-        }
-        if (target_app) {
-            const time_t now = time(nullptr);
-            if (now - target_app->last_wakeup_timestamp > 60) target_app->wakeup_count_in_window = 1;
-            else target_app->wakeup_count_in_window++;
-            target_app->last_wakeup_timestamp = now;
-            if (target_app->wakeup_count_in_window > 10) {
-                LOGW("Throttling: Probe wakeup for %s ignored. Triggered %d times in last 60s.", target_app->package_name.c_str(), target_app->wakeup_count_in_window);
-                logger_->log(LogLevel::WARN, "节流阀", "Probe唤醒过于频繁，已临时忽略", target_app->package_name, target_app->user_id);
-                return;
-            }
-            WakeupPolicy policy = decide_wakeup_policy_for_probe(event_type);
-            if (unfreeze_and_observe_nolock(*target_app, "Probe Request", policy)) {
-                state_changed = true;
+    bool refresh_top_app = false;
+    PendingSnapshot pending;
+    {
+        std::lock_guard<RecordedMutex> lock(state_mutex_);
+        for (const auto& event : events) {
+            switch (event.kind) {
+                case ProbeEvent::Kind::FOREGROUND:
+                case ProbeEvent::Kind::BACKGROUND:
+                    // 与单条事件一致：前后台切换只发放一次前台刷新票据，由主循环统一核对
+                    if (!event.package_name.empty()) refresh_top_app = true;
+                    break;
+                case ProbeEvent::Kind::WAKEUP:
+                    if (event.uid >= 0 && handle_probe_wakeup_nolock(event.uid, event.arg)) state_changed = true;
+                    break;
+                case ProbeEvent::Kind::PROACTIVE_START:
+                    if (!event.package_name.empty() && handle_proactive_unfreeze_nolock(event.package_name, event.user_id)) {
+                        state_changed = true;
+                    }
+                    break;
             }
-        } else {
-            LOGW("Wakeup request for unknown UID: %d", uid);
         }
-    } catch (const json::exception& e) {
-        LOGE("Error processing wakeup request from probe: %s", e.what());
+        if (state_changed) pending = capture_snapshot_nolock();
+    }
+    if (refresh_top_app) g_top_app_refresh_tickets = 1;
+    if (state_changed) {
+        finish_snapshot(std::move(pending));
+        broadcast_dashboard_update();
+        notify_probe_of_config_change();
+    }
+}
+
+void StateManager::on_wakeup_request_from_probe(int uid, int type_int) {
+    if (uid < 0) return;
+    bool state_changed = false;
+    {
+        std::lock_guard<RecordedMutex> lock(state_mutex_);
+        state_changed = handle_probe_wakeup_nolock(uid, type_int);
     }
     if (state_changed) {
+        publish_snapshot();
         broadcast_dashboard_update();
         notify_probe_of_config_change();
     }
 }
 
 void StateManager::audit_app_structures(const std::map<int, ProcessInfo>& process_tree) {
-    std::lock_guard<std::mutex> lock(state_mutex_);
-    for(auto& [key, app] : managed_apps_) {
+    std::lock_guard<RecordedMutex> lock(state_mutex_);
+    for(auto& app : apps_) {
         app.has_rogue_structure = false;
         app.rogue_puppet_pid = -1;
         app.rogue_master_pid = -1;
@@ -977,14 +1039,14 @@ void StateManager::audit_app_structures(const std::map<int, ProcessInfo>& proces
             const auto& child_info = it_pid->second;
             if (child_info.oom_score_adj <= 0) {
                 auto it_ppid = process_tree.find(child_info.ppid);
-                if (it_ppid != process_tree.end() && it_ppid->second.pkg_name == app.package_name) {
+                if (it_ppid != process_tree.end() && it_ppid->second.pkg_name == apps_.package_name(app)) {
                     const auto& parent_info = it_ppid->second;
                     if (parent_info.oom_score_adj > 200) {
                         if (!app.has_logged_rogue_warning) {
                             LOGW("AUDIT: Rogue structure detected in %s! Puppet: pid=%d (adj=%d), Master: pid=%d (adj=%d)",
-                                app.package_name.c_str(), child_info.pid, child_info.oom_score_adj,
+                                apps_.package_name(app).c_str(), child_info.pid, child_info.oom_score_adj,
                                 parent_info.pid, parent_info.oom_score_adj);
-                            logger_->log(LogLevel::WARN, "审计", "检测到流氓进程结构", app.package_name, app.user_id);
+                            logger_->log(LogLevel::WARN, "审计", "检测到流氓进程结构", apps_.package_name(app), app.user_id);
                             app.has_logged_rogue_warning = true;
                         }
                         app.has_rogue_structure = true;
@@ -1002,7 +1064,7 @@ bool StateManager::update_foreground_state(const std::set<AppInstanceKey>& visib
     bool state_has_changed = false;
     bool probe_config_needs_update = false;
     {
-        std::lock_guard<std::mutex> lock(state_mutex_);
+        std::lock_guard<RecordedMutex> lock(state_mutex_);
         if (visible_app_keys == last_known_visible_app_keys_) {
             return false;
         }
@@ -1012,21 +1074,26 @@ bool StateManager::update_foreground_state(const std::set<AppInstanceKey>& visib
             last_known_visible_app_keys_.insert({current_ime_pkg, 0});
         }
         std::set<AppInstanceKey> prev_foreground_keys;
-        for (const auto& [key, app] : managed_apps_) {
-            if (app.is_foreground) prev_foreground_keys.insert(key);
+        for (const auto& app : apps_) {
+            if (app.is_foreground) prev_foreground_keys.insert(apps_.key_of(app));
         }
         const auto& final_foreground_keys = last_known_visible_app_keys_;
+        std::vector<bool> is_final_foreground(apps_.size(), false);
+        for (const auto& key : final_foreground_keys) {
+            AppSlot slot = apps_.find(key);
+            if (slot != INVALID_APP_SLOT) is_final_foreground[slot] = true;
+        }
         time_t now = time(nullptr);
-        for (auto& [key, app] : managed_apps_) {
-            bool is_now_foreground = final_foreground_keys.count(key);
+        for (auto& app : apps_) {
+            bool is_now_foreground = is_final_foreground[app.slot];
             if (app.is_foreground != is_now_foreground) {
                 state_has_changed = true;
                 app.is_foreground = is_now_foreground;
                 if (is_now_foreground) {
                     app.has_logged_rogue_warning = false;
-                    if (prev_foreground_keys.find(key) == prev_foreground_keys.end()) {
-                         logger_->log(LogLevel::ACTION_OPEN, "打开", "已打开 (权威)", app.package_name, app.user_id);
-                         app.last_foreground_timestamp_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+                    if (prev_foreground_keys.find(apps_.key_of(app)) == prev_foreground_keys.end()) {
+                         logger_->log(LogLevel::ACTION_OPEN, "打开", "已打开 (权威)", apps_.package_name(app), app.user_id);
+                         apps_.display(app).last_foreground_timestamp_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
                     }
                     if (unfreeze_and_observe_nolock(app, "切换至前台(权威)", WakeupPolicy::UNFREEZE_UNTIL_BACKGROUND)) {
                         probe_config_needs_update = true;
@@ -1035,15 +1102,16 @@ bool StateManager::update_foreground_state(const std::set<AppInstanceKey>& visib
                     app.background_since = 0;
                     app.freeze_retry_count = 0;
                 } else {
-                     if (prev_foreground_keys.count(key) > 0) {
+                     if (prev_foreground_keys.count(apps_.key_of(app)) > 0) {
                         long long now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-                        long long current_runtime_ms = (app.last_foreground_timestamp_ms > 0) ? (now_ms - app.last_foreground_timestamp_ms) : 0;
-                        app.total_runtime_ms += current_runtime_ms;
-                        long total_seconds = app.total_runtime_ms / 1000;
+                        auto& display = apps_.display(app);
+                        long long current_runtime_ms = (display.last_foreground_timestamp_ms > 0) ? (now_ms - display.last_foreground_timestamp_ms) : 0;
+                        display.total_runtime_ms += current_runtime_ms;
+                        long total_seconds = display.total_runtime_ms / 1000;
                         std::stringstream ss_msg;
                         ss_msg << "已关闭 [本次: " << (current_runtime_ms / 1000) << "s] [累计: "
                                << (total_seconds / 3600) << "h" << ((total_seconds % 3600) / 60) << "m" << (total_seconds % 60) << "s]";
-                        logger_->log(LogLevel::ACTION_CLOSE, "关闭", ss_msg.str(), app.package_name, app.user_id);
+                        logger_->log(LogLevel::ACTION_CLOSE, "关闭", ss_msg.str(), apps_.package_name(app), app.user_id);
                     }
                     if (app.current_status == AppRuntimeState::Status::RUNNING && (app.config.policy == AppPolicy::STANDARD || app.config.policy == AppPolicy::STRICT) && !app.pids.empty()) {
                         app.observation_since = now;
@@ -1052,6 +1120,9 @@ bool StateManager::update_foreground_state(const std::set<AppInstanceKey>& visib
             }
         }
     }
+    if (state_has_changed || probe_config_needs_update) {
+        publish_snapshot();
+    }
     if (probe_config_needs_update) {
         notify_probe_of_config_change();
     }
@@ -1062,7 +1133,7 @@ bool StateManager::update_foreground_state_from_pids(const std::set<int>& top_pi
     bool state_has_changed = false;
     bool probe_config_needs_update = false;
     {
-        std::lock_guard<std::mutex> lock(state_mutex_);
+        std::lock_guard<RecordedMutex> lock(state_mutex_);
         std::map<int, AppInstanceKey> pid_to_key_map;
         std::set<AppInstanceKey> top_app_keys;
         for (int pid : top_pids) {
@@ -1079,7 +1150,7 @@ bool StateManager::update_foreground_state_from_pids(const std::set<int>& top_pi
             top_app_keys.insert({current_ime_pkg, 0});
         }
         for (const auto& key : top_app_keys) {
-            if (managed_apps_.find(key) == managed_apps_.end()) {
+            if (apps_.find(key) == INVALID_APP_SLOT) {
                 LOGI("Discovered new top app via fast path: %s (user %d). Creating state...", key.first.c_str(), key.second);
                 AppRuntimeState* new_app = get_or_create_app_state(key.first, key.second);
                 if (new_app) {
@@ -1096,24 +1167,29 @@ bool StateManager::update_foreground_state_from_pids(const std::set<int>& top_pi
             }
         }
         std::set<AppInstanceKey> prev_foreground_keys;
-        for (const auto& [key, app] : managed_apps_) {
-            if (app.is_foreground) prev_foreground_keys.insert(key);
+        for (const auto& app : apps_) {
+            if (app.is_foreground) prev_foreground_keys.insert(apps_.key_of(app));
         }
         if (top_app_keys == prev_foreground_keys && !state_has_changed) {
             return false;
         }
         const auto& final_foreground_keys = top_app_keys;
+        std::vector<bool> is_final_foreground(apps_.size(), false);
+        for (const auto& key : final_foreground_keys) {
+            AppSlot slot = apps_.find(key);
+            if (slot != INVALID_APP_SLOT) is_final_foreground[slot] = true;
+        }
         time_t now = time(nullptr);
-        for (auto& [key, app] : managed_apps_) {
-            bool is_now_foreground = final_foreground_keys.count(key);
+        for (auto& app : apps_) {
+            bool is_now_foreground = is_final_foreground[app.slot];
             if (app.is_foreground != is_now_foreground) {
                 state_has_changed = true;
                 app.is_foreground = is_now_foreground;
                 if (is_now_foreground) {
                     app.has_logged_rogue_warning = false;
-                    if (prev_foreground_keys.find(key) == prev_foreground_keys.end()) {
-                         logger_->log(LogLevel::ACTION_OPEN, "打开", "已打开 (快速)", app.package_name, app.user_id);
-                         app.last_foreground_timestamp_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+                    if (prev_foreground_keys.find(apps_.key_of(app)) == prev_foreground_keys.end()) {
+                         logger_->log(LogLevel::ACTION_OPEN, "打开", "已打开 (快速)", apps_.package_name(app), app.user_id);
+                         apps_.display(app).last_foreground_timestamp_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
                     }
                     if (unfreeze_and_observe_nolock(app, "切换至前台(快速)", WakeupPolicy::UNFREEZE_UNTIL_BACKGROUND)) {
                         probe_config_needs_update = true;
@@ -1122,15 +1198,16 @@ bool StateManager::update_foreground_state_from_pids(const std::set<int>& top_pi
                     app.background_since = 0;
                     app.freeze_retry_count = 0;
                 } else {
-                     if (prev_foreground_keys.count(key) > 0) {
+                     if (prev_foreground_keys.count(apps_.key_of(app)) > 0) {
                         long long now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-                        long long current_runtime_ms = (app.last_foreground_timestamp_ms > 0) ? (now_ms - app.last_foreground_timestamp_ms) : 0;
-                        app.total_runtime_ms += current_runtime_ms;
-                        long total_seconds = app.total_runtime_ms / 1000;
+                        auto& display = apps_.display(app);
+                        long long current_runtime_ms = (display.last_foreground_timestamp_ms > 0) ? (now_ms - display.last_foreground_timestamp_ms) : 0;
+                        display.total_runtime_ms += current_runtime_ms;
+                        long total_seconds = display.total_runtime_ms / 1000;
                         std::stringstream ss_msg;
                         ss_msg << "已关闭 [本次: " << (current_runtime_ms / 1000) << "s] [累计: "
                                << (total_seconds / 3600) << "h" << ((total_seconds % 3600) / 60) << "m" << (total_seconds % 60) << "s]";
-                        logger_->log(LogLevel::ACTION_CLOSE, "关闭", ss_msg.str(), app.package_name, app.user_id);
+                        logger_->log(LogLevel::ACTION_CLOSE, "关闭", ss_msg.str(), apps_.package_name(app), app.user_id);
                     }
                     if (app.current_status == AppRuntimeState::Status::RUNNING && (app.config.policy == AppPolicy::STANDARD || app.config.policy == AppPolicy::STRICT) && !app.pids.empty()) {
                         app.observation_since = now;
@@ -1139,92 +1216,70 @@ bool StateManager::update_foreground_state_from_pids(const std::set<int>& top_pi
             }
         }
     }
+    if (state_has_changed || probe_config_needs_update) {
+        publish_snapshot();
+    }
     if (probe_config_needs_update) {
         notify_probe_of_config_change();
     }
     return state_has_changed;
 }
 
-void StateManager::on_app_foreground_event(const json& payload) {
-    try {
-        std::string package_name = payload.value("package_name", "");
-        int user_id = payload.value("user_id", 0);
-        if (package_name.empty()) return;
-        LOGD("EVENT: Received foreground event for %s (user %d), issuing refresh ticket.", package_name.c_str(), user_id);
-        g_top_app_refresh_tickets = 1;
-    } catch (const json::exception& e) {
-        LOGE("Error processing foreground event: %s", e.what());
-    }
-}
-
-void StateManager::on_app_background_event(const json& payload) {
-    try {
-        std::string package_name = payload.value("package_name", "");
-        int user_id = payload.value("user_id", 0);
-        if (package_name.empty()) return;
-        LOGD("EVENT: Received background event for %s (user %d), issuing refresh ticket.", package_name.c_str(), user_id);
-        g_top_app_refresh_tickets = 1;
-    } catch (const json::exception& e) {
-        LOGE("Error processing background event: %s", e.what());
-    }
-}
-
-void StateManager::on_proactive_unfreeze_request(const json& payload) {
-    try {
-        std::string package_name = payload.value("package_name", "");
-        int user_id = payload.value("user_id", 0);
-        if (package_name.empty()) return;
-        LOGD("PROACTIVE: Received unfreeze request for %s (user %d)", package_name.c_str(), user_id);
-        std::lock_guard<std::mutex> lock(state_mutex_);
-        AppInstanceKey key = {package_name, user_id};
-        auto it = managed_apps_.find(key);
-        if (it != managed_apps_.end()) {
-            if (it->second.current_status == AppRuntimeState::Status::FROZEN) {
-                 if(unfreeze_and_observe_nolock(it->second, "PROACTIVE_START", WakeupPolicy::FROM_PROBE_START)) {
-                    broadcast_dashboard_update();
-                    notify_probe_of_config_change();
-                 }
-            }
-        }
-    } catch (const json::exception& e) {
-        LOGE("Error processing proactive unfreeze request: %s", e.what());
+void StateManager::on_app_foreground_event(const std::string& package_name, int user_id) {
+    if (package_name.empty()) return;
+    LOGD("EVENT: Received foreground event for %s (user %d), issuing refresh ticket.", package_name.c_str(), user_id);
+    g_top_app_refresh_tickets = 1;
+}
+
+void StateManager::on_app_background_event(const std::string& package_name, int user_id) {
+    if (package_name.empty()) return;
+    LOGD("EVENT: Received background event for %s (user %d), issuing refresh ticket.", package_name.c_str(), user_id);
+    g_top_app_refresh_tickets = 1;
+}
+
+void StateManager::on_proactive_unfreeze_request(const std::string& package_name, int user_id) {
+    if (package_name.empty()) return;
+    bool state_changed = false;
+    {
+        std::lock_guard<RecordedMutex> lock(state_mutex_);
+        state_changed = handle_proactive_unfreeze_nolock(package_name, user_id);
+    }
+    if (state_changed) {
+        publish_snapshot();
+        broadcast_dashboard_update();
+        notify_probe_of_config_change();
     }
 }
 
-void StateManager::on_wakeup_request(const json& payload) {
+void StateManager::on_wakeup_request(const std::string& package_name, int user_id) {
+    if (package_name.empty()) return;
     bool state_changed = false;
-    try {
-        std::string package_name = payload.value("package_name", "");
-        int user_id = payload.value("user_id", 0);
-        if (package_name.empty()) return;
-        LOGD("Received wakeup request for %s (user %d)", package_name.c_str(), user_id);
-        std::lock_guard<std::mutex> lock(state_mutex_);
-        AppInstanceKey key = {package_name, user_id};
-        auto it = managed_apps_.find(key);
-        if (it != managed_apps_.end()) {
-            state_changed = unfreeze_and_observe_nolock(it->second, "WAKEUP_REQUEST (Legacy)", WakeupPolicy::STANDARD_OBSERVATION);
+    LOGD("Received wakeup request for %s (user %d)", package_name.c_str(), user_id);
+    {
+        std::lock_guard<RecordedMutex> lock(state_mutex_);
+        AppSlot slot = apps_.find(package_name, user_id);
+        if (slot != INVALID_APP_SLOT) {
+            state_changed = unfreeze_and_observe_nolock(apps_[slot], "WAKEUP_REQUEST (Legacy)", WakeupPolicy::STANDARD_OBSERVATION);
         } else {
             LOGW("Wakeup request for unknown app: %s", package_name.c_str());
         }
-    } catch (const json::exception& e) {
-        LOGE("Error processing wakeup request: %s", e.what());
     }
     if (state_changed) {
+        publish_snapshot();
         broadcast_dashboard_update();
         notify_probe_of_config_change();
     }
 }
 
-void StateManager::on_temp_unfreeze_request_by_pkg(const json& payload) {
+void StateManager::on_temp_unfreeze_request_by_pkg(const std::string& package_name) {
+    if (package_name.empty()) return;
     bool state_changed = false;
-    try {
-        std::string package_name = payload.value("package_name", "");
-        if (package_name.empty()) return;
-        LOGD("Received temp unfreeze request by package: %s", package_name.c_str());
-        std::lock_guard<std::mutex> lock(state_mutex_);
+    LOGD("Received temp unfreeze request by package: %s", package_name.c_str());
+    {
+        std::lock_guard<RecordedMutex> lock(state_mutex_);
         bool app_found = false;
-        for (auto& [key, app] : managed_apps_) {
-            if (key.first == package_name) {
+        for (auto& app : apps_) {
+            if (apps_.package_name(app) == package_name) {
                 app_found = true;
                 if (unfreeze_and_observe_nolock(app, "FCM", WakeupPolicy::FROM_FCM)) {
                     state_changed = true;
@@ -1234,72 +1289,65 @@ void StateManager::on_temp_unfreeze_request_by_pkg(const json& payload) {
         if (!app_found) {
             LOGW("Temp unfreeze request for unknown package: %s", package_name.c_str());
         }
-    } catch (const json::exception& e) {
-        LOGE("Error processing temp unfreeze by pkg: %s", e.what());
     }
     if (state_changed) {
+        publish_snapshot();
         broadcast_dashboard_update();
         notify_probe_of_config_change();
     }
 }
 
-void StateManager::on_temp_unfreeze_request_by_uid(const json& payload) {
+void StateManager::on_temp_unfreeze_request_by_uid(int uid) {
+    if (uid < 0) return;
     bool state_changed = false;
-    try {
-        int uid = payload.value("uid", -1);
-        if (uid < 0) return;
-        LOGD("Received temp unfreeze request by UID: %d", uid);
-        std::lock_guard<std::mutex> lock(state_mutex_);
-        bool app_found = false;
-        for (auto& [key, app] : managed_apps_) {
-            if (app.uid == uid) {
-                app_found = true;
-                if (unfreeze_and_observe_nolock(app, "AUDIO_FOCUS", WakeupPolicy::STANDARD_OBSERVATION)) {
-                    state_changed = true;
-                }
-                break;
+    LOGD("Received temp unfreeze request by UID: %d", uid);
+    {
+        std::lock_guard<RecordedMutex> lock(state_mutex_);
+        AppSlot slot = apps_.find_by_uid(uid);
+        if (slot != INVALID_APP_SLOT) {
+            if (unfreeze_and_observe_nolock(apps_[slot], "AUDIO_FOCUS", WakeupPolicy::STANDARD_OBSERVATION)) {
+                state_changed = true;
             }
-        }
-        if(!app_found) {
+        } else {
             LOGW("Temp unfreeze request for unknown UID: %d", uid);
         }
-    } catch (const json::exception& e) {
-        LOGE("Error processing temp unfreeze by uid: %s", e.what());
     }
     if (state_changed) {
+        publish_snapshot();
         broadcast_dashboard_update();
         notify_probe_of_config_change();
     }
 }
 
-void StateManager::on_temp_unfreeze_request_by_pid(const json& payload) {
+void StateManager::on_temp_unfreeze_request_by_pid(int pid) {
+    if (pid < 0) return;
     bool state_changed = false;
-    try {
-        int pid = payload.value("pid", -1);
-        if (pid < 0) return;
-        LOGD("Received temp unfreeze request by PID: %d", pid);
-        std::lock_guard<std::mutex> lock(state_mutex_);
-        auto it = pid_to_app_map_.find(pid);
-        if (it != pid_to_app_map_.end()) {
-            if (unfreeze_and_observe_nolock(*(it->second), "SIGKILL_PROTECT", WakeupPolicy::STANDARD_OBSERVATION)) {
+    LOGD("Received temp unfreeze request by PID: %d", pid);
+    {
+        std::lock_guard<RecordedMutex> lock(state_mutex_);
+        AppSlot slot = apps_.find_by_pid(pid);
+        if (slot != INVALID_APP_SLOT) {
+            if (unfreeze_and_observe_nolock(apps_[slot], "SIGKILL_PROTECT", WakeupPolicy::STANDARD_OBSERVATION)) {
                 state_changed = true;
             }
         } else {
             LOGW("Temp unfreeze request for unknown PID: %d", pid);
         }
-    } catch (const json::exception& e) {
-        LOGE("Error processing temp unfreeze by pid: %s", e.what());
     }
     if (state_changed) {
+        publish_snapshot();
         broadcast_dashboard_update();
         notify_probe_of_config_change();
     }
 }
 
 void StateManager::update_master_config(const MasterConfig& config) {
-    std::lock_guard<std::mutex> lock(state_mutex_);
+    std::unique_lock<RecordedMutex> lock(state_mutex_);
     master_config_ = config;
     db_manager_->set_master_config(config);
+    PendingSnapshot pending = capture_snapshot_nolock();
+    lock.unlock();
+    finish_snapshot(std::move(pending));
     LOGI("Master config updated: standard_timeout=%ds, timed_unfreeze_enabled=%d, timed_unfreeze_interval=%ds",
         master_config_.standard_timeout_sec, master_config_.is_timed_unfreeze_enabled, master_config_.timed_unfreeze_interval_sec);
     logger_->log(LogLevel::EVENT, "配置", "核心配置已更新");
@@ -1321,8 +1369,8 @@ void StateManager::validate_pids_nolock(AppRuntimeState& app) {
     while (it != app.pids.end()) {
         fs::path proc_path("/proc/" + std::to_string(*it));
         if (!fs::exists(proc_path)) {
-            LOGI("Sync: PID %d for %s no longer exists. Removing from state.", *it, app.package_name.c_str());
-            pid_to_app_map_.erase(*it);
+            LOGI("Sync: PID %d for %s no longer exists. Removing from state.", *it, apps_.package_name(app).c_str());
+            apps_.unmap_pid(*it);
             it = app.pids.erase(it);
         } else {
             ++it;
@@ -1336,9 +1384,9 @@ bool StateManager::tick_state_machine_timers() {
     const int MAX_FREEZE_RETRIES = 3;
     const int RETRY_DELAY_BASE_SEC = 5;
     {
-        std::lock_guard<std::mutex> lock(state_mutex_);
+        std::lock_guard<RecordedMutex> lock(state_mutex_);
         time_t now = time(nullptr);    
-        for (auto& [key, app] : managed_apps_) {
+        for (auto& app : apps_) {
             if (!app.is_foreground && !app.pids.empty()) {
                 validate_pids_nolock(app);
             }
@@ -1363,7 +1411,7 @@ bool StateManager::tick_state_machine_timers() {
                         reason_str += active_reasons[i] + (i < active_reasons.size() - 1 ? " / " : "");
                     }
                     std::string log_msg = "因 " + reason_str + " 活跃而推迟冻结";
-                    logger_->log(LogLevel::ACTION_DELAY, "延迟", log_msg, app.package_name, app.user_id);
+                    logger_->log(LogLevel::ACTION_DELAY, "延迟", log_msg, apps_.package_name(app), app.user_id);
                     app.observation_since = now;
                     changed = true;
                     continue;
@@ -1382,7 +1430,7 @@ bool StateManager::tick_state_machine_timers() {
                     std::vector<int> pids_to_freeze;
                     std::string strategy_log_msg;
                     if (app.pids.empty()) {
-                        LOGI("Freeze skipped for %s as all its processes have died.", app.package_name.c_str());
+                        LOGI("Freeze skipped for %s as all its processes have died.", apps_.package_name(app).c_str());
                         app.background_since = 0;
                         app.freeze_retry_count = 0;
                         continue;
@@ -1399,8 +1447,8 @@ bool StateManager::tick_state_machine_timers() {
                         pids_to_freeze = app.pids;
                     }
                     size_t frozen_pids_count = pids_to_freeze.size();
-                    logger_->log(LogLevel::INFO, "冻结", strategy_log_msg, app.package_name, app.user_id);
-                    int freeze_result = action_executor_->freeze(key, app.pids);
+                    logger_->log(LogLevel::INFO, "冻结", strategy_log_msg, apps_.package_name(app), app.user_id);
+                    int freeze_result = action_executor_->freeze(apps_.key_of(app), app.pids);
                     std::stringstream log_msg_ss;
                     log_msg_ss << "[" << frozen_pids_count << "/" << total_pids << "] ";
                     switch (freeze_result) {
@@ -1408,7 +1456,7 @@ bool StateManager::tick_state_machine_timers() {
                             app.current_status = AppRuntimeState::Status::FROZEN;
                             app.freeze_method = AppRuntimeState::FreezeMethod::CGROUP;
                             log_msg_ss << "因后台超时被冻结 (Cgroup)";
-                            logger_->log(LogLevel::ACTION_FREEZE, "冻结", log_msg_ss.str(), app.package_name, app.user_id);
+                            logger_->log(LogLevel::ACTION_FREEZE, "冻结", log_msg_ss.str(), apps_.package_name(app), app.user_id);
                             schedule_timed_unfreeze(app);
                             probe_config_needs_update = true;
                             app.background_since = 0;
@@ -1418,7 +1466,7 @@ bool StateManager::tick_state_machine_timers() {
                             app.current_status = AppRuntimeState::Status::FROZEN;
                             app.freeze_method = AppRuntimeState::FreezeMethod::SIG_STOP;
                             log_msg_ss << "因后台超时被冻结 (SIGSTOP)";
-                            logger_->log(LogLevel::ACTION_FREEZE, "冻结", log_msg_ss.str(), app.package_name, app.user_id);
+                            logger_->log(LogLevel::ACTION_FREEZE, "冻结", log_msg_ss.str(), apps_.package_name(app), app.user_id);
                             schedule_timed_unfreeze(app);
                             probe_config_needs_update = true;
                             app.background_since = 0;
@@ -1427,16 +1475,16 @@ bool StateManager::tick_state_machine_timers() {
                         case 2:
                             app.freeze_retry_count++;
                             if (app.freeze_retry_count > MAX_FREEZE_RETRIES) {
-                                logger_->log(LogLevel::WARN, "冻结", "多次尝试冻结失败，已放弃", app.package_name, app.user_id);
+                                logger_->log(LogLevel::WARN, "冻结", "多次尝试冻结失败，已放弃", apps_.package_name(app), app.user_id);
                                 app.background_since = 0;
                                 app.freeze_retry_count = 0;
                             } else {
-                                logger_->log(LogLevel::INFO, "冻结", "冻结遇到软失败，将重试", app.package_name, app.user_id);
+                                logger_->log(LogLevel::INFO, "冻结", "冻结遇到软失败，将重试", apps_.package_name(app), app.user_id);
                                 app.background_since = now;
                             }
                             break;
                         default:
-                             logger_->log(LogLevel::ERROR, "冻结", "冻结遇到致命错误，已中止", app.package_name, app.user_id);
+                             logger_->log(LogLevel::ERROR, "冻结", "冻结遇到致命错误，已中止", apps_.package_name(app), app.user_id);
                             app.background_since = 0;
                             app.freeze_retry_count = 0;
                             break;
@@ -1446,6 +1494,9 @@ bool StateManager::tick_state_machine_timers() {
             }
         }
     }
+    if (changed || probe_config_needs_update) {
+        publish_snapshot();
+    }
     if (probe_config_needs_update) {
         notify_probe_of_config_change();
     }
@@ -1457,7 +1508,7 @@ void StateManager::cancel_timed_unfreeze(AppRuntimeState& app) {
         if (app.scheduled_unfreeze_idx < unfrozen_timeline_.size()) {
             if (unfrozen_timeline_[app.scheduled_unfreeze_idx] == app.uid) {
                 unfrozen_timeline_[app.scheduled_unfreeze_idx] = 0;
-                LOGD("TIMELINE: Cancelled scheduled unfreeze for %s at index %d.", app.package_name.c_str(), app.scheduled_unfreeze_idx);
+                LOGD("TIMELINE: Cancelled scheduled unfreeze for %s at index %d.", apps_.package_name(app).c_str(), app.scheduled_unfreeze_idx);
             }
         }
         app.scheduled_unfreeze_idx = -1;
@@ -1475,40 +1526,40 @@ void StateManager::schedule_timed_unfreeze(AppRuntimeState& app) {
         if (unfrozen_timeline_[current_index] == 0) {
             unfrozen_timeline_[current_index] = app.uid;
             app.scheduled_unfreeze_idx = current_index;
-            LOGD("TIMELINE: Scheduled timed unfreeze for %s (uid %d) at index %u.", app.package_name.c_str(), app.uid, current_index);
+            LOGD("TIMELINE: Scheduled timed unfreeze for %s (uid %d) at index %u.", apps_.package_name(app).c_str(), app.uid, current_index);
             return;
         }
     }
-    LOGW("TIMELINE: Could not find empty slot for %s. Timeline is full!", app.package_name.c_str());
+    LOGW("TIMELINE: Could not find empty slot for %s. Timeline is full!", apps_.package_name(app).c_str());
 }
 
 bool StateManager::check_timed_unfreeze() {
     bool state_changed = false;
     int uid_to_unfreeze;
     {
-        std::lock_guard<std::mutex> lock(state_mutex_);
+        std::lock_guard<RecordedMutex> lock(state_mutex_);
         timeline_idx_ = (timeline_idx_ + 1) % unfrozen_timeline_.size();
         uid_to_unfreeze = unfrozen_timeline_[timeline_idx_];
         if (uid_to_unfreeze == 0) return false;
         unfrozen_timeline_[timeline_idx_] = 0;
     }
     {
-        std::lock_guard<std::mutex> lock(state_mutex_);
-        for (auto& [key, app] : managed_apps_) {
-            if (app.uid == uid_to_unfreeze) {
-                if (app.current_status == AppRuntimeState::Status::FROZEN && !app.is_foreground) {
-                    LOGI("TIMELINE: Executing timed unfreeze for %s.", app.package_name.c_str());
-                    logger_->log(LogLevel::TIMER, "定时器", "执行定时解冻", app.package_name, app.user_id);
-                    if(unfreeze_and_observe_nolock(app, "定时器唤醒", WakeupPolicy::STANDARD_OBSERVATION)) {
-                       state_changed = true;
-                    }
+        std::lock_guard<RecordedMutex> lock(state_mutex_);
+        AppSlot slot = apps_.find_by_uid(uid_to_unfreeze);
+        if (slot != INVALID_APP_SLOT) {
+            auto& app = apps_[slot];
+            if (app.current_status == AppRuntimeState::Status::FROZEN && !app.is_foreground) {
+                LOGI("TIMELINE: Executing timed unfreeze for %s.", apps_.package_name(app).c_str());
+                logger_->log(LogLevel::TIMER, "定时器", "执行定时解冻", apps_.package_name(app), app.user_id);
+                if(unfreeze_and_observe_nolock(app, "定时器唤醒", WakeupPolicy::STANDARD_OBSERVATION)) {
+                   state_changed = true;
                 }
-                app.scheduled_unfreeze_idx = -1;
-                break;
             }
+            app.scheduled_unfreeze_idx = -1;
         }
     }
     if (state_changed) {
+        publish_snapshot();
         broadcast_dashboard_update();
         notify_probe_of_config_change();
     }
@@ -1518,10 +1569,10 @@ bool StateManager::check_timed_unfreeze() {
 bool StateManager::perform_deep_scan() {
     bool changed = false;
     {
-        std::lock_guard<std::mutex> lock(state_mutex_);
+        std::lock_guard<RecordedMutex> lock(state_mutex_);
         changed = reconcile_process_state_full();
         time_t now = time(nullptr);
-        for (auto& [key, app] : managed_apps_) {
+        for (auto& app : apps_) {
             if (app.current_status == AppRuntimeState::Status::FROZEN && !app.pids.empty()) {
                 action_executor_->verify_and_reapply_oom_scores(app.pids);
             }
@@ -1530,7 +1581,7 @@ bool StateManager::perform_deep_scan() {
                     app.undetected_since = now;
                 } else if (now - app.undetected_since >= 3) {
                     if (app.current_status == AppRuntimeState::Status::FROZEN) {
-                         LOGI("Frozen app %s no longer has active PIDs. Marking as STOPPED.", app.package_name.c_str());
+                         LOGI("Frozen app %s no longer has active PIDs. Marking as STOPPED.", apps_.package_name(app).c_str());
                          cancel_timed_unfreeze(app);
                          action_executor_->verify_and_reapply_oom_scores(app.pids); 
                     }
@@ -1540,9 +1591,10 @@ bool StateManager::perform_deep_scan() {
                     app.background_since = 0;
                     app.observation_since = 0;
                     app.freeze_retry_count = 0;
-                    app.mem_usage_kb = 0;
-                    app.swap_usage_kb = 0;
-                    app.cpu_usage_percent = 0.0f;
+                    auto& display = apps_.display(app);
+                    display.mem_usage_kb = 0;
+                    display.swap_usage_kb = 0;
+                    display.cpu_usage_percent = 0.0f;
                     app.undetected_since = 0;
                     changed = true;
                 }
@@ -1557,7 +1609,7 @@ bool StateManager::perform_deep_scan() {
 bool StateManager::on_config_changed_from_ui(const json& payload) {
     bool probe_config_needs_update = false;
     {
-        std::lock_guard<std::mutex> lock(state_mutex_);
+        std::lock_guard<RecordedMutex> lock(state_mutex_);
         if (!payload.contains("policies")) return false;
         LOGI("Applying new configuration from UI...");
         std::vector<AppConfig> new_configs;
@@ -1581,6 +1633,7 @@ bool StateManager::on_config_changed_from_ui(const json& payload) {
         for (const auto& new_config : new_configs) {
             AppRuntimeState* app = get_or_create_app_state(new_config.package_name, new_config.user_id);
             if (app) {
+                policies_dirty_ = true;
                 bool policy_changed = app->config.policy != new_config.policy;
                 app->config = new_config;
                 if (policy_changed && app->current_status == AppRuntimeState::Status::FROZEN && (new_config.policy == AppPolicy::EXEMPTED || new_config.policy == AppPolicy::IMPORTANT)) {
@@ -1593,104 +1646,247 @@ bool StateManager::on_config_changed_from_ui(const json& payload) {
         logger_->log(LogLevel::EVENT, "配置", "应用策略已从UI原子化更新");
         LOGI("New configuration applied atomically.");
     }
+    publish_snapshot();
     if (probe_config_needs_update) {
         notify_probe_of_config_change();
     }
     return true;
 }
 
-json StateManager::get_dashboard_payload() {
-    std::lock_guard<std::mutex> lock(state_mutex_);
-    json payload;
+void StateManager::publish_snapshot() {
+    PendingSnapshot pending;
+    {
+        std::lock_guard<RecordedMutex> lock(state_mutex_);
+        pending = capture_snapshot_nolock();
+    }
+    finish_snapshot(std::move(pending));
+}
+
+// 锁内只复制应用表中的字段；定位、网络、音频状态来自 SystemMonitor 自己加锁的缓存，
+// 由 finish_snapshot 在 state_mutex_ 之外查询，避免每次发布都让事件线程等待上百次查找
+StateManager::PendingSnapshot StateManager::capture_snapshot_nolock() {
+    PendingSnapshot pending;
+    pending.snapshot = std::make_shared<StateSnapshot>();
+    StateSnapshot& snapshot = *pending.snapshot;
+    snapshot.version = ++snapshot_version_;
     if (last_metrics_record_) {
-        payload["global_stats"] = {
-            {"total_cpu_usage_percent", last_metrics_record_->total_cpu_usage_percent},
-            {"total_mem_kb", last_metrics_record_->mem_total_kb},
-            {"avail_mem_kb", last_metrics_record_->mem_available_kb},
-            {"swap_total_kb", last_metrics_record_->swap_total_kb},
-            {"swap_free_kb", last_metrics_record_->swap_free_kb},
+        snapshot.global_stats = DashboardGlobalStats{
+            .total_cpu_usage_percent = last_metrics_record_->total_cpu_usage_percent,
+            .mem_total_kb = last_metrics_record_->mem_total_kb,
+            .mem_available_kb = last_metrics_record_->mem_available_kb,
+            .swap_total_kb = last_metrics_record_->swap_total_kb,
+            .swap_free_kb = last_metrics_record_->swap_free_kb
         };
-    } else {
-        payload["global_stats"] = json::object();
     }
-    json apps_state = json::array();
-    for (auto& [key, app] : managed_apps_) {
+    if (policies_dirty_ || !policies_snapshot_) {
+        auto policies = std::make_shared<std::vector<AppConfig>>();
+        policies->reserve(apps_.size());
+        for (const auto& app : apps_) {
+            policies->push_back(app.config);
+        }
+        policies_snapshot_ = std::move(policies);
+        policies_dirty_ = false;
+    }
+    snapshot.policies = policies_snapshot_;
+    snapshot.master_config = master_config_;
+    for (auto& app : apps_) {
+        if (app.current_status == AppRuntimeState::Status::FROZEN) {
+            if (app.uid != -1) snapshot.frozen_uids.push_back(app.uid);
+            snapshot.frozen_pids.insert(snapshot.frozen_pids.end(), app.pids.begin(), app.pids.end());
+        }
         if (app.pids.empty() && app.current_status == AppRuntimeState::Status::STOPPED) {
             continue;
         }
-        json app_json;
-        app_json["package_name"] = app.package_name;
-        app_json["app_name"] = app.app_name;
-        app_json["user_id"] = app.user_id;
-        app_json["display_status"] = status_to_string(app, master_config_);
-        app_json["mem_usage_kb"] = app.mem_usage_kb;
-        app_json["swap_usage_kb"] = app.swap_usage_kb;
-        app_json["cpu_usage_percent"] = app.cpu_usage_percent;
-        app_json["is_whitelisted"] = app.config.policy == AppPolicy::EXEMPTED || app.config.policy == AppPolicy::IMPORTANT;
-        app_json["is_foreground"] = app.is_foreground;
-        app_json["is_playing_audio"] = is_app_playing_audio(app);
-        app_json["is_using_location"] = sys_monitor_->is_uid_using_location(app.uid);
-        app_json["has_high_network_usage"] = sys_monitor_->get_cached_network_speed(app.uid).download_kbps > NETWORK_THRESHOLD_KBPS;        
-        if (app.current_status == AppRuntimeState::Status::RUNNING && !app.is_foreground) {
-            if (is_app_playing_audio(app)) {
-                app_json["exemption_reason"] = "PLAYING_AUDIO";
-            }
+        const auto& display = apps_.display(app);
+        DashboardAppView view;
+        view.package_name = apps_.package_name(app);
+        view.app_name = display.app_name;
+        view.user_id = app.user_id;
+        view.display_status = status_to_string(app, master_config_);
+        view.mem_usage_kb = display.mem_usage_kb;
+        view.swap_usage_kb = display.swap_usage_kb;
+        view.cpu_usage_percent = display.cpu_usage_percent;
+        view.is_whitelisted = app.config.policy == AppPolicy::EXEMPTED || app.config.policy == AppPolicy::IMPORTANT;
+        view.is_foreground = app.is_foreground;
+        // 先记下是否满足后台运行的条件，finish_snapshot 查到音频状态后再确定
+        view.is_audio_exempted = app.current_status == AppRuntimeState::Status::RUNNING && !app.is_foreground;
+        snapshot.apps.push_back(std::move(view));
+        pending.view_uids.push_back(app.uid);
+    }
+    return pending;
+}
+
+void StateManager::finish_snapshot(PendingSnapshot pending) {
+    StateSnapshot& snapshot = *pending.snapshot;
+    for (size_t i = 0; i < snapshot.apps.size(); ++i) {
+        DashboardAppView& view = snapshot.apps[i];
+        int uid = pending.view_uids[i];
+        view.is_playing_audio = sys_monitor_->is_uid_playing_audio(uid);
+        view.is_using_location = sys_monitor_->is_uid_using_location(uid);
+        view.has_high_network_usage = sys_monitor_->get_cached_network_speed(uid).download_kbps > NETWORK_THRESHOLD_KBPS;
+        view.is_audio_exempted = view.is_audio_exempted && view.is_playing_audio;
+    }
+    // 多个线程可能同时补齐快照：只发布比当前更新的版本，冻结位图与快照保持同一版本
+    std::lock_guard<std::mutex> lock(snapshot_publish_mutex_);
+    auto current = std::atomic_load(&snapshot_);
+    if (current && current->version > snapshot.version) return;
+    if (frozen_uid_bitmap_) frozen_uid_bitmap_->update(snapshot.frozen_uids);
+    std::atomic_store(&snapshot_, std::shared_ptr<const StateSnapshot>(std::move(pending.snapshot)));
+}
+
+std::shared_ptr<const StateSnapshot> StateManager::get_snapshot() const {
+    return std::atomic_load(&snapshot_);
+}
+
+json DashboardAppView::to_json() const {
+    json app_json;
+    app_json["package_name"] = package_name;
+    app_json["app_name"] = app_name;
+    app_json["user_id"] = user_id;
+    app_json["display_status"] = display_status;
+    app_json["mem_usage_kb"] = mem_usage_kb;
+    app_json["swap_usage_kb"] = swap_usage_kb;
+    app_json["cpu_usage_percent"] = cpu_usage_percent;
+    app_json["is_whitelisted"] = is_whitelisted;
+    app_json["is_foreground"] = is_foreground;
+    app_json["is_playing_audio"] = is_playing_audio;
+    app_json["is_using_location"] = is_using_location;
+    app_json["has_high_network_usage"] = has_high_network_usage;
+    if (is_audio_exempted) {
+        app_json["exemption_reason"] = "PLAYING_AUDIO";
+    }
+    return app_json;
+}
+
+// 键按字典序写出，与 to_json() 的 std::map 顺序一致
+void DashboardAppView::write_json(JsonWriter& writer) const {
+    writer.begin_object()
+          .field("app_name", app_name)
+          .field("cpu_usage_percent", cpu_usage_percent)
+          .field("display_status", display_status);
+    if (is_audio_exempted) writer.field("exemption_reason", "PLAYING_AUDIO");
+    writer.field("has_high_network_usage", has_high_network_usage)
+          .field("is_foreground", is_foreground)
+          .field("is_playing_audio", is_playing_audio)
+          .field("is_using_location", is_using_location)
+          .field("is_whitelisted", is_whitelisted)
+          .field("mem_usage_kb", mem_usage_kb)
+          .field("package_name", package_name)
+          .field("swap_usage_kb", swap_usage_kb)
+          .field("user_id", user_id)
+          .end_object();
+}
+
+json DashboardGlobalStats::to_json() const {
+    return json{
+        {"total_cpu_usage_percent", total_cpu_usage_percent},
+        {"total_mem_kb", mem_total_kb},
+        {"avail_mem_kb", mem_available_kb},
+        {"swap_total_kb", swap_total_kb},
+        {"swap_free_kb", swap_free_kb},
+    };
+}
+
+void DashboardGlobalStats::write_json(JsonWriter& writer) const {
+    writer.begin_object()
+          .field("avail_mem_kb", mem_available_kb)
+          .field("swap_free_kb", swap_free_kb)
+          .field("swap_total_kb", swap_total_kb)
+          .field("total_cpu_usage_percent", total_cpu_usage_percent)
+          .field("total_mem_kb", mem_total_kb)
+          .end_object();
+}
+
+json StateManager::get_dashboard_payload() const {
+    auto snapshot = get_snapshot();
+    return build_dashboard_payload(snapshot.get());
+}
+
+json build_dashboard_payload(const StateSnapshot* snapshot) {
+    json payload;
+    if (snapshot && snapshot->global_stats) {
+        payload["global_stats"] = snapshot->global_stats->to_json();
+    } else {
+        payload["global_stats"] = json::object();
+    }
+    json apps_state = json::array();
+    if (snapshot) {
+        for (const auto& view : snapshot->apps) {
+            apps_state.push_back(view.to_json());
         }
-        apps_state.push_back(app_json);
     }
     payload["apps_runtime_state"] = apps_state;
     return payload;
 }
 
-json StateManager::get_full_config_for_ui() {
-    std::lock_guard<std::mutex> lock(state_mutex_);
-    auto db_master_config = db_manager_->get_master_config().value_or(MasterConfig{});
-    auto all_db_configs = db_manager_->get_all_app_configs();
-    json response;
-    response["master_config"] = {
+void write_dashboard_payload(JsonWriter& writer, const StateSnapshot* snapshot) {
+    writer.begin_object().key("apps_runtime_state").begin_array();
+    if (snapshot) {
+        for (const auto& view : snapshot->apps) view.write_json(writer);
+    }
+    writer.end_array().key("global_stats");
+    if (snapshot && snapshot->global_stats) {
+        snapshot->global_stats->write_json(writer);
+    } else {
+        writer.begin_object().end_object();
+    }
+    writer.end_object();
+}
+
+// 内存中的策略与主配置在每次修改时都会同步写入数据库，因此直接从快照读取，避免在请求路径上查询 SQLite
+json master_config_to_json(const MasterConfig& config) {
+    return {
         {"is_enabled", true},
         {"freeze_on_screen_off", true},
-        {"standard_timeout_sec", db_master_config.standard_timeout_sec},
-        {"is_timed_unfreeze_enabled", db_master_config.is_timed_unfreeze_enabled},
-        {"timed_unfreeze_interval_sec", db_master_config.timed_unfreeze_interval_sec}
+        {"standard_timeout_sec", config.standard_timeout_sec},
+        {"is_timed_unfreeze_enabled", config.is_timed_unfreeze_enabled},
+        {"timed_unfreeze_interval_sec", config.timed_unfreeze_interval_sec}
+    };
+}
+
+json app_config_to_json(const AppConfig& config) {
+    return {
+        {"package_name", config.package_name},
+        {"user_id", config.user_id},
+        {"policy", static_cast<int>(config.policy)},
+        {"force_playback_exemption", config.force_playback_exemption},
+        {"force_network_exemption", config.force_network_exemption},
+        {"force_location_exemption", config.force_location_exemption},
+        {"allow_timed_unfreeze", config.allow_timed_unfreeze}
     };
+}
+
+static json build_config_json(const StateSnapshot* snapshot) {
+    json response;
+    response["master_config"] = master_config_to_json(snapshot ? snapshot->master_config : MasterConfig{});
     response["exempt_config"] = {{"exempt_foreground_services", true}};
     json policies = json::array();
-    for (const auto& config : all_db_configs) {
-        policies.push_back({
-            {"package_name", config.package_name},
-            {"user_id", config.user_id},
-            {"policy", static_cast<int>(config.policy)},
-            {"force_playback_exemption", config.force_playback_exemption},
-            {"force_network_exemption", config.force_network_exemption},
-            {"force_location_exemption", config.force_location_exemption},
-            {"allow_timed_unfreeze", config.allow_timed_unfreeze}
-        });
+    if (snapshot && snapshot->policies) {
+        for (const auto& config : *snapshot->policies) {
+            policies.push_back(app_config_to_json(config));
+        }
     }
     response["policies"] = policies;
     return response;
 }
 
-json StateManager::get_probe_config_payload() {
-    std::lock_guard<std::mutex> lock(state_mutex_);
-    json payload = get_full_config_for_ui();
-    json frozen_uids = json::array();
-    json frozen_pids = json::array();
-    for (const auto& [key, app] : managed_apps_) {
-        if (app.current_status == AppRuntimeState::Status::FROZEN) {
-            if (app.uid != -1) {
-                frozen_uids.push_back(app.uid);
-            }
-            for (int pid : app.pids) {
-                frozen_pids.push_back(pid);
-            }
-        }
-    }
-    payload["frozen_uids"] = frozen_uids;
-    payload["frozen_pids"] = frozen_pids;
+json build_probe_config_payload(const StateSnapshot* snapshot) {
+    json payload = build_config_json(snapshot);
+    payload["frozen_uids"] = snapshot ? snapshot->frozen_uids : std::vector<int>{};
+    payload["frozen_pids"] = snapshot ? snapshot->frozen_pids : std::vector<int>{};
     return payload;
 }
 
+json StateManager::get_full_config_for_ui() const {
+    auto snapshot = get_snapshot();
+    return build_config_json(snapshot.get());
+}
+
+json StateManager::get_probe_config_payload() const {
+    auto snapshot = get_snapshot();
+    return build_probe_config_payload(snapshot.get());
+}
+
 bool StateManager::reconcile_process_state_full() {
     bool changed = false;
     time_t now = time(nullptr);
@@ -1707,9 +1903,11 @@ bool StateManager::reconcile_process_state_full() {
         } catch (...) { continue; }
     }
     std::vector<int> dead_pids;
-    for(const auto& [pid, app_ptr] : pid_to_app_map_) {
-        if (current_pids.find(pid) == current_pids.end()) {
-            dead_pids.push_back(pid);
+    for (const auto& app : apps_) {
+        for (int pid : app.pids) {
+            if (current_pids.find(pid) == current_pids.end()) {
+                dead_pids.push_back(pid);
+            }
         }
     }
     if (!dead_pids.empty()) {
@@ -1717,13 +1915,13 @@ bool StateManager::reconcile_process_state_full() {
         for (int pid : dead_pids) remove_pid_from_app(pid);
     }
     for(const auto& [pid, info_tuple] : current_pids) {
-        if (pid_to_app_map_.find(pid) == pid_to_app_map_.end()) {
+        if (apps_.find_by_pid(pid) == INVALID_APP_SLOT) {
             changed = true;
             const auto& [pkg_name, user_id, uid] = info_tuple;
             add_pid_to_app(pid, pkg_name, user_id, uid);
         }
     }
-    for (auto& [key, app] : managed_apps_) {
+    for (auto& app : apps_) {
         bool is_candidate = !app.is_foreground &&
                             app.current_status == AppRuntimeState::Status::RUNNING &&
                             (app.config.policy == AppPolicy::STANDARD || app.config.policy == AppPolicy::STRICT) &&
@@ -1731,8 +1929,8 @@ bool StateManager::reconcile_process_state_full() {
         if (is_candidate) {
             if (app.observation_since == 0 && app.background_since == 0) {
                 LOGW("AUDIT [Catch]: Found an 'escaped' background app %s (user %d). Placing under observation.",
-                     app.package_name.c_str(), app.user_id);
-                logger_->log(LogLevel::INFO, "审计", "捕获到逃逸的后台应用，已置于观察期", app.package_name, app.user_id);
+                     apps_.package_name(app).c_str(), app.user_id);
+                logger_->log(LogLevel::INFO, "审计", "捕获到逃逸的后台应用，已置于观察期", apps_.package_name(app), app.user_id);
                 app.observation_since = now;
                 changed = true;
             }
@@ -1775,41 +1973,43 @@ std::string StateManager::get_package_name_from_pid(int pid, int& uid, int& user
 
 AppRuntimeState* StateManager::get_or_create_app_state(const std::string& package_name, int user_id) {
     if (package_name.empty()) return nullptr;
-    AppInstanceKey key = {package_name, user_id};
-    auto it = managed_apps_.find(key);
-    if (it != managed_apps_.end()) return &it->second;
-    
-    AppRuntimeState new_state;
-    new_state.package_name = package_name;
-    new_state.user_id = user_id;
-    new_state.app_name = package_name; // 初始时用包名作为应用名
+    AppSlot existing = apps_.find(package_name, user_id);
+    if (existing != INVALID_APP_SLOT) return &apps_[existing];
 
+    AppInstanceKey key = {package_name, user_id};
     // [核心修改] 在创建状态时，立即从预加载的map中查找并设置UID
+    int uid = -1;
     auto map_it = initial_package_uid_map_.find(key);
     if (map_it != initial_package_uid_map_.end()) {
-        new_state.uid = map_it->second;
+        uid = map_it->second;
     } else {
         // 如果在map中找不到（例如系统应用或极少数情况），保持-1
-        new_state.uid = -1; 
         LOGW("Could not find UID for %s (user %d) in initial map.", package_name.c_str(), user_id);
     }
 
+    AppConfig config;
     auto config_opt = db_manager_->get_app_config(package_name, user_id);
     if (config_opt) {
-        new_state.config = *config_opt;
+        config = *config_opt;
     } else {
         LOGI("New app instance discovered: %s (user %d). Creating default DB entry.", package_name.c_str(), user_id);
         if (is_critical_system_app(package_name)) {
-            new_state.config = AppConfig{package_name, user_id, AppPolicy::EXEMPTED};
+            config = AppConfig{package_name, user_id, AppPolicy::EXEMPTED};
         } else {
             // 默认为豁免，让用户手动配置
-            new_state.config = AppConfig{package_name, user_id, AppPolicy::EXEMPTED};
+            config = AppConfig{package_name, user_id, AppPolicy::EXEMPTED};
         }
-        db_manager_->set_app_config(new_state.config);
+        db_manager_->set_app_config(config);
     }
+
+    AppSlot slot = apps_.emplace(package_name, user_id);
+    policies_dirty_ = true;
+    apps_.set_uid(slot, uid);
+    apps_.display(slot).app_name = package_name; // 初始时用包名作为应用名
+    AppRuntimeState& new_state = apps_[slot];
+    new_state.config = std::move(config);
     new_state.current_status = AppRuntimeState::Status::STOPPED;
-    auto [map_iterator, success] = managed_apps_.emplace(key, new_state);
-    return &map_iterator->second;
+    return &new_state;
 }
 
 void StateManager::add_pid_to_app(int pid, const std::string& package_name, int user_id, int uid) {
@@ -1818,49 +2018,49 @@ void StateManager::add_pid_to_app(int pid, const std::string& package_name, int
 
     // [核心修改] 如果初始UID为-1，现在用进程信息来更新它
     if (app->uid == -1 && uid != -1) {
-        app->uid = uid;
+        apps_.set_uid(app->slot, uid);
     }
-    if (app->app_name == app->package_name) {
+    auto& display = apps_.display(*app);
+    if (display.app_name == apps_.package_name(*app)) {
         std::string friendly_name = sys_monitor_->get_app_name_from_pid(pid);
         if (!friendly_name.empty()) {
             size_t colon_pos = friendly_name.find(':');
             if (colon_pos != std::string::npos) {
-                app->app_name = friendly_name.substr(0, colon_pos);
+                display.app_name = friendly_name.substr(0, colon_pos);
             } else {
-                app->app_name = friendly_name;
+                display.app_name = friendly_name;
             }
         }
     }
     if (std::find(app->pids.begin(), app->pids.end(), pid) == app->pids.end()) {
         app->pids.push_back(pid);
-        pid_to_app_map_[pid] = app;
+        apps_.map_pid(pid, app->slot);
         if (app->current_status == AppRuntimeState::Status::STOPPED) {
            app->current_status = AppRuntimeState::Status::RUNNING;
-           logger_->log(LogLevel::INFO, "进程", "检测到新进程启动", app->package_name, user_id);
+           logger_->log(LogLevel::INFO, "进程", "检测到新进程启动", apps_.package_name(*app), user_id);
         }
     }
 }
 
 void StateManager::remove_pid_from_app(int pid) {
-    auto it = pid_to_app_map_.find(pid);
-    if (it == pid_to_app_map_.end()) return;
-    AppRuntimeState* app = it->second;
-    pid_to_app_map_.erase(it);
-    if (app) {
-        auto& pids = app->pids;
-        pids.erase(std::remove(pids.begin(), pids.end(), pid), pids.end());
-        if (pids.empty()) {
-            app->mem_usage_kb = 0;
-            app->swap_usage_kb = 0;
-            app->cpu_usage_percent = 0.0f;
-            app->is_foreground = false;
-            app->background_since = 0;
-            app->observation_since = 0;
-            app->freeze_retry_count = 0;
-            app->undetected_since = 0;
-            app->freeze_method = AppRuntimeState::FreezeMethod::NONE;
-            cancel_timed_unfreeze(*app);
-        }
+    AppSlot slot = apps_.find_by_pid(pid);
+    if (slot == INVALID_APP_SLOT) return;
+    apps_.unmap_pid(pid);
+    AppRuntimeState* app = &apps_[slot];
+    auto& pids = app->pids;
+    pids.erase(std::remove(pids.begin(), pids.end(), pid), pids.end());
+    if (pids.empty()) {
+        auto& display = apps_.display(*app);
+        display.mem_usage_kb = 0;
+        display.swap_usage_kb = 0;
+        display.cpu_usage_percent = 0.0f;
+        app->is_foreground = false;
+        app->background_since = 0;
+        app->observation_since = 0;
+        app->freeze_retry_count = 0;
+        app->undetected_since = 0;
+        app->freeze_method = AppRuntimeState::FreezeMethod::NONE;
+        cancel_timed_unfreeze(*app);
     }
 }
 
@@ -1869,9 +2069,9 @@ std::vector<int> StateManager::get_managed_uids_for_probe() const {
     std::vector<int> managed_uids;
     // 由于此函数在 const 方法中调用，我们不能使用常规的 lock_guard
     // 但考虑到 state_mutex_ 是 mutable 的，我们仍然可以锁定它
-    std::lock_guard<std::mutex> lock(state_mutex_);
+    std::lock_guard<RecordedMutex> lock(state_mutex_);
 
-    for (const auto& [key, app] : managed_apps_) {
+    for (const auto& app : apps_) {
         // 根据您的定义，策略为“智能”或“严格”的应用就是受管应用
         if (app.config.policy == AppPolicy::STANDARD || app.config.policy == AppPolicy::STRICT) {
             if (app.uid != -1) {
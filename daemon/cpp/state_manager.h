@@ -17,6 +17,10 @@
 #include "logger.h"
 #include "time_series_database.h"
 #include "rekernel_client.h"
+#include "app_state_table.h"
+#include "frozen_uid_bitmap.h"
+#include "json_writer.h"
+#include "flight_recorder.h"
 
 class AdjMapper;
 class MemoryButler;
@@ -40,46 +44,6 @@ enum class WakeupPolicy {
 };
 
 
-struct AppRuntimeState {
-    enum class Status {
-        STOPPED,
-        RUNNING,
-        FROZEN
-    } current_status = Status::STOPPED;
-
-    enum class FreezeMethod {
-        NONE,
-        CGROUP,
-        SIG_STOP
-    } freeze_method = FreezeMethod::NONE;
-
-    std::string package_name;
-    std::string app_name;
-    int uid = -1;
-    int user_id = 0;
-    std::vector<int> pids;
-    AppConfig config;
-    bool is_oom_protected = false;
-    bool is_foreground = false;
-    time_t background_since = 0;
-    time_t observation_since = 0;
-    time_t undetected_since = 0;
-    int freeze_retry_count = 0;
-    bool has_rogue_structure = false;
-    int rogue_puppet_pid = -1;
-    int rogue_master_pid = -1;
-    bool has_logged_rogue_warning = false;
-    int scheduled_unfreeze_idx = -1;
-    float cpu_usage_percent = 0.0f;
-    long mem_usage_kb = 0;
-    long swap_usage_kb = 0;
-    long long last_foreground_timestamp_ms = 0;
-    long long total_runtime_ms = 0;
-    time_t last_wakeup_timestamp = 0;
-    int wakeup_count_in_window = 0;
-    time_t last_successful_wakeup_timestamp = 0;
-};
-
 class DozeManager {
 public:
     enum class State { AWAKE, IDLE, INACTIVE, DEEP_DOZE };
@@ -98,6 +62,75 @@ private:
     std::shared_ptr<ActionExecutor> action_executor_;
 };
 
+// 仪表盘中单个应用的只读视图
+struct DashboardAppView {
+    std::string package_name;
+    std::string app_name;
+    int user_id = 0;
+    std::string display_status;
+    long mem_usage_kb = 0;
+    long swap_usage_kb = 0;
+    float cpu_usage_percent = 0.0f;
+    bool is_whitelisted = false;
+    bool is_foreground = false;
+    bool is_playing_audio = false;
+    bool is_using_location = false;
+    bool has_high_network_usage = false;
+    bool is_audio_exempted = false;
+
+    json to_json() const;
+    // 与 to_json().dump() 逐字节一致
+    void write_json(JsonWriter& writer) const;
+};
+
+struct DashboardGlobalStats {
+    float total_cpu_usage_percent = 0.0f;
+    long mem_total_kb = 0;
+    long mem_available_kb = 0;
+    long swap_total_kb = 0;
+    long swap_free_kb = 0;
+
+    json to_json() const;
+    void write_json(JsonWriter& writer) const;
+};
+
+// 状态所有者在每批修改后发布的不可变读模型。
+// 载荷构建器只持有快照的 shared_ptr，序列化过程中无需 state_mutex_。
+struct StateSnapshot {
+    uint64_t version = 0;
+    std::optional<DashboardGlobalStats> global_stats;
+    std::vector<DashboardAppView> apps;
+    MasterConfig master_config;
+    // 策略列表仅在配置变化时重建，未变化的快照之间共享同一份
+    std::shared_ptr<const std::vector<AppConfig>> policies;
+    std::vector<int> frozen_uids;
+    std::vector<int> frozen_pids;
+};
+
+// 探针与 UI 共用的配置 JSON 格式，全量载荷与增量消息使用同一套字段
+json master_config_to_json(const MasterConfig& config);
+json app_config_to_json(const AppConfig& config);
+// 探针全量配置载荷（主配置、策略与冻结集合），只依赖快照
+json build_probe_config_payload(const StateSnapshot* snapshot);
+// 仪表盘载荷 {global_stats, apps_runtime_state}；流式版本与 DOM 版本输出相同的文本
+json build_dashboard_payload(const StateSnapshot* snapshot);
+void write_dashboard_payload(JsonWriter& writer, const StateSnapshot* snapshot);
+
+// 探针批量事件帧 (event.probe_batch) 中的一条事件，各字段的含义取决于 kind
+struct ProbeEvent {
+    enum class Kind : int {
+        FOREGROUND = 1,       // package_name, user_id
+        BACKGROUND = 2,       // package_name, user_id
+        WAKEUP = 3,           // uid, arg = 唤醒类型 (type_int)
+        PROACTIVE_START = 4   // package_name, user_id
+    };
+    Kind kind = Kind::FOREGROUND;
+    int uid = -1;
+    int user_id = 0;
+    int arg = 0;
+    std::string package_name;
+};
+
 struct DozeProcessRecord {
     long long start_jiffies;
     std::string process_name;
@@ -124,18 +157,26 @@ public:
     bool perform_deep_scan();
     bool on_config_changed_from_ui(const json& payload);
     void update_master_config(const MasterConfig& config);
-    json get_dashboard_payload();
-    json get_full_config_for_ui();
-    json get_probe_config_payload();
-    void on_app_foreground_event(const json& payload);
-    void on_app_background_event(const json& payload);
-    void on_proactive_unfreeze_request(const json& payload);
-    void on_wakeup_request(const json& payload);
-    void on_temp_unfreeze_request_by_pkg(const json& payload);
-    void on_temp_unfreeze_request_by_uid(const json& payload);
-    void on_temp_unfreeze_request_by_pid(const json& payload);
+    json get_dashboard_payload() const;
+    json get_full_config_for_ui() const;
+    json get_probe_config_payload() const;
+    void publish_snapshot();
+    std::shared_ptr<const StateSnapshot> get_snapshot() const;
+    // state_mutex_ 的累计获取与等待统计
+    RecordedMutex::Stats state_lock_stats() const { return state_mutex_.get_stats(); }
+    // 随快照同步更新的共享内存冻结位图，创建失败时为 nullptr
+    const FrozenUidBitmap* frozen_uid_bitmap() const { return frozen_uid_bitmap_.get(); }
+    void on_app_foreground_event(const std::string& package_name, int user_id);
+    void on_app_background_event(const std::string& package_name, int user_id);
+    void on_proactive_unfreeze_request(const std::string& package_name, int user_id);
+    void on_wakeup_request(const std::string& package_name, int user_id);
+    void on_temp_unfreeze_request_by_pkg(const std::string& package_name);
+    void on_temp_unfreeze_request_by_uid(int uid);
+    void on_temp_unfreeze_request_by_pid(int pid);
     bool perform_staggered_stats_scan();
-    void on_wakeup_request_from_probe(const json& payload);
+    void on_wakeup_request_from_probe(int uid, int type_int);
+    // 整批事件只获取一次 state_mutex_，全部处理完后最多发布一次快照与推送
+    void on_probe_event_batch(const std::vector<ProbeEvent>& events);
     void on_signal_from_rekernel(const ReKernelSignalEvent& event);
     void on_binder_from_rekernel(const ReKernelBinderEvent& event);
     void run_memory_butler_tasks();
@@ -158,6 +199,8 @@ private:
     void generate_doze_exit_report();
     void analyze_battery_change(const MetricsRecord& old_record, const MetricsRecord& new_record);
     bool unfreeze_and_observe_nolock(AppRuntimeState& app, const std::string& reason, WakeupPolicy policy);
+    bool handle_probe_wakeup_nolock(int uid, int event_type_int);
+    bool handle_proactive_unfreeze_nolock(const std::string& package_name, int user_id);
     bool reconcile_process_state_full();
     void load_all_configs();
     std::string get_package_name_from_pid(int pid, int& uid, int& user_id);
@@ -178,6 +221,15 @@ private:
     void audit_app_structures(const std::map<int, ProcessInfo>& process_tree);
     void validate_pids_nolock(AppRuntimeState& app);
     void update_memory_health(const MetricsRecord& record);
+    // 锁内复制得到、尚未补齐 SystemMonitor 字段的快照；view_uids[i] 是 apps[i] 的 uid
+    struct PendingSnapshot {
+        std::shared_ptr<StateSnapshot> snapshot;
+        std::vector<int> view_uids;
+    };
+    PendingSnapshot capture_snapshot_nolock();
+    // 在 state_mutex_ 之外调用
+    void finish_snapshot(PendingSnapshot pending);
+    void report_state_lock_stats_if_due();
 
     std::shared_ptr<DatabaseManager> db_manager_;
     std::shared_ptr<SystemMonitor> sys_monitor_;
@@ -190,7 +242,8 @@ private:
     MasterConfig master_config_;
     MemoryHealth memory_health_ = MemoryHealth::HEALTHY;
     std::unique_ptr<DozeManager> doze_manager_;
-    mutable std::mutex state_mutex_;
+    // 等待超过 1ms 时写入飞行记录器
+    mutable RecordedMutex state_mutex_{"state_mutex_"};
     std::set<AppInstanceKey> last_known_visible_app_keys_;
     std::optional<MetricsRecord> last_metrics_record_;
     std::optional<std::pair<int, long long>> last_battery_level_info_;
@@ -202,11 +255,20 @@ private:
 
     std::map<int, DozeProcessRecord> doze_start_process_info_;
 
-    std::map<AppInstanceKey, AppRuntimeState> managed_apps_;
-    std::map<int, AppRuntimeState*> pid_to_app_map_;
-    std::unordered_set<std::string> critical_system_apps_;
-    std::map<AppInstanceKey, AppRuntimeState>::iterator next_scan_iterator_;
     std::map<AppInstanceKey, int> initial_package_uid_map_;
+    AppStateTable apps_;
+    std::unordered_set<std::string> critical_system_apps_;
+    AppSlot next_scan_slot_ = 0;
+
+    // 只读快照，通过 std::atomic_load/atomic_store 发布与获取
+    std::shared_ptr<const StateSnapshot> snapshot_;
+    // 串行化 finish_snapshot 的发布步骤，不与 state_mutex_ 嵌套
+    std::mutex snapshot_publish_mutex_;
+    uint64_t snapshot_version_ = 0;
+    std::shared_ptr<const std::vector<AppConfig>> policies_snapshot_;
+    bool policies_dirty_ = true;
+    std::unique_ptr<FrozenUidBitmap> frozen_uid_bitmap_;
+    std::chrono::steady_clock::time_point last_lock_report_time_{};
 };
 
 #endif //CERBERUS_STATE_MANAGER_H
\ No newline at end of file
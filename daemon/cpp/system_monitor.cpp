@@ -666,7 +666,7 @@ void SystemMonitor::update_audio_state() {
             } catch (...) {}
         }
     }
-    std::set<int> active_uids;
+    std::unordered_set<int> active_uids;
     for (const auto& [uid, states] : uid_session_states) {
         if (states.empty()) continue;
         int product = std::accumulate(states.begin(), states.end(), 1, std::multiplies<int>());
@@ -841,7 +841,7 @@ std::string SystemMonitor::get_current_ime_package() {
     return current_ime_package_;
 }
 void SystemMonitor::update_location_state() {
-    std::set<int> active_uids;
+    std::unordered_set<int> active_uids;
     std::string result = exec_shell_pipe_efficient({"dumpsys", "location"});
     std::stringstream ss(result);
     std::string line;
@@ -8,6 +8,8 @@
 #include <map>
 #include <vector>
 #include <set>
+#include <unordered_set>
+#include <unordered_map>
 #include <thread>
 #include <atomic>
 #include <functional>
@@ -124,10 +126,10 @@ private:
     std::string top_app_tasks_path_;
 
     std::mutex audio_uids_mutex_;
-    std::set<int> uids_playing_audio_;
+    std::unordered_set<int> uids_playing_audio_;
 
     mutable std::mutex location_uids_mutex_;
-    std::set<int> uids_using_location_;
+    std::unordered_set<int> uids_using_location_;
 
     mutable std::mutex ime_mutex_;
     std::string current_ime_package_;
@@ -150,7 +152,7 @@ private:
     std::map<int, TrafficStats> last_traffic_snapshot_;
     std::chrono::steady_clock::time_point last_snapshot_time_;
     mutable std::mutex speed_mutex_;
-    std::map<int, NetworkSpeed> uid_network_speed_;
+    std::unordered_map<int, NetworkSpeed> uid_network_speed_;
 };
 
 #endif //CERBERUS_SYSTEM_MONITOR_H
\ No newline at end of file
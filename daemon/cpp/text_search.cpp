@@ -0,0 +1,123 @@
+// daemon/cpp/text_search.cpp
+#include "text_search.h"
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define CERBERUS_TEXT_SEARCH_SSE2 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define CERBERUS_TEXT_SEARCH_NEON 1
+#endif
+
+namespace text_search {
+
+size_t find_scalar(std::string_view haystack, std::string_view needle, size_t from) {
+    const size_t n = haystack.size();
+    const size_t k = needle.size();
+    if (from > n) return npos;
+    if (k == 0) return from;
+    if (k > n - from) return npos;
+    const char* s = haystack.data();
+    const char first = needle[0];
+    const char last = needle[k - 1];
+    for (size_t i = from; i + k <= n; ++i) {
+        if (s[i] == first && s[i + k - 1] == last && std::memcmp(s + i + 1, needle.data() + 1, k > 2 ? k - 2 : 0) == 0) {
+            return i;
+        }
+    }
+    return npos;
+}
+
+const char* simd_name() {
+#if defined(CERBERUS_TEXT_SEARCH_SSE2)
+    return "sse2";
+#elif defined(CERBERUS_TEXT_SEARCH_NEON)
+    return "neon";
+#else
+    return "scalar";
+#endif
+}
+
+#if defined(CERBERUS_TEXT_SEARCH_SSE2) || defined(CERBERUS_TEXT_SEARCH_NEON)
+
+size_t find_simd(std::string_view haystack, std::string_view needle, size_t from) {
+    const size_t n = haystack.size();
+    const size_t k = needle.size();
+    if (from > n) return npos;
+    if (k == 0) return from;
+    if (k > n - from) return npos;
+    const char* s = haystack.data();
+    if (k == 1) {
+        const void* hit = std::memchr(s + from, needle[0], n - from);
+        return hit ? static_cast<size_t>(static_cast<const char*>(hit) - s) : npos;
+    }
+
+#if defined(CERBERUS_TEXT_SEARCH_SSE2)
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last = _mm_set1_epi8(needle[k - 1]);
+#else
+    const uint8x16_t first = vdupq_n_u8(static_cast<uint8_t>(needle[0]));
+    const uint8x16_t last = vdupq_n_u8(static_cast<uint8_t>(needle[k - 1]));
+#endif
+    size_t i = from;
+    // 两次 16 字节加载分别从 i 与 i + k - 1 开始，都不能越过 haystack 末尾
+    for (; i + k - 1 + 16 <= n; i += 16) {
+        // 掩码中每个起点对应一位（SSE2）或四位（NEON），首字节与末字节同时相等时置位
+#if defined(CERBERUS_TEXT_SEARCH_SSE2)
+        __m128i block_first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+        __m128i block_last = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i + k - 1));
+        uint64_t mask = static_cast<uint32_t>(_mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(block_first, first), _mm_cmpeq_epi8(block_last, last))));
+        constexpr int bits_per_offset = 1;
+#else
+        uint8x16_t block_first = vld1q_u8(reinterpret_cast<const uint8_t*>(s + i));
+        uint8x16_t block_last = vld1q_u8(reinterpret_cast<const uint8_t*>(s + i + k - 1));
+        uint8x16_t eq = vandq_u8(vceqq_u8(block_first, first), vceqq_u8(block_last, last));
+        // 每个 16 位通道右移 4 位再窄化为 8 位，得到每字节 4 位的 64 位掩码
+        uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+        constexpr int bits_per_offset = 4;
+#endif
+        while (mask) {
+            size_t offset = static_cast<size_t>(__builtin_ctzll(mask)) / bits_per_offset;
+            if (std::memcmp(s + i + offset + 1, needle.data() + 1, k - 2) == 0) return i + offset;
+            mask &= ~(((1ULL << bits_per_offset) - 1) << (offset * bits_per_offset));
+        }
+    }
+    return find_scalar(haystack, needle, i);
+}
+
+#else
+
+size_t find_simd(std::string_view haystack, std::string_view needle, size_t from) {
+    return find_scalar(haystack, needle, from);
+}
+
+#endif
+
+static inline uint32_t trigram_bit(uint8_t a, uint8_t b, uint8_t c, uint32_t bit_mask) {
+    uint32_t value = static_cast<uint32_t>(a) | (static_cast<uint32_t>(b) << 8) | (static_cast<uint32_t>(c) << 16);
+    return ((value * 2654435761u) >> 16) & bit_mask;
+}
+
+void add_trigrams(std::string_view text, uint8_t* bloom, size_t bytes) {
+    const uint32_t bit_mask = static_cast<uint32_t>(bytes * 8 - 1);
+    const auto* p = reinterpret_cast<const uint8_t*>(text.data());
+    for (size_t i = 0; i + 3 <= text.size(); ++i) {
+        uint32_t bit = trigram_bit(p[i], p[i + 1], p[i + 2], bit_mask);
+        bloom[bit >> 3] |= static_cast<uint8_t>(1u << (bit & 7));
+    }
+}
+
+std::vector<uint32_t> trigram_bits(std::string_view needle, size_t bytes) {
+    const uint32_t bit_mask = static_cast<uint32_t>(bytes * 8 - 1);
+    const auto* p = reinterpret_cast<const uint8_t*>(needle.data());
+    std::vector<uint32_t> bits;
+    for (size_t i = 0; i + 3 <= needle.size(); ++i) bits.push_back(trigram_bit(p[i], p[i + 1], p[i + 2], bit_mask));
+    std::sort(bits.begin(), bits.end());
+    bits.erase(std::unique(bits.begin(), bits.end()), bits.end());
+    return bits;
+}
+
+} // namespace text_search
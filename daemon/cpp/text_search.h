@@ -0,0 +1,42 @@
+// daemon/cpp/text_search.h
+#ifndef CERBERUS_TEXT_SEARCH_H
+#define CERBERUS_TEXT_SEARCH_H
+
+#include <string_view>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+// 日志全文检索用的子串扫描与三字节组布隆过滤。
+// 比较按字节进行（区分大小写），UTF-8 中文按其编码字节参与匹配与三字节组。
+namespace text_search {
+
+constexpr size_t npos = std::string_view::npos;
+
+// 从 from 起查找 needle 第一次出现的位置。
+// find_simd 每次比较 16 字节中各位置的首尾字节（x86 用 SSE2，ARM 用 NEON），候选位置再 memcmp 确认；
+// 编译目标两者都没有时退回 find_scalar
+size_t find_scalar(std::string_view haystack, std::string_view needle, size_t from = 0);
+size_t find_simd(std::string_view haystack, std::string_view needle, size_t from = 0);
+inline size_t find(std::string_view haystack, std::string_view needle, size_t from = 0) {
+    return find_simd(haystack, needle, from);
+}
+// 当前编译目标使用的指令集："sse2"、"neon" 或 "scalar"
+const char* simd_name();
+
+// 三字节组布隆过滤器：每个三字节组映射到 bytes * 8 位中的一位（bytes 为 2 的幂）。
+// 文本包含 needle 时，needle 的每个三字节组都必然在文本的过滤器中，因此任一位缺失即可断定不包含；
+// 短于 3 字节的 needle 没有三字节组，不能据此排除
+void add_trigrams(std::string_view text, uint8_t* bloom, size_t bytes);
+// needle 各三字节组对应的位号，去重后供 bloom_may_contain 反复使用
+std::vector<uint32_t> trigram_bits(std::string_view needle, size_t bytes);
+inline bool bloom_may_contain(const uint8_t* bloom, const std::vector<uint32_t>& bits) {
+    for (uint32_t bit : bits) {
+        if (!(bloom[bit >> 3] & (1u << (bit & 7)))) return false;
+    }
+    return true;
+}
+
+} // namespace text_search
+
+#endif // CERBERUS_TEXT_SEARCH_H
@@ -1,6 +1,9 @@
 // daemon/cpp/time_series_database.cpp
 #include "time_series_database.h"
 #include "uds_server.h"
+#include <unistd.h>
+#include <climits>
+#include <algorithm>
 
 extern std::unique_ptr<UdsServer> g_server;
 
@@ -28,56 +31,213 @@ json MetricsRecord::to_json() const {
     };
 }
 
+// 键按字典序写出，与 to_json() 的 std::map 顺序一致。MetricsRecord 与列式视图共用
+static void write_metrics_json(JsonWriter& writer, long long timestamp_ms, float cpu_usage, const float* per_core, size_t core_count,
+                               long mem_total_kb, long mem_available_kb, long swap_total_kb, long swap_free_kb,
+                               int battery_level, float battery_temp_celsius, float battery_power_watt,
+                               bool is_charging, bool is_screen_on, bool is_audio_playing, bool is_location_active) {
+    writer.begin_object()
+          .field("battery_level", battery_level)
+          .field("battery_power_watt", battery_power_watt)
+          .field("battery_temp_celsius", battery_temp_celsius)
+          .field("cpu_usage_percent", cpu_usage)
+          .field("is_audio_playing", is_audio_playing)
+          .field("is_charging", is_charging)
+          .field("is_location_active", is_location_active)
+          .field("is_screen_on", is_screen_on)
+          .field("mem_available_kb", mem_available_kb)
+          .field("mem_total_kb", mem_total_kb);
+    writer.key("per_core_cpu_usage_percent").begin_array();
+    for (size_t i = 0; i < core_count; ++i) writer.value(per_core[i]);
+    writer.end_array()
+          .field("swap_free_kb", swap_free_kb)
+          .field("swap_total_kb", swap_total_kb)
+          .field("timestamp", timestamp_ms)
+          .end_object();
+}
+
+void MetricsRecord::write_json(JsonWriter& writer) const {
+    write_metrics_json(writer, timestamp_ms, total_cpu_usage_percent, per_core_cpu_usage.data(), per_core_cpu_usage.size(),
+                       mem_total_kb, mem_available_kb, swap_total_kb, swap_free_kb,
+                       battery_level, battery_temp_celsius, battery_power_watt,
+                       is_charging, is_screen_on, is_audio_playing, is_location_active);
+}
+
+// --- MetricsSampleView ---
+
+long long MetricsSampleView::timestamp_ms() const { return db_.timestamp_ms_[slot_]; }
+float MetricsSampleView::cpu_usage_percent() const { return db_.cpu_usage_[slot_]; }
+const float* MetricsSampleView::per_core_cpu_usage() const { return &db_.per_core_[slot_ * db_.core_width_]; }
+size_t MetricsSampleView::core_count() const { return db_.core_count_[slot_]; }
+long MetricsSampleView::mem_total_kb() const { return db_.mem_total_kb_[slot_]; }
+long MetricsSampleView::mem_available_kb() const { return db_.mem_available_kb_[slot_]; }
+long MetricsSampleView::swap_total_kb() const { return db_.swap_total_kb_[slot_]; }
+long MetricsSampleView::swap_free_kb() const { return db_.swap_free_kb_[slot_]; }
+int MetricsSampleView::battery_level() const { return db_.battery_level_[slot_]; }
+float MetricsSampleView::battery_temp_celsius() const { return db_.battery_temp_[slot_]; }
+float MetricsSampleView::battery_power_watt() const { return db_.battery_power_[slot_]; }
+bool MetricsSampleView::is_charging() const { return db_.flags_[slot_] & TimeSeriesDatabase::CHARGING; }
+bool MetricsSampleView::is_screen_on() const { return db_.flags_[slot_] & TimeSeriesDatabase::SCREEN_ON; }
+bool MetricsSampleView::is_audio_playing() const { return db_.flags_[slot_] & TimeSeriesDatabase::AUDIO_PLAYING; }
+bool MetricsSampleView::is_location_active() const { return db_.flags_[slot_] & TimeSeriesDatabase::LOCATION_ACTIVE; }
+
+MetricsRecord MetricsSampleView::to_record() const {
+    MetricsRecord record;
+    record.timestamp_ms = timestamp_ms();
+    record.total_cpu_usage_percent = cpu_usage_percent();
+    record.per_core_cpu_usage.assign(per_core_cpu_usage(), per_core_cpu_usage() + core_count());
+    record.mem_total_kb = mem_total_kb();
+    record.mem_available_kb = mem_available_kb();
+    record.swap_total_kb = swap_total_kb();
+    record.swap_free_kb = swap_free_kb();
+    record.battery_level = battery_level();
+    record.battery_temp_celsius = battery_temp_celsius();
+    record.battery_power_watt = battery_power_watt();
+    record.is_charging = is_charging();
+    record.is_screen_on = is_screen_on();
+    record.is_audio_playing = is_audio_playing();
+    record.is_location_active = is_location_active();
+    return record;
+}
+
+void MetricsSampleView::write_json(JsonWriter& writer) const {
+    write_metrics_json(writer, timestamp_ms(), cpu_usage_percent(), per_core_cpu_usage(), core_count(),
+                       mem_total_kb(), mem_available_kb(), swap_total_kb(), swap_free_kb(),
+                       battery_level(), battery_temp_celsius(), battery_power_watt(),
+                       is_charging(), is_screen_on(), is_audio_playing(), is_location_active());
+}
+
+// --- TimeSeriesDatabase ---
+
 std::shared_ptr<TimeSeriesDatabase> TimeSeriesDatabase::get_instance(size_t max_size) {
     std::lock_guard<std::mutex> lock(instance_mutex_);
     if (!instance_) {
-        struct make_shared_enabler : public TimeSeriesDatabase {
-            make_shared_enabler(size_t size) : TimeSeriesDatabase(size) {}
-        };
-        instance_ = std::make_shared<make_shared_enabler>(max_size);
+        // 按配置的核心数（含离线核心）确定矩阵宽度，核心上下线不改变列数
+        long cores = sysconf(_SC_NPROCESSORS_CONF);
+        size_t core_width = std::clamp<long>(cores, 1, static_cast<long>(MAX_CORE_WIDTH));
+        instance_ = create(max_size, core_width);
     }
     return instance_;
 }
 
-TimeSeriesDatabase::TimeSeriesDatabase(size_t max_size) : max_size_(max_size) {}
+std::shared_ptr<TimeSeriesDatabase> TimeSeriesDatabase::create(size_t max_size, size_t core_width) {
+    struct make_shared_enabler : public TimeSeriesDatabase {
+        make_shared_enabler(size_t size, size_t width) : TimeSeriesDatabase(size, width) {}
+    };
+    return std::make_shared<make_shared_enabler>(max_size, core_width);
+}
+
+TimeSeriesDatabase::TimeSeriesDatabase(size_t max_size, size_t core_width)
+    : capacity_(std::max<size_t>(max_size, 1)),
+      core_width_(std::clamp<size_t>(core_width, 1, MAX_CORE_WIDTH)),
+      timestamp_ms_(new long long[capacity_]()),
+      cpu_usage_(new float[capacity_]()),
+      per_core_(new float[capacity_ * core_width_]()),
+      core_count_(new uint8_t[capacity_]()),
+      mem_total_kb_(new long[capacity_]()),
+      mem_available_kb_(new long[capacity_]()),
+      swap_total_kb_(new long[capacity_]()),
+      swap_free_kb_(new long[capacity_]()),
+      battery_level_(new int16_t[capacity_]()),
+      battery_temp_(new float[capacity_]()),
+      battery_power_(new float[capacity_]()),
+      flags_(new uint8_t[capacity_]()) {}
+
+void TimeSeriesDatabase::store(const MetricsRecord& record) {
+    size_t slot = head_;
+    timestamp_ms_[slot] = record.timestamp_ms;
+    cpu_usage_[slot] = record.total_cpu_usage_percent;
+    size_t cores = std::min(record.per_core_cpu_usage.size(), core_width_);
+    std::copy_n(record.per_core_cpu_usage.data(), cores, &per_core_[slot * core_width_]);
+    core_count_[slot] = static_cast<uint8_t>(cores);
+    mem_total_kb_[slot] = record.mem_total_kb;
+    mem_available_kb_[slot] = record.mem_available_kb;
+    swap_total_kb_[slot] = record.swap_total_kb;
+    swap_free_kb_[slot] = record.swap_free_kb;
+    battery_level_[slot] = static_cast<int16_t>(record.battery_level);
+    battery_temp_[slot] = record.battery_temp_celsius;
+    battery_power_[slot] = record.battery_power_watt;
+    flags_[slot] = (record.is_charging ? CHARGING : 0) | (record.is_screen_on ? SCREEN_ON : 0) |
+                   (record.is_audio_playing ? AUDIO_PLAYING : 0) | (record.is_location_active ? LOCATION_ACTIVE : 0);
+    head_ = (head_ + 1) % capacity_;
+    if (size_ < capacity_) size_++;
+}
 
 void TimeSeriesDatabase::add_record(const MetricsRecord& record) {
     {
         std::lock_guard<std::mutex> lock(db_mutex_);
-        if (records_.size() >= max_size_) {
-            records_.pop_front();
-        }
-        records_.push_back(record);
+        store(record);
     }
-    
+    rollup_.add_sample(record);
+
     if (g_server) {
-        g_server->broadcast_message(json{
-            {"type", "stream.new_stats_record"},
-            {"payload", record.to_json()}
-        }.dump());
+        g_server->publish_text(TOPIC_STATS, [&record] {
+            JsonWriter writer(512);
+            writer.begin_object().key("payload");
+            record.write_json(writer);
+            writer.field("type", "stream.new_stats_record").end_object();
+            return writer.take();
+        });
     }
 }
 
+size_t TimeSeriesDatabase::range_count(long long since_ms, size_t max_records) const {
+    size_t limit = std::min(size_, max_records);
+    size_t count = 0;
+    while (count < limit && timestamp_ms_[slot_of(size_ - 1 - count)] >= since_ms) count++;
+    return count;
+}
+
 std::vector<MetricsRecord> TimeSeriesDatabase::get_records_since(long long timestamp_ms) const {
     std::vector<MetricsRecord> result;
-    std::lock_guard<std::mutex> lock(db_mutex_);
-    for (const auto& record : records_) {
-        if (record.timestamp_ms >= timestamp_ms) {
-            result.push_back(record);
-        }
-    }
+    visit_records(timestamp_ms, SIZE_MAX, [&result](const MetricsSampleView& sample) { result.push_back(sample.to_record()); });
     return result;
 }
 
 std::vector<MetricsRecord> TimeSeriesDatabase::get_all_records() const {
-    std::lock_guard<std::mutex> lock(db_mutex_);
-    return std::vector<MetricsRecord>(records_.begin(), records_.end());
+    return get_records_since(LLONG_MIN);
+}
+
+void TimeSeriesDatabase::write_records(JsonWriter& writer, long long since_ms, size_t max_records) const {
+    writer.begin_array();
+    visit_records(since_ms, max_records, [&writer](const MetricsSampleView& sample) { sample.write_json(writer); });
+    writer.end_array();
 }
 
 std::optional<MetricsRecord> TimeSeriesDatabase::get_latest_record() const {
+    std::optional<MetricsRecord> latest;
+    visit_records(LLONG_MIN, 1, [&latest](const MetricsSampleView& sample) { latest = sample.to_record(); });
+    return latest;
+}
+
+size_t TimeSeriesDatabase::size() const {
     std::lock_guard<std::mutex> lock(db_mutex_);
-    if (records_.empty()) {
-        return std::nullopt;
+    return size_;
+}
+
+bool TimeSeriesDatabase::open_rollups(const std::string& dir) {
+    return rollup_.open(dir);
+}
+
+void TimeSeriesDatabase::write_history(JsonWriter& writer, long long since_ms, RollupResolution resolution, long long now_ms) const {
+    if (resolution == RollupResolution::AUTO) {
+        long long raw_oldest_ms = LLONG_MAX;
+        {
+            std::lock_guard<std::mutex> lock(db_mutex_);
+            if (size_ > 0) raw_oldest_ms = timestamp_ms_[slot_of(0)];
+        }
+        resolution = MetricsRollup::choose_resolution(since_ms, now_ms, raw_oldest_ms);
+    }
+    // 降采样历史没有打开时只有原始样本可用
+    if (!rollup_.is_open()) resolution = RollupResolution::RAW;
+
+    writer.begin_object().key("points");
+    if (resolution == RollupResolution::RAW) {
+        write_records(writer, since_ms);
+    } else {
+        rollup_.write_buckets(writer, resolution, since_ms);
     }
-    return records_.back();
-}
\ No newline at end of file
+    writer.field("resolution", MetricsRollup::resolution_name(resolution))
+          .field("resolution_ms", MetricsRollup::resolution_ms(resolution))
+          .end_object();
+}
@@ -3,21 +3,23 @@
 #define CERBERUS_TIME_SERIES_DATABASE_H
 
 #include <vector>
-#include <deque>
 #include <mutex>
 #include <chrono>
 #include <nlohmann/json.hpp>
 #include <memory>
 #include <optional>
+#include <cstdint>
+#include "json_writer.h"
+#include "metrics_rollup.h"
 
 using json = nlohmann::json;
 
 struct MetricsRecord {
     long long timestamp_ms;
     // [核心修改] total_cpu_usage_percent 用于仪表盘和旧逻辑
-    float total_cpu_usage_percent = 0.0f; 
+    float total_cpu_usage_percent = 0.0f;
     // [核心新增] per_core_cpu_usage 用于新的统计图表
-    std::vector<float> per_core_cpu_usage; 
+    std::vector<float> per_core_cpu_usage;
     long mem_total_kb = 0;
     long mem_available_kb = 0;
     long swap_total_kb = 0;
@@ -31,11 +33,53 @@ struct MetricsRecord {
     bool is_location_active = false;
 
     json to_json() const;
+    // 与 to_json().dump() 逐字节一致
+    void write_json(JsonWriter& writer) const;
 };
 
+class TimeSeriesDatabase;
+
+// 列式环形存储中一个样本的只读视图，直接读取各列，只在 visit_records 的回调内有效
+class MetricsSampleView {
+public:
+    long long timestamp_ms() const;
+    float cpu_usage_percent() const;
+    const float* per_core_cpu_usage() const;
+    size_t core_count() const;
+    long mem_total_kb() const;
+    long mem_available_kb() const;
+    long swap_total_kb() const;
+    long swap_free_kb() const;
+    int battery_level() const;
+    float battery_temp_celsius() const;
+    float battery_power_watt() const;
+    bool is_charging() const;
+    bool is_screen_on() const;
+    bool is_audio_playing() const;
+    bool is_location_active() const;
+
+    MetricsRecord to_record() const;
+    // 与 to_record().write_json() 逐字节一致
+    void write_json(JsonWriter& writer) const;
+
+private:
+    friend class TimeSeriesDatabase;
+    MetricsSampleView(const TimeSeriesDatabase& db, size_t slot) : db_(db), slot_(slot) {}
+
+    const TimeSeriesDatabase& db_;
+    size_t slot_;
+};
+
+// 最近 capacity 个样本的列式环形存储：每个指标一个定长数组，各核心使用率为 capacity × core_width 的矩阵，
+// 全部在构造时分配，写入不再分配内存。样本按写入顺序保存（时钟回拨时时间戳可能不单调）
 class TimeSeriesDatabase : public std::enable_shared_from_this<TimeSeriesDatabase> {
 public:
+    // 每核心矩阵的最大列数，更多的核心截断
+    static constexpr size_t MAX_CORE_WIDTH = 32;
+
     static std::shared_ptr<TimeSeriesDatabase> get_instance(size_t max_size = 900);
+    // 不注册为全局实例的独立存储，core_width 为每核心矩阵的列数
+    static std::shared_ptr<TimeSeriesDatabase> create(size_t max_size, size_t core_width);
     ~TimeSeriesDatabase() = default;
 
     TimeSeriesDatabase(const TimeSeriesDatabase&) = delete;
@@ -44,17 +88,60 @@ public:
     void add_record(const MetricsRecord& record);
     std::vector<MetricsRecord> get_records_since(long long timestamp_ms) const;
     std::vector<MetricsRecord> get_all_records() const;
+    // 在锁内把 since_ms 之后（含）最新的至多 max_records 个样本直接从各列写成 JSON 数组
+    void write_records(JsonWriter& writer, long long since_ms = 0, size_t max_records = SIZE_MAX) const;
     std::optional<MetricsRecord> get_latest_record() const;
+    size_t size() const;
+
+    // 打开 dir 下的持久化降采样历史，之后 add_record 的样本同时汇总进去
+    bool open_rollups(const std::string& dir);
+    // 写出 {"points": [...], "resolution": ..., "resolution_ms": ...}。resolution 为 AUTO 时按 since_ms 到 now_ms 的跨度选择，
+    // raw 的点与 write_records 相同，其余为 min/max/avg 桶
+    void write_history(JsonWriter& writer, long long since_ms, RollupResolution resolution, long long now_ms) const;
+    json rollup_stats() const { return rollup_.stats(); }
+
+    // 在锁内按时间顺序访问 since_ms 之后（含）最新的至多 max_records 个样本，返回访问的个数。
+    // 从最新一端向前定位起点，只触及结果范围内的样本
+    template <typename Fn>
+    size_t visit_records(long long since_ms, size_t max_records, Fn&& fn) const {
+        std::lock_guard<std::mutex> lock(db_mutex_);
+        size_t count = range_count(since_ms, max_records);
+        for (size_t i = size_ - count; i < size_; ++i) fn(MetricsSampleView(*this, slot_of(i)));
+        return count;
+    }
 
 private:
-    explicit TimeSeriesDatabase(size_t max_size);
+    friend class MetricsSampleView;
+    TimeSeriesDatabase(size_t max_size, size_t core_width);
+
+    // 第 i 旧的样本所在的槽位
+    size_t slot_of(size_t i) const { return (head_ + capacity_ - size_ + i) % capacity_; }
+    size_t range_count(long long since_ms, size_t max_records) const;
+    void store(const MetricsRecord& record);
+
+    enum Flag : uint8_t { CHARGING = 1, SCREEN_ON = 2, AUDIO_PLAYING = 4, LOCATION_ACTIVE = 8 };
 
     static std::shared_ptr<TimeSeriesDatabase> instance_;
     static std::mutex instance_mutex_;
 
-    size_t max_size_;
-    std::deque<MetricsRecord> records_;
+    const size_t capacity_;
+    const size_t core_width_;
+    size_t head_ = 0;   // 下一个写入的槽位
+    size_t size_ = 0;
+    std::unique_ptr<long long[]> timestamp_ms_;
+    std::unique_ptr<float[]> cpu_usage_;
+    std::unique_ptr<float[]> per_core_;     // capacity_ × core_width_
+    std::unique_ptr<uint8_t[]> core_count_;
+    std::unique_ptr<long[]> mem_total_kb_;
+    std::unique_ptr<long[]> mem_available_kb_;
+    std::unique_ptr<long[]> swap_total_kb_;
+    std::unique_ptr<long[]> swap_free_kb_;
+    std::unique_ptr<int16_t[]> battery_level_;
+    std::unique_ptr<float[]> battery_temp_;
+    std::unique_ptr<float[]> battery_power_;
+    std::unique_ptr<uint8_t[]> flags_;
     mutable std::mutex db_mutex_;
+    MetricsRollup rollup_;
 };
 
-#endif // CERBERUS_TIME_SERIES_DATABASE_H
\ No newline at end of file
+#endif // CERBERUS_TIME_SERIES_DATABASE_H
@@ -8,12 +8,16 @@
 #include <netinet/tcp.h>
 #include <arpa/inet.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include <cerrno>
 #include <cstring>
 #include <algorithm>
 #include <vector>
 #include <cstddef>
-#include <sys/select.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/uio.h>
+#include <climits>
 #include <thread>
 
 #define LOG_TAG "cerberusd_dev_socket_v1"
@@ -21,19 +25,78 @@
 #define LOGW(...) __android_log_print(ANDROID_LOG_WARN, LOG_TAG, __VA_ARGS__)
 #define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
 
+struct TopicName {
+    PushTopic topic;
+    const char* name;
+};
+
+static constexpr TopicName TOPIC_NAMES[] = {
+    {TOPIC_DASHBOARD, "dashboard"},
+    {TOPIC_STATS, "stats"},
+    {TOPIC_LOGS, "logs"},
+    {TOPIC_PROBE_CONFIG, "probe_config"},
+    {TOPIC_DOZE, "doze"},
+};
+
+uint32_t parse_push_topics(const nlohmann::json& names) {
+    uint32_t topics = 0;
+    if (!names.is_array()) return topics;
+    for (const auto& item : names) {
+        if (!item.is_string()) continue;
+        const std::string name = item.get<std::string>();
+        for (const auto& entry : TOPIC_NAMES) {
+            if (name == entry.name) topics |= entry.topic;
+        }
+    }
+    return topics;
+}
+
+nlohmann::json push_topic_names(uint32_t topics) {
+    nlohmann::json names = nlohmann::json::array();
+    for (const auto& entry : TOPIC_NAMES) {
+        if (topics & entry.topic) names.push_back(entry.name);
+    }
+    return names;
+}
+
+// 单次 epoll_wait 最多取回的事件数
+constexpr int MAX_EPOLL_EVENTS = 64;
+// 单次读取的块大小；边沿触发下会循环读取直到 EAGAIN
+constexpr size_t READ_CHUNK_SIZE = 16 * 1024;
+// 监听队列长度，需容纳大量客户端同时重连
+constexpr int LISTEN_BACKLOG = 128;
+// 单个客户端发送队列的字节预算，约为数十次完整仪表盘推送
+constexpr size_t MAX_CLIENT_QUEUE_BYTES = 4 * 1024 * 1024;
+// 队列非空且持续这么久没有任何写出进展，视为客户端停滞并断开
+constexpr auto CLIENT_STALL_TIMEOUT = std::chrono::seconds(30);
+// 单次 sendmsg 聚合的最大帧数
+constexpr size_t MAX_IOV_PER_WRITE = 64;
+
 UdsServer::UdsServer(const std::string& uds_socket_name, int tcp_port)
     : uds_socket_name_(uds_socket_name),
       tcp_port_(tcp_port),
       server_fd_uds_(-1),
       server_fd_tcp_(-1),
-      is_running_(false) {}
+      epoll_fd_(-1),
+      wake_fd_(-1),
+      is_running_(false),
+      stall_timeout_(CLIENT_STALL_TIMEOUT) {}
 
 // ... (所有非 run/stop 的函数保持不变) ...
 UdsServer::~UdsServer() {
     stop();
+    if (epoll_fd_ != -1) close(epoll_fd_);
+    if (wake_fd_ != -1) close(wake_fd_);
+}
+
+void UdsServer::wake_event_loop() {
+    if (wake_fd_ == -1) return;
+    uint64_t one = 1;
+    ssize_t ret = write(wake_fd_, &one, sizeof(one));
+    (void)ret;
 }
 
-void UdsServer::set_message_handler(std::function<void(int, const std::string&)> handler) {
+void UdsServer::set_message_handler(std::function<void(int, std::string_view)> handler) {
     on_message_received_ = std::move(handler);
 }
 
@@ -51,10 +114,69 @@ void UdsServer::broadcast_message_to_ui(const std::string& message) {
     std::lock_guard<std::mutex> lock(client_mutex_);
     if (ui_client_fds_.empty()) return;
 
-    auto ui_clients_copy = ui_client_fds_;
-    for (int fd : ui_clients_copy) {
-        send_message(fd, message);
+    broadcast_locked([&message](WireEncoding encoding) {
+        if (encoding == WireEncoding::JSON_LINES) return message + "\n";
+        return wire_codec::encode_frame(nlohmann::json::parse(message), encoding);
+    }, [this](int fd) { return ui_client_fds_.count(fd) > 0; });
+}
+
+void UdsServer::subscribe(int client_fd, uint32_t topics) {
+    std::lock_guard<std::mutex> lock(client_mutex_);
+    auto it = connections_.find(client_fd);
+    if (it != connections_.end()) it->second.topics |= topics;
+}
+
+void UdsServer::unsubscribe(int client_fd, uint32_t topics) {
+    std::lock_guard<std::mutex> lock(client_mutex_);
+    auto it = connections_.find(client_fd);
+    if (it != connections_.end()) it->second.topics &= ~topics;
+}
+
+void UdsServer::set_subscriptions(int client_fd, uint32_t topics) {
+    std::lock_guard<std::mutex> lock(client_mutex_);
+    auto it = connections_.find(client_fd);
+    if (it != connections_.end()) it->second.topics = topics;
+}
+
+uint32_t UdsServer::subscriptions(int client_fd) const {
+    std::lock_guard<std::mutex> lock(client_mutex_);
+    auto it = connections_.find(client_fd);
+    return it != connections_.end() ? it->second.topics : 0;
+}
+
+bool UdsServer::has_subscribers(uint32_t topic, const std::set<int>& excluded_fds) const {
+    std::lock_guard<std::mutex> lock(client_mutex_);
+    for (const auto& [fd, conn] : connections_) {
+        if ((conn.topics & topic) && excluded_fds.count(fd) == 0) return true;
     }
+    return false;
+}
+
+size_t UdsServer::publish(uint32_t topic, const std::function<nlohmann::json()>& build, const std::set<int>& excluded_fds) {
+    // 没有订阅者时连消息都不构建；构建在锁外进行，避免大载荷的序列化阻塞其他发送
+    if (!has_subscribers(topic, excluded_fds)) return 0;
+    nlohmann::json message = build();
+
+    std::lock_guard<std::mutex> lock(client_mutex_);
+    return broadcast_locked([&message](WireEncoding encoding) {
+        return wire_codec::encode_frame(message, encoding);
+    }, [this, topic, &excluded_fds](int fd) {
+        auto it = connections_.find(fd);
+        return it != connections_.end() && (it->second.topics & topic) && excluded_fds.count(fd) == 0;
+    });
+}
+
+size_t UdsServer::publish_text(uint32_t topic, const std::function<std::string()>& build, const std::set<int>& excluded_fds) {
+    if (!has_subscribers(topic, excluded_fds)) return 0;
+    std::string text = build();
+
+    std::lock_guard<std::mutex> lock(client_mutex_);
+    return broadcast_locked([&text](WireEncoding encoding) {
+        return wire_codec::encode_text_frame(text, encoding);
+    }, [this, topic, &excluded_fds](int fd) {
+        auto it = connections_.find(fd);
+        return it != connections_.end() && (it->second.topics & topic) && excluded_fds.count(fd) == 0;
+    });
 }
 
 bool UdsServer::has_clients() const {
@@ -62,32 +184,81 @@ bool UdsServer::has_clients() const {
     return !client_fds_.empty();
 }
 
-void UdsServer::add_client(int client_fd) {
+bool UdsServer::has_clients_except(int excluded_fd) const {
+    std::lock_guard<std::mutex> lock(client_mutex_);
+    return std::any_of(client_fds_.begin(), client_fds_.end(), [excluded_fd](int fd) { return fd != excluded_fd; });
+}
+
+bool UdsServer::has_clients_except(const std::set<int>& excluded_fds) const {
+    std::lock_guard<std::mutex> lock(client_mutex_);
+    return std::any_of(client_fds_.begin(), client_fds_.end(), [&excluded_fds](int fd) { return excluded_fds.count(fd) == 0; });
+}
+
+UdsServer::OutboundFrame::OutboundFrame(OutboundFrame&& other) noexcept
+    : data(std::move(other.data)), attached_fd(other.attached_fd) {
+    other.attached_fd = -1;
+}
+
+UdsServer::OutboundFrame& UdsServer::OutboundFrame::operator=(OutboundFrame&& other) noexcept {
+    if (this != &other) {
+        release_attached_fd();
+        data = std::move(other.data);
+        attached_fd = other.attached_fd;
+        other.attached_fd = -1;
+    }
+    return *this;
+}
+
+UdsServer::OutboundFrame::~OutboundFrame() {
+    release_attached_fd();
+}
+
+void UdsServer::OutboundFrame::release_attached_fd() {
+    if (attached_fd != -1) {
+        close(attached_fd);
+        attached_fd = -1;
+    }
+}
+
+void UdsServer::add_client(int client_fd, bool is_local) {
+    struct epoll_event ev {};
+    ev.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+    ev.data.fd = client_fd;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, client_fd, &ev) == -1) {
+        LOGE("epoll_ctl(ADD) failed for fd %d: %s", client_fd, strerror(errno));
+        close(client_fd);
+        return;
+    }
+    receive_buffers_[client_fd] = ReceiveBuffer{};
     std::lock_guard<std::mutex> lock(client_mutex_);
     client_fds_.push_back(client_fd);
-    client_buffers_[client_fd] = "";
+    ClientConnection conn;
+    conn.id = next_connection_id_++;
+    conn.is_local = is_local;
+    connections_[client_fd] = std::move(conn);
     LOGI("Client connected, fd: %d. Total clients: %zu", client_fd, client_fds_.size());
 }
 
-void UdsServer::remove_client(int client_fd) {
+bool UdsServer::remove_client(int client_fd) {
+    receive_buffers_.erase(client_fd);
     std::lock_guard<std::mutex> lock(client_mutex_);
     auto it = std::remove(client_fds_.begin(), client_fds_.end(), client_fd);
-    if (it != client_fds_.end()) {
-        client_fds_.erase(it, client_fds_.end());
-        client_buffers_.erase(client_fd);
-        ui_client_fds_.erase(client_fd);
-        close(client_fd);
-        LOGI("Client disconnected, fd: %d. Total clients: %zu, UI clients: %zu", client_fd, client_fds_.size(), ui_client_fds_.size());
-        if (on_disconnect_) {
-            on_disconnect_(client_fd);
-        }
-    }
+    if (it == client_fds_.end()) return false;
+    client_fds_.erase(it, client_fds_.end());
+    connections_.erase(client_fd);
+    ui_client_fds_.erase(client_fd);
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, client_fd, nullptr);
+    close(client_fd);
+    LOGI("Client disconnected, fd: %d. Total clients: %zu, UI clients: %zu", client_fd, client_fds_.size(), ui_client_fds_.size());
+    return true;
 }
 
 void UdsServer::schedule_client_removal(int client_fd) {
     std::lock_guard<std::mutex> lock(clients_to_remove_mutex_);
     if (std::find(clients_to_remove_.begin(), clients_to_remove_.end(), client_fd) == clients_to_remove_.end()) {
         clients_to_remove_.push_back(client_fd);
+        // 发送失败可能发生在工作线程上，唤醒事件循环以便及时回收
+        wake_event_loop();
     }
 }
 
@@ -101,90 +272,376 @@ void UdsServer::process_clients_to_remove() {
         to_remove.swap(clients_to_remove_);
     }
 
+    std::vector<int> removed;
     for (int fd : to_remove) {
-        remove_client(fd);
+        if (remove_client(fd)) removed.push_back(fd);
     }
+    // 断开处理器在 client_mutex_ 之外调用：处理器会回到服务器上退订、发送，需要同一把锁。
+    // fd 的复用只发生在本线程的 accept 中，处理器执行期间不会被新连接占用
+    if (!on_disconnect_) return;
+    for (int fd : removed) on_disconnect_(fd);
 }
 
 
-void UdsServer::broadcast_message_except(const std::string& message, int excluded_fd) {
+int UdsServer::reap_stalled_clients() {
+    auto now = std::chrono::steady_clock::now();
+    auto next_deadline = std::chrono::steady_clock::time_point::max();
     std::lock_guard<std::mutex> lock(client_mutex_);
-    if (client_fds_.empty()) return;
+    for (const auto& [fd, conn] : connections_) {
+        if (conn.outbound.empty()) continue;
+        auto deadline = conn.last_progress + stall_timeout_;
+        if (now > deadline) {
+            LOGW("Client fd %d made no write progress for %llds with %zu bytes queued, disconnecting.",
+                 fd, (long long)std::chrono::duration_cast<std::chrono::seconds>(now - conn.last_progress).count(),
+                 conn.queued_bytes);
+            schedule_client_removal(fd);
+        } else {
+            next_deadline = std::min(next_deadline, deadline);
+        }
+    }
+    if (next_deadline == std::chrono::steady_clock::time_point::max()) return -1;
+    // 向上取整，避免在到期前一刻醒来后又以 0 超时空转
+    return static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(next_deadline - now).count()) + 1;
+}
 
-    auto clients_copy = client_fds_;
-    for (int fd : clients_copy) {
-        if (fd != excluded_fd) {
-            send_message(fd, message);
+WireEncoding UdsServer::encoding_of_locked(int client_fd) const {
+    auto it = connections_.find(client_fd);
+    return it != connections_.end() ? it->second.encoding : WireEncoding::JSON_LINES;
+}
+
+void UdsServer::set_write_interest_locked(int client_fd, ClientConnection& conn, bool enabled) {
+    if (conn.write_armed == enabled) return;
+    struct epoll_event ev {};
+    ev.events = EPOLLIN | EPOLLRDHUP | EPOLLET | (enabled ? static_cast<uint32_t>(EPOLLOUT) : 0u);
+    ev.data.fd = client_fd;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, client_fd, &ev) == 0) {
+        conn.write_armed = enabled;
+        // 队列开始积压：事件循环可能正无限期阻塞，唤醒它按停滞时限重新计算超时
+        if (enabled) wake_event_loop();
+    } else {
+        LOGE("epoll_ctl(MOD) failed for fd %d: %s", client_fd, strerror(errno));
+    }
+}
+
+void UdsServer::flush_locked(int client_fd, ClientConnection& conn) {
+    while (!conn.outbound.empty()) {
+        struct iovec iov[MAX_IOV_PER_WRITE];
+        size_t iov_count = 0;
+        for (auto it = conn.outbound.begin(); it != conn.outbound.end() && iov_count < MAX_IOV_PER_WRITE; ++it) {
+            // 附带描述符的帧只能位于一次写出的开头，描述符才会与它的首字节一同到达
+            if (iov_count > 0 && it->attached_fd != -1) break;
+            size_t offset = (iov_count == 0) ? conn.front_offset : 0;
+            iov[iov_count].iov_base = const_cast<char*>(it->data->data() + offset);
+            iov[iov_count].iov_len = it->data->size() - offset;
+            ++iov_count;
+        }
+
+        // 等价于 writev，但可以带 MSG_NOSIGNAL 避免对端关闭时触发 SIGPIPE
+        struct msghdr msg {};
+        msg.msg_iov = iov;
+        msg.msg_iovlen = iov_count;
+        alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+        int attached_fd = conn.outbound.front().attached_fd;
+        if (attached_fd != -1) {
+            std::memset(control, 0, sizeof(control));
+            msg.msg_control = control;
+            msg.msg_controllen = sizeof(control);
+            struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+            cmsg->cmsg_level = SOL_SOCKET;
+            cmsg->cmsg_type = SCM_RIGHTS;
+            cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+            std::memcpy(CMSG_DATA(cmsg), &attached_fd, sizeof(int));
+        }
+        ssize_t written = sendmsg(client_fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                set_write_interest_locked(client_fd, conn, true);
+                return;
+            }
+            if (errno == EPIPE || errno == ECONNRESET) {
+                LOGW("Send to fd %d failed (connection closed), scheduling for removal.", client_fd);
+            } else {
+                LOGE("Send to fd %d failed: %s", client_fd, strerror(errno));
+            }
+            schedule_client_removal(client_fd);
+            return;
+        }
+
+        conn.last_progress = std::chrono::steady_clock::now();
+        // 只要写出了字节，描述符就已随之进入对端的接收队列
+        if (attached_fd != -1 && written > 0) conn.outbound.front().release_attached_fd();
+        conn.queued_bytes -= static_cast<size_t>(written);
+        size_t remaining = static_cast<size_t>(written);
+        while (remaining > 0) {
+            size_t front_left = conn.outbound.front().data->size() - conn.front_offset;
+            if (remaining < front_left) {
+                conn.front_offset += remaining;
+                break;
+            }
+            remaining -= front_left;
+            conn.outbound.pop_front();
+            conn.front_offset = 0;
         }
     }
+    set_write_interest_locked(client_fd, conn, false);
 }
 
-bool UdsServer::send_message(int client_fd, const std::string& message) {
-    std::string line = message + "\n";
-    ssize_t bytes_sent = send(client_fd, line.c_str(), line.length(), MSG_NOSIGNAL);
-    if (bytes_sent < 0) {
-        if (errno == EPIPE || errno == ECONNRESET) {
-            LOGW("Send to fd %d failed (connection closed), scheduling for removal.", client_fd);
+bool UdsServer::enqueue_locked(int client_fd, SharedFrame frame, OverflowPolicy policy, int attached_fd) {
+    // 未入队时由这里负责关闭附带的描述符
+    OutboundFrame entry(std::move(frame), attached_fd);
+    auto it = connections_.find(client_fd);
+    if (it == connections_.end()) return false;
+    ClientConnection& conn = it->second;
+    auto now = std::chrono::steady_clock::now();
+
+    if (!conn.outbound.empty() && now - conn.last_progress > stall_timeout_) {
+        LOGW("Client fd %d made no write progress for %llds with %zu bytes queued, disconnecting.",
+             client_fd, (long long)std::chrono::duration_cast<std::chrono::seconds>(now - conn.last_progress).count(),
+             conn.queued_bytes);
+        schedule_client_removal(client_fd);
+        return false;
+    }
+    if (conn.queued_bytes + entry.data->size() > MAX_CLIENT_QUEUE_BYTES) {
+        if (policy == OverflowPolicy::DISCONNECT) {
+            LOGW("Send queue of fd %d exceeded %zu bytes, disconnecting.", client_fd, MAX_CLIENT_QUEUE_BYTES);
             schedule_client_removal(client_fd);
-        } else {
-            LOGE("Send to fd %d failed: %s", client_fd, strerror(errno));
+        } else if (conn.dropped_frames++ % 100 == 0) {
+            LOGW("Send queue of fd %d is full (%zu bytes), dropped %llu broadcast frame(s) so far.",
+                 client_fd, conn.queued_bytes, (unsigned long long)conn.dropped_frames);
         }
         return false;
     }
+
+    if (conn.outbound.empty()) conn.last_progress = now;
+    conn.queued_bytes += entry.data->size();
+    conn.outbound.push_back(std::move(entry));
+    // 之前已在等待可写事件时由事件循环负责写出，否则立即尝试
+    if (!conn.write_armed) flush_locked(client_fd, conn);
     return true;
 }
 
-void UdsServer::broadcast_message(const std::string& message) {
-    std::lock_guard<std::mutex> lock(client_mutex_);
-    if (client_fds_.empty()) return;
+bool UdsServer::send_text_locked(int client_fd, const std::string& message) {
+    WireEncoding encoding = encoding_of_locked(client_fd);
+    if (encoding == WireEncoding::JSON_LINES) {
+        return enqueue_locked(client_fd, std::make_shared<const std::string>(message + "\n"), OverflowPolicy::DISCONNECT);
+    }
+    try {
+        return enqueue_locked(client_fd, std::make_shared<const std::string>(
+            wire_codec::encode_frame(nlohmann::json::parse(message), encoding)), OverflowPolicy::DISCONNECT);
+    } catch (const nlohmann::json::exception& e) {
+        LOGE("Failed to transcode message for fd %d: %s", client_fd, e.what());
+        return false;
+    }
+}
+
+size_t UdsServer::broadcast_locked(const std::function<std::string(WireEncoding)>& make_frame,
+                                 const std::function<bool(int)>& include) {
+    if (client_fds_.empty()) return 0;
 
+    size_t bytes_sent = 0;
+    // 每种编码最多序列化一次，所有同编码的客户端队列共享同一份帧
+    std::map<WireEncoding, SharedFrame> frames;
     auto clients_copy = client_fds_;
     for (int fd : clients_copy) {
-        send_message(fd, message);
+        if (!include(fd)) continue;
+        WireEncoding encoding = encoding_of_locked(fd);
+        auto it = frames.find(encoding);
+        if (it == frames.end()) {
+            try {
+                it = frames.emplace(encoding, std::make_shared<const std::string>(make_frame(encoding))).first;
+            } catch (const nlohmann::json::exception& e) {
+                LOGE("Failed to encode broadcast as %s: %s", wire_codec::encoding_name(encoding), e.what());
+                continue;
+            }
+        }
+        if (enqueue_locked(fd, it->second, OverflowPolicy::DROP)) bytes_sent += it->second->size();
     }
+    return bytes_sent;
 }
 
-void UdsServer::handle_client_data(int client_fd) {
-    char buffer[4096];
-    ssize_t bytes_read = recv(client_fd, buffer, sizeof(buffer), 0);
+void UdsServer::broadcast_message_except(const std::string& message, int excluded_fd) {
+    broadcast_message_except(message, std::set<int>{excluded_fd});
+}
 
-    if (bytes_read <= 0) {
-        schedule_client_removal(client_fd);
-        return;
+void UdsServer::broadcast_message_except(const std::string& message, const std::set<int>& excluded_fds) {
+    std::lock_guard<std::mutex> lock(client_mutex_);
+    broadcast_locked([&message](WireEncoding encoding) {
+        if (encoding == WireEncoding::JSON_LINES) return message + "\n";
+        return wire_codec::encode_frame(nlohmann::json::parse(message), encoding);
+    }, [&excluded_fds](int fd) { return excluded_fds.count(fd) == 0; });
+}
+
+bool UdsServer::send_message(int client_fd, const std::string& message) {
+    std::lock_guard<std::mutex> lock(client_mutex_);
+    return send_text_locked(client_fd, message);
+}
+
+void UdsServer::broadcast_message(const std::string& message) {
+    broadcast_message_except(message, std::set<int>{});
+}
+
+size_t UdsServer::send_json(int client_fd, const nlohmann::json& message) {
+    std::lock_guard<std::mutex> lock(client_mutex_);
+    auto frame = std::make_shared<const std::string>(wire_codec::encode_frame(message, encoding_of_locked(client_fd)));
+    return enqueue_locked(client_fd, frame, OverflowPolicy::DISCONNECT) ? frame->size() : 0;
+}
+
+size_t UdsServer::send_json(int client_fd, uint64_t connection_id, const nlohmann::json& message) {
+    std::lock_guard<std::mutex> lock(client_mutex_);
+    auto it = connections_.find(client_fd);
+    if (it == connections_.end() || it->second.id != connection_id) return 0;
+    auto frame = std::make_shared<const std::string>(wire_codec::encode_frame(message, it->second.encoding));
+    return enqueue_locked(client_fd, frame, OverflowPolicy::DISCONNECT) ? frame->size() : 0;
+}
+
+size_t UdsServer::send_json_text(int client_fd, std::string text) {
+    std::lock_guard<std::mutex> lock(client_mutex_);
+    auto frame = std::make_shared<const std::string>(wire_codec::encode_text_frame(std::move(text), encoding_of_locked(client_fd)));
+    return enqueue_locked(client_fd, frame, OverflowPolicy::DISCONNECT) ? frame->size() : 0;
+}
+
+size_t UdsServer::send_json_text(int client_fd, uint64_t connection_id, std::string text) {
+    std::lock_guard<std::mutex> lock(client_mutex_);
+    auto it = connections_.find(client_fd);
+    if (it == connections_.end() || it->second.id != connection_id) return 0;
+    auto frame = std::make_shared<const std::string>(wire_codec::encode_text_frame(std::move(text), it->second.encoding));
+    return enqueue_locked(client_fd, frame, OverflowPolicy::DISCONNECT) ? frame->size() : 0;
+}
+
+size_t UdsServer::send_json_with_fd(int client_fd, const nlohmann::json& message, int shared_fd) {
+    std::lock_guard<std::mutex> lock(client_mutex_);
+    auto it = connections_.find(client_fd);
+    if (it == connections_.end() || !it->second.is_local) return 0;
+    int attached_fd = fcntl(shared_fd, F_DUPFD_CLOEXEC, 0);
+    if (attached_fd == -1) {
+        LOGE("Failed to dup fd %d for client fd %d: %s", shared_fd, client_fd, strerror(errno));
+        return 0;
     }
+    auto frame = std::make_shared<const std::string>(wire_codec::encode_frame(message, it->second.encoding));
+    return enqueue_locked(client_fd, frame, OverflowPolicy::DISCONNECT, attached_fd) ? frame->size() : 0;
+}
+
+uint64_t UdsServer::connection_id(int client_fd) const {
+    std::lock_guard<std::mutex> lock(client_mutex_);
+    auto it = connections_.find(client_fd);
+    return it != connections_.end() ? it->second.id : 0;
+}
 
-    std::string received_data(buffer, bytes_read);
-    std::vector<std::string> messages_to_process;
+size_t UdsServer::broadcast_json(const nlohmann::json& message) {
+    return broadcast_json_except(message, std::set<int>{});
+}
 
-    {
-        std::lock_guard<std::mutex> lock(client_mutex_);
-        auto buffer_it = client_buffers_.find(client_fd);
-        if (buffer_it == client_buffers_.end()) return;
-        
-        buffer_it->second += received_data;
-        std::string& client_buffer = buffer_it->second;
-
-        size_t pos;
-        while ((pos = client_buffer.find('\n')) != std::string::npos) {
-            std::string message = client_buffer.substr(0, pos);
-            if (!message.empty()) {
-                messages_to_process.push_back(message);
-            }
-            client_buffer.erase(0, pos + 1);
+size_t UdsServer::broadcast_json_except(const nlohmann::json& message, const std::set<int>& excluded_fds) {
+    std::lock_guard<std::mutex> lock(client_mutex_);
+    return broadcast_locked([&message](WireEncoding encoding) {
+        return wire_codec::encode_frame(message, encoding);
+    }, [&excluded_fds](int fd) { return excluded_fds.count(fd) == 0; });
+}
+
+void UdsServer::switch_client_encoding(int client_fd, WireEncoding encoding, const nlohmann::json& ack) {
+    std::lock_guard<std::mutex> lock(client_mutex_);
+    auto it = connections_.find(client_fd);
+    if (it == connections_.end()) return;
+    // 应答与之前的 JSON 行按序排在队列中，之后入队的帧才使用新编码
+    enqueue_locked(client_fd, std::make_shared<const std::string>(wire_codec::encode_frame(ack, it->second.encoding)),
+                   OverflowPolicy::DISCONNECT);
+    it->second.encoding = encoding;
+    LOGI("Client fd %d switched to %s encoding.", client_fd, wire_codec::encoding_name(encoding));
+}
+
+void UdsServer::handle_client_data(int client_fd) {
+    auto buffer_it = receive_buffers_.find(client_fd);
+    if (buffer_it == receive_buffers_.end()) return;
+    ReceiveBuffer& inbound = buffer_it->second;
+
+    // 边沿触发：必须一次读空内核缓冲，否则剩余数据不会再产生事件。
+    // 数据直接读入接收缓冲区，不经过栈上的临时数组
+    bool peer_closed = false;
+    while (true) {
+        char* dest = inbound.prepare(READ_CHUNK_SIZE);
+        ssize_t bytes_read = recv(client_fd, dest, inbound.writable(), MSG_DONTWAIT);
+        if (bytes_read > 0) {
+            inbound.commit(static_cast<size_t>(bytes_read));
+            // 对端持续写入时缓冲区会一直增长：超过单帧上限就先分发已完整的消息，
+            // 剩下的若仍超限即是单个超长帧，立即断开，缓冲区至多比上限多一次读入的大小
+            if (inbound.buffered() > MAX_WIRE_FRAME_BYTES && !dispatch_buffered_messages(client_fd, inbound)) return;
+            continue;
         }
+        if (bytes_read < 0 && errno == EINTR) continue;
+        if (bytes_read < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        peer_closed = true;
+        break;
+    }
+    if (peer_closed) {
+        schedule_client_removal(client_fd);
     }
+    dispatch_buffered_messages(client_fd, inbound);
+}
 
-    if (on_message_received_ && !messages_to_process.empty()) {
-        for (const auto& msg : messages_to_process) {
-            on_message_received_(client_fd, msg);
+bool UdsServer::dispatch_buffered_messages(int client_fd, ReceiveBuffer& inbound) {
+    std::string_view payload;
+    while (true) {
+        // 每条消息都重新读取编码：握手消息的处理会切换后续数据的编码
+        WireEncoding encoding;
+        {
+            std::lock_guard<std::mutex> lock(client_mutex_);
+            encoding = encoding_of_locked(client_fd);
+        }
+        ReceiveBuffer::Status status = inbound.next_message(encoding, payload);
+        if (status == ReceiveBuffer::Status::NEED_MORE) return true;
+        if (status == ReceiveBuffer::Status::OVERSIZED) {
+            LOGW("Oversized frame from fd %d, disconnecting.", client_fd);
+            schedule_client_removal(client_fd);
+            return false;
+        }
+        if (!on_message_received_) continue;
+        if (encoding == WireEncoding::JSON_LINES || encoding == WireEncoding::JSON_FRAMED) {
+            on_message_received_(client_fd, payload);
+            continue;
+        }
+        // 上行消息量小，二进制帧统一还原为 JSON 文本交给现有的消息处理器
+        try {
+            std::string text = wire_codec::decode_payload(payload, encoding).dump();
+            on_message_received_(client_fd, text);
+        } catch (const nlohmann::json::exception& e) {
+            LOGE("Failed to decode %s frame from fd %d: %s", wire_codec::encoding_name(encoding), client_fd, e.what());
         }
     }
 }
 
+void UdsServer::handle_client_writable(int client_fd) {
+    std::lock_guard<std::mutex> lock(client_mutex_);
+    auto it = connections_.find(client_fd);
+    if (it == connections_.end()) return;
+    flush_locked(client_fd, it->second);
+}
+
+void UdsServer::accept_clients(int listen_fd, bool is_tcp) {
+    // 监听 socket 同样是边沿触发，循环 accept 直到队列为空
+    while (true) {
+        int new_socket = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (new_socket < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                LOGW("accept4() failed: %s", strerror(errno));
+            }
+            return;
+        }
+        if (is_tcp) {
+            LOGI("Accepted new TCP connection.");
+            int nodelay_opt = 1;
+            setsockopt(new_socket, IPPROTO_TCP, TCP_NODELAY, &nodelay_opt, sizeof(nodelay_opt));
+        } else {
+            LOGI("Accepted new UDS connection.");
+        }
+        add_client(new_socket, !is_tcp);
+    }
+}
 
 void UdsServer::run() {
     // 步骤1: 初始化 UDS Socket (文件系统路径)
-    server_fd_uds_ = socket(AF_LOCAL, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    server_fd_uds_ = socket(AF_LOCAL, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
     if (server_fd_uds_ == -1) {
         LOGE("Failed to create UDS socket: %s", strerror(errno));
         return;
@@ -211,7 +668,7 @@ void UdsServer::run() {
         return;
     }
 
-    if (listen(server_fd_uds_, 5) == -1) {
+    if (listen(server_fd_uds_, LISTEN_BACKLOG) == -1) {
         LOGE("Failed to listen on UDS socket: %s", strerror(errno));
         close(server_fd_uds_);
         unlink(uds_socket_name_.c_str());
@@ -220,7 +677,7 @@ void UdsServer::run() {
     LOGI("Server listening on UDS path: %s (permissions set to 0666)", uds_socket_name_.c_str());
 
     // 步骤2: 初始化 TCP Socket (保持不变)
-    server_fd_tcp_ = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    server_fd_tcp_ = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
     if (server_fd_tcp_ == -1) {
         LOGE("Failed to create TCP socket: %s", strerror(errno));
         close(server_fd_uds_);
@@ -241,7 +698,7 @@ void UdsServer::run() {
         close(server_fd_tcp_);
         return;
     }
-    if (listen(server_fd_tcp_, 5) == -1) {
+    if (listen(server_fd_tcp_, LISTEN_BACKLOG) == -1) {
         LOGE("Failed to listen on TCP socket: %s", strerror(errno));
         close(server_fd_uds_);
         close(server_fd_tcp_);
@@ -249,78 +706,82 @@ void UdsServer::run() {
     }
     LOGI("Server listening on TCP 127.0.0.1:%d", tcp_port_);
 
+    // 步骤3: 建立 epoll 与唤醒用的 eventfd
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epoll_fd_ == -1 || wake_fd_ == -1) {
+        LOGE("Failed to create epoll/eventfd: %s", strerror(errno));
+        close(server_fd_uds_);
+        close(server_fd_tcp_);
+        return;
+    }
+    for (int fd : {server_fd_uds_, server_fd_tcp_, wake_fd_}) {
+        struct epoll_event ev {};
+        ev.events = EPOLLIN | EPOLLET;
+        ev.data.fd = fd;
+        epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev);
+    }
+
     is_running_ = true;
 
-    // 步骤3: 主循环同时监控两个监听Socket (保持不变)
+    // 步骤4: 事件循环。无事件且没有积压的发送队列时无限期阻塞，不再每秒空转
+    struct epoll_event events[MAX_EPOLL_EVENTS];
     while (is_running_) {
+        // 停滞检查不能只在入队时进行：不再有新消息的客户端同样要被回收
+        int timeout_ms = reap_stalled_clients();
         process_clients_to_remove();
 
-        fd_set read_fds;
-        FD_ZERO(&read_fds);
-        FD_SET(server_fd_uds_, &read_fds);
-        FD_SET(server_fd_tcp_, &read_fds);
-        int max_fd = std::max(server_fd_uds_, server_fd_tcp_);
-
-        {
-            std::lock_guard<std::mutex> lock(client_mutex_);
-            for (int fd : client_fds_) {
-                FD_SET(fd, &read_fds);
-                max_fd = std::max(max_fd, fd);
-            }
-        }
-        
-        struct timeval tv { .tv_sec = 1, .tv_usec = 0 };
-        int activity = select(max_fd + 1, &read_fds, nullptr, nullptr, &tv);
-
+        int count = epoll_wait(epoll_fd_, events, MAX_EPOLL_EVENTS, timeout_ms);
         if (!is_running_) break;
-        if (activity < 0) {
+        if (count < 0) {
             if (errno == EINTR) continue;
-            LOGE("select() error: %s", strerror(errno));
+            LOGE("epoll_wait() error: %s", strerror(errno));
             break;
         }
-        if (activity == 0) continue;
-
-        if (FD_ISSET(server_fd_uds_, &read_fds)) {
-            struct sockaddr_un client_addr;
-            socklen_t client_len = sizeof(client_addr);
-            int new_socket = accept(server_fd_uds_, (struct sockaddr*)&client_addr, &client_len);
-            if (new_socket >= 0) {
-                LOGI("Accepted new UDS connection.");
-                add_client(new_socket);
-            }
-        }
-        
-        if (FD_ISSET(server_fd_tcp_, &read_fds)) {
-            struct sockaddr_in client_addr;
-            socklen_t client_len = sizeof(client_addr);
-            int new_socket = accept(server_fd_tcp_, (struct sockaddr*)&client_addr, &client_len);
-            if (new_socket >= 0) {
-                LOGI("Accepted new TCP connection.");
-                int nodelay_opt = 1;
-                setsockopt(new_socket, IPPROTO_TCP, TCP_NODELAY, &nodelay_opt, sizeof(nodelay_opt));
-                add_client(new_socket);
+
+        for (int i = 0; i < count; ++i) {
+            int fd = events[i].data.fd;
+            if (fd == wake_fd_) {
+                uint64_t value;
+                while (read(wake_fd_, &value, sizeof(value)) > 0) {}
+            } else if (fd == server_fd_uds_) {
+                accept_clients(server_fd_uds_, false);
+            } else if (fd == server_fd_tcp_) {
+                accept_clients(server_fd_tcp_, true);
+            } else {
+                if (events[i].events & EPOLLOUT) {
+                    handle_client_writable(fd);
+                }
+                if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+                    handle_client_data(fd);
+                }
             }
         }
-        
-        std::vector<int> clients_to_check;
-        {
-            std::lock_guard<std::mutex> lock(client_mutex_);
-            clients_to_check = client_fds_;
-        }
-        for (int fd : clients_to_check) {
-            if (FD_ISSET(fd, &read_fds)) {
-                handle_client_data(fd);
+    }
+    // 回收剩余的全部客户端，走与运行期间相同的路径：关闭 fd、清理接收缓冲区并调用断开处理器
+    std::vector<int> remaining;
+    {
+        std::lock_guard<std::mutex> lock(client_mutex_);
+        remaining = client_fds_;
+    }
+    {
+        std::lock_guard<std::mutex> lock(clients_to_remove_mutex_);
+        for (int fd : remaining) {
+            if (std::find(clients_to_remove_.begin(), clients_to_remove_.end(), fd) == clients_to_remove_.end()) {
+                clients_to_remove_.push_back(fd);
             }
         }
     }
-    LOGI("Server event loop terminated.");
+    process_clients_to_remove();
+    receive_buffers_.clear();
+    LOGI("Server event loop terminated and all clients disconnected.");
 }
 
 
 void UdsServer::stop() {
     if (!is_running_.exchange(false)) return;
     LOGI("Stopping Dual-Protocol server...");
-    
+
     if (server_fd_uds_ != -1) {
         shutdown(server_fd_uds_, SHUT_RDWR);
         close(server_fd_uds_);
@@ -333,15 +794,8 @@ void UdsServer::stop() {
         close(server_fd_tcp_);
         server_fd_tcp_ = -1;
     }
-    
-    process_clients_to_remove(); 
-    
-    std::lock_guard<std::mutex> lock(client_mutex_);
-    for (int fd : client_fds_) {
-        close(fd);
-    }
-    client_fds_.clear();
-    ui_client_fds_.clear();
-    client_buffers_.clear();
-    LOGI("Server stopped and all clients disconnected.");
+
+    // 客户端由事件循环退出时在 run() 中回收：stop() 可能在信号处理线程上调用，
+    // 而接收缓冲区与断开处理器都只属于事件循环线程
+    wake_event_loop();
 }
\ No newline at end of file
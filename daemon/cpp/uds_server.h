@@ -3,12 +3,43 @@
 #define CERBERUSD_UDS_SERVER_H
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <mutex>
 #include <atomic>
 #include <functional>
 #include <map>
 #include <set>
+#include <deque>
+#include <memory>
+#include <chrono>
+#include <nlohmann/json.hpp>
+#include "wire_codec.h"
+
+// 出站帧在多个客户端之间共享，最后一个队列释放时销毁
+using SharedFrame = std::shared_ptr<const std::string>;
+
+// 服务器推送主题，按位存放在每个连接的订阅掩码中
+enum PushTopic : uint32_t {
+    TOPIC_DASHBOARD    = 1u << 0,
+    TOPIC_STATS        = 1u << 1,
+    TOPIC_LOGS         = 1u << 2,
+    TOPIC_PROBE_CONFIG = 1u << 3,
+    TOPIC_DOZE         = 1u << 4,
+};
+// 未发送过订阅命令的客户端沿用旧行为：接收原本对所有客户端广播的主题。
+// 日志流需显式订阅（附带游标回填）
+constexpr uint32_t DEFAULT_CLIENT_TOPICS = TOPIC_DASHBOARD | TOPIC_STATS | TOPIC_DOZE;
+
+// 主题名（"dashboard"、"stats" 等）与掩码互转；未知名称会被忽略
+uint32_t parse_push_topics(const nlohmann::json& names);
+nlohmann::json push_topic_names(uint32_t topics);
+
+// 客户端发送队列超出预算时的处理方式
+enum class OverflowPolicy {
+    DROP,       // 丢弃本条（用于可被后续推送覆盖的广播）
+    DISCONNECT  // 断开连接（用于请求应答等不可丢失的消息）
+};
 
 class UdsServer {
 public:
@@ -23,27 +54,110 @@ public:
     void stop();
     
     void broadcast_message(const std::string& message);
-    void set_message_handler(std::function<void(int client_fd, const std::string&)> handler);
+    // 消息以 string_view 形式直接指向接收缓冲区，仅在回调期间有效
+    void set_message_handler(std::function<void(int client_fd, std::string_view)> handler);
+    // 所有发送均为非阻塞：消息进入该客户端的有界队列后立即返回，由事件循环在可写时继续写出。
+    // 单播超出预算时断开该客户端，广播超出预算时丢弃本条。
+    // 发送已序列化的 JSON 文本；对已协商二进制编码的客户端会转码，热点路径应改用 send_json
     bool send_message(int client_fd, const std::string& message);
+    // 按各客户端协商的编码发送，返回入队的字节数（失败为 0）；广播时每种编码只序列化一次
+    size_t send_json(int client_fd, const nlohmann::json& message);
+    // 异步应答使用：fd 可能在任务执行期间被关闭并复用，仅当连接编号仍匹配时才发送
+    size_t send_json(int client_fd, uint64_t connection_id, const nlohmann::json& message);
+    // 仅限 UDS 连接：随消息以 SCM_RIGHTS 附带一个描述符（内部 dup，调用方保留原描述符），
+    // 描述符与该消息的首字节一同到达对端。TCP 连接或 dup 失败时返回 0，调用方应改发普通消息
+    size_t send_json_with_fd(int client_fd, const nlohmann::json& message, int shared_fd);
+    // 发送由 JsonWriter 等直接写出的 JSON 文本（不含换行）。JSON 行客户端的帧直接复用该缓冲区，
+    // 二进制编码的客户端会解析后转码。返回入队的字节数
+    size_t send_json_text(int client_fd, std::string text);
+    size_t send_json_text(int client_fd, uint64_t connection_id, std::string text);
+    // 返回该 fd 当前连接的编号，未知 fd 返回 0
+    uint64_t connection_id(int client_fd) const;
+    size_t broadcast_json(const nlohmann::json& message);
+    size_t broadcast_json_except(const nlohmann::json& message, const std::set<int>& excluded_fds);
+    // 以当前 (JSON 行) 编码发送握手应答后切换该连接的编码，两步在同一把锁内完成，
+    // 保证应答之前不会有二进制帧、应答之后不会有 JSON 行混入
+    void switch_client_encoding(int client_fd, WireEncoding encoding, const nlohmann::json& ack);
+    // 主题订阅：推送只发给订阅了该主题的连接
+    void subscribe(int client_fd, uint32_t topics);
+    void unsubscribe(int client_fd, uint32_t topics);
+    void set_subscriptions(int client_fd, uint32_t topics);
+    uint32_t subscriptions(int client_fd) const;
+    bool has_subscribers(uint32_t topic, const std::set<int>& excluded_fds = {}) const;
+    // 仅当存在订阅者时才调用 build 构建消息，每种编码序列化一次；返回入队的总字节数
+    size_t publish(uint32_t topic, const std::function<nlohmann::json()>& build, const std::set<int>& excluded_fds = {});
+    // 同上，消息由 build 直接写成 JSON 文本
+    size_t publish_text(uint32_t topic, const std::function<std::string()>& build, const std::set<int>& excluded_fds = {});
+
     bool has_clients() const;
+    bool has_clients_except(int excluded_fd) const;
     void broadcast_message_except(const std::string& message, int excluded_fd);
+    // 排除一组客户端（如探针与已订阅增量协议的客户端）后广播
+    bool has_clients_except(const std::set<int>& excluded_fds) const;
+    void broadcast_message_except(const std::string& message, const std::set<int>& excluded_fds);
     void set_disconnect_handler(std::function<void(int client_fd)> handler);
+    // 发送队列非空且持续这么久没有写出进展即断开该客户端，默认 30 秒；须在 run() 之前设置
+    void set_stall_timeout(std::chrono::milliseconds timeout) { stall_timeout_ = timeout; }
 
     void broadcast_message_to_ui(const std::string& message);
     void identify_client_as_ui(int client_fd);
 
 private:
-    void add_client(int client_fd);
-    void remove_client(int client_fd);
+    void add_client(int client_fd, bool is_local);
+    // 返回该 fd 是否仍在连接表中；断开处理器由调用方在锁外调用
+    bool remove_client(int client_fd);
     void handle_client_data(int client_fd);
+    // 切分并分发缓冲区中已完整的消息；遇到超长帧时安排断开并返回 false
+    bool dispatch_buffered_messages(int client_fd, ReceiveBuffer& inbound);
+    void handle_client_writable(int client_fd);
     void schedule_client_removal(int client_fd);
     void process_clients_to_remove();
+    // 安排移除写出停滞的客户端，返回到下一个客户端可能停滞的毫秒数，作为 epoll_wait 的超时；
+    // 没有客户端积压待发数据时返回 -1
+    int reap_stalled_clients();
+    void accept_clients(int listen_fd, bool is_tcp);
+    // 唤醒事件循环（关闭、待移除客户端等），写 eventfd，可在任意线程调用
+    void wake_event_loop();
+    // 队列中的一帧；attached_fd 为随首字节发出的描述符，由帧持有，发出或丢弃时关闭
+    struct OutboundFrame {
+        SharedFrame data;
+        int attached_fd = -1;
+
+        OutboundFrame(SharedFrame frame, int fd) : data(std::move(frame)), attached_fd(fd) {}
+        OutboundFrame(OutboundFrame&& other) noexcept;
+        OutboundFrame& operator=(OutboundFrame&& other) noexcept;
+        ~OutboundFrame();
+        void release_attached_fd();
+    };
+    struct ClientConnection {
+        uint64_t id = 0;
+        bool is_local = false;     // UDS 连接，可传递描述符
+        uint32_t topics = DEFAULT_CLIENT_TOPICS;
+        WireEncoding encoding = WireEncoding::JSON_LINES;
+        std::deque<OutboundFrame> outbound;
+        size_t front_offset = 0;   // 队首帧已写出的字节数
+        size_t queued_bytes = 0;   // 队列中尚未写出的字节数
+        bool write_armed = false;  // 是否已在 epoll 中注册 EPOLLOUT
+        std::chrono::steady_clock::time_point last_progress;
+        uint64_t dropped_frames = 0;
+    };
+
+    // 以下 *_locked 函数要求调用方已持有 client_mutex_
+    WireEncoding encoding_of_locked(int client_fd) const;
+    bool send_text_locked(int client_fd, const std::string& message);
+    size_t broadcast_locked(const std::function<std::string(WireEncoding)>& make_frame,
+                          const std::function<bool(int)>& include);
+    bool enqueue_locked(int client_fd, SharedFrame frame, OverflowPolicy policy, int attached_fd = -1);
+    void flush_locked(int client_fd, ClientConnection& conn);
+    void set_write_interest_locked(int client_fd, ClientConnection& conn, bool enabled);
 
     // 成员变量更新，以支持双协议
     std::string uds_socket_name_;
     int tcp_port_;
     int server_fd_uds_; // UDS 监听 fd
     int server_fd_tcp_; // TCP 监听 fd
+    int epoll_fd_;      // 边沿触发的 epoll 实例
+    int wake_fd_;       // eventfd，用于跨线程唤醒 epoll_wait
     std::atomic<bool> is_running_;
     
     std::vector<int> client_fds_;
@@ -53,9 +167,13 @@ private:
     std::vector<int> clients_to_remove_;
     std::mutex clients_to_remove_mutex_;
 
-    std::function<void(int, const std::string&)> on_message_received_;
+    std::function<void(int, std::string_view)> on_message_received_;
     std::function<void(int)> on_disconnect_;
-    std::map<int, std::string> client_buffers_;
+    std::map<int, ClientConnection> connections_;
+    // 接收缓冲区只由事件循环线程访问，不受 client_mutex_ 保护，回调期间可安全持有其中的视图
+    std::map<int, ReceiveBuffer> receive_buffers_;
+    uint64_t next_connection_id_ = 1;
+    std::chrono::milliseconds stall_timeout_;
 };
 
 #endif // CERBERUSD_UDS_SERVER_H
\ No newline at end of file
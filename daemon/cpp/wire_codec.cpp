@@ -0,0 +1,150 @@
+// daemon/cpp/wire_codec.cpp
+#include "wire_codec.h"
+#include <cstring>
+#include <algorithm>
+
+// 接收缓冲区的初始容量
+constexpr size_t RECEIVE_BUFFER_INITIAL_CAPACITY = 16 * 1024;
+
+namespace wire_codec {
+
+const char* encoding_name(WireEncoding encoding) {
+    switch (encoding) {
+        case WireEncoding::JSON_FRAMED: return "json-framed";
+        case WireEncoding::MSGPACK: return "msgpack";
+        case WireEncoding::CBOR: return "cbor";
+        default: return "json";
+    }
+}
+
+bool parse_encoding(const std::string& name, WireEncoding& out) {
+    if (name == "json") { out = WireEncoding::JSON_LINES; return true; }
+    if (name == "json-framed") { out = WireEncoding::JSON_FRAMED; return true; }
+    if (name == "msgpack") { out = WireEncoding::MSGPACK; return true; }
+    if (name == "cbor") { out = WireEncoding::CBOR; return true; }
+    return false;
+}
+
+WireEncoding negotiate(const json& accepted) {
+    if (!accepted.is_array()) return WireEncoding::JSON_LINES;
+    for (const auto& item : accepted) {
+        if (!item.is_string()) continue;
+        WireEncoding encoding;
+        if (parse_encoding(item.get<std::string>(), encoding)) return encoding;
+    }
+    return WireEncoding::JSON_LINES;
+}
+
+static void append_length_prefix(std::string& out, uint32_t length) {
+    out.push_back(static_cast<char>((length >> 24) & 0xFF));
+    out.push_back(static_cast<char>((length >> 16) & 0xFF));
+    out.push_back(static_cast<char>((length >> 8) & 0xFF));
+    out.push_back(static_cast<char>(length & 0xFF));
+}
+
+std::string encode_frame(const json& message, WireEncoding encoding) {
+    if (encoding == WireEncoding::JSON_LINES) {
+        std::string line = message.dump();
+        line.push_back('\n');
+        return line;
+    }
+
+    std::string frame;
+    if (encoding == WireEncoding::JSON_FRAMED) {
+        std::string body = message.dump();
+        frame.reserve(body.size() + 4);
+        append_length_prefix(frame, static_cast<uint32_t>(body.size()));
+        frame.append(body);
+        return frame;
+    }
+
+    std::vector<uint8_t> body = (encoding == WireEncoding::MSGPACK)
+        ? json::to_msgpack(message)
+        : json::to_cbor(message);
+    frame.reserve(body.size() + 4);
+    append_length_prefix(frame, static_cast<uint32_t>(body.size()));
+    frame.append(reinterpret_cast<const char*>(body.data()), body.size());
+    return frame;
+}
+
+std::string encode_text_frame(std::string text, WireEncoding encoding) {
+    if (encoding == WireEncoding::JSON_LINES) {
+        text.push_back('\n');
+        return text;
+    }
+    if (encoding == WireEncoding::JSON_FRAMED) {
+        std::string frame;
+        frame.reserve(text.size() + 4);
+        append_length_prefix(frame, static_cast<uint32_t>(text.size()));
+        frame.append(text);
+        return frame;
+    }
+    return encode_frame(json::parse(text), encoding);
+}
+
+json decode_payload(std::string_view payload, WireEncoding encoding) {
+    switch (encoding) {
+        case WireEncoding::MSGPACK: return json::from_msgpack(payload.begin(), payload.end());
+        case WireEncoding::CBOR: return json::from_cbor(payload.begin(), payload.end());
+        default: return json::parse(payload.begin(), payload.end());
+    }
+}
+
+} // namespace wire_codec
+
+char* ReceiveBuffer::prepare(size_t min_space) {
+    if (writable() >= min_space) return data_.get() + write_pos_;
+
+    size_t pending = write_pos_ - read_pos_;
+    if (read_pos_ > 0 && capacity_ - pending >= min_space) {
+        // 仅在空间不足时搬移一次未消费的数据，均摊为线性
+        std::memmove(data_.get(), data_.get() + read_pos_, pending);
+    } else {
+        size_t new_capacity = capacity_ > 0 ? capacity_ * 2 : RECEIVE_BUFFER_INITIAL_CAPACITY;
+        while (new_capacity < pending + min_space) new_capacity *= 2;
+        std::unique_ptr<char[]> grown(new char[new_capacity]);
+        if (pending > 0) std::memcpy(grown.get(), data_.get() + read_pos_, pending);
+        data_ = std::move(grown);
+        capacity_ = new_capacity;
+    }
+    scan_pos_ -= read_pos_;
+    write_pos_ = pending;
+    read_pos_ = 0;
+    return data_.get() + write_pos_;
+}
+
+ReceiveBuffer::Status ReceiveBuffer::next_message(WireEncoding encoding, std::string_view& out) {
+    while (true) {
+        size_t pending = write_pos_ - read_pos_;
+        if (pending == 0) return Status::NEED_MORE;
+        const char* base = data_.get() + read_pos_;
+
+        if (!wire_codec::is_length_prefixed(encoding)) {
+            if (scan_pos_ < read_pos_) scan_pos_ = read_pos_;
+            const char* scan_from = data_.get() + scan_pos_;
+            const void* newline = std::memchr(scan_from, '\n', write_pos_ - scan_pos_);
+            if (newline == nullptr) {
+                scan_pos_ = write_pos_;
+                return pending > MAX_WIRE_FRAME_BYTES ? Status::OVERSIZED : Status::NEED_MORE;
+            }
+            size_t line_end = static_cast<size_t>(static_cast<const char*>(newline) - data_.get());
+            size_t length = line_end - read_pos_;
+            read_pos_ = line_end + 1;
+            scan_pos_ = read_pos_;
+            if (length == 0) continue; // 跳过空行
+            out = std::string_view(base, length);
+            return Status::MESSAGE;
+        }
+
+        if (pending < 4) return Status::NEED_MORE;
+        const auto* p = reinterpret_cast<const uint8_t*>(base);
+        uint32_t length = (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+                          (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]);
+        if (length > MAX_WIRE_FRAME_BYTES) return Status::OVERSIZED;
+        if (pending - 4 < length) return Status::NEED_MORE;
+        out = std::string_view(base + 4, length);
+        read_pos_ += 4 + length;
+        scan_pos_ = read_pos_;
+        return Status::MESSAGE;
+    }
+}
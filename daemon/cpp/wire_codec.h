@@ -0,0 +1,79 @@
+// daemon/cpp/wire_codec.h
+#ifndef CERBERUS_WIRE_CODEC_H
+#define CERBERUS_WIRE_CODEC_H
+
+#include <nlohmann/json.hpp>
+#include <string>
+#include <string_view>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+using json = nlohmann::json;
+
+// 连接上的消息编码。
+//   JSON_LINES: 默认，每条消息为一行 JSON 文本，以 '\n' 结尾
+//   JSON_FRAMED/MSGPACK/CBOR: 握手后启用，每帧为 4 字节大端长度 + 消息体。
+//   长度前缀帧无需逐字节查找分隔符，适合数 MB 级的配置上传
+enum class WireEncoding {
+    JSON_LINES,
+    JSON_FRAMED,
+    MSGPACK,
+    CBOR
+};
+
+// 单帧上限，超出视为协议错误，防止恶意或损坏的长度字段导致无限缓冲
+constexpr uint32_t MAX_WIRE_FRAME_BYTES = 16 * 1024 * 1024;
+
+namespace wire_codec {
+
+const char* encoding_name(WireEncoding encoding);
+bool parse_encoding(const std::string& name, WireEncoding& out);
+inline bool is_length_prefixed(WireEncoding encoding) { return encoding != WireEncoding::JSON_LINES; }
+
+// 从客户端提供的候选列表中按其偏好顺序选出第一个支持的编码；都不支持时返回 JSON_LINES
+WireEncoding negotiate(const json& accepted);
+
+// 编码为可直接写入 socket 的完整帧（JSON 行含结尾换行；其余含长度前缀）
+std::string encode_frame(const json& message, WireEncoding encoding);
+
+// 以已序列化的 JSON 文本构建帧：JSON 行与长度前缀 JSON 直接复用该文本（JSON 行原地追加换行，不复制），
+// 二进制编码需先解析再转码
+std::string encode_text_frame(std::string text, WireEncoding encoding);
+
+// 解码单个消息体
+json decode_payload(std::string_view payload, WireEncoding encoding);
+
+} // namespace wire_codec
+
+// 每个连接一个的接收缓冲区，数据直接 recv 到缓冲区内，原地切分消息并以 string_view 交出。
+// 已消费的前缀在下一次 prepare() 时整体搬移一次（而非每条消息 erase 一次），
+// 换行查找从上次停下的位置继续，因此无论消息多大、分多少次到达，总开销都与字节数成线性。
+// 交出的 string_view 在下一次 prepare() 之前有效。
+class ReceiveBuffer {
+public:
+    enum class Status {
+        MESSAGE,     // out 中是一条完整消息
+        NEED_MORE,   // 缓冲区中没有完整消息
+        OVERSIZED    // 帧或行超过 MAX_WIRE_FRAME_BYTES，应断开连接
+    };
+
+    // 返回至少 min_space 字节的可写空间，必要时搬移未消费数据或扩容
+    char* prepare(size_t min_space);
+    size_t writable() const { return capacity_ - write_pos_; }
+    void commit(size_t bytes) { write_pos_ += bytes; }
+
+    Status next_message(WireEncoding encoding, std::string_view& out);
+
+    size_t buffered() const { return write_pos_ - read_pos_; }
+
+private:
+    std::unique_ptr<char[]> data_;
+    size_t capacity_ = 0;
+    size_t read_pos_ = 0;
+    size_t write_pos_ = 0;
+    // JSON 行模式下已确认不含换行的位置，避免重复扫描未完成的长行
+    size_t scan_pos_ = 0;
+};
+
+#endif // CERBERUS_WIRE_CODEC_H
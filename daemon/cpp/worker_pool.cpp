@@ -0,0 +1,81 @@
+// daemon/cpp/worker_pool.cpp
+#include "worker_pool.h"
+#include <android/log.h>
+#include <exception>
+
+#define LOG_TAG "cerberusd_worker_pool"
+#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+#define LOGW(...) __android_log_print(ANDROID_LOG_WARN, LOG_TAG, __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+
+WorkerPool::WorkerPool(std::string name, size_t thread_count, size_t max_queue)
+    : name_(std::move(name)), thread_count_(thread_count > 0 ? thread_count : 1), max_queue_(max_queue) {}
+
+WorkerPool::~WorkerPool() {
+    stop();
+}
+
+void WorkerPool::start() {
+    if (is_running_.exchange(true)) return;
+    threads_.reserve(thread_count_);
+    for (size_t i = 0; i < thread_count_; ++i) {
+        threads_.emplace_back(&WorkerPool::worker_thread_func, this, i);
+    }
+    LOGI("[%s] Worker pool started (%zu threads, queue limit %zu).", name_.c_str(), thread_count_, max_queue_);
+}
+
+void WorkerPool::stop() {
+    {
+        // 在锁内清除标志：工作线程检查条件与进入等待之间不会错过这次通知
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!is_running_.exchange(false)) return;
+    }
+    cv_.notify_all();
+    for (auto& thread : threads_) {
+        if (thread.joinable()) thread.join();
+    }
+    threads_.clear();
+    LOGI("[%s] Worker pool stopped (submitted %llu, completed %llu, rejected %llu).", name_.c_str(),
+         (unsigned long long)stats_.submitted, (unsigned long long)stats_.completed, (unsigned long long)stats_.rejected);
+}
+
+bool WorkerPool::submit(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!is_running_ || tasks_.size() >= max_queue_) {
+            stats_.rejected++;
+            LOGW("[%s] Rejected task, queue depth %zu.", name_.c_str(), tasks_.size());
+            return false;
+        }
+        tasks_.push_back(std::move(task));
+        stats_.submitted++;
+        if (tasks_.size() > stats_.max_queue_depth) stats_.max_queue_depth = tasks_.size();
+    }
+    cv_.notify_one();
+    return true;
+}
+
+WorkerPool::Stats WorkerPool::get_stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+void WorkerPool::worker_thread_func(size_t index) {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this] { return !is_running_ || !tasks_.empty(); });
+            if (tasks_.empty()) return;
+            task = std::move(tasks_.front());
+            tasks_.pop_front();
+        }
+        try {
+            task();
+        } catch (const std::exception& e) {
+            LOGE("[%s] Task on worker %zu threw: %s", name_.c_str(), index, e.what());
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.completed++;
+    }
+}
@@ -0,0 +1,54 @@
+// daemon/cpp/worker_pool.h
+#ifndef CERBERUS_WORKER_POOL_H
+#define CERBERUS_WORKER_POOL_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <cstdint>
+
+// 固定线程数、有界队列的工作线程池，用于把耗时的 IPC 查询移出服务器事件循环。
+// 队列已满时 submit() 立即返回 false，由调用方向客户端回复“忙”，而不是无限堆积。
+class WorkerPool {
+public:
+    struct Stats {
+        uint64_t submitted = 0;
+        uint64_t completed = 0;
+        uint64_t rejected = 0;
+        size_t max_queue_depth = 0;
+    };
+
+    WorkerPool(std::string name, size_t thread_count, size_t max_queue);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    void start();
+    // 停止接收新任务，已入队的任务执行完毕后线程退出
+    void stop();
+
+    bool submit(std::function<void()> task);
+    Stats get_stats() const;
+
+private:
+    void worker_thread_func(size_t index);
+
+    std::string name_;
+    size_t thread_count_;
+    size_t max_queue_;
+
+    std::atomic<bool> is_running_{false};
+    std::vector<std::thread> threads_;
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<std::function<void()>> tasks_;
+    Stats stats_;
+};
+
+#endif // CERBERUS_WORKER_POOL_H
@@ -0,0 +1,159 @@
+// daemon/tests/app_state_table_test.cpp
+#include "test_harness.h"
+#include "app_state_table.h"
+#include <chrono>
+#include <map>
+#include <random>
+
+// 查找基准：登记的应用数与每种查找的次数
+constexpr int APP_TABLE_BENCHMARK_APPS = 2000;
+constexpr int APP_TABLE_BENCHMARK_LOOKUPS = 200000;
+// 遍历基准：整表遍历的轮数
+constexpr int APP_TABLE_BENCHMARK_PASSES = 2000;
+
+static std::string table_package(int i) {
+    return "com.example.app" + std::to_string(i);
+}
+
+// 索引之前的做法：应用表是按 (包名, 用户) 排序的 std::map，按 UID 线性查找返回首个匹配，
+// 即共享该 UID 的包中键最小的一个
+static AppSlot linear_find_by_uid(const AppStateTable& table, int uid) {
+    AppSlot found = INVALID_APP_SLOT;
+    for (const auto& app : table) {
+        if (app.uid == uid && (found == INVALID_APP_SLOT || table.key_of(app) < table.key_of(table[found]))) found = app.slot;
+    }
+    return found;
+}
+
+TEST_CASE(app_state_table_shared_uid_follows_smallest_key) {
+    AppStateTable table;
+    AppSlot c = table.emplace("com.example.shared.c", 0);
+    AppSlot a = table.emplace("com.example.shared.a", 0);
+    AppSlot b = table.emplace("com.example.shared.b", 0);
+    table.set_uid(c, 10500);
+    CHECK_EQ(table.find_by_uid(10500), c);
+    table.set_uid(b, 10500);
+    // 后登记的 b 包名更小，以 b 为准
+    CHECK_EQ(table.find_by_uid(10500), b);
+    table.set_uid(a, 10500);
+    CHECK_EQ(table.find_by_uid(10500), a);
+
+    // 索引指向的包换了 UID，改指向其余共享者中键最小的
+    table.set_uid(a, 10600);
+    CHECK_EQ(table.find_by_uid(10500), b);
+    CHECK_EQ(table.find_by_uid(10600), a);
+    table.set_uid(b, -1);
+    CHECK_EQ(table.find_by_uid(10500), c);
+    // 非索引指向的包变更不影响索引
+    table.set_uid(b, 10500);
+    CHECK_EQ(table.find_by_uid(10500), b);
+    table.set_uid(c, 10700);
+    table.set_uid(b, 10700);
+    CHECK_EQ(table.find_by_uid(10500), INVALID_APP_SLOT);
+    CHECK_EQ(table.find_by_uid(10700), b);
+
+    // 同一包的多个用户按用户 ID 排序
+    AppSlot clone = table.emplace("com.example.shared.d", 10);
+    AppSlot owner = table.emplace("com.example.shared.d", 0);
+    table.set_uid(clone, 10800);
+    table.set_uid(owner, 10800);
+    CHECK_EQ(table.find_by_uid(10800), owner);
+}
+
+// 随机改变 UID（包含大量共享）后，索引结果始终与线性查找一致
+TEST_CASE(app_state_table_uid_index_matches_linear_scan) {
+    std::mt19937 rng(20260105);
+    AppStateTable table;
+    for (int i = 0; i < 64; ++i) table.emplace(table_package(i), 0);
+    size_t mismatched = 0;
+    for (int step = 0; step < 5000; ++step) {
+        AppSlot slot = rng() % table.size();
+        int uid = rng() % 10 == 0 ? -1 : 10000 + static_cast<int>(rng() % 16);
+        table.set_uid(slot, uid);
+        for (int probe = 10000; probe < 10016; ++probe) {
+            if (table.find_by_uid(probe) != linear_find_by_uid(table, probe)) mismatched++;
+        }
+    }
+    CHECK_EQ(mismatched, 0u);
+}
+
+// 2000 个应用时按包名、UID、PID 查找的平均耗时，与线性查找 UID 比较
+BENCHMARK_CASE(app_state_table_lookup_benchmark) {
+    AppStateTable table(APP_TABLE_BENCHMARK_APPS);
+    std::vector<std::string> packages;
+    for (int i = 0; i < APP_TABLE_BENCHMARK_APPS; ++i) {
+        packages.push_back(table_package(i));
+        AppSlot slot = table.emplace(packages.back(), 0);
+        table.set_uid(slot, 10000 + i);
+        table.map_pid(1000 + i, slot);
+    }
+    std::mt19937 rng(7);
+    std::vector<int> order(APP_TABLE_BENCHMARK_LOOKUPS);
+    for (auto& index : order) index = static_cast<int>(rng() % APP_TABLE_BENCHMARK_APPS);
+
+    size_t misses = 0;
+    auto measure = [&order, &misses](const auto& lookup) {
+        auto start = std::chrono::steady_clock::now();
+        for (int index : order) {
+            if (lookup(index) != static_cast<AppSlot>(index)) misses++;
+        }
+        auto elapsed_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        return static_cast<double>(elapsed_ns) / order.size();
+    };
+    json result = {
+        {"apps", APP_TABLE_BENCHMARK_APPS},
+        {"lookups", APP_TABLE_BENCHMARK_LOOKUPS},
+        {"package_ns", measure([&](int i) { return table.find(packages[i], 0); })},
+        {"uid_ns", measure([&](int i) { return table.find_by_uid(10000 + i); })},
+        {"pid_ns", measure([&](int i) { return table.find_by_pid(1000 + i); })},
+        {"uid_linear_ns", measure([&](int i) { return linear_find_by_uid(table, 10000 + i); })}
+    };
+    CHECK_EQ(misses, 0u);
+    CHECK(result["uid_ns"].get<double>() < result["uid_linear_ns"].get<double>());
+    test_harness::report_benchmark(result);
+}
+
+// 2000 个应用时状态机每个 tick 那样整表遍历一次的耗时，与原先的 std::map<(包名, 用户), 状态> 比较
+BENCHMARK_CASE(app_state_table_iteration_benchmark) {
+    AppStateTable table(APP_TABLE_BENCHMARK_APPS);
+    std::map<std::pair<std::string, int>, AppRuntimeState> legacy;
+    std::mt19937 rng(11);
+    for (int i = 0; i < APP_TABLE_BENCHMARK_APPS; ++i) {
+        AppSlot slot = table.emplace(table_package(i), 0);
+        AppRuntimeState& app = table[slot];
+        app.current_status = rng() % 3 == 0 ? AppRuntimeState::Status::FROZEN : AppRuntimeState::Status::RUNNING;
+        app.background_since = rng() % 2 ? 1700000000 + static_cast<time_t>(rng() % 600) : 0;
+        app.pids.assign(1 + rng() % 4, 1000 + i);
+        table.set_uid(slot, 10000 + i);
+        AppRuntimeState copy = app;
+        legacy.emplace(std::make_pair(table_package(i), 0), std::move(copy));
+    }
+
+    // 与状态机相同的访问模式：读状态、后台时刻与 pid 列表
+    auto visit = [](const AppRuntimeState& app, long long& sink) {
+        if (app.current_status == AppRuntimeState::Status::RUNNING && app.background_since > 0) {
+            sink += app.background_since + static_cast<long long>(app.pids.size());
+        }
+    };
+    auto measure = [](const auto& pass) {
+        long long sink = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int round = 0; round < APP_TABLE_BENCHMARK_PASSES; ++round) pass(sink);
+        auto elapsed_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        return std::make_pair(static_cast<double>(elapsed_ns) / APP_TABLE_BENCHMARK_PASSES, sink);
+    };
+    auto [table_ns, table_sink] = measure([&](long long& sink) {
+        for (const auto& app : table) visit(app, sink);
+    });
+    auto [legacy_ns, legacy_sink] = measure([&](long long& sink) {
+        for (const auto& [key, app] : legacy) visit(app, sink);
+    });
+    CHECK_EQ(table_sink, legacy_sink);
+    CHECK(table_ns < legacy_ns);
+    test_harness::report_benchmark({
+        {"apps", APP_TABLE_BENCHMARK_APPS},
+        {"passes", APP_TABLE_BENCHMARK_PASSES},
+        {"table_pass_ns", table_ns},
+        {"map_pass_ns", legacy_ns}
+    });
+}
@@ -0,0 +1,110 @@
+// daemon/tests/broadcast_scheduler_test.cpp
+#include "test_harness.h"
+#include "broadcast_scheduler.h"
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <memory>
+#include <thread>
+
+// 反复启动、停止调度器的轮数；单轮停止超过该时限视为丢失唤醒
+constexpr int BROADCAST_SCHEDULER_STOP_ROUNDS = 2000;
+constexpr auto BROADCAST_SCHEDULER_STOP_TIMEOUT = std::chrono::seconds(5);
+// 合并测试：窗口、窗口内连续标记的次数与每次推送的载荷字节数
+constexpr auto BROADCAST_SCHEDULER_TEST_WINDOW = std::chrono::milliseconds(200);
+constexpr int BROADCAST_SCHEDULER_TEST_MARKS = 10;
+constexpr size_t BROADCAST_SCHEDULER_TEST_PAYLOAD_BYTES = 100;
+
+static bool wait_until(const std::function<bool()>& done) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (!done()) {
+        if (std::chrono::steady_clock::now() > deadline) return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+static bool wait_for_count(const std::atomic<int>& count, int expected) {
+    return wait_until([&count, expected] { return count.load() >= expected; });
+}
+
+// 刚启动的调度线程正处于检查条件与进入等待之间时停止，线程也必须被唤醒退出
+TEST_CASE(broadcast_scheduler_stop_never_loses_the_wakeup) {
+    int hung_round = -1;
+    for (int round = 0; round < BROADCAST_SCHEDULER_STOP_ROUNDS && hung_round < 0; ++round) {
+        auto scheduler = std::make_shared<BroadcastScheduler>("stop_test", std::chrono::milliseconds(50));
+        scheduler->set_flush_handler([] { return size_t{0}; });
+        scheduler->start();
+        // 停止放在分离的线程上：卡住时该线程与调度器一起泄漏，用例仍能报告失败
+        std::promise<void> done;
+        std::future<void> stopped = done.get_future();
+        std::thread([scheduler, done = std::move(done)]() mutable {
+            scheduler->stop();
+            done.set_value();
+        }).detach();
+        if (stopped.wait_for(BROADCAST_SCHEDULER_STOP_TIMEOUT) != std::future_status::ready) hung_round = round;
+    }
+    CHECK_EQ(hung_round, -1);
+}
+
+// 窗口内的多次标记只推送一次；没有订阅者时不调用推送，被合并与跳过的推送按最近一次载荷大小计入 bytes_saved
+TEST_CASE(broadcast_scheduler_coalesces_marks_and_skips_without_subscribers) {
+    BroadcastScheduler scheduler("coalesce_test", BROADCAST_SCHEDULER_TEST_WINDOW);
+    std::atomic<bool> subscribed{true};
+    std::atomic<int> flushes{0};
+    scheduler.set_subscriber_check([&subscribed] { return subscribed.load(); });
+    scheduler.set_flush_handler([&flushes] {
+        flushes++;
+        return BROADCAST_SCHEDULER_TEST_PAYLOAD_BYTES;
+    });
+    scheduler.start();
+
+    // 距上次推送已超过窗口：第一次标记立即推送
+    scheduler.mark_dirty();
+    REQUIRE(wait_for_count(flushes, 1));
+
+    for (int i = 0; i < BROADCAST_SCHEDULER_TEST_MARKS; ++i) scheduler.mark_dirty();
+    REQUIRE(wait_for_count(flushes, 2));
+    std::this_thread::sleep_for(BROADCAST_SCHEDULER_TEST_WINDOW * 2);
+    CHECK_EQ(flushes.load(), 2);
+
+    // 没有订阅者时同样按窗口合并：第一次标记立即跳过，紧随其后的几次在窗口结束时合并为一次跳过
+    subscribed = false;
+    auto skipped = [&scheduler](uint64_t expected) {
+        return wait_until([&scheduler, expected] { return scheduler.get_stats().skipped_no_subscriber >= expected; });
+    };
+    scheduler.mark_dirty();
+    REQUIRE(skipped(1));
+    for (int i = 0; i < 3; ++i) scheduler.mark_dirty();
+    REQUIRE(skipped(2));
+    std::this_thread::sleep_for(BROADCAST_SCHEDULER_TEST_WINDOW * 2);
+    scheduler.stop();
+    CHECK_EQ(flushes.load(), 2);
+
+    BroadcastScheduler::Stats stats = scheduler.get_stats();
+    CHECK_EQ(stats.dirty_marks, static_cast<uint64_t>(1 + BROADCAST_SCHEDULER_TEST_MARKS + 1 + 3));
+    CHECK_EQ(stats.flushes, 2u);
+    CHECK_EQ(stats.skipped_no_subscriber, 2u);
+    CHECK_EQ(stats.bytes_sent, 2 * BROADCAST_SCHEDULER_TEST_PAYLOAD_BYTES);
+    CHECK_EQ(stats.bytes_saved, (BROADCAST_SCHEDULER_TEST_MARKS - 1 + 1 + 3) * BROADCAST_SCHEDULER_TEST_PAYLOAD_BYTES);
+}
+
+// 调整后的窗口从下一次推送起生效
+TEST_CASE(broadcast_scheduler_window_can_be_changed_while_running) {
+    BroadcastScheduler scheduler("window_test", std::chrono::milliseconds(5000));
+    std::atomic<int> flushes{0};
+    scheduler.set_flush_handler([&flushes] {
+        flushes++;
+        return size_t{1};
+    });
+    scheduler.start();
+    scheduler.mark_dirty();
+    REQUIRE(wait_for_count(flushes, 1));
+
+    scheduler.set_window(std::chrono::milliseconds(50));
+    CHECK(scheduler.window() == std::chrono::milliseconds(50));
+    scheduler.mark_dirty();
+    CHECK(wait_for_count(flushes, 2));
+    scheduler.stop();
+}
@@ -0,0 +1,227 @@
+// daemon/tests/dashboard_stream_test.cpp
+#include "test_harness.h"
+#include "test_fixtures.h"
+#include "dashboard_stream.h"
+#include <algorithm>
+#include <map>
+#include <random>
+
+// 随机演化的快照版本数
+constexpr int DASHBOARD_STREAM_TEST_STEPS = 300;
+
+// 按协议应用快照与补丁的客户端，base_version 与本地版本不符时记为需要重新订阅
+struct FakeDashboardClient {
+    bool has_snapshot = false;
+    bool needs_resync = false;
+    uint64_t version = 0;
+    std::vector<std::string> order;
+    std::map<std::string, json> rows;
+    json global_stats;
+    json totals;
+
+    static std::string key_of(const json& row) {
+        return row["package_name"].get<std::string>() + ":" + std::to_string(row["user_id"].get<int>());
+    }
+
+    void apply(const json& message) {
+        const json& payload = message["payload"];
+        if (message["type"] == "stream.dashboard_snapshot") {
+            has_snapshot = true;
+            version = payload["version"].get<uint64_t>();
+            global_stats = payload["global_stats"];
+            totals = payload["totals"];
+            order.clear();
+            rows.clear();
+            for (const auto& row : payload["apps_runtime_state"]) {
+                order.push_back(key_of(row));
+                rows[key_of(row)] = row;
+            }
+            return;
+        }
+        if (!has_snapshot || payload["base_version"].get<uint64_t>() != version) {
+            needs_resync = true;
+            return;
+        }
+        if (payload.contains("global_stats")) global_stats = payload["global_stats"];
+        if (payload.contains("totals")) totals = payload["totals"];
+        if (payload.contains("upserts")) {
+            for (const auto& change : payload["upserts"]) {
+                json& row = rows[key_of(change)];
+                if (row.is_null()) row = json::object();
+                for (auto field = change.begin(); field != change.end(); ++field) {
+                    if (field.value().is_null()) row.erase(field.key());
+                    else row[field.key()] = field.value();
+                }
+            }
+        }
+        if (payload.contains("removes")) {
+            for (const auto& key : payload["removes"]) rows.erase(key.get<std::string>());
+        }
+        if (payload.contains("order")) order = payload["order"].get<std::vector<std::string>>();
+        version = payload["version"].get<uint64_t>();
+    }
+
+    json visible_rows() const {
+        json result = json::array();
+        for (const auto& key : order) {
+            auto it = rows.find(key);
+            result.push_back(it == rows.end() ? json() : it->second);
+        }
+        return result;
+    }
+};
+
+// 新订阅者收到的完整快照即为该版本的正确状态，与增量重建的结果逐项比较
+static void check_reconstruction(DashboardStreamer& streamer, const json& subscribe_payload, const FakeDashboardClient& client,
+                                 const StateSnapshot& snapshot) {
+    constexpr int REFERENCE_FD = 1000;
+    streamer.subscribe(REFERENCE_FD, subscribe_payload);
+    json reference = streamer.next_message(REFERENCE_FD, snapshot);
+    streamer.unsubscribe(REFERENCE_FD);
+    REQUIRE(reference.is_object());
+    const json& payload = reference["payload"];
+    CHECK(!client.needs_resync);
+    CHECK(client.visible_rows() == payload["apps_runtime_state"]);
+    CHECK(client.global_stats == payload["global_stats"]);
+    CHECK(client.totals == payload["totals"]);
+}
+
+TEST_CASE(dashboard_patches_rebuild_the_snapshot) {
+    std::mt19937 rng(20260105);
+    StateSnapshot snapshot = make_dashboard_snapshot(40);
+    snapshot.version = 1;
+    const json full = json::object();
+    const json top = {{"sort_by", "cpu"}, {"top_n", 8}};
+
+    DashboardStreamer streamer;
+    FakeDashboardClient full_client, top_client;
+    streamer.subscribe(1, full);
+    streamer.subscribe(2, top);
+    full_client.apply(streamer.next_message(1, snapshot));
+    top_client.apply(streamer.next_message(2, snapshot));
+
+    int next_app = 40;
+    size_t skipped = 0, patches = 0;
+    for (int step = 0; step < DASHBOARD_STREAM_TEST_STEPS; ++step) {
+        snapshot.version++;
+        switch (rng() % 6) {
+            case 0:
+                // 版本前进但内容不变
+                break;
+            case 1:
+                if (snapshot.apps.size() > 5) snapshot.apps.erase(snapshot.apps.begin() + rng() % snapshot.apps.size());
+                break;
+            case 2: {
+                DashboardAppView view = make_dashboard_snapshot(1).apps[0];
+                view.package_name = "com.example.added" + std::to_string(next_app++);
+                view.cpu_usage_percent = static_cast<float>(rng() % 100);
+                snapshot.apps.push_back(std::move(view));
+                break;
+            }
+            case 3:
+                snapshot.global_stats->mem_available_kb = 2000000 + static_cast<long>(rng() % 100000);
+                break;
+            default:
+                for (int i = 0; i < 3; ++i) {
+                    DashboardAppView& view = snapshot.apps[rng() % snapshot.apps.size()];
+                    view.cpu_usage_percent = static_cast<float>(rng() % 100);
+                    view.mem_usage_kb += 1;
+                    view.display_status = rng() % 2 ? "FROZEN" : "RUNNING";
+                }
+                break;
+        }
+
+        for (auto [fd, client] : {std::make_pair(1, &full_client), std::make_pair(2, &top_client)}) {
+            json message = streamer.next_message(fd, snapshot);
+            if (message.is_null()) {
+                skipped++;
+            } else {
+                CHECK(message["type"] == "stream.dashboard_patch");
+                client->apply(message);
+                patches++;
+                // 同一版本不重复发送
+                CHECK(streamer.next_message(fd, snapshot).is_null());
+            }
+        }
+        check_reconstruction(streamer, full, full_client, snapshot);
+        check_reconstruction(streamer, top, top_client, snapshot);
+    }
+    CHECK(skipped > 0);
+    CHECK(patches > 0);
+}
+
+// 对客户端不可见的版本不发送任何内容，下一条补丁的 base_version 仍是客户端最后收到的版本
+TEST_CASE(dashboard_noop_version_keeps_base_version) {
+    StateSnapshot snapshot = make_dashboard_snapshot(5);
+    snapshot.version = 7;
+    DashboardStreamer streamer;
+    streamer.subscribe(3, json::object());
+    json first = streamer.next_message(3, snapshot);
+    REQUIRE(first.is_object());
+    CHECK_EQ(first["payload"]["version"].get<uint64_t>(), 7u);
+
+    snapshot.version = 8;
+    CHECK(streamer.next_message(3, snapshot).is_null());
+
+    snapshot.version = 9;
+    snapshot.apps[2].mem_usage_kb += 100;
+    json patch = streamer.next_message(3, snapshot);
+    REQUIRE(patch.is_object());
+    CHECK_EQ(patch["payload"]["base_version"].get<uint64_t>(), 7u);
+    CHECK_EQ(patch["payload"]["version"].get<uint64_t>(), 9u);
+    REQUIRE(patch["payload"]["upserts"].size() == 1);
+    CHECK_EQ(patch["payload"]["upserts"][0]["mem_usage_kb"].get<long>(), snapshot.apps[2].mem_usage_kb);
+}
+
+// 排序值相同的行按包名与用户排列，与快照中应用的先后顺序无关
+TEST_CASE(dashboard_sort_ties_follow_row_key) {
+    StateSnapshot snapshot = make_dashboard_snapshot(20);
+    snapshot.version = 1;
+    for (auto& view : snapshot.apps) view.cpu_usage_percent = 5.0f;
+    snapshot.apps[7].cpu_usage_percent = 50.0f;
+    const json top = {{"sort_by", "cpu"}, {"top_n", 6}};
+
+    DashboardStreamer streamer;
+    streamer.subscribe(4, top);
+    json forward = streamer.next_message(4, snapshot);
+    REQUIRE(forward.is_object());
+
+    std::reverse(snapshot.apps.begin(), snapshot.apps.end());
+    streamer.subscribe(4, top);
+    json reversed = streamer.next_message(4, snapshot);
+    REQUIRE(reversed.is_object());
+    CHECK(forward["payload"]["apps_runtime_state"] == reversed["payload"]["apps_runtime_state"]);
+
+    std::vector<std::string> packages;
+    for (const auto& row : forward["payload"]["apps_runtime_state"]) packages.push_back(row["package_name"].get<std::string>());
+    REQUIRE(packages.size() == 6);
+    CHECK_EQ(packages[0], std::string("com.example.benchmark.app7"));
+    CHECK(std::is_sorted(packages.begin() + 1, packages.end()));
+}
+
+// 并发路径可能先后取到新旧两个快照：比基线旧的快照不产生消息，之后的补丁仍以最新基线为准
+TEST_CASE(dashboard_older_snapshot_never_moves_version_back) {
+    StateSnapshot older = make_dashboard_snapshot(5);
+    older.version = 4;
+    StateSnapshot newer = older;
+    newer.version = 5;
+    newer.apps[1].mem_usage_kb += 100;
+
+    DashboardStreamer streamer;
+    streamer.subscribe(5, json::object());
+    json first = streamer.next_message(5, newer);
+    REQUIRE(first.is_object());
+    CHECK(first["type"] == "stream.dashboard_snapshot");
+    CHECK_EQ(first["payload"]["version"].get<uint64_t>(), 5u);
+
+    CHECK(streamer.next_message(5, older).is_null());
+
+    StateSnapshot latest = newer;
+    latest.version = 6;
+    latest.apps[2].mem_usage_kb += 100;
+    json patch = streamer.next_message(5, latest);
+    REQUIRE(patch.is_object());
+    CHECK(patch["type"] == "stream.dashboard_patch");
+    CHECK_EQ(patch["payload"]["base_version"].get<uint64_t>(), 5u);
+    CHECK_EQ(patch["payload"]["version"].get<uint64_t>(), 6u);
+}
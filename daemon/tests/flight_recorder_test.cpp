@@ -0,0 +1,288 @@
+// daemon/tests/flight_recorder_test.cpp
+#include "test_harness.h"
+#include "flight_recorder.h"
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <csignal>
+#include <chrono>
+#include <cstring>
+#include <future>
+#include <random>
+#include <set>
+#include <thread>
+
+using namespace flight_recorder_layout;
+
+// 崩溃测试的轮数与每轮所用记录器的槽位数；基准的写入条数
+constexpr int CRASH_TEST_ROUNDS = 16;
+constexpr uint32_t CRASH_TEST_CAPACITY = 1024;
+constexpr int FLIGHT_RECORDER_BENCHMARK_RECORDS = 200000;
+
+// 子进程第 seq 条记录的内容，父进程据此逐条核对。文本长度覆盖空串、短串与需要截断的中文长串
+struct CrashTestExpectation {
+    FlightRecordKind kind;
+    int a;
+    int b;
+    int64_t value;
+    std::string_view parts[3];
+};
+
+static CrashTestExpectation crash_test_record(uint64_t seq) {
+    static const std::string_view PACKAGES[] = {"", "com.tencent.mm", "com.google.android.gms.persistent", "com.example.app7"};
+    static const std::string_view MESSAGES[] = {
+        "已冻结 (pids: 12345)",
+        "因 Kernel Signal 9 而解冻",
+        "白名单内核Binder (RPC:android.os.IMessenger, Code:17) 白名单Binder唤醒过于频繁，已临时忽略",
+        ""
+    };
+    static const std::string_view COMMANDS[] = {"event.app_foreground", "cmd.set_policy", "event.probe_batch"};
+    CrashTestExpectation e;
+    e.a = static_cast<int>(seq * 7);
+    e.b = -static_cast<int>(seq % 100000);
+    e.value = static_cast<int64_t>(seq) * 1000003;
+    switch (seq % 4) {
+        case 0:
+            e.kind = FlightRecordKind::IPC_COMMAND;
+            e.parts[0] = COMMANDS[seq % 3];
+            break;
+        case 1:
+            e.kind = FlightRecordKind::FREEZE_BEGIN;
+            e.parts[0] = PACKAGES[seq / 4 % 4];
+            break;
+        default:
+            e.kind = FlightRecordKind::LOG;
+            e.parts[0] = "冻结";
+            e.parts[1] = PACKAGES[seq / 4 % 4];
+            e.parts[2] = MESSAGES[seq / 8 % 4];
+            break;
+    }
+    return e;
+}
+
+static void write_crash_test_record(FlightRecorder& recorder, uint64_t seq) {
+    CrashTestExpectation e = crash_test_record(seq);
+    if (e.kind == FlightRecordKind::LOG) {
+        recorder.record_log(seq, LogLevel::ACTION_FREEZE, e.parts[0], e.parts[1], e.a, e.parts[2], static_cast<uint64_t>(e.value));
+        return;
+    }
+    recorder.record(e.kind, e.a, e.b, e.value, e.parts[0]);
+}
+
+// 记录器写入的文本：各段以 \x1f 拼接，超出 FLIGHT_TEXT_BYTES 时在 UTF-8 字符边界截断
+static std::string expected_text(const CrashTestExpectation& e, bool& truncated) {
+    std::string joined(e.parts[0]);
+    if (e.kind == FlightRecordKind::LOG) {
+        joined.append(1, '\x1f').append(e.parts[1]).append(1, '\x1f').append(e.parts[2]);
+    }
+    truncated = joined.size() > FLIGHT_TEXT_BYTES;
+    if (!truncated) return joined;
+    size_t cut = FLIGHT_TEXT_BYTES;
+    while (cut > 0 && (static_cast<uint8_t>(joined[cut]) & 0xC0) == 0x80) --cut;
+    return joined.substr(0, cut);
+}
+
+static bool crash_test_matches(const FlightRecord& record) {
+    CrashTestExpectation e = crash_test_record(record.seq);
+    bool truncated;
+    std::string text = expected_text(e, truncated);
+    if (record.kind != e.kind || record.a != e.a || record.value != e.value || record.truncated != truncated || record.text != text) {
+        return false;
+    }
+    if (e.kind == FlightRecordKind::LOG) {
+        return record.timestamp_ms == static_cast<long long>(record.seq) && record.level == static_cast<int>(LogLevel::ACTION_FREEZE);
+    }
+    return record.b == e.b;
+}
+
+TEST_CASE(flight_recorder_round_trips_records) {
+    std::string path = test_harness::scratch_dir("flight_recorder_round_trip") + "/flight.bin";
+    {
+        FlightRecorder recorder;
+        REQUIRE(recorder.open(path, 64));
+        CHECK_EQ(recorder.next_seq(), 1u);
+        for (uint64_t seq = 2; seq <= 40; ++seq) write_crash_test_record(recorder, seq);
+        recorder.mark_log_persisted(7);
+    }
+
+    FlightRecovery recovery = FlightRecorder::decode(path);
+    REQUIRE(recovery.found);
+    CHECK(!recovery.clean_shutdown);
+    CHECK_EQ(recovery.pid, static_cast<int>(getpid()));
+    CHECK_EQ(recovery.next_seq, 40u);
+    CHECK_EQ(recovery.log_persisted_pos, 7u);
+    CHECK_EQ(recovery.torn, 0u);
+    REQUIRE(recovery.records.size() == 40);
+    CHECK(recovery.records[0].kind == FlightRecordKind::DAEMON_START);
+    size_t mismatched = 0;
+    for (size_t i = 1; i < recovery.records.size(); ++i) {
+        CHECK_EQ(recovery.records[i].seq, i + 1);
+        if (!crash_test_matches(recovery.records[i])) mismatched++;
+    }
+    CHECK_EQ(mismatched, 0u);
+
+    // 容量相同则重用文件，上一次的记录留在 recovered() 里
+    FlightRecorder reopened;
+    REQUIRE(reopened.open(path, 64));
+    CHECK_EQ(reopened.recovered().records.size(), 40u);
+    reopened.mark_clean_shutdown();
+    CHECK(FlightRecorder::decode(path).clean_shutdown);
+}
+
+TEST_CASE(flight_recorder_restores_unpersisted_logs) {
+    std::string path = test_harness::scratch_dir("flight_recorder_logs") + "/flight.bin";
+    {
+        FlightRecorder recorder;
+        REQUIRE(recorder.open(path, 64));
+        recorder.record_log(1000, LogLevel::INFO, "冻结", "com.example.a", 0, "已持久化", 3);
+        recorder.record_log(2000, LogLevel::WARN, "解冻", "com.example.b", 10, "未持久化", 4);
+        recorder.record(FlightRecordKind::IPC_COMMAND, 9, 64, 0, "cmd.set_policy");
+        recorder.mark_log_persisted(4);
+    }
+
+    std::vector<LogEntry> entries = FlightRecorder::to_log_entries(FlightRecorder::decode(path));
+    // 汇总、DAEMON_START、未落盘的一条日志与 IPC 记录
+    REQUIRE(entries.size() == 4);
+    CHECK(entries[0].message.find("1 条日志未及落盘") != std::string::npos);
+    CHECK_EQ(entries[2].category, std::string("解冻"));
+    CHECK_EQ(entries[2].package_name, std::string("com.example.b"));
+    CHECK_EQ(entries[2].message, std::string("未持久化"));
+    CHECK_EQ(entries[2].user_id, 10);
+    CHECK(entries[3].message.find("cmd.set_policy") != std::string::npos);
+}
+
+// 子进程持续写入时被 SIGKILL，父进程解码并逐条校验内容与 seq 连续性
+TEST_CASE(flight_recorder_survives_sigkill) {
+    std::string dir = test_harness::scratch_dir("flight_recorder_crash");
+    std::mt19937 rng(static_cast<uint32_t>(getpid()));
+    size_t mismatched = 0, missing = 0;
+    int unclean = 0, completed = 0;
+    for (int round = 0; round < CRASH_TEST_ROUNDS; ++round) {
+        std::string path = dir + "/crash_" + std::to_string(round) + ".bin";
+        uint64_t kill_after = 0;
+        {
+            FlightRecorder recorder;
+            REQUIRE(recorder.open(path, CRASH_TEST_CAPACITY));
+            // 第 1 条是 open 写入的 DAEMON_START，子进程从第 2 条写起
+            pid_t child = fork();
+            REQUIRE(child != -1);
+            if (child == 0) {
+                // 子进程只做对映射内存的写入，不分配内存也不加锁
+                for (uint64_t seq = 2; seq < (1ULL << 40); ++seq) write_crash_test_record(recorder, seq);
+                _exit(0);
+            }
+            uint64_t target = CRASH_TEST_CAPACITY * (2 + round % 3) + rng() % CRASH_TEST_CAPACITY;
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+            while (recorder.next_seq() < target && std::chrono::steady_clock::now() < deadline) std::this_thread::yield();
+            kill(child, SIGKILL);
+            waitpid(child, nullptr, 0);
+            kill_after = recorder.next_seq();
+        }
+
+        FlightRecovery recovery = FlightRecorder::decode(path);
+        if (recovery.found && !recovery.clean_shutdown) unclean++;
+        std::set<uint64_t> seen;
+        for (const auto& record : recovery.records) {
+            seen.insert(record.seq);
+            if (record.seq >= 2 && !crash_test_matches(record)) mismatched++;
+        }
+        // 单写者：窗口内缺失的只可能是被杀时正在写的最后一条
+        uint64_t window_begin = recovery.next_seq > CRASH_TEST_CAPACITY ? recovery.next_seq - CRASH_TEST_CAPACITY + 1 : 1;
+        for (uint64_t seq = window_begin; seq < recovery.next_seq; ++seq) {
+            if (!seen.count(seq)) missing++;
+        }
+        if (recovery.next_seq == kill_after && kill_after > CRASH_TEST_CAPACITY) completed++;
+    }
+    CHECK_EQ(mismatched, 0u);
+    CHECK_EQ(missing, 0u);
+    CHECK_EQ(unclean, CRASH_TEST_ROUNDS);
+    CHECK_EQ(completed, CRASH_TEST_ROUNDS);
+}
+
+// 人为撕裂：直接改动文件中已写入槽位的内容或 seq 而不更新校验和，解码必须丢弃它们
+TEST_CASE(flight_recorder_discards_torn_slots) {
+    std::string path = test_harness::scratch_dir("flight_recorder_torn") + "/flight.bin";
+    constexpr uint32_t capacity = 64;
+    {
+        FlightRecorder recorder;
+        REQUIRE(recorder.open(path, capacity));
+        for (uint64_t seq = 2; seq <= 100; ++seq) write_crash_test_record(recorder, seq);
+    }
+
+    int fd = open(path.c_str(), O_RDWR | O_CLOEXEC);
+    REQUIRE(fd != -1);
+    size_t size = HEADER_SIZE + static_cast<size_t>(capacity) * SLOT_SIZE;
+    void* mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    REQUIRE(mapping != MAP_FAILED);
+    auto* slots = reinterpret_cast<FlightSlot*>(static_cast<char*>(mapping) + HEADER_SIZE);
+    size_t injected = 0;
+    for (uint32_t i = 3; i < capacity; i += 5) {
+        if (i % 2) slots[i].body.text[0] ^= 0x20;
+        else slots[i].body.value ^= 1;
+        injected++;
+    }
+    // 模拟编译器重排：第 66 条的内容已写入而 seq 仍是上一圈的 2
+    slots[1].seq.store(2, std::memory_order_relaxed);
+    injected++;
+    munmap(mapping, size);
+
+    FlightRecovery recovery = FlightRecorder::decode(path);
+    CHECK_EQ(recovery.torn, injected);
+    CHECK_EQ(recovery.records.size(), capacity - injected);
+    size_t mismatched = 0;
+    for (const auto& record : recovery.records) {
+        if (!crash_test_matches(record)) mismatched++;
+    }
+    CHECK_EQ(mismatched, 0u);
+}
+
+// 无竞争的获取只计次数；被持有期间的获取计入一次等待，等待时长不短于持有者的剩余持有时间
+TEST_CASE(recorded_mutex_measures_lock_waits) {
+    RecordedMutex mutex("test_mutex");
+    for (int i = 0; i < 10; ++i) {
+        std::lock_guard<RecordedMutex> lock(mutex);
+    }
+    RecordedMutex::Stats stats = mutex.get_stats();
+    CHECK_EQ(stats.acquisitions, 10u);
+    CHECK_EQ(stats.contended, 0u);
+    CHECK_EQ(stats.max_wait_us, 0u);
+
+    std::promise<void> locked;
+    std::thread holder([&mutex, &locked] {
+        std::lock_guard<RecordedMutex> lock(mutex);
+        locked.set_value();
+        std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    });
+    locked.get_future().wait();
+    {
+        std::lock_guard<RecordedMutex> lock(mutex);
+    }
+    holder.join();
+    stats = mutex.get_stats();
+    CHECK_EQ(stats.acquisitions, 12u);
+    CHECK_EQ(stats.contended, 1u);
+    CHECK(stats.max_wait_us >= 10000u);
+    CHECK_EQ(stats.total_wait_us, stats.max_wait_us);
+    REQUIRE(mutex.try_lock());
+    mutex.unlock();
+    CHECK_EQ(mutex.get_stats().acquisitions, 13u);
+}
+
+// 单线程写入一条 LOG 记录的开销
+BENCHMARK_CASE(flight_recorder_benchmark) {
+    std::string path = test_harness::scratch_dir("flight_recorder_benchmark") + "/flight.bin";
+    FlightRecorder recorder;
+    REQUIRE(recorder.open(path));
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < FLIGHT_RECORDER_BENCHMARK_RECORDS; ++i) {
+        recorder.record_log(i, LogLevel::ACTION_FREEZE, "冻结", "com.tencent.mm", 0, "因后台超时被冻结 (Cgroup)", i);
+    }
+    auto elapsed_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    CHECK_EQ(recorder.next_seq(), static_cast<uint64_t>(FLIGHT_RECORDER_BENCHMARK_RECORDS) + 1);
+    test_harness::report_benchmark({
+        {"records", FLIGHT_RECORDER_BENCHMARK_RECORDS},
+        {"record_ns", static_cast<double>(elapsed_ns) / FLIGHT_RECORDER_BENCHMARK_RECORDS}
+    });
+}
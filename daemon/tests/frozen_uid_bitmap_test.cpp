@@ -0,0 +1,86 @@
+// daemon/tests/frozen_uid_bitmap_test.cpp
+#include "test_harness.h"
+#include "frozen_uid_bitmap.h"
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+using namespace frozen_uid_layout;
+
+// 并发测试中写者切换集合的次数
+constexpr int SEQLOCK_TEST_WRITES = 20000;
+
+TEST_CASE(frozen_uid_bitmap_reader_sees_updates) {
+    FrozenUidBitmap writer;
+    REQUIRE(writer.create());
+    FrozenUidBitmapReader reader;
+    REQUIRE(reader.attach(writer.reader_fd()));
+
+    const int clone_uid = 999 * PER_USER_RANGE + FIRST_APP_ID + 42;
+    writer.update({FIRST_APP_ID + 1, clone_uid});
+    CHECK(reader.is_frozen(FIRST_APP_ID + 1) == std::optional<bool>(true));
+    CHECK(reader.is_frozen(FIRST_APP_ID + 2) == std::optional<bool>(false));
+    CHECK(reader.is_frozen(clone_uid) == std::optional<bool>(true));
+    CHECK(reader.frozen_uids() == std::vector<int>({FIRST_APP_ID + 1, clone_uid}));
+
+    // 集合未变化时不触碰 sequence
+    uint32_t sequence = reader.sequence();
+    writer.update({clone_uid, FIRST_APP_ID + 1});
+    CHECK_EQ(reader.sequence(), sequence);
+
+    writer.update({});
+    CHECK(reader.frozen_uids().empty());
+    CHECK(reader.is_frozen(clone_uid) == std::optional<bool>(false));
+    CHECK_EQ(reader.sequence() % 2, 0u);
+}
+
+TEST_CASE(frozen_uid_bitmap_ignores_non_app_uids) {
+    FrozenUidBitmap writer;
+    REQUIRE(writer.create());
+    FrozenUidBitmapReader reader;
+    REQUIRE(reader.attach(writer.reader_fd()));
+
+    writer.update({1000, 2000, FIRST_APP_ID});
+    CHECK(reader.frozen_uids() == std::vector<int>({FIRST_APP_ID}));
+    CHECK(!reader.is_frozen(1000).has_value());
+    // 从未出现过的用户没有槽位，结果未知
+    CHECK(!reader.is_frozen(5 * PER_USER_RANGE + FIRST_APP_ID).has_value());
+}
+
+// 写者在两个互不相交、跨越多个字和两个用户的集合之间反复切换，读者任何时候都只应看到其中之一
+TEST_CASE(frozen_uid_bitmap_seqlock_never_tears) {
+    FrozenUidBitmap writer;
+    REQUIRE(writer.create());
+    FrozenUidBitmapReader reader;
+    REQUIRE(reader.attach(writer.reader_fd()));
+
+    std::vector<int> set_a, set_b;
+    for (int i = 0; i < 300; ++i) set_a.push_back(FIRST_APP_ID + i * 7);
+    for (int i = 0; i < 200; ++i) set_b.push_back(10 * PER_USER_RANGE + FIRST_APP_ID + i * 13);
+    writer.update(set_b);
+    writer.update(set_a);
+    std::sort(set_a.begin(), set_a.end());
+    std::sort(set_b.begin(), set_b.end());
+
+    std::atomic<bool> done{false};
+    std::thread writer_thread([&] {
+        for (int i = 0; i < SEQLOCK_TEST_WRITES; ++i) writer.update((i % 2) ? set_a : set_b);
+        done.store(true, std::memory_order_release);
+    });
+
+    uint64_t reads = 0, torn = 0, unknown = 0;
+    while (!done.load(std::memory_order_acquire)) {
+        auto seen = reader.frozen_uids();
+        ++reads;
+        if (seen != set_a && seen != set_b) ++torn;
+        // 两个用户都已分配槽位，单点查询必须给出确定结果
+        if (!reader.is_frozen(set_a.front()).has_value() || !reader.is_frozen(set_b.back()).has_value()) ++unknown;
+    }
+    writer_thread.join();
+
+    CHECK(reads > 0);
+    CHECK_EQ(torn, 0u);
+    CHECK_EQ(unknown, 0u);
+    CHECK(reader.frozen_uids() == set_a);
+    CHECK_EQ(reader.sequence() % 2, 0u);
+}
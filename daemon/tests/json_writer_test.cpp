@@ -0,0 +1,120 @@
+// daemon/tests/json_writer_test.cpp
+#include "test_harness.h"
+#include "test_fixtures.h"
+#include "json_writer.h"
+#include "state_manager.h"
+#include "time_series_database.h"
+#include <chrono>
+
+// 序列化基准：合成仪表盘的应用数、历史记录条数与重复次数
+constexpr int SERIALIZER_BENCHMARK_APPS = 500;
+constexpr int SERIALIZER_BENCHMARK_RECORDS = 900;
+constexpr int SERIALIZER_BENCHMARK_ITERATIONS = 20;
+
+static std::vector<MetricsRecord> make_history(int count) {
+    std::vector<MetricsRecord> records(count);
+    for (int i = 0; i < count; ++i) {
+        MetricsRecord& record = records[i];
+        record.timestamp_ms = 1767225600000LL + i * 2000LL;
+        record.total_cpu_usage_percent = static_cast<float>(i % 97) / 3.0f;
+        record.per_core_cpu_usage.assign(8, static_cast<float>(i % 13) * 1.5f);
+        record.mem_total_kb = 7864320;
+        record.mem_available_kb = 2621440 + i;
+        record.battery_level = 80 - i % 20;
+        record.battery_temp_celsius = 31.5f;
+        record.battery_power_watt = -1.25f;
+    }
+    return records;
+}
+
+// 与守护进程推送的仪表盘帧写法一致
+static std::string dashboard_dom_text(const StateSnapshot& snapshot) {
+    return json{{"type", "stream.dashboard_update"}, {"payload", build_dashboard_payload(&snapshot)}}.dump();
+}
+
+static std::string dashboard_stream_text(const StateSnapshot& snapshot) {
+    JsonWriter writer;
+    writer.begin_object().key("payload");
+    write_dashboard_payload(writer, &snapshot);
+    writer.field("type", "stream.dashboard_update").end_object();
+    return writer.take();
+}
+
+static std::string history_dom_text(const std::vector<MetricsRecord>& records) {
+    json record_array = json::array();
+    for (const auto& record : records) record_array.push_back(record.to_json());
+    return json{{"type", "resp.history_stats"}, {"payload", record_array}}.dump();
+}
+
+static std::string history_stream_text(const std::vector<MetricsRecord>& records) {
+    JsonWriter writer;
+    writer.begin_object().key("payload").begin_array();
+    for (const auto& record : records) record.write_json(writer);
+    writer.end_array().field("type", "resp.history_stats").end_object();
+    return writer.take();
+}
+
+TEST_CASE(json_writer_matches_dom_dump) {
+    JsonWriter writer;
+    writer.begin_object()
+          .field("empty", "")
+          .field("escaped", "引号\" 反斜杠\\ 换行\n 控制\x01")
+          .field("float", 0.1f)
+          .field("negative", -42)
+          .field("yes", true);
+    writer.key("list").begin_array().value(1).value(2.5).null_value().end_array();
+    writer.end_object();
+    json expected = {
+        {"empty", ""}, {"escaped", "引号\" 反斜杠\\ 换行\n 控制\x01"}, {"float", 0.1f}, {"negative", -42}, {"yes", true},
+        {"list", {1, 2.5, nullptr}}
+    };
+    // 流式写出不排序，按解析后的值比较
+    CHECK(json::parse(writer.take()) == expected);
+}
+
+TEST_CASE(streaming_serializers_match_dom) {
+    StateSnapshot snapshot = make_dashboard_snapshot(50);
+    CHECK_EQ(dashboard_stream_text(snapshot), dashboard_dom_text(snapshot));
+    StateSnapshot empty;
+    CHECK_EQ(dashboard_stream_text(empty), dashboard_dom_text(empty));
+
+    std::vector<MetricsRecord> records = make_history(30);
+    records[3].per_core_cpu_usage.clear();
+    records[4].battery_level = -1;
+    CHECK_EQ(history_stream_text(records), history_dom_text(records));
+}
+
+// 以合成的 500 应用快照与 900 条历史记录比较“构建 DOM + dump()”与流式写出：
+// 每次序列化的平均耗时、当前线程的堆分配次数，并确认两者输出逐字节一致
+BENCHMARK_CASE(serializer_benchmark) {
+    StateSnapshot snapshot = make_dashboard_snapshot(SERIALIZER_BENCHMARK_APPS);
+    std::vector<MetricsRecord> records = make_history(SERIALIZER_BENCHMARK_RECORDS);
+
+    auto measure = [](const auto& serialize) {
+        std::string output;
+        uint64_t allocations_before = test_harness::heap_allocations();
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < SERIALIZER_BENCHMARK_ITERATIONS; ++i) output = serialize();
+        auto elapsed_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+        json stats = {
+            {"bytes", output.size()},
+            {"us", elapsed_us / SERIALIZER_BENCHMARK_ITERATIONS},
+            {"allocations", (test_harness::heap_allocations() - allocations_before) / SERIALIZER_BENCHMARK_ITERATIONS}
+        };
+        return std::make_pair(std::move(stats), std::move(output));
+    };
+
+    auto [dashboard_dom, dashboard_dom_out] = measure([&snapshot] { return dashboard_dom_text(snapshot); });
+    auto [dashboard_stream, dashboard_stream_out] = measure([&snapshot] { return dashboard_stream_text(snapshot); });
+    auto [history_dom, history_dom_out] = measure([&records] { return history_dom_text(records); });
+    auto [history_stream, history_stream_out] = measure([&records] { return history_stream_text(records); });
+
+    CHECK_EQ(dashboard_stream_out, dashboard_dom_out);
+    CHECK_EQ(history_stream_out, history_dom_out);
+    CHECK(dashboard_stream["allocations"].get<uint64_t>() < dashboard_dom["allocations"].get<uint64_t>());
+    CHECK(history_stream["allocations"].get<uint64_t>() < history_dom["allocations"].get<uint64_t>());
+    test_harness::report_benchmark({
+        {"dashboard", {{"apps", SERIALIZER_BENCHMARK_APPS}, {"dom", dashboard_dom}, {"streaming", dashboard_stream}}},
+        {"history", {{"records", SERIALIZER_BENCHMARK_RECORDS}, {"dom", history_dom}, {"streaming", history_stream}}}
+    });
+}
@@ -0,0 +1,213 @@
+// daemon/tests/log_queue_test.cpp
+#include "test_harness.h"
+#include "log_queue.h"
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <iterator>
+#include <thread>
+#include <vector>
+
+// 压力测试：生产者线程数与每个线程写入的条数；断言测试用小队列以覆盖队列满时的等待
+constexpr int LOG_QUEUE_TEST_PRODUCERS = 4;
+constexpr int LOG_QUEUE_TEST_PER_PRODUCER = 5000;
+constexpr size_t LOG_QUEUE_TEST_CAPACITY = 64;
+constexpr int LOG_QUEUE_STRESS_PRODUCERS = 8;
+constexpr int LOG_QUEUE_STRESS_PER_PRODUCER = 50000;
+constexpr size_t LOG_QUEUE_STRESS_CAPACITY = 4096;
+
+TEST_CASE(log_string_table_interns_and_looks_up) {
+    LogStringTable strings;
+    CHECK_EQ(strings.intern(""), 0u);
+    CHECK(strings.lookup(0).empty());
+    uint32_t freeze = strings.intern("冻结");
+    uint32_t package = strings.intern("com.example.app");
+    CHECK(freeze != 0 && package != 0 && freeze != package);
+    CHECK_EQ(strings.intern(std::string("冻结")), freeze);
+    CHECK_EQ(strings.lookup(freeze), std::string("冻结"));
+    CHECK_EQ(strings.lookup(package), std::string("com.example.app"));
+    CHECK_EQ(strings.size(), 3u);
+
+    // 其他线程的缓存为空，只能走全局表，结果必须一致
+    uint32_t from_other_thread = 0;
+    std::thread([&] { from_other_thread = strings.intern("com.example.app"); }).join();
+    CHECK_EQ(from_other_thread, package);
+}
+
+TEST_CASE(log_queue_drains_in_position_order) {
+    LogQueue queue(8);
+    std::string long_message(LogSlot::INLINE_MESSAGE_BYTES + 50, 'x');
+    CHECK_EQ(queue.push(1, LogLevel::INFO, 1, 0, -1, "short"), 0u);
+    CHECK_EQ(queue.push(2, LogLevel::WARN, 2, 3, 10, long_message), 1u);
+    CHECK(queue.has_ready());
+
+    std::vector<std::pair<uint64_t, std::string>> seen;
+    size_t taken = queue.drain(SIZE_MAX, [&](uint64_t pos, const LogSlot& slot) {
+        seen.emplace_back(pos, std::string(slot.message_view()));
+        if (pos == 1) {
+            CHECK_EQ(slot.timestamp_ms, 2LL);
+            CHECK_EQ(slot.package_id, 3u);
+            CHECK_EQ(slot.user_id, 10);
+            CHECK_EQ(slot.level, static_cast<uint8_t>(LogLevel::WARN));
+        }
+    });
+    CHECK_EQ(taken, 2u);
+    REQUIRE(seen.size() == 2);
+    CHECK_EQ(seen[0].second, std::string("short"));
+    CHECK_EQ(seen[1].second, long_message);
+    CHECK(!queue.has_ready());
+
+    // 环绕多圈后位置号继续递增
+    for (int i = 0; i < 20; ++i) {
+        CHECK_EQ(queue.push(i, LogLevel::INFO, 0, 0, 0, "wrap"), static_cast<uint64_t>(i + 2));
+        CHECK_EQ(queue.drain(1, [](uint64_t, const LogSlot&) {}), 1u);
+    }
+    CHECK_EQ(queue.full_waits(), 0u);
+}
+
+static json percentiles(std::vector<uint32_t>& samples_ns) {
+    if (samples_ns.empty()) return json::object();
+    std::sort(samples_ns.begin(), samples_ns.end());
+    auto at = [&](double q) { return samples_ns[std::min(samples_ns.size() - 1, static_cast<size_t>(q * samples_ns.size()))]; };
+    return {
+        {"p50_ns", at(0.50)},
+        {"p90_ns", at(0.90)},
+        {"p99_ns", at(0.99)},
+        {"p999_ns", at(0.999)},
+        {"max_ns", samples_ns.back()}
+    };
+}
+
+// producers 个线程各写 per_producer 条，单消费者同时取出。
+// 断言每条恰好收到一次、位置号连续且同一生产者的条目保持顺序，并与旧路径（构造 LogEntry + 互斥锁 + deque）
+// 比较生产者单次调用耗时的分位数
+static json stress_queue(int producers, int per_producer, size_t capacity) {
+    static const char* CATEGORIES[] = {"冻结", "解冻", "唤醒", "节流阀", "审计"};
+    auto now_ns = [] {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    };
+    json result = {{"producers", producers}, {"per_producer", per_producer}};
+
+    // 新路径：驻留 ID + 无锁队列，单消费者边取边校验
+    {
+        LogStringTable strings;
+        LogQueue queue(capacity);
+        std::atomic<bool> producers_done{false};
+        std::vector<long long> next_expected(producers, 0);
+        uint64_t received = 0, out_of_order = 0, last_pos = 0;
+        bool first = true;
+        std::thread consumer([&] {
+            auto consume = [&](uint64_t pos, const LogSlot& slot) {
+                int producer = slot.user_id;
+                if (producer < 0 || producer >= producers || slot.timestamp_ms != next_expected[producer] ||
+                    (!first && pos != last_pos + 1)) {
+                    out_of_order++;
+                }
+                if (producer >= 0 && producer < producers) next_expected[producer] = slot.timestamp_ms + 1;
+                last_pos = pos;
+                first = false;
+                received++;
+            };
+            while (!producers_done.load(std::memory_order_acquire) || queue.has_ready()) {
+                if (queue.drain(SIZE_MAX, consume) == 0) std::this_thread::yield();
+            }
+        });
+        std::vector<std::vector<uint32_t>> latencies(producers);
+        std::vector<std::thread> threads;
+        auto start = std::chrono::steady_clock::now();
+        for (int p = 0; p < producers; ++p) {
+            threads.emplace_back([&, p] {
+                auto& samples = latencies[p];
+                samples.reserve(per_producer);
+                std::string package = "com.example.stress" + std::to_string(p % 4);
+                for (int i = 0; i < per_producer; ++i) {
+                    std::string message = "唤醒风暴 uid=" + std::to_string(10000 + p) + " #" + std::to_string(i);
+                    long long t0 = now_ns();
+                    queue.push(i, LogLevel::ACTION_FREEZE, strings.intern(CATEGORIES[i % 5]), strings.intern(package), p, message);
+                    samples.push_back(static_cast<uint32_t>(std::min<long long>(now_ns() - t0, UINT32_MAX)));
+                }
+            });
+        }
+        for (auto& thread : threads) thread.join();
+        producers_done.store(true, std::memory_order_release);
+        consumer.join();
+        auto elapsed_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+        std::vector<uint32_t> all;
+        for (auto& samples : latencies) all.insert(all.end(), samples.begin(), samples.end());
+        CHECK_EQ(received, static_cast<uint64_t>(producers) * per_producer);
+        CHECK_EQ(out_of_order, 0u);
+        for (long long expected : next_expected) CHECK_EQ(expected, static_cast<long long>(per_producer));
+        CHECK_EQ(strings.size() - 1, std::size(CATEGORIES) + static_cast<size_t>(std::min(producers, 4)));
+        result["lock_free"] = {
+            {"received", received},
+            {"full_waits", queue.full_waits()},
+            {"interned_strings", strings.size() - 1},
+            {"elapsed_us", elapsed_us},
+            {"latency", percentiles(all)}
+        };
+    }
+
+    // 旧路径：每次构造带 std::string 的 LogEntry，在互斥锁下 push 进 deque，消费者整体 swap 取走
+    {
+        std::mutex mutex;
+        std::deque<LogEntry> pending;
+        std::atomic<bool> producers_done{false};
+        uint64_t received = 0;
+        std::thread consumer([&] {
+            std::deque<LogEntry> batch;
+            for (;;) {
+                bool done = producers_done.load(std::memory_order_acquire);
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    batch.swap(pending);
+                }
+                received += batch.size();
+                bool drained_any = !batch.empty();
+                batch.clear();
+                if (done && !drained_any) break;
+                if (!drained_any) std::this_thread::yield();
+            }
+        });
+        std::vector<std::vector<uint32_t>> latencies(producers);
+        std::vector<std::thread> threads;
+        auto start = std::chrono::steady_clock::now();
+        for (int p = 0; p < producers; ++p) {
+            threads.emplace_back([&, p] {
+                auto& samples = latencies[p];
+                samples.reserve(per_producer);
+                std::string package = "com.example.stress" + std::to_string(p % 4);
+                for (int i = 0; i < per_producer; ++i) {
+                    std::string message = "唤醒风暴 uid=" + std::to_string(10000 + p) + " #" + std::to_string(i);
+                    long long t0 = now_ns();
+                    LogEntry entry{i, LogLevel::ACTION_FREEZE, CATEGORIES[i % 5], message, package, p};
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        pending.push_back(std::move(entry));
+                    }
+                    samples.push_back(static_cast<uint32_t>(std::min<long long>(now_ns() - t0, UINT32_MAX)));
+                }
+            });
+        }
+        for (auto& thread : threads) thread.join();
+        producers_done.store(true, std::memory_order_release);
+        consumer.join();
+        auto elapsed_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+        std::vector<uint32_t> all;
+        for (auto& samples : latencies) all.insert(all.end(), samples.begin(), samples.end());
+        CHECK_EQ(received, static_cast<uint64_t>(producers) * per_producer);
+        result["mutex_deque"] = {
+            {"received", received},
+            {"elapsed_us", elapsed_us},
+            {"latency", percentiles(all)}
+        };
+    }
+    return result;
+}
+
+TEST_CASE(log_queue_concurrent_producers_lose_nothing) {
+    stress_queue(LOG_QUEUE_TEST_PRODUCERS, LOG_QUEUE_TEST_PER_PRODUCER, LOG_QUEUE_TEST_CAPACITY);
+}
+
+BENCHMARK_CASE(log_queue_stress_test) {
+    test_harness::report_benchmark(stress_queue(LOG_QUEUE_STRESS_PRODUCERS, LOG_QUEUE_STRESS_PER_PRODUCER, LOG_QUEUE_STRESS_CAPACITY));
+}
@@ -0,0 +1,471 @@
+// daemon/tests/log_segment_test.cpp
+#include "test_harness.h"
+#include "test_fixtures.h"
+#include "log_segment.h"
+#include "text_search.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+
+namespace fs = std::filesystem;
+using namespace log_segment_layout;
+
+// 断言测试与基准的合成日志条数
+constexpr size_t LOG_SEGMENT_TEST_ENTRIES = 5000;
+constexpr size_t LOG_SEGMENT_BENCHMARK_ENTRIES = 100000;
+// 写入对比的条数（结果按每 1 万条折算）
+constexpr size_t LOG_WRITER_TEST_ENTRIES = 2000;
+constexpr size_t LOG_WRITER_BENCHMARK_ENTRIES = 10000;
+// 全文检索对比的条数，基准约等于保留期内的全部日志（3 天 × 每天 3 个文件 × 每文件 4096 条）
+constexpr size_t LOG_TEXT_SEARCH_TEST_ENTRIES = 10000;
+constexpr size_t LOG_TEXT_SEARCH_BENCHMARK_ENTRIES = 36864;
+
+// 以 LogSegmentWriter 写出并封存一个段，每 INDEX_INTERVAL 条 flush 一次
+static bool write_segment(const std::string& path, const std::vector<LogEntry>& entries) {
+    LogSegmentWriter writer;
+    if (!writer.open(path)) return false;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        writer.append(entries[i]);
+        if ((i + 1) % INDEX_INTERVAL == 0 && !writer.flush()) return false;
+    }
+    return writer.seal();
+}
+
+static bool same_entry(const LogEntry& a, const LogEntry& b) {
+    return a.timestamp_ms == b.timestamp_ms && a.level == b.level && a.category == b.category && a.message == b.message &&
+           a.package_name == b.package_name && a.user_id == b.user_id;
+}
+
+// 同一批日志分别以旧版 JSON 行与段格式写出，比较写入耗时、文件大小，
+// 以及几类查询（最新一页、按时间定位、按级别、按包名）的耗时与解码量；两种格式的查询结果必须一致
+static json compare_with_legacy(const std::string& work_dir, size_t entries) {
+    std::string legacy_path = work_dir + "/bench.log";
+    std::string segment_path = work_dir + "/bench.seg";
+    std::vector<LogEntry> generated = make_synthetic_logs(entries);
+
+    auto now = [] { return std::chrono::steady_clock::now(); };
+    auto micros = [](auto begin, auto end) { return std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count(); };
+
+    auto legacy_start = now();
+    {
+        std::ofstream output(legacy_path, std::ios_base::trunc);
+        for (const auto& entry : generated) output << legacy_log_line(entry);
+    }
+    auto legacy_write_us = micros(legacy_start, now());
+
+    auto segment_start = now();
+    CHECK(write_segment(segment_path, generated));
+    auto segment_write_us = micros(segment_start, now());
+
+    struct NamedQuery {
+        const char* name;
+        LogQuery query;
+    };
+    std::vector<NamedQuery> queries(5);
+    queries[0].name = "latest_page";
+    queries[1].name = "seek_by_time";
+    queries[1].query.before_ts = generated[generated.size() / 4].timestamp_ms;
+    queries[2].name = "level_error";
+    queries[2].query.level_mask = 1u << static_cast<int>(LogLevel::ERROR);
+    queries[3].name = "rare_package";
+    queries[3].query.package_name = "com.example.package0";
+    queries[4].name = "since_recent";
+    queries[4].query.since_ts = generated[generated.size() - generated.size() / 50].timestamp_ms;
+
+    LogSegmentReader reader;
+    CHECK(reader.open(segment_path));
+    json query_results = json::object();
+    for (const auto& [name, query] : queries) {
+        std::vector<LogEntry> legacy_out, segment_out;
+        LogQueryStats legacy_stats, segment_stats;
+        auto t0 = now();
+        log_segment::query_legacy_file(legacy_path, query, legacy_out, &legacy_stats);
+        auto t1 = now();
+        reader.query(query, segment_out, &segment_stats);
+        auto t2 = now();
+
+        CHECK(!segment_out.empty());
+        CHECK_EQ(segment_out.size(), legacy_out.size());
+        bool identical = legacy_out.size() == segment_out.size();
+        for (size_t i = 0; identical && i < legacy_out.size(); ++i) identical = same_entry(legacy_out[i], segment_out[i]);
+        CHECK(identical);
+        query_results[name] = {
+            {"results", segment_out.size()},
+            {"legacy", {{"us", micros(t0, t1)}, {"decoded", legacy_stats.records_decoded}}},
+            {"segment", {{"us", micros(t1, t2)}, {"examined", segment_stats.records_examined},
+                         {"decoded", segment_stats.records_decoded}, {"blocks_skipped", segment_stats.blocks_skipped},
+                         {"blocks_total", segment_stats.blocks_total}}}
+        };
+    }
+
+    std::error_code ec;
+    return {
+        {"entries", entries},
+        {"legacy", {{"bytes", fs::file_size(legacy_path, ec)}, {"write_us", legacy_write_us}}},
+        {"segment", {{"bytes", fs::file_size(segment_path, ec)}, {"write_us", segment_write_us}}},
+        {"queries", query_results}
+    };
+}
+
+// 以批大小 1、16、64 写出 entries 条合成日志，比较旧版写入线程（每批打开文件、每行写一次、换文件时重读）
+// 与组提交写入（常开 fd、每批一次 writev，可选每批或定时 fsync）每 1 万条的系统调用数与写出字节数
+static json compare_writers(const std::string& work_dir, size_t entries) {
+    constexpr size_t LEGACY_LINES_PER_FILE = 200;
+    constexpr size_t SEGMENT_ENTRIES_PER_FILE = 4096;
+    constexpr size_t LEGACY_READ_BUFFER = 8192;
+    constexpr long long SIMULATED_BATCH_GAP_MS = 10;
+    constexpr long long FSYNC_INTERVAL_MS = 1000;
+    std::vector<LogEntry> generated = make_synthetic_logs(entries);
+    auto per_10k = [entries](uint64_t value) { return entries ? value * 10000 / entries : 0; };
+
+    // 旧版写入线程：每批打开一个 ofstream，每行 std::endl 刷新一次，换文件时 manage_log_files 重读最新文件数行数
+    auto run_legacy = [&](size_t batch_size) {
+        uint64_t open_calls = 0, close_calls = 0, write_calls = 0, read_calls = 0, bytes = 0;
+        size_t file_index = 0, lines_in_file = 0;
+        std::string path;
+        auto start = std::chrono::steady_clock::now();
+        for (size_t first = 0; first < generated.size(); first += batch_size) {
+            size_t count = std::min(batch_size, generated.size() - first);
+            if (path.empty() || lines_in_file + count > LEGACY_LINES_PER_FILE) {
+                if (!path.empty()) {
+                    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+                    open_calls++;
+                    char buffer[LEGACY_READ_BUFFER];
+                    while (::read(fd, buffer, sizeof(buffer)) > 0) read_calls++;
+                    read_calls++;
+                    ::close(fd);
+                    close_calls++;
+                }
+                path = work_dir + "/legacy_" + std::to_string(++file_index) + ".log";
+                lines_in_file = 0;
+            }
+            int fd = ::open(path.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+            open_calls++;
+            for (size_t i = first; i < first + count; ++i) {
+                std::string line = legacy_log_line(generated[i]);
+                ssize_t written = ::write(fd, line.data(), line.size());
+                write_calls++;
+                if (written > 0) bytes += static_cast<uint64_t>(written);
+            }
+            ::close(fd);
+            close_calls++;
+            lines_in_file += count;
+        }
+        auto elapsed_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+        return json{
+            {"us", elapsed_us},
+            {"files", file_index},
+            {"syscalls_per_10k", per_10k(open_calls + close_calls + write_calls + read_calls)},
+            {"open_per_10k", per_10k(open_calls)},
+            {"close_per_10k", per_10k(close_calls)},
+            {"write_per_10k", per_10k(write_calls)},
+            {"read_per_10k", per_10k(read_calls)},
+            {"fsync_per_10k", 0},
+            {"bytes_per_10k", per_10k(bytes)}
+        };
+    };
+
+    // 新写入线程：段文件常开，每批一次 writev，按计数轮转；fsync_mode 0 不同步，1 每批同步，
+    // 2 按模拟时钟（每 SIMULATED_BATCH_GAP_MS 一批）至多每 FSYNC_INTERVAL_MS 同步一次
+    auto run_group_commit = [&](size_t batch_size, int fsync_mode, const std::string& tag) {
+        LogSegmentWriter writer;
+        size_t file_index = 0;
+        long long clock_ms = 0, last_sync_ms = 0;
+        bool unsynced = false;
+        std::deque<LogEntry> batch;
+        auto start = std::chrono::steady_clock::now();
+        for (size_t first = 0; first < generated.size(); first += batch_size) {
+            size_t count = std::min(batch_size, generated.size() - first);
+            if (!writer.is_open() || writer.entry_count() + count > SEGMENT_ENTRIES_PER_FILE) {
+                if (writer.is_open()) {
+                    if (fsync_mode != 0) writer.sync();
+                    writer.seal();
+                }
+                writer.open(work_dir + "/" + tag + "_" + std::to_string(++file_index) + ".seg");
+            }
+            batch.assign(generated.begin() + first, generated.begin() + first + count);
+            CHECK(writer.write_batch(batch));
+            clock_ms += SIMULATED_BATCH_GAP_MS;
+            unsynced = true;
+            if (fsync_mode == 1 || (fsync_mode == 2 && clock_ms - last_sync_ms >= FSYNC_INTERVAL_MS)) {
+                writer.sync();
+                last_sync_ms = clock_ms;
+                unsynced = false;
+            }
+        }
+        if (unsynced && fsync_mode != 0) writer.sync();
+        CHECK(writer.seal());
+        auto elapsed_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+        LogWriterStats stats = writer.stats();
+        CHECK_EQ(stats.entries, static_cast<uint64_t>(entries));
+        CHECK_EQ(stats.batches, static_cast<uint64_t>((entries + batch_size - 1) / batch_size));
+        CHECK_EQ(stats.fsync_calls == 0, fsync_mode == 0);
+        return json{
+            {"us", elapsed_us},
+            {"files", file_index},
+            {"syscalls_per_10k", per_10k(stats.open_calls + stats.close_calls + stats.write_calls + stats.fsync_calls)},
+            {"open_per_10k", per_10k(stats.open_calls)},
+            {"close_per_10k", per_10k(stats.close_calls)},
+            {"write_per_10k", per_10k(stats.write_calls)},
+            {"read_per_10k", 0},
+            {"fsync_per_10k", per_10k(stats.fsync_calls)},
+            {"bytes_per_10k", per_10k(stats.bytes_written)}
+        };
+    };
+
+    json scenarios = json::object();
+    for (size_t batch_size : {size_t{1}, size_t{16}, size_t{64}}) {
+        std::string tag = "batch_" + std::to_string(batch_size);
+        scenarios[tag] = {
+            {"legacy", run_legacy(batch_size)},
+            {"group_commit", run_group_commit(batch_size, 0, tag + "_nosync")},
+            {"group_commit_fsync_each_batch", run_group_commit(batch_size, 1, tag + "_sync")},
+            {"group_commit_fsync_1s", run_group_commit(batch_size, 2, tag + "_timed")}
+        };
+        CHECK(scenarios[tag]["group_commit"]["syscalls_per_10k"] < scenarios[tag]["legacy"]["syscalls_per_10k"]);
+        CHECK(scenarios[tag]["group_commit"]["bytes_per_10k"] < scenarios[tag]["legacy"]["bytes_per_10k"]);
+    }
+    return json{{"entries", entries}, {"simulated_batch_gap_ms", SIMULATED_BATCH_GAP_MS}, {"scenarios", scenarios}};
+}
+
+
+// 把 entries 条合成日志按 Logger 的轮转上限写成若干封存段，模拟完整的保留历史，
+// 比较子串扫描（std::string_view::find、逐字节、SIMD）的吞吐，以及几类关键字在
+// 逐字节 / SIMD × 有无三字节组索引四种组合下检索全部历史的耗时与跳过的块数；各组合与旧版 JSON 行的命中必须一致
+static json compare_text_search(const std::string& work_dir, size_t entries, int throughput_rounds) {
+    constexpr size_t SEGMENT_ENTRIES_PER_FILE = 4096;
+    std::error_code ec;
+    std::vector<LogEntry> generated = make_synthetic_logs(entries);
+    auto now = [] { return std::chrono::steady_clock::now(); };
+    auto micros = [](auto begin, auto end) { return std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count(); };
+
+    // 与 Logger 的轮转上限相同的一组封存段，外加同样内容的旧版 JSON 行文件作为对照
+    std::vector<std::string> segment_paths;
+    std::vector<std::string> legacy_paths;
+    for (size_t first = 0; first < generated.size(); first += SEGMENT_ENTRIES_PER_FILE) {
+        size_t last = std::min(generated.size(), first + SEGMENT_ENTRIES_PER_FILE);
+        std::string base = work_dir + "/part_" + std::to_string(segment_paths.size() + 1);
+        LogSegmentWriter writer;
+        std::ofstream legacy(base + ".log", std::ios_base::trunc);
+        if (!writer.open(base + ".seg")) break;
+        for (size_t i = first; i < last; ++i) {
+            writer.append(generated[i]);
+            if ((i + 1) % INDEX_INTERVAL == 0) writer.flush();
+            legacy << legacy_log_line(generated[i]);
+        }
+        CHECK(writer.seal());
+        segment_paths.push_back(base + ".seg");
+        legacy_paths.push_back(base + ".log");
+    }
+    uint64_t segment_bytes = 0, trigram_bytes = 0;
+    for (const auto& path : segment_paths) {
+        segment_bytes += fs::file_size(path, ec);
+        LogSegmentReader reader;
+        if (reader.open(path) && reader.has_trigram_index()) {
+            trigram_bytes += sizeof(LogTrigramSectionHeader) + (reader.entry_count() + INDEX_INTERVAL - 1) / INDEX_INTERVAL * TRIGRAM_BLOOM_BYTES;
+        }
+    }
+
+    // 子串扫描吞吐：把全部消息拼成一段，查找一个不存在的关键字（必须扫完全部字节）
+    std::string haystack;
+    for (const auto& entry : generated) haystack.append(entry.message).push_back('\n');
+    const std::string absent = "lowmemorykiller";
+    auto throughput = [&](auto&& find) {
+        size_t found = 0;
+        auto t0 = now();
+        for (int round = 0; round < throughput_rounds; ++round) {
+            if (find(std::string_view(haystack), std::string_view(absent)) != text_search::npos) found++;
+        }
+        CHECK_EQ(found, 0u);
+        double seconds = std::max<double>(micros(t0, now()), 1) / 1e6;
+        return json{{"mb_per_s", static_cast<double>(haystack.size()) * throughput_rounds / seconds / 1e6}, {"false_hits", found}};
+    };
+    json substring = {
+        {"haystack_bytes", haystack.size()},
+        {"std_find", throughput([](std::string_view h, std::string_view n) { return h.find(n); })},
+        {"scalar", throughput([](std::string_view h, std::string_view n) { return text_search::find_scalar(h, n); })},
+        {"simd", throughput([](std::string_view h, std::string_view n) { return text_search::find_simd(h, n); })}
+    };
+
+    // 全部历史上的检索：从新到旧取出全部命中
+    const std::string& sample = generated[generated.size() / 3].message;
+    size_t pid_at = sample.find("pid=");
+    std::vector<std::pair<const char*, std::string>> needles = {
+        {"rare", sample.substr(pid_at, sample.find(' ', pid_at) - pid_at + 1)},
+        {"medium", "adj=99"},
+        {"common", "执行冻结"},
+        {"absent", absent}
+    };
+    struct Mode {
+        const char* name;
+        LogTextSearchOptions options;
+    };
+    const Mode modes[] = {
+        {"scalar", {false, false}},
+        {"simd", {true, false}},
+        {"scalar_trigram", {false, true}},
+        {"simd_trigram", {true, true}}
+    };
+    json searches = json::object();
+    for (const auto& [label, needle] : needles) {
+        LogFilter filter;
+        filter.text = needle;
+        json row = {{"needle", needle}};
+        std::vector<uint64_t> reference;
+        bool identical = true;
+        for (const auto& mode : modes) {
+            std::vector<LogEntry> hits;
+            LogQueryStats stats;
+            auto t0 = now();
+            for (auto it = segment_paths.rbegin(); it != segment_paths.rend(); ++it) {
+                LogSegmentReader reader;
+                if (!reader.open(*it)) continue;
+                reader.set_text_search_options(mode.options);
+                reader.search(filter, 0, UINT64_MAX, true, SIZE_MAX, hits, &stats);
+            }
+            auto elapsed = micros(t0, now());
+            std::vector<uint64_t> seqs;
+            for (const auto& entry : hits) seqs.push_back(entry.seq);
+            if (reference.empty() && mode.options.simd == false && mode.options.trigram_index == false) reference = seqs;
+            else identical = identical && seqs == reference;
+            row[mode.name] = {{"us", elapsed}, {"hits", hits.size()}, {"blocks_total", stats.blocks_total},
+                              {"blocks_trigram_skipped", stats.blocks_trigram_skipped},
+                              {"records_examined", stats.records_examined}};
+        }
+        // 旧路径：逐行解析 JSON 后比较字符串
+        size_t legacy_hits = 0;
+        auto t0 = now();
+        for (const auto& path : legacy_paths) {
+            std::ifstream input(path);
+            std::string line;
+            LogEntry entry;
+            while (std::getline(input, line)) {
+                if (log_segment::parse_legacy_line(line, entry) && entry.message.find(needle) != std::string::npos) legacy_hits++;
+            }
+        }
+        row["legacy_json"] = {{"us", micros(t0, now())}, {"hits", legacy_hits}};
+        CHECK(identical);
+        CHECK_EQ(legacy_hits, reference.size());
+        searches[label] = row;
+    }
+
+    CHECK(searches["rare"]["scalar"]["hits"].get<size_t>() >= 1);
+    CHECK_EQ(searches["common"]["scalar"]["hits"].get<size_t>(), entries);
+    CHECK_EQ(searches["absent"]["scalar"]["hits"].get<size_t>(), 0u);
+    // 不存在的关键字应被三字节组索引排除掉大部分块
+    CHECK(searches["absent"]["simd_trigram"]["blocks_trigram_skipped"].get<size_t>() * 2 > searches["absent"]["simd_trigram"]["blocks_total"].get<size_t>());
+    return json{
+        {"entries", entries},
+        {"files", segment_paths.size()},
+        {"simd", text_search::simd_name()},
+        {"segment_bytes", segment_bytes},
+        {"trigram_index_bytes", trigram_bytes},
+        {"substring", substring},
+        {"searches", searches}
+    };
+}
+
+TEST_CASE(log_segment_round_trips_entries) {
+    std::string path = test_harness::scratch_dir("log_segment_round_trip") + "/roundtrip.seg";
+    std::vector<LogEntry> generated = make_synthetic_logs(LOG_SEGMENT_TEST_ENTRIES);
+    REQUIRE(write_segment(path, generated));
+
+    LogSegmentReader reader;
+    REQUIRE(reader.open(path));
+    CHECK(reader.is_sealed());
+    CHECK(reader.has_trigram_index());
+    CHECK_EQ(reader.entry_count(), generated.size());
+    CHECK_EQ(reader.min_ts(), generated.front().timestamp_ms);
+    CHECK_EQ(reader.max_ts(), generated.back().timestamp_ms);
+    CHECK_EQ(reader.first_seq(), generated.front().seq);
+    CHECK_EQ(reader.last_seq(), generated.back().seq);
+
+    std::vector<LogEntry> read_back;
+    reader.read_all(read_back);
+    REQUIRE(read_back.size() == generated.size());
+    size_t mismatches = 0;
+    for (size_t i = 0; i < generated.size(); ++i) {
+        if (!same_entry(read_back[i], generated[i]) || read_back[i].seq != generated[i].seq) ++mismatches;
+    }
+    CHECK_EQ(mismatches, 0u);
+}
+
+// 封存后再次打开会去掉尾部继续追加，未封存的段仍能顺序扫描读出
+TEST_CASE(log_segment_reopens_and_appends) {
+    std::string path = test_harness::scratch_dir("log_segment_reopen") + "/reopen.seg";
+    std::vector<LogEntry> generated = make_synthetic_logs(300);
+    std::vector<LogEntry> first(generated.begin(), generated.begin() + 200);
+    REQUIRE(write_segment(path, first));
+
+    LogSegmentWriter writer;
+    REQUIRE(writer.open(path));
+    CHECK_EQ(writer.entry_count(), 200u);
+    for (size_t i = 200; i < generated.size(); ++i) writer.append(generated[i]);
+    REQUIRE(writer.flush());
+    writer.close();
+
+    LogSegmentReader reader;
+    REQUIRE(reader.open(path));
+    CHECK(!reader.is_sealed());
+    std::vector<LogEntry> read_back;
+    reader.read_all(read_back);
+    REQUIRE(read_back.size() == generated.size());
+    CHECK(same_entry(read_back[199], generated[199]));
+    CHECK(same_entry(read_back.back(), generated.back()));
+}
+
+// 组提交一次写出整批，读回的内容与逐条 append 相同
+TEST_CASE(log_segment_write_batch_round_trips) {
+    std::string path = test_harness::scratch_dir("log_segment_write_batch") + "/batch.seg";
+    std::vector<LogEntry> generated = make_synthetic_logs(1000);
+    LogSegmentWriter writer;
+    REQUIRE(writer.open(path));
+    for (size_t first = 0; first < generated.size(); first += 100) {
+        std::deque<LogEntry> batch(generated.begin() + first, generated.begin() + first + 100);
+        REQUIRE(writer.write_batch(batch));
+    }
+    LogWriterStats stats = writer.stats();
+    CHECK_EQ(stats.batches, 10u);
+    CHECK_EQ(stats.entries, 1000u);
+    CHECK_EQ(stats.open_calls, 1u);
+    REQUIRE(writer.seal());
+
+    LogSegmentReader reader;
+    REQUIRE(reader.open(path));
+    std::vector<LogEntry> read_back;
+    reader.read_all(read_back);
+    REQUIRE(read_back.size() == generated.size());
+    size_t mismatches = 0;
+    for (size_t i = 0; i < generated.size(); ++i) {
+        if (!same_entry(read_back[i], generated[i])) ++mismatches;
+    }
+    CHECK_EQ(mismatches, 0u);
+}
+
+TEST_CASE(log_segment_group_commit_uses_fewer_syscalls) {
+    compare_writers(test_harness::scratch_dir("log_writer_compare"), LOG_WRITER_TEST_ENTRIES);
+}
+
+TEST_CASE(log_segment_text_search_modes_agree) {
+    compare_text_search(test_harness::scratch_dir("log_text_search"), LOG_TEXT_SEARCH_TEST_ENTRIES, 1);
+}
+
+TEST_CASE(log_segment_queries_match_legacy_file) {
+    compare_with_legacy(test_harness::scratch_dir("log_segment_queries"), LOG_SEGMENT_TEST_ENTRIES);
+}
+
+BENCHMARK_CASE(log_segment_benchmark) {
+    test_harness::report_benchmark(compare_with_legacy(test_harness::scratch_dir("log_segment_benchmark"), LOG_SEGMENT_BENCHMARK_ENTRIES));
+}
+
+BENCHMARK_CASE(log_writer_benchmark) {
+    test_harness::report_benchmark(compare_writers(test_harness::scratch_dir("log_writer_benchmark"), LOG_WRITER_BENCHMARK_ENTRIES));
+}
+
+BENCHMARK_CASE(text_search_benchmark) {
+    test_harness::report_benchmark(compare_text_search(test_harness::scratch_dir("text_search_benchmark"), LOG_TEXT_SEARCH_BENCHMARK_ENTRIES, 20));
+}
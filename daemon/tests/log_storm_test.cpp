@@ -0,0 +1,241 @@
+// daemon/tests/log_storm_test.cpp
+#include "test_harness.h"
+#include "log_storm.h"
+#include <algorithm>
+#include <random>
+#include <vector>
+
+static LogEntry storm_entry(long long timestamp_ms, std::string message, LogLevel level = LogLevel::WARN) {
+    return LogEntry{timestamp_ms, level, "节流阀", std::move(message), "com.example.storm", 0};
+}
+
+TEST_CASE(log_storm_template_masks_digit_runs) {
+    CHECK_EQ(LogStormAggregator::message_template("已冻结 (pids: 12345, 678)"), std::string("已冻结 (pids: #, #)"));
+    CHECK_EQ(LogStormAggregator::message_template("no digits"), std::string("no digits"));
+    CHECK_EQ(LogStormAggregator::message_template("9"), std::string("#"));
+}
+
+TEST_CASE(log_storm_merges_repeats_into_one_summary) {
+    LogStormConfig config;
+    config.window_ms = 1000;
+    config.passthrough = 2;
+    LogStormAggregator aggregator(config);
+    std::deque<LogEntry> out;
+    for (int i = 0; i < 10; ++i) aggregator.add(storm_entry(100 + i * 10, "pid=" + std::to_string(i)), out);
+    // 前 passthrough 条立即写出，其余等窗口结束
+    REQUIRE(out.size() == 2);
+    CHECK_EQ(out[1].message, std::string("pid=1"));
+    CHECK(aggregator.next_deadline_ms() == std::optional<long long>(1100));
+
+    aggregator.flush_expired(1099, out);
+    CHECK_EQ(out.size(), 2u);
+    aggregator.flush_expired(1100, out);
+    REQUIRE(out.size() == 3);
+    CHECK_EQ(out[2].repeat_count, 8u);
+    CHECK_EQ(out[2].first_timestamp_ms, 120LL);
+    CHECK_EQ(out[2].timestamp_ms, 190LL);
+    CHECK_EQ(out[2].message, std::string("pid=9"));
+    CHECK_EQ(aggregator.tracked_keys(), 0u);
+    CHECK(!aggregator.next_deadline_ms().has_value());
+
+    const LogStormStats& stats = aggregator.stats();
+    CHECK_EQ(stats.events, 10u);
+    CHECK_EQ(stats.passed, 2u);
+    CHECK_EQ(stats.merged, 8u);
+    CHECK_EQ(stats.summaries, 1u);
+}
+
+TEST_CASE(log_storm_passes_exempt_levels_and_distinct_keys) {
+    LogStormAggregator aggregator;
+    std::deque<LogEntry> out;
+    for (int i = 0; i < 5; ++i) aggregator.add(storm_entry(i, "Doze 报告", LogLevel::REPORT), out);
+    CHECK_EQ(out.size(), 5u);
+    aggregator.add(storm_entry(10, "唤醒过于频繁"), out);
+    aggregator.add(storm_entry(11, "另一种消息"), out);
+    CHECK_EQ(out.size(), 7u);
+    CHECK_EQ(aggregator.tracked_keys(), 2u);
+}
+
+// 落盘位置不能越过仍在窗口里的条目：只有最早被合并的那条之前的输入已经写出
+TEST_CASE(log_storm_reports_oldest_held_position) {
+    LogStormConfig config;
+    config.window_ms = 1000;
+    config.max_keys = 2;
+    LogStormAggregator aggregator(config);
+    std::deque<LogEntry> out;
+    aggregator.add(storm_entry(0, "a"), out, 10);
+    aggregator.add(storm_entry(1, "b"), out, 11);
+    // 只有原样写出的条目时没有被扣留的输入
+    CHECK(!aggregator.oldest_held_pos().has_value());
+    aggregator.add(storm_entry(2, "a"), out, 12);
+    aggregator.add(storm_entry(3, "b"), out, 13);
+    aggregator.add(storm_entry(4, "a"), out, 14);
+    CHECK(aggregator.oldest_held_pos() == std::optional<uint64_t>(12));
+
+    // 新键挤掉最早开始的 "a" 窗口并写出其汇总，剩下 "b" 从 13 开始被扣留
+    aggregator.add(storm_entry(5, "c"), out, 15);
+    CHECK(aggregator.oldest_held_pos() == std::optional<uint64_t>(13));
+    aggregator.flush_expired(1001, out);
+    CHECK(!aggregator.oldest_held_pos().has_value());
+}
+
+// 键数超过 max_keys 时最早开始的窗口提前结束并写出汇总
+TEST_CASE(log_storm_evicts_oldest_window_when_full) {
+    LogStormConfig config;
+    config.max_keys = 2;
+    LogStormAggregator aggregator(config);
+    std::deque<LogEntry> out;
+    aggregator.add(storm_entry(0, "a"), out);
+    aggregator.add(storm_entry(1, "a"), out);
+    aggregator.add(storm_entry(2, "b"), out);
+    aggregator.add(storm_entry(3, "c"), out);
+    REQUIRE(out.size() == 4);
+    CHECK_EQ(out[2].message, std::string("a"));
+    CHECK_EQ(out[2].repeat_count, 1u);
+    CHECK_EQ(out[3].message, std::string("c"));
+    CHECK_EQ(aggregator.tracked_keys(), 2u);
+
+    // 切换配置前把进行中的窗口全部写出
+    aggregator.add(storm_entry(4, "c"), out);
+    LogStormConfig disabled;
+    disabled.enabled = false;
+    aggregator.set_config(disabled, out);
+    CHECK_EQ(out.size(), 5u);
+    CHECK_EQ(aggregator.tracked_keys(), 0u);
+}
+
+struct ReplayEvent {
+    LogEntry entry;
+    bool storm;
+};
+
+// 10 分钟的合成时间线：第 1–6 分钟三个应用分别遭遇 Binder、信号与 FCM 唤醒风暴，
+// 其余应用全程按正常频率冻结、解冻与打开关闭
+static std::vector<ReplayEvent> synthetic_storm() {
+    const long long base_ms = 1700000000000LL;
+    const long long duration_ms = 10 * 60 * 1000;
+    std::mt19937 rng(20240601);
+    std::vector<ReplayEvent> events;
+    auto emit = [&](long long t, LogLevel level, const char* category, std::string message, const std::string& package, bool storm) {
+        events.push_back({LogEntry{base_ms + t, level, category, std::move(message), package, 0}, storm});
+    };
+
+    const std::string binder_app = "com.tencent.mm";
+    const std::string signal_app = "com.taobao.taobao";
+    const std::string fcm_app = "com.whatsapp";
+    for (long long t = 60000; t < 360000; t += 120) {
+        emit(t, LogLevel::INFO, "内核事件", "白名单内核Binder (RPC:android.os.IMessenger, Code:" + std::to_string(1 + rng() % 40) + ")", binder_app, true);
+        emit(t + 1, LogLevel::WARN, "节流阀", "白名单Binder唤醒过于频繁，已临时忽略", binder_app, true);
+    }
+    for (long long t = 60000; t < 360000; t += 250) {
+        emit(t + 7, LogLevel::ACTION_UNFREEZE, "解冻", "因 Kernel Signal " + std::to_string(rng() % 2 ? 9 : 17) + " 而解冻", signal_app, true);
+        emit(t + 180, LogLevel::ACTION_FREEZE, "冻结", "已冻结 (pids: " + std::to_string(20000 + rng() % 3000) + ")", signal_app, true);
+    }
+    for (long long t = 90000; t < 360000; t += 400) {
+        emit(t + 13, LogLevel::WARN, "节流阀", "Probe唤醒过于频繁，已临时忽略", fcm_app, true);
+    }
+
+    for (int app = 0; app < 40; ++app) {
+        std::string package = "com.example.app" + std::to_string(app);
+        for (long long t = rng() % 20000; t < duration_ms; t += 15000 + rng() % 30000) {
+            switch (rng() % 4) {
+                case 0: emit(t, LogLevel::ACTION_OPEN, "打开", "已打开 (快速)", package, false); break;
+                case 1: emit(t, LogLevel::ACTION_CLOSE, "关闭", "已关闭，" + std::to_string(5 + rng() % 60) + "秒后冻结", package, false); break;
+                case 2: emit(t, LogLevel::ACTION_FREEZE, "冻结", "已冻结 (pids: " + std::to_string(10000 + rng() % 9000) + ")", package, false); break;
+                default: emit(t, LogLevel::ACTION_UNFREEZE, "解冻", "因 Probe Request 而解冻", package, false); break;
+            }
+        }
+    }
+    std::stable_sort(events.begin(), events.end(), [](const ReplayEvent& a, const ReplayEvent& b) {
+        return a.entry.timestamp_ms < b.entry.timestamp_ms;
+    });
+    return events;
+}
+
+static json replay_with(const std::vector<ReplayEvent>& events, const LogStormConfig& config) {
+    LogStormAggregator aggregator(config);
+    std::deque<LogEntry> out;
+    // 独立记录每个键的窗口起点：凡是按定义应开启新窗口的日志，必须在 add() 返回时已经原样写出
+    std::unordered_map<std::string, long long> window_starts;
+    uint64_t first_occurrences = 0, delayed_first = 0;
+    uint64_t storm_events = 0;
+    for (const auto& event : events) {
+        const LogEntry& entry = event.entry;
+        if (event.storm) storm_events++;
+        aggregator.flush_expired(entry.timestamp_ms, out);
+        std::string key = std::to_string(static_cast<int>(entry.level)) + '\x1f' + std::to_string(entry.user_id) + '\x1f' +
+                          entry.category + '\x1f' + entry.package_name + '\x1f' + LogStormAggregator::message_template(entry.message);
+        auto it = window_starts.find(key);
+        bool opens_window = it == window_starts.end() || entry.timestamp_ms - it->second >= config.window_ms;
+        if (opens_window) window_starts[key] = entry.timestamp_ms;
+
+        size_t before = out.size();
+        aggregator.add(LogEntry(entry), out);
+        if (opens_window) {
+            first_occurrences++;
+            bool emitted = out.size() > before && out.back().repeat_count == 1 &&
+                           out.back().timestamp_ms == entry.timestamp_ms && out.back().message == entry.message;
+            if (!emitted) delayed_first++;
+        }
+    }
+    aggregator.flush_all(out);
+
+    uint64_t represented = 0, max_repeat = 0;
+    for (const auto& entry : out) {
+        represented += entry.repeat_count;
+        max_repeat = std::max<uint64_t>(max_repeat, entry.repeat_count);
+    }
+    // 合并前后的总次数一致，每个窗口的第一次出现都立即写出
+    CHECK_EQ(represented, static_cast<uint64_t>(events.size()));
+    CHECK_EQ(delayed_first, 0u);
+    CHECK(first_occurrences > 0);
+    const LogStormStats& stats = aggregator.stats();
+    CHECK_EQ(stats.events, static_cast<uint64_t>(events.size()));
+    CHECK_EQ(stats.passed + stats.merged, stats.events);
+    return {
+        {"window_ms", config.window_ms},
+        {"passthrough", config.passthrough},
+        {"events", events.size()},
+        {"storm_events", storm_events},
+        {"entries_written", out.size()},
+        {"summaries", stats.summaries},
+        {"merged", stats.merged},
+        {"max_repeat_count", max_repeat},
+        {"compression_ratio", out.empty() ? 0.0 : static_cast<double>(events.size()) / out.size()},
+        {"first_occurrences", first_occurrences},
+        {"delayed_first_occurrences", delayed_first}
+    };
+}
+
+// 几种窗口长度与放行次数下的回放结果
+static json replay_all() {
+    std::vector<ReplayEvent> events = synthetic_storm();
+    json runs = json::array();
+    LogStormConfig disabled;
+    disabled.enabled = false;
+    json unmerged = replay_with(events, disabled);
+    CHECK_EQ(unmerged["entries_written"].get<size_t>(), events.size());
+    runs.push_back(unmerged);
+    for (long long window_ms : {5000LL, 30000LL, 60000LL}) {
+        LogStormConfig config;
+        config.window_ms = window_ms;
+        json run = replay_with(events, config);
+        // 风暴部分应被明显压缩，窗口越长压缩越多
+        CHECK(run["compression_ratio"].get<double>() > 2.0);
+        CHECK(run["compression_ratio"] > runs.back()["compression_ratio"]);
+        runs.push_back(run);
+    }
+    LogStormConfig lenient;
+    lenient.passthrough = 3;
+    runs.push_back(replay_with(events, lenient));
+    return {{"duration_minutes", 10}, {"runs", runs}};
+}
+
+// 回放合成的唤醒风暴：数个应用被 Binder / 信号 / FCM 反复唤醒，夹杂正常的冻结解冻日志
+TEST_CASE(log_storm_replay_preserves_counts) {
+    replay_all();
+}
+
+BENCHMARK_CASE(log_storm_replay) {
+    test_harness::report_benchmark(replay_all());
+}
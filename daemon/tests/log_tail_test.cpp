@@ -0,0 +1,119 @@
+// daemon/tests/log_tail_test.cpp
+#include "test_harness.h"
+#include "logger.h"
+#include "log_storm.h"
+#include "message_dispatch.h"
+#include <chrono>
+#include <thread>
+
+// 写入的日志条数，超过尾部缓冲区容量，使缓冲区发生回绕
+constexpr uint64_t LOG_TAIL_TEST_ENTRIES = Logger::TAIL_CAPACITY + 500;
+
+// 关闭风暴合并后逐条写入 entries 条内容各不相同的日志，等写入线程全部放入尾部缓冲区，返回最后一条的 seq
+static uint64_t fill_logger(Logger& logger, uint64_t entries) {
+    LogStormConfig config = logger.storm_config();
+    config.enabled = false;
+    logger.set_storm_config(config);
+    uint64_t expected = logger.latest_log_seq() + entries;
+    for (uint64_t i = 0; i < entries; ++i) {
+        logger.log(LogLevel::INFO, "测试", "tail entry " + std::to_string(i));
+    }
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (logger.latest_log_seq() < expected && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return logger.latest_log_seq();
+}
+
+// 检查批次内 seq 连续，且为 (first - 1, last]
+static void check_seq_range(const LogTailBatch& batch, uint64_t first, uint64_t last) {
+    REQUIRE(!batch.entries.empty());
+    CHECK_EQ(batch.entries.size(), static_cast<size_t>(last - first + 1));
+    CHECK_EQ(batch.entries.front().first, first);
+    CHECK_EQ(batch.entries.back().first, last);
+    for (size_t i = 1; i < batch.entries.size(); ++i) {
+        CHECK_EQ(batch.entries[i].first, batch.entries[i - 1].first + 1);
+    }
+    CHECK_EQ(batch.cursor, last);
+}
+
+TEST_CASE(log_tail_wraps_and_respects_bounds) {
+    auto logger = Logger::create(test_harness::scratch_dir("log_tail_wrap"));
+    uint64_t base = logger->latest_log_seq();
+    uint64_t latest = fill_logger(*logger, LOG_TAIL_TEST_ENTRIES);
+    REQUIRE(latest == base + LOG_TAIL_TEST_ENTRIES);
+    uint64_t oldest = latest - Logger::TAIL_CAPACITY + 1;
+
+    // 起点已被缓冲区淘汰：从缓冲区中最早的一条开始，并标记缺口
+    LogTailBatch all = logger->read_log_tail(base, UINT64_MAX, SIZE_MAX);
+    CHECK(all.truncated);
+    CHECK(!all.has_more);
+    check_seq_range(all, oldest, latest);
+    CHECK_EQ(all.entries.back().second.message, "tail entry " + std::to_string(LOG_TAIL_TEST_ENTRIES - 1));
+
+    // 起点恰为缓冲区中最早一条之前：没有缺口
+    LogTailBatch exact = logger->read_log_tail(oldest - 1, UINT64_MAX, SIZE_MAX);
+    CHECK(!exact.truncated);
+    check_seq_range(exact, oldest, latest);
+
+    // (after, up_to] 两端都生效
+    LogTailBatch middle = logger->read_log_tail(latest - 10, latest - 5, 100);
+    CHECK(!middle.truncated);
+    CHECK(!middle.has_more);
+    check_seq_range(middle, latest - 9, latest - 5);
+
+    // 条数上限截断时 has_more，cursor 停在本批最后一条，从 cursor 继续读到剩余部分
+    LogTailBatch first_page = logger->read_log_tail(latest - 100, UINT64_MAX, 30);
+    CHECK(first_page.has_more);
+    check_seq_range(first_page, latest - 99, latest - 70);
+    LogTailBatch rest = logger->read_log_tail(first_page.cursor, UINT64_MAX, 100);
+    CHECK(!rest.has_more);
+    check_seq_range(rest, latest - 69, latest);
+
+    // 已读到最新：没有新条目，cursor 不变
+    LogTailBatch empty = logger->read_log_tail(latest, UINT64_MAX, 10);
+    CHECK(empty.entries.empty());
+    CHECK(!empty.truncated);
+    CHECK(!empty.has_more);
+    CHECK_EQ(empty.cursor, latest);
+    logger->stop();
+}
+
+// 守护进程重启后客户端带着更大的旧游标重新订阅：只回填最近的默认条数并标记截断
+TEST_CASE(log_backfill_after_restart_resends_recent_entries) {
+    auto logger = Logger::create(test_harness::scratch_dir("log_backfill_stale_cursor"));
+    uint64_t latest = fill_logger(*logger, 2 * LOG_BACKFILL_MAX);
+    REQUIRE(latest >= 2 * LOG_BACKFILL_MAX);
+
+    LogBackfillRange stale = parse_log_backfill_range(json{{"log_cursor", latest + 5000}}, latest);
+    CHECK(stale.truncated);
+    CHECK_EQ(stale.after_seq, latest - LOG_BACKFILL_DEFAULT);
+    LogTailBatch batch = logger->read_log_tail(stale.after_seq, latest, LOG_BACKFILL_MAX);
+    CHECK(!batch.truncated);
+    check_seq_range(batch, latest - LOG_BACKFILL_DEFAULT + 1, latest);
+
+    // 游标落后超过上限：只回填最近的上限条
+    LogBackfillRange behind = parse_log_backfill_range(json{{"log_cursor", latest - LOG_BACKFILL_MAX - 100}}, latest);
+    CHECK(behind.truncated);
+    CHECK_EQ(behind.after_seq, latest - LOG_BACKFILL_MAX);
+    check_seq_range(logger->read_log_tail(behind.after_seq, latest, LOG_BACKFILL_MAX), latest - LOG_BACKFILL_MAX + 1, latest);
+
+    // 游标在范围内：从游标接续，没有缺口
+    LogBackfillRange resume = parse_log_backfill_range(json{{"log_cursor", latest - 7}}, latest);
+    CHECK(!resume.truncated);
+    CHECK_EQ(resume.after_seq, latest - 7);
+
+    // 推送位置之后才写入的日志不在回填范围内，由后续推送接续
+    LogTailBatch bounded = logger->read_log_tail(latest - 7, latest - 3, LOG_BACKFILL_MAX);
+    check_seq_range(bounded, latest - 6, latest - 3);
+
+    // 不带游标：回填条数受上限约束，不标记截断；推送位置很小时从头开始
+    LogBackfillRange fresh = parse_log_backfill_range(json{{"log_backfill", 100000}}, latest);
+    CHECK(!fresh.truncated);
+    CHECK_EQ(fresh.after_seq, latest - LOG_BACKFILL_MAX);
+    CHECK_EQ(parse_log_backfill_range(json::object(), latest).after_seq, latest - LOG_BACKFILL_DEFAULT);
+    CHECK_EQ(parse_log_backfill_range(json::object(), 10).after_seq, 0u);
+    CHECK(parse_log_backfill_range(json{{"log_cursor", 20}}, 10).truncated);
+    CHECK_EQ(parse_log_backfill_range(json{{"log_cursor", 20}}, 10).after_seq, 0u);
+    logger->stop();
+}
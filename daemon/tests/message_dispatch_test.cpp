@@ -0,0 +1,306 @@
+// daemon/tests/message_dispatch_test.cpp
+#include "test_harness.h"
+#include "message_dispatch.h"
+#include "state_manager.h"
+#include "log_storm.h"
+#include <algorithm>
+#include <chrono>
+#include <map>
+
+// 基准中每组消息至少处理的条数
+constexpr size_t DISPATCH_BENCHMARK_MESSAGES = 20000;
+
+// 只解码载荷而不执行处理，成功返回 true
+using PayloadDecoder = bool (*)(std::string_view payload_text);
+
+struct DecodeRoute {
+    std::string_view type;
+    PayloadDecoder decode = nullptr;
+};
+
+template <typename Request>
+static bool decode_only(std::string_view payload_text) {
+    Request request;
+    return decode_payload(payload_text, request);
+}
+
+static bool decode_dom(std::string_view payload_text) {
+    return !payload_text.empty() && !json::parse(payload_text, nullptr, false).is_discarded();
+}
+
+// 与 main.cpp 的 MESSAGE_ROUTE_LIST 相同的消息类型与顺序，每条附上该消息载荷的解码方式
+static constexpr std::array DECODE_ROUTE_LIST{
+    DecodeRoute{"hello.ui", nullptr},
+    DecodeRoute{"hello.encoding", decode_dom},
+    DecodeRoute{"cmd.subscribe", decode_dom},
+    DecodeRoute{"cmd.unsubscribe", decode_dom},
+    DecodeRoute{"query.get_logs", decode_dom},
+    DecodeRoute{"query.get_log_files", nullptr},
+    DecodeRoute{"query.search_logs", decode_dom},
+    DecodeRoute{"query.get_history_stats", decode_dom},
+    DecodeRoute{"query.get_metrics_history", decode_dom},
+    DecodeRoute{"query.get_adj_rules_content", nullptr},
+    DecodeRoute{"query.get_data_app_packages", nullptr},
+    DecodeRoute{"query.get_all_policies", nullptr},
+    DecodeRoute{"event.probe_hello", nullptr},
+    DecodeRoute{"cmd.probe_resync", decode_dom},
+    DecodeRoute{"cmd.set_adj_rules_content", decode_only<AdjRulesContentRequest>},
+    DecodeRoute{"event.probe_batch", decode_dom},
+    DecodeRoute{"event.app_wakeup_request_v2", decode_only<ProbeWakeupRequest>},
+    DecodeRoute{"cmd.proactive_unfreeze", decode_only<AppTargetRequest>},
+    DecodeRoute{"event.app_foreground", decode_only<AppTargetRequest>},
+    DecodeRoute{"event.app_background", decode_only<AppTargetRequest>},
+    DecodeRoute{"cmd.request_temp_unfreeze_pkg", decode_only<AppTargetRequest>},
+    DecodeRoute{"cmd.request_temp_unfreeze_uid", decode_only<UidRequest>},
+    DecodeRoute{"cmd.request_temp_unfreeze_pid", decode_only<PidRequest>},
+    DecodeRoute{"event.app_wakeup_request", decode_only<AppTargetRequest>},
+    DecodeRoute{"cmd.set_policy", decode_dom},
+    DecodeRoute{"cmd.set_master_config", decode_only<MasterConfigRequest>},
+    DecodeRoute{"query.refresh_dashboard", nullptr},
+    DecodeRoute{"cmd.dashboard_subscribe", decode_dom},
+    DecodeRoute{"cmd.dashboard_unsubscribe", nullptr},
+    DecodeRoute{"cmd.reload_adj_rules", nullptr},
+    DecodeRoute{"cmd.set_log_storm_config", decode_dom},
+    DecodeRoute{"cmd.set_dashboard_window", decode_dom},
+};
+static constexpr StaticRouteTable<DecodeRoute, DECODE_ROUTE_LIST.size()> DECODE_ROUTES(DECODE_ROUTE_LIST);
+static_assert(DECODE_ROUTES.is_perfect(), "no collision-free seed for the test route table");
+
+TEST_CASE(route_table_finds_every_entry_and_nothing_else) {
+    for (const auto& route : DECODE_ROUTE_LIST) {
+        const DecodeRoute* found = DECODE_ROUTES.find(route.type);
+        REQUIRE(found != nullptr);
+        CHECK(found->type == route.type);
+    }
+    CHECK(DECODE_ROUTES.find("") == nullptr);
+    CHECK(DECODE_ROUTES.find("hello") == nullptr);
+    CHECK(DECODE_ROUTES.find("hello.ui ") == nullptr);
+    CHECK(DECODE_ROUTES.find("event.app_foregroun") == nullptr);
+    CHECK(DECODE_ROUTES.find("query.unknown") == nullptr);
+}
+
+TEST_CASE(envelope_scan_extracts_top_level_fields) {
+    std::string text = R"({"req_id":"7","payload":{"type":"nested","a":[1,{"b":"}"}]},"extra":[null,true],"type":"cmd.subscribe"})";
+    MessageEnvelope envelope;
+    envelope.parse(text);
+    CHECK(!envelope.used_fallback());
+    CHECK(envelope.type() == "cmd.subscribe");
+    CHECK_EQ(envelope.req_id(), std::string("7"));
+    CHECK(envelope.payload_text() == R"({"type":"nested","a":[1,{"b":"}"}]})");
+    CHECK(envelope.payload_json()["a"][1]["b"] == "}");
+
+    MessageEnvelope empty;
+    empty.parse(R"({"type":"query.refresh_dashboard"})");
+    CHECK(!empty.has_payload());
+    CHECK(empty.payload_json() == json::object());
+}
+
+TEST_CASE(envelope_falls_back_on_escaped_fields) {
+    MessageEnvelope envelope;
+    envelope.parse(R"({"type":"event.app\u005fforeground","payload":{"package_name":"\u0061"}})");
+    CHECK(envelope.used_fallback());
+    CHECK(envelope.type() == "event.app_foreground");
+    CHECK(envelope.payload_json() == json({{"package_name", "a"}}));
+
+    bool threw = false;
+    try {
+        envelope.parse(R"({"type":)");
+    } catch (const json::exception&) {
+        threw = true;
+    }
+    CHECK(threw);
+}
+
+TEST_CASE(payload_binder_keeps_defaults_on_type_mismatch) {
+    MasterConfigRequest request;
+    CHECK(decode_payload(R"({"standard_timeout_sec":"60","is_timed_unfreeze_enabled":false,"nested":{"timed_unfreeze_interval_sec":5}})", request));
+    CHECK_EQ(request.standard_timeout_sec, 90);
+    CHECK_EQ(request.is_timed_unfreeze_enabled, false);
+    CHECK_EQ(request.timed_unfreeze_interval_sec, 1800);
+
+    AppTargetRequest target;
+    CHECK(decode_payload(R"({"package_name":"com.example.app","user_id":10})", target));
+    CHECK_EQ(target.package_name, std::string("com.example.app"));
+    CHECK_EQ(target.user_id, 10);
+    CHECK(!decode_payload("", target));
+    CHECK(!decode_payload("[1,2]", target));
+    CHECK(!decode_payload("{\"user_id\":", target));
+}
+
+TEST_CASE(log_storm_config_keeps_unset_fields_and_rejects_bad_values) {
+    LogStormConfig live;
+    live.window_ms = 5000;
+    live.passthrough = 3;
+    live.max_keys = 64;
+
+    LogStormConfig config = live;
+    std::string bad_field;
+    CHECK(parse_log_storm_config(json::parse(R"({"passthrough": 2, "exempt_levels": [3, 14], "future_field": "x"})"), config, bad_field));
+    CHECK_EQ(config.window_ms, 5000LL);
+    CHECK_EQ(config.passthrough, 2u);
+    CHECK_EQ(config.max_keys, size_t{64});
+    CHECK_EQ(config.exempt_level_mask, (1u << 3) | (1u << 14));
+
+    const char* rejected[][2] = {
+        {R"({"passthrough": -1})", "passthrough"},
+        {R"({"passthrough": 0})", "passthrough"},
+        {R"({"passthrough": 1.5})", "passthrough"},
+        {R"({"passthrough": "2"})", "passthrough"},
+        {R"({"window_ms": -30000})", "window_ms"},
+        {R"({"window_ms": 99999999999})", "window_ms"},
+        {R"({"max_keys": 100000})", "max_keys"},
+        {R"({"enabled": 1})", "enabled"},
+        {R"({"exempt_levels": [1, -2]})", "exempt_levels"},
+        {R"({"exempt_levels": [40]})", "exempt_levels"},
+        {R"({"exempt_levels": 3})", "exempt_levels"},
+        {R"({"window_ms": 2000, "passthrough": -1})", "passthrough"},
+        {R"([1])", "payload"},
+    };
+    for (const auto& [text, field] : rejected) {
+        LogStormConfig unchanged = live;
+        bad_field.clear();
+        CHECK(!parse_log_storm_config(json::parse(text), unchanged, bad_field));
+        CHECK_EQ(bad_field, std::string(field));
+        // 拒绝时不应用任何字段
+        CHECK_EQ(unchanged.window_ms, live.window_ms);
+        CHECK_EQ(unchanged.passthrough, live.passthrough);
+    }
+}
+
+TEST_CASE(dashboard_window_accepts_only_bounded_integers) {
+    long long window_ms = 250;
+    std::string bad_field;
+    CHECK(parse_dashboard_window(json::parse(R"({"window_ms": 1000})"), window_ms, bad_field));
+    CHECK_EQ(window_ms, 1000LL);
+
+    const char* rejected[][2] = {
+        {R"({"window_ms": 10})", "window_ms"},
+        {R"({"window_ms": 60000})", "window_ms"},
+        {R"({"window_ms": -250})", "window_ms"},
+        {R"({"window_ms": 250.5})", "window_ms"},
+        {R"({"window_ms": "250"})", "window_ms"},
+        {R"({})", "window_ms"},
+        {R"([250])", "payload"},
+    };
+    for (const auto& [text, field] : rejected) {
+        bad_field.clear();
+        CHECK(!parse_dashboard_window(json::parse(text), window_ms, bad_field));
+        CHECK_EQ(bad_field, std::string(field));
+        CHECK_EQ(window_ms, 1000LL);
+    }
+}
+
+// 基准的消息组合：探针事件流与 UI 操作，形状与真实消息一致
+static std::vector<std::string> build_dispatch_mix(const std::string& name) {
+    std::vector<std::string> mix;
+    if (name == "probe") {
+        for (int i = 0; i < 16; ++i) {
+            std::string package = "com.example.app" + std::to_string(i);
+            mix.push_back(json{{"type", "event.app_foreground"}, {"payload", {{"package_name", package}, {"user_id", 0}}}}.dump());
+            mix.push_back(json{{"type", "event.app_background"}, {"payload", {{"package_name", package}, {"user_id", 0}}}}.dump());
+            mix.push_back(json{{"type", "event.app_wakeup_request_v2"}, {"payload", {{"uid", 10100 + i}, {"type_int", 1}}}}.dump());
+            mix.push_back(json{{"type", "cmd.proactive_unfreeze"}, {"payload", {{"package_name", package}, {"user_id", 0}}}}.dump());
+            mix.push_back(json{{"type", "cmd.request_temp_unfreeze_uid"}, {"payload", {{"uid", 10100 + i}}}}.dump());
+        }
+        json batch = json::array();
+        for (int i = 0; i < 16; ++i) batch.push_back(json::array({i % 4 + 1, 10100 + i, 0, 1, "com.example.app" + std::to_string(i)}));
+        mix.push_back(json{{"type", "event.probe_batch"}, {"payload", {{"e", batch}}}}.dump());
+    } else if (name == "ui") {
+        mix.push_back(json{{"type", "cmd.subscribe"}, {"req_id", "1"}, {"payload", {{"topics", {"dashboard", "logs"}}, {"log_backfill", 50}}}}.dump());
+        mix.push_back(json{{"type", "query.get_logs"}, {"req_id", "2"}, {"payload", {{"filename", "cerberus_20260101.log"}, {"limit", 50}, {"before", 1767225600000LL}}}}.dump());
+        mix.push_back(json{{"type", "query.refresh_dashboard"}}.dump());
+        mix.push_back(json{{"type", "cmd.set_master_config"}, {"payload", {{"standard_timeout_sec", 90}, {"is_timed_unfreeze_enabled", true}, {"timed_unfreeze_interval_sec", 1800}}}}.dump());
+        mix.push_back(json{{"type", "cmd.dashboard_subscribe"}, {"payload", {{"sort", "mem"}, {"limit", 50}}}}.dump());
+        mix.push_back(json{{"type", "cmd.set_policy"}, {"payload", {{"policies", {{{"package_name", "com.example.app"}, {"user_id", 0}, {"policy", 2}, {"force_playback_exempt", false}, {"force_network_exempt", false}}}}}}}.dump());
+        mix.push_back(json{{"type", "query.get_all_policies"}, {"req_id", "3"}}.dump());
+    }
+    return mix;
+}
+
+// 对同一组消息分别走“完整解析 + 逐个比较 type”的旧路径和“信封扫描 + 完美哈希 + 只解析载荷”的新路径，
+// 分开统计每条消息的解析与分发耗时（纳秒）。两条路径必须命中同样多的路由，新路径不得有解码失败
+BENCHMARK_CASE(message_dispatch_benchmark) {
+    std::map<std::string, std::vector<std::string>> mixes;
+    mixes["probe"] = build_dispatch_mix("probe");
+    mixes["ui"] = build_dispatch_mix("ui");
+
+    auto elapsed_ns = [](auto begin) {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count();
+    };
+    json result = json::object();
+    result["routes"] = DECODE_ROUTE_LIST.size();
+    result["hash_slots"] = DECODE_ROUTES.SLOTS;
+    result["hash_seed"] = DECODE_ROUTES.seed();
+    for (const auto& [name, mix] : mixes) {
+        size_t rounds = std::max<size_t>(1, DISPATCH_BENCHMARK_MESSAGES / mix.size());
+        size_t count = rounds * mix.size();
+        size_t bytes = 0;
+        for (const auto& message : mix) bytes += message.size();
+
+        // 旧路径：整条消息解析为 DOM，再按表的顺序逐个比较
+        std::vector<std::string> legacy_types;
+        auto start = std::chrono::steady_clock::now();
+        for (size_t r = 0; r < rounds; ++r) {
+            for (const auto& message : mix) {
+                json msg = json::parse(message, nullptr, false);
+                if (r == 0) legacy_types.push_back(msg.is_object() ? msg.value("type", "") : "");
+            }
+        }
+        long long legacy_parse_ns = elapsed_ns(start);
+        size_t legacy_matched = 0;
+        start = std::chrono::steady_clock::now();
+        for (size_t r = 0; r < rounds; ++r) {
+            for (const auto& type : legacy_types) {
+                for (const auto& route : DECODE_ROUTE_LIST) {
+                    if (type == route.type) { ++legacy_matched; break; }
+                }
+            }
+        }
+        long long legacy_dispatch_ns = elapsed_ns(start);
+
+        // 新路径：扫描信封，按路由只解码载荷
+        std::vector<std::string> table_types;
+        size_t fallbacks = 0;
+        size_t failures = 0;
+        start = std::chrono::steady_clock::now();
+        for (size_t r = 0; r < rounds; ++r) {
+            for (const auto& message : mix) {
+                MessageEnvelope envelope;
+                try {
+                    envelope.parse(message);
+                    const DecodeRoute* route = DECODE_ROUTES.find(envelope.type());
+                    if (route && route->decode && envelope.has_payload() && !route->decode(envelope.payload_text())) ++failures;
+                } catch (const json::exception&) {
+                    ++failures;
+                }
+                if (r == 0) {
+                    table_types.emplace_back(envelope.type());
+                    if (envelope.used_fallback()) ++fallbacks;
+                }
+            }
+        }
+        long long table_parse_ns = elapsed_ns(start);
+        size_t table_matched = 0;
+        start = std::chrono::steady_clock::now();
+        for (size_t r = 0; r < rounds; ++r) {
+            for (const auto& type : table_types) {
+                if (DECODE_ROUTES.find(type)) ++table_matched;
+            }
+        }
+        long long table_dispatch_ns = elapsed_ns(start);
+
+        CHECK_EQ(legacy_matched, count);
+        CHECK_EQ(table_matched, count);
+        CHECK_EQ(failures, 0u);
+        CHECK_EQ(fallbacks, 0u);
+
+        auto per_message = [count](long long total) { return static_cast<double>(total) / static_cast<double>(count); };
+        result[name] = {
+            {"messages", count},
+            {"avg_bytes", bytes / mix.size()},
+            {"legacy", {{"parse_ns", per_message(legacy_parse_ns)}, {"dispatch_ns", per_message(legacy_dispatch_ns)}}},
+            {"table", {{"parse_ns", per_message(table_parse_ns)}, {"dispatch_ns", per_message(table_dispatch_ns)}}}
+        };
+    }
+    test_harness::report_benchmark(result);
+}
@@ -0,0 +1,301 @@
+// daemon/tests/metrics_rollup_test.cpp
+#include "test_harness.h"
+#include "metrics_rollup.h"
+#include "time_series_database.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <chrono>
+#include <climits>
+#include <cmath>
+
+using namespace metrics_rollup_layout;
+
+// 2026-01-05 00:00 UTC 起一周的 2 秒样本，第 3 天 00:07:30 模拟一次重启
+constexpr long long ROLLUP_TEST_START_MS = 1767571200000LL;
+constexpr long long ROLLUP_TEST_SAMPLES = 7LL * 24 * 3600 * 1000 / MetricsRollup::RAW_INTERVAL_MS;
+constexpr long long ROLLUP_TEST_RESTART_SAMPLE =
+    (3LL * 24 * 3600 * 1000 + 7 * MetricsRollup::MINUTE_MS + 30 * 1000) / MetricsRollup::RAW_INTERVAL_MS;
+constexpr uint32_t ROLLUP_TEST_CRASH_RETENTION = 8;
+constexpr long long MINUTE_MS = MetricsRollup::MINUTE_MS;
+constexpr long long QUARTER_HOUR_MS = MetricsRollup::QUARTER_HOUR_MS;
+
+static MetricsRecord rollup_test_sample(long long i) {
+    MetricsRecord record;
+    long long minute = i / (MINUTE_MS / MetricsRollup::RAW_INTERVAL_MS);
+    record.timestamp_ms = ROLLUP_TEST_START_MS + i * MetricsRollup::RAW_INTERVAL_MS;
+    record.total_cpu_usage_percent = static_cast<float>(i % 30);
+    record.mem_total_kb = 7864320;
+    record.mem_available_kb = 1000000 + (minute % 60) * 1000;
+    record.swap_total_kb = 4194304;
+    record.swap_free_kb = 4194304 - (i % 30) * 100;
+    record.battery_level = minute % 97 == 0 ? -1 : 50;
+    record.battery_temp_celsius = 30.0f + static_cast<float>(i % 2);
+    record.battery_power_watt = -2.0f;
+    record.is_charging = (i / 450) % 2 == 0;
+    record.is_screen_on = i % 5 != 0;
+    return record;
+}
+
+// 灌入一周样本，中途关闭并重新打开，模拟守护进程被杀后重启（未封口的 1 分钟桶丢失）
+static void ingest_week(MetricsRollup& rollup, const std::string& dir) {
+    for (long long i = 0; i < ROLLUP_TEST_SAMPLES; ++i) {
+        if (i == ROLLUP_TEST_RESTART_SAMPLE) {
+            rollup.close();
+            rollup.open(dir);
+        }
+        rollup.add_sample(rollup_test_sample(i));
+    }
+}
+
+static bool near(float value, double expected) {
+    return std::fabs(value - expected) <= 1e-3;
+}
+
+// 每个 1 分钟桶 30 个样本，15 分钟桶 450 个，统计量在两种分辨率下相同
+static bool check_bucket(const RollupBucket& bucket, uint32_t expected_samples, bool battery_known) {
+    const RollupStat& cpu = bucket.stats[ROLLUP_CPU_USAGE];
+    const RollupStat& swap = bucket.stats[ROLLUP_SWAP_USED_KB];
+    const RollupStat& temp = bucket.stats[ROLLUP_BATTERY_TEMP];
+    const RollupStat& battery = bucket.stats[ROLLUP_BATTERY_LEVEL];
+    bool charging_ok = bucket.charging_samples == 0 || bucket.charging_samples == bucket.sample_count;
+    return bucket.sample_count == expected_samples && cpu.count == expected_samples &&
+           cpu.min == 0.0f && cpu.max == 29.0f && near(cpu.avg, 14.5) &&
+           swap.min == 0.0f && swap.max == 2900.0f && near(swap.avg, 1450.0) &&
+           temp.min == 30.0f && temp.max == 31.0f && near(temp.avg, 30.5) &&
+           (battery_known ? battery.count > 0 && near(battery.avg, 50.0) : battery.count == 0) &&
+           bucket.screen_on_samples * 5 == bucket.sample_count * 4 && charging_ok;
+}
+
+static json query_points(const MetricsRollup& rollup, RollupResolution resolution, long long since_ms) {
+    JsonWriter writer;
+    rollup.write_buckets(writer, resolution, since_ms);
+    return json::parse(writer.take());
+}
+
+TEST_CASE(metrics_rollup_week_with_restart) {
+    std::string dir = test_harness::scratch_dir("metrics_rollup_week") + "/history";
+    MetricsRollup rollup;
+    REQUIRE(rollup.open(dir));
+    ingest_week(rollup, dir);
+
+    const long long now = ROLLUP_TEST_START_MS + ROLLUP_TEST_SAMPLES * MetricsRollup::RAW_INTERVAL_MS;
+    const long long restart_ms = ROLLUP_TEST_START_MS + ROLLUP_TEST_RESTART_SAMPLE * MetricsRollup::RAW_INTERVAL_MS;
+    const long long restart_minute = restart_ms - restart_ms % MINUTE_MS;
+    const long long restart_quarter = restart_minute - restart_minute % QUARTER_HOUR_MS;
+    const uint32_t lost_at_restart = static_cast<uint32_t>((restart_ms - restart_minute) / MetricsRollup::RAW_INTERVAL_MS);
+
+    // 自动选择的分辨率与各查询返回的点数（含末尾未封口的桶）
+    struct QueryCase {
+        long long span_ms;
+        long long raw_oldest_ms;
+        RollupResolution expected;
+        size_t expected_points;
+    };
+    const QueryCase cases[] = {
+        {10 * MINUTE_MS, now - MetricsRollup::RAW_SPAN_MS, RollupResolution::RAW, 0},
+        // 重启后原始环只覆盖最近 5 分钟
+        {20 * MINUTE_MS, now - 5 * MINUTE_MS, RollupResolution::MINUTE, 20},
+        {6 * 60 * MINUTE_MS, now - MetricsRollup::RAW_SPAN_MS, RollupResolution::MINUTE, 360},
+        {7 * 24 * 60 * MINUTE_MS, now - MetricsRollup::RAW_SPAN_MS, RollupResolution::QUARTER_HOUR, 672},
+        {40LL * 24 * 60 * MINUTE_MS, now - MetricsRollup::RAW_SPAN_MS, RollupResolution::QUARTER_HOUR, 672}
+    };
+    for (const QueryCase& query : cases) {
+        RollupResolution chosen = MetricsRollup::choose_resolution(now - query.span_ms, now, query.raw_oldest_ms);
+        CHECK(chosen == query.expected);
+        if (chosen != RollupResolution::RAW) CHECK_EQ(query_points(rollup, chosen, now - query.span_ms).size(), query.expected_points);
+    }
+
+    json stats = rollup.stats();
+    size_t minutes = stats["1m"]["buckets"].get<size_t>();
+    size_t quarters = stats["15m"]["buckets"].get<size_t>();
+    CHECK(stats["1m"]["compactions"].get<uint64_t>() > 0);
+    CHECK_EQ(quarters, static_cast<size_t>((now - ROLLUP_TEST_START_MS) / QUARTER_HOUR_MS) - 1);
+    rollup.close();
+
+    // 重启所在的分钟只剩重启之后的样本，所在的 15 分钟桶少了重启前未封口的部分，这两个桶只核对样本数。
+    // 1 分钟文件只保留最近 24 到 48 小时，重启所在的分钟可能已被压缩掉
+    {
+        RollupFile minute_file;
+        REQUIRE(minute_file.open(dir + "/rollup_1m.bin", MINUTE_MS, MetricsRollup::MINUTE_RETENTION));
+        REQUIRE(minute_file.size() == minutes);
+        size_t bad_minutes = 0;
+        for (size_t i = 0; i < minute_file.size(); ++i) {
+            const RollupBucket& bucket = minute_file.at(i);
+            long long minute = (bucket.start_ms - ROLLUP_TEST_START_MS) / MINUTE_MS;
+            if (bucket.start_ms == restart_minute) {
+                CHECK_EQ(bucket.sample_count, 30 - lost_at_restart);
+            } else if (!check_bucket(bucket, 30, minute % 97 != 0)) {
+                bad_minutes++;
+            }
+        }
+        CHECK_EQ(bad_minutes, 0u);
+        CHECK(minute_file.at(0).start_ms <= now - static_cast<long long>(MetricsRollup::MINUTE_RETENTION) * MINUTE_MS);
+
+        RollupFile quarter_file;
+        REQUIRE(quarter_file.open(dir + "/rollup_15m.bin", QUARTER_HOUR_MS, MetricsRollup::QUARTER_HOUR_RETENTION));
+        REQUIRE(quarter_file.size() == quarters);
+        size_t bad_quarters = 0;
+        uint32_t restart_quarter_samples = 0;
+        for (size_t i = 0; i < quarter_file.size(); ++i) {
+            const RollupBucket& bucket = quarter_file.at(i);
+            if (bucket.start_ms == restart_quarter) {
+                restart_quarter_samples = bucket.sample_count;
+            } else if (!check_bucket(bucket, 450, true)) {
+                bad_quarters++;
+            }
+        }
+        CHECK_EQ(bad_quarters, 0u);
+        CHECK_EQ(restart_quarter_samples, 450 - lost_at_restart);
+    }
+
+    // 再次重启：1 分钟桶原样读回，未封口的 15 分钟桶由已持久化的 1 分钟桶补回
+    REQUIRE(rollup.open(dir));
+    stats = rollup.stats();
+    CHECK_EQ(stats["1m"]["buckets"].get<size_t>(), minutes);
+    CHECK_EQ(stats["15m"]["buckets"].get<size_t>(), quarters);
+    json open_quarter = query_points(rollup, RollupResolution::QUARTER_HOUR, now - QUARTER_HOUR_MS);
+    REQUIRE(!open_quarter.empty());
+    CHECK_EQ(open_quarter.back()["samples"].get<uint32_t>(), 14u * 30);
+}
+
+// 时钟回拨测试：先按超前的时钟写入 2 小时样本，再从 1 小时前接着写 2 小时
+constexpr long long ROLLUP_JUMP_TEST_SAMPLES = 2 * 3600 * 1000 / MetricsRollup::RAW_INTERVAL_MS;
+constexpr long long ROLLUP_JUMP_TEST_BACK_SAMPLES = 3600 * 1000 / MetricsRollup::RAW_INTERVAL_MS;
+
+// 回拨后的数据从 ROLLUP_TEST_START_MS 起连续：每个 1 分钟桶 30 个样本，末尾的分钟未封口；
+// 15 分钟桶各 450 个样本，末尾未封口的 15 分钟桶还不含未封口的那一分钟
+static void check_after_clock_jump(const MetricsRollup& rollup) {
+    const long long end_ms = ROLLUP_TEST_START_MS + (ROLLUP_JUMP_TEST_SAMPLES + ROLLUP_JUMP_TEST_BACK_SAMPLES) * MetricsRollup::RAW_INTERVAL_MS;
+    json minutes = query_points(rollup, RollupResolution::MINUTE, ROLLUP_TEST_START_MS);
+    REQUIRE(minutes.size() == static_cast<size_t>((end_ms - ROLLUP_TEST_START_MS) / MINUTE_MS));
+    size_t bad_minutes = 0;
+    for (size_t k = 0; k < minutes.size(); ++k) {
+        if (minutes[k]["timestamp"].get<long long>() != ROLLUP_TEST_START_MS + static_cast<long long>(k) * MINUTE_MS ||
+            minutes[k]["samples"].get<uint32_t>() != 30) {
+            bad_minutes++;
+        }
+    }
+    CHECK_EQ(bad_minutes, 0u);
+
+    json quarters = query_points(rollup, RollupResolution::QUARTER_HOUR, ROLLUP_TEST_START_MS);
+    REQUIRE(quarters.size() == static_cast<size_t>((end_ms - ROLLUP_TEST_START_MS) / QUARTER_HOUR_MS));
+    size_t bad_quarters = 0;
+    for (size_t k = 0; k < quarters.size(); ++k) {
+        uint32_t expected = k + 1 == quarters.size() ? 14 * 30 : 450;
+        if (quarters[k]["timestamp"].get<long long>() != ROLLUP_TEST_START_MS + static_cast<long long>(k) * QUARTER_HOUR_MS ||
+            quarters[k]["samples"].get<uint32_t>() != expected) {
+            bad_quarters++;
+        }
+    }
+    CHECK_EQ(bad_quarters, 0u);
+}
+
+// 墙钟回拨 1 小时：运行中与重启后都应截掉按超前时钟记录的桶并从新时间继续，而不是把样本并入旧桶或丢弃
+TEST_CASE(metrics_rollup_recovers_from_clock_jump) {
+    // 运行中回拨
+    std::string dir = test_harness::scratch_dir("metrics_rollup_clock_jump") + "/history";
+    MetricsRollup rollup;
+    REQUIRE(rollup.open(dir));
+    for (long long i = 0; i < ROLLUP_JUMP_TEST_SAMPLES; ++i) rollup.add_sample(rollup_test_sample(i));
+    for (long long i = ROLLUP_JUMP_TEST_BACK_SAMPLES; i < ROLLUP_JUMP_TEST_SAMPLES + ROLLUP_JUMP_TEST_BACK_SAMPLES; ++i) {
+        rollup.add_sample(rollup_test_sample(i));
+    }
+    json stats = rollup.stats();
+    CHECK_EQ(stats["clock_jumps"].get<uint64_t>(), 1u);
+    CHECK_EQ(stats["dropped_samples"].get<uint64_t>(), 0u);
+    CHECK_EQ(stats["1m"]["truncated_buckets"].get<size_t>(), 59u);
+    CHECK_EQ(stats["15m"]["truncated_buckets"].get<size_t>(), 3u);
+    check_after_clock_jump(rollup);
+    rollup.close();
+
+    // 重启后回拨：文件末尾是超前时钟下的桶
+    MetricsRollup restarted;
+    REQUIRE(restarted.open(dir));
+    for (long long i = ROLLUP_JUMP_TEST_SAMPLES; i < ROLLUP_JUMP_TEST_SAMPLES + ROLLUP_JUMP_TEST_BACK_SAMPLES; ++i) {
+        restarted.add_sample(rollup_test_sample(i));
+    }
+    stats = restarted.stats();
+    CHECK_EQ(stats["clock_jumps"].get<uint64_t>(), 1u);
+    CHECK_EQ(stats["dropped_samples"].get<uint64_t>(), 0u);
+    check_after_clock_jump(restarted);
+
+    // 小幅回拨仍按原规则处理：并入当前桶，不截断
+    restarted.add_sample(rollup_test_sample(ROLLUP_JUMP_TEST_SAMPLES + ROLLUP_JUMP_TEST_BACK_SAMPLES - 60));
+    CHECK_EQ(restarted.stats()["clock_jumps"].get<uint64_t>(), 1u);
+}
+
+// 撕裂的追加、损坏的头部副本、损坏的桶与压缩
+TEST_CASE(rollup_file_recovers_from_crashes) {
+    std::string path = test_harness::scratch_dir("rollup_file_crash") + "/crash.bin";
+    auto bucket_at = [](long long k) {
+        RollupBucket bucket{};
+        bucket.start_ms = ROLLUP_TEST_START_MS + k * MINUTE_MS;
+        bucket.sample_count = static_cast<uint32_t>(k + 1);
+        return bucket;
+    };
+    RollupFile file;
+    REQUIRE(file.open(path, MINUTE_MS, ROLLUP_TEST_CRASH_RETENTION));
+    for (long long k = 0; k < 5; ++k) CHECK(file.append(bucket_at(k)));
+    file.close();
+
+    int fd = open(path.c_str(), O_RDWR | O_CLOEXEC);
+    REQUIRE(fd != -1);
+    // 桶写了一半、头部还没提交
+    RollupBucket torn = bucket_at(5);
+    torn.checksum = 0xdeadbeef;
+    CHECK(pwrite(fd, &torn, sizeof(torn) / 2, HEADER_SIZE + 5 * BUCKET_SIZE) == static_cast<ssize_t>(sizeof(torn) / 2));
+    REQUIRE(file.open(path, MINUTE_MS, ROLLUP_TEST_CRASH_RETENTION));
+    CHECK_EQ(file.size(), 5u);
+    file.close();
+
+    // 较新的头部副本损坏，回退到上一次提交
+    RollupFileHeader headers[2];
+    CHECK(pread(fd, headers, sizeof(headers), 0) == static_cast<ssize_t>(sizeof(headers)));
+    int newer = headers[1].generation > headers[0].generation ? 1 : 0;
+    headers[newer].count ^= 0xff;
+    CHECK(pwrite(fd, &headers[newer], sizeof(RollupFileHeader), newer * HEADER_SLOT_SIZE) == static_cast<ssize_t>(sizeof(RollupFileHeader)));
+    REQUIRE(file.open(path, MINUTE_MS, ROLLUP_TEST_CRASH_RETENTION));
+    CHECK_EQ(file.size(), 4u);
+    CHECK(file.stats().used_backup_header);
+    file.close();
+
+    // 已提交的桶内容损坏，从该桶起截断
+    uint8_t flip = 0x5a;
+    CHECK(pwrite(fd, &flip, 1, HEADER_SIZE + 2 * BUCKET_SIZE + offsetof(RollupBucket, stats)) == 1);
+    close(fd);
+    REQUIRE(file.open(path, MINUTE_MS, ROLLUP_TEST_CRASH_RETENTION));
+    CHECK_EQ(file.size(), 2u);
+    CHECK_EQ(file.stats().dropped_buckets, 2u);
+
+    // 写满 2 × retention 后压缩为最新的 retention 个再继续追加
+    for (long long k = 2; k < 20; ++k) CHECK(file.append(bucket_at(k)));
+    CHECK_EQ(file.size(), 12u);
+    CHECK_EQ(file.at(0).start_ms, bucket_at(8).start_ms);
+    CHECK_EQ(file.stats().compactions, 1u);
+    file.close();
+    REQUIRE(file.open(path, MINUTE_MS, ROLLUP_TEST_CRASH_RETENTION));
+    CHECK_EQ(file.size(), 12u);
+    CHECK(!file.stats().recreated);
+    CHECK_EQ(file.at(file.size() - 1).start_ms, bucket_at(19).start_ms);
+}
+
+// 一周样本的汇总开销，含每分钟封口时的追加与 msync
+BENCHMARK_CASE(metrics_rollup_benchmark) {
+    std::string dir = test_harness::scratch_dir("metrics_rollup_benchmark") + "/history";
+    MetricsRollup rollup;
+    REQUIRE(rollup.open(dir));
+    auto start = std::chrono::steady_clock::now();
+    ingest_week(rollup, dir);
+    auto elapsed_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    json stats = rollup.stats();
+    CHECK(stats["15m"]["buckets"].get<size_t>() > 0);
+    test_harness::report_benchmark({
+        {"samples", ROLLUP_TEST_SAMPLES},
+        {"ingest_ns_per_sample", static_cast<double>(elapsed_ns) / ROLLUP_TEST_SAMPLES},
+        {"file_bytes", {
+            {"1m", HEADER_SIZE + 2ULL * MetricsRollup::MINUTE_RETENTION * BUCKET_SIZE},
+            {"15m", HEADER_SIZE + 2ULL * MetricsRollup::QUARTER_HOUR_RETENTION * BUCKET_SIZE}
+        }},
+        {"stats", stats}
+    });
+}
@@ -0,0 +1,178 @@
+// daemon/tests/probe_config_stream_test.cpp
+#include "test_harness.h"
+#include "probe_config_stream.h"
+#include <algorithm>
+#include <map>
+#include <random>
+#include <set>
+#include <tuple>
+
+// 随机演化的快照版本数
+constexpr int PROBE_CONFIG_STREAM_TEST_STEPS = 400;
+// 丢弃增量的比例（百分比）
+constexpr unsigned PROBE_CONFIG_STREAM_DROP_PERCENT = 25;
+
+// 按协议应用全量与增量的探针：本地序号不等于 prev_seq 时丢弃该增量并记为需要 resync
+struct FakeProbe {
+    bool needs_resync = false;
+    uint64_t seq = 0;
+    json master_config;
+    json exempt_config;
+    std::map<std::pair<std::string, int>, json> policies;
+    std::set<int> frozen_uids;
+    std::set<int> frozen_pids;
+
+    static std::pair<std::string, int> key_of(const json& policy) {
+        return {policy["package_name"].get<std::string>(), policy["user_id"].get<int>()};
+    }
+
+    static void apply_set(std::set<int>& target, const json& payload, const std::string& added, const std::string& removed) {
+        if (payload.contains(added)) for (int id : payload[added]) target.insert(id);
+        if (payload.contains(removed)) for (int id : payload[removed]) target.erase(id);
+    }
+
+    void apply(const json& message) {
+        const json& payload = message["payload"];
+        if (message["type"] == "resp.probe_init_data") {
+            needs_resync = false;
+            seq = payload["config_seq"].get<uint64_t>();
+            master_config = payload["master_config"];
+            exempt_config = payload["exempt_config"];
+            policies.clear();
+            for (const auto& policy : payload["policies"]) policies[key_of(policy)] = policy;
+            frozen_uids = payload["frozen_uids"].get<std::set<int>>();
+            frozen_pids = payload["frozen_pids"].get<std::set<int>>();
+            return;
+        }
+        if (payload["prev_seq"].get<uint64_t>() != seq) {
+            needs_resync = true;
+            return;
+        }
+        if (payload.contains("master_config")) master_config = payload["master_config"];
+        if (payload.contains("policies_upsert")) {
+            for (const auto& policy : payload["policies_upsert"]) policies[key_of(policy)] = policy;
+        }
+        if (payload.contains("policies_removed")) {
+            for (const auto& key : payload["policies_removed"]) policies.erase(key_of(key));
+        }
+        apply_set(frozen_uids, payload, "frozen_uids_added", "frozen_uids_removed");
+        apply_set(frozen_pids, payload, "frozen_pids_added", "frozen_pids_removed");
+        seq = payload["seq"].get<uint64_t>();
+    }
+
+    // 以 build_probe_config_payload 的格式输出本地状态；快照中的策略与冻结集合保持有序，可直接比较
+    json payload() const {
+        json result;
+        result["master_config"] = master_config;
+        result["exempt_config"] = exempt_config;
+        result["policies"] = json::array();
+        for (const auto& [key, policy] : policies) result["policies"].push_back(policy);
+        result["frozen_uids"] = std::vector<int>(frozen_uids.begin(), frozen_uids.end());
+        result["frozen_pids"] = std::vector<int>(frozen_pids.begin(), frozen_pids.end());
+        return result;
+    }
+};
+
+// 在有序向量中加入或移除一个 id
+static void toggle_id(std::vector<int>& ids, int id) {
+    auto it = std::lower_bound(ids.begin(), ids.end(), id);
+    if (it != ids.end() && *it == id) ids.erase(it);
+    else ids.insert(it, id);
+}
+
+// 随机修改快照中的一项；策略列表每次变化都换成新的共享副本，与 StateManager 的做法一致
+static void mutate_snapshot(StateSnapshot& snapshot, std::mt19937& rng) {
+    switch (rng() % 7) {
+        case 0:
+            // 版本前进但内容不变
+            break;
+        case 1:
+            snapshot.master_config.standard_timeout_sec = 30 + static_cast<int>(rng() % 5) * 30;
+            break;
+        case 2:
+        case 3: {
+            auto policies = std::make_shared<std::vector<AppConfig>>(*snapshot.policies);
+            AppConfig config;
+            config.package_name = "com.example.policy" + std::to_string(rng() % 30);
+            config.user_id = rng() % 4 == 0 ? 10 : 0;
+            auto key_less = [](const AppConfig& a, const AppConfig& b) {
+                return std::tie(a.package_name, a.user_id) < std::tie(b.package_name, b.user_id);
+            };
+            auto it = std::lower_bound(policies->begin(), policies->end(), config, key_less);
+            bool exists = it != policies->end() && !key_less(config, *it);
+            if (exists && rng() % 3 == 0) {
+                policies->erase(it);
+            } else {
+                config.policy = static_cast<AppPolicy>(rng() % 4);
+                config.allow_timed_unfreeze = rng() % 2 == 0;
+                if (exists) *it = config;
+                else policies->insert(it, config);
+            }
+            snapshot.policies = std::move(policies);
+            break;
+        }
+        case 4:
+        case 5:
+            toggle_id(snapshot.frozen_uids, 10000 + static_cast<int>(rng() % 40));
+            break;
+        default:
+            toggle_id(snapshot.frozen_pids, 2000 + static_cast<int>(rng() % 60));
+            break;
+    }
+}
+
+// 随机丢弃一部分增量，探针凭 prev_seq 发现缺口后以 full_message() 重新同步；
+// 每次与流序号对齐时本地状态都应等于当前快照的全量载荷
+TEST_CASE(probe_config_deltas_with_drops_resync_to_full_payload) {
+    std::mt19937 rng(20260212);
+    StateSnapshot snapshot;
+    snapshot.version = 1;
+    snapshot.policies = std::make_shared<const std::vector<AppConfig>>();
+
+    ProbeConfigStream stream;
+    FakeProbe probe;
+    CHECK(stream.advance(snapshot).is_null());
+    probe.apply(stream.full_message(snapshot));
+    CHECK(probe.payload() == build_probe_config_payload(&snapshot));
+
+    size_t delivered = 0, dropped = 0, resyncs = 0;
+    for (int step = 0; step < PROBE_CONFIG_STREAM_TEST_STEPS; ++step) {
+        snapshot.version++;
+        mutate_snapshot(snapshot, rng);
+
+        json delta = stream.advance(snapshot);
+        if (delta.is_null()) continue;
+        CHECK(delta["type"] == "stream.probe_config_delta");
+        CHECK_EQ(delta["payload"]["seq"].get<uint64_t>(), stream.sequence());
+        // 同一版本不重复推进
+        CHECK(stream.advance(snapshot).is_null());
+
+        if (rng() % 100 < PROBE_CONFIG_STREAM_DROP_PERCENT) {
+            dropped++;
+            continue;
+        }
+        probe.apply(delta);
+        delivered++;
+        if (probe.needs_resync) {
+            probe.apply(stream.full_message(snapshot));
+            resyncs++;
+        }
+        CHECK_EQ(probe.seq, stream.sequence());
+        CHECK(probe.payload() == build_probe_config_payload(&snapshot));
+    }
+
+    // 最后一条增量可能恰好被丢弃：再推进一次必然产生的变化，送达后探针应追平
+    snapshot.version++;
+    toggle_id(snapshot.frozen_pids, 99999);
+    json last = stream.advance(snapshot);
+    REQUIRE(last.is_object());
+    probe.apply(last);
+    if (probe.needs_resync) probe.apply(stream.full_message(snapshot));
+    CHECK(!probe.needs_resync);
+    CHECK_EQ(probe.seq, stream.sequence());
+    CHECK(probe.payload() == build_probe_config_payload(&snapshot));
+
+    CHECK(delivered > 0);
+    CHECK(dropped > 0);
+    CHECK(resyncs > 0);
+}
@@ -0,0 +1,113 @@
+// daemon/tests/probe_event_test.cpp
+#include "test_harness.h"
+#include "message_dispatch.h"
+#include "state_manager.h"
+#include <chrono>
+#include <ctime>
+
+// 事件风暴基准：总事件数与每个批量帧的事件数
+constexpr int PROBE_EVENT_BENCHMARK_EVENTS = 10000;
+constexpr int PROBE_EVENT_BENCHMARK_BATCH = 64;
+
+TEST_CASE(probe_event_batch_parses_fixed_arrays) {
+    json payload = json::parse(R"({"e": [
+        [1, -1, 0, 0, "com.example.fg"],
+        [2, 10123, 10, 0, "com.example.bg"],
+        [3, 10456, 0, 2, ""],
+        [4, -1, 999, 0, "com.example.clone"]
+    ]})");
+    std::vector<ProbeEvent> events;
+    parse_probe_event_batch(payload, events);
+    REQUIRE(events.size() == 4);
+    CHECK(events[0].kind == ProbeEvent::Kind::FOREGROUND);
+    CHECK_EQ(events[0].package_name, std::string("com.example.fg"));
+    CHECK(events[1].kind == ProbeEvent::Kind::BACKGROUND);
+    CHECK_EQ(events[1].uid, 10123);
+    CHECK_EQ(events[1].user_id, 10);
+    CHECK(events[2].kind == ProbeEvent::Kind::WAKEUP);
+    CHECK_EQ(events[2].arg, 2);
+    CHECK(events[3].kind == ProbeEvent::Kind::PROACTIVE_START);
+    CHECK_EQ(events[3].user_id, 999);
+}
+
+TEST_CASE(probe_event_batch_skips_malformed_entries) {
+    json payload = json::parse(R"({"e": [
+        [0, -1, 0, 0, "kind.too.small"],
+        [5, -1, 0, 0, "kind.too.large"],
+        ["1", -1, 0, 0, "kind.not.integer"],
+        [1, -1, 0, 0],
+        [1, -1, 0, 0, 42],
+        {"kind": 1},
+        [1, "uid", "user", null, "com.example.defaults"]
+    ]})");
+    std::vector<ProbeEvent> events;
+    parse_probe_event_batch(payload, events);
+    REQUIRE(events.size() == 1);
+    CHECK_EQ(events[0].package_name, std::string("com.example.defaults"));
+    CHECK_EQ(events[0].uid, -1);
+    CHECK_EQ(events[0].user_id, 0);
+    CHECK_EQ(events[0].arg, 0);
+
+    events.clear();
+    parse_probe_event_batch(json::object(), events);
+    parse_probe_event_batch(json{{"e", "not an array"}}, events);
+    CHECK(events.empty());
+}
+
+static long long thread_cpu_us() {
+    struct timespec ts {};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return static_cast<long long>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+// 以同一组事件分别走逐条 JSON 行和批量帧两条路径，测量解析 10000 条事件的 CPU 时间
+BENCHMARK_CASE(probe_event_batch_benchmark) {
+    constexpr const char* BENCH_PACKAGE = "cerberus.benchmark.invalid";
+    std::vector<std::string> single_lines;
+    std::vector<std::string> batch_frames;
+    single_lines.reserve(PROBE_EVENT_BENCHMARK_EVENTS);
+    json batch = json::array();
+    for (int i = 0; i < PROBE_EVENT_BENCHMARK_EVENTS; ++i) {
+        static const char* TYPES[] = {"event.app_foreground", "event.app_background", "cmd.proactive_unfreeze"};
+        int kind = (i % 3 == 2) ? static_cast<int>(ProbeEvent::Kind::PROACTIVE_START) : (i % 3) + 1;
+        single_lines.push_back(json{{"type", TYPES[i % 3]}, {"payload", {{"package_name", BENCH_PACKAGE}, {"user_id", 0}}}}.dump());
+        batch.push_back(json::array({kind, -1, 0, 0, BENCH_PACKAGE}));
+        if (batch.size() == PROBE_EVENT_BENCHMARK_BATCH || i + 1 == PROBE_EVENT_BENCHMARK_EVENTS) {
+            batch_frames.push_back(json{{"type", "event.probe_batch"}, {"payload", {{"e", batch}}}}.dump());
+            batch = json::array();
+        }
+    }
+
+    // 与守护进程的处理路径一致：逐条消息解码为 AppTargetRequest，批量帧解析为 ProbeEvent 数组
+    size_t decoded = 0;
+    auto measure = [&decoded](const std::vector<std::string>& messages, bool batched) {
+        size_t bytes = 0;
+        auto wall_start = std::chrono::steady_clock::now();
+        long long cpu_start = thread_cpu_us();
+        for (const auto& message : messages) {
+            MessageEnvelope envelope;
+            envelope.parse(message);
+            if (batched) {
+                std::vector<ProbeEvent> events;
+                parse_probe_event_batch(envelope.payload_json(), events);
+                decoded += events.size();
+            } else {
+                AppTargetRequest request;
+                if (decode_payload(envelope.payload_text(), request)) ++decoded;
+            }
+            bytes += message.size() + 1;
+        }
+        long long cpu_us = thread_cpu_us() - cpu_start;
+        auto wall_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - wall_start).count();
+        return json{{"messages", messages.size()}, {"bytes", bytes}, {"cpu_us", cpu_us}, {"wall_us", wall_us}};
+    };
+    json single = measure(single_lines, false);
+    json batched = measure(batch_frames, true);
+    CHECK_EQ(decoded, static_cast<size_t>(2 * PROBE_EVENT_BENCHMARK_EVENTS));
+    test_harness::report_benchmark({
+        {"events", PROBE_EVENT_BENCHMARK_EVENTS},
+        {"batch_size", PROBE_EVENT_BENCHMARK_BATCH},
+        {"single", single},
+        {"batched", batched}
+    });
+}
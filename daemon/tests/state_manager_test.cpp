@@ -0,0 +1,98 @@
+// daemon/tests/state_manager_test.cpp
+#include "test_harness.h"
+#include "state_manager.h"
+#include "action_executor.h"
+#include "adj_mapper.h"
+#include "database_manager.h"
+#include "json_writer.h"
+#include "memory_butler.h"
+#include "system_monitor.h"
+#include "time_series_database.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+// 并发读写测试：写线程修改状态的时长、策略列表中的应用数
+constexpr int SNAPSHOT_READ_TEST_DURATION_MS = 500;
+constexpr int SNAPSHOT_READ_TEST_APPS = 40;
+// 只有写线程获取 state_mutex_，读端再频繁也不应让它等待超过这个时长
+constexpr uint64_t SNAPSHOT_READ_TEST_MAX_WAIT_US = 1000;
+
+// 与 main.cpp 推送仪表盘时相同的写法：只持有快照，不经过 StateManager 的锁
+static std::string dashboard_update_text(const StateSnapshot* snapshot) {
+    JsonWriter writer(4096);
+    writer.begin_object().key("payload");
+    write_dashboard_payload(writer, snapshot);
+    writer.field("type", "stream.dashboard_update").end_object();
+    return writer.take();
+}
+
+static json policies_payload(int round) {
+    json policies = json::array();
+    for (int i = 0; i < SNAPSHOT_READ_TEST_APPS; ++i) {
+        policies.push_back({
+            {"package_name", "com.example.snapshot" + std::to_string(i)},
+            {"user_id", 0},
+            {"policy", (i + round) % 4},
+            {"allow_timed_unfreeze", (i + round) % 2 == 0}
+        });
+    }
+    return json{{"policies", policies}};
+}
+
+// 读端在紧凑循环里取快照并序列化仪表盘与探针载荷，同时另一线程经 StateManager 修改配置；
+// 读端不获取 state_mutex_，因此写线程从不等待，锁统计中的最长等待保持在阈值以下
+TEST_CASE(state_snapshot_reads_do_not_block_mutations) {
+    std::string dir = test_harness::scratch_dir("state_manager_snapshot_reads");
+    auto db = std::make_shared<DatabaseManager>(dir + "/cerberus.db");
+    auto sys = std::make_shared<SystemMonitor>();
+    auto adj_mapper = std::make_shared<AdjMapper>(dir + "/adj_rules.json");
+    auto executor = std::make_shared<ActionExecutor>(sys, adj_mapper);
+    auto logger = Logger::create(dir + "/logs");
+    StateManager manager(db, sys, executor, logger, TimeSeriesDatabase::create(60, 8), adj_mapper,
+                         std::make_shared<MemoryButler>());
+    manager.publish_snapshot();
+    REQUIRE(manager.get_snapshot() != nullptr);
+    uint64_t first_version = manager.get_snapshot()->version;
+
+    std::atomic<bool> done{false};
+    std::atomic<int> mutations{0};
+    std::thread writer([&] {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(SNAPSHOT_READ_TEST_DURATION_MS);
+        for (int round = 0; std::chrono::steady_clock::now() < deadline; ++round) {
+            if (round % 2 == 0) {
+                MasterConfig config;
+                config.standard_timeout_sec = 60 + round % 120;
+                manager.update_master_config(config);
+            } else {
+                manager.on_config_changed_from_ui(policies_payload(round));
+            }
+            mutations++;
+        }
+        done = true;
+    });
+
+    size_t reads = 0, empty_reads = 0;
+    uint64_t last_version = first_version;
+    bool versions_monotonic = true;
+    while (!done) {
+        auto snapshot = manager.get_snapshot();
+        if (snapshot->version < last_version) versions_monotonic = false;
+        last_version = snapshot->version;
+        std::string text = dashboard_update_text(snapshot.get());
+        json probe_payload = build_probe_config_payload(snapshot.get());
+        if (text.empty() || !probe_payload.contains("policies")) empty_reads++;
+        reads++;
+    }
+    writer.join();
+
+    RecordedMutex::Stats stats = manager.state_lock_stats();
+    CHECK(mutations.load() > 0);
+    CHECK(reads > 0);
+    CHECK_EQ(empty_reads, 0u);
+    CHECK(versions_monotonic);
+    CHECK(last_version > first_version);
+    CHECK(stats.acquisitions > 0);
+    CHECK(stats.max_wait_us < SNAPSHOT_READ_TEST_MAX_WAIT_US);
+    CHECK_EQ(manager.get_snapshot()->policies->size(), static_cast<size_t>(SNAPSHOT_READ_TEST_APPS));
+}
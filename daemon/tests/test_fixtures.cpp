@@ -0,0 +1,78 @@
+// daemon/tests/test_fixtures.cpp
+#include "test_fixtures.h"
+#include <random>
+#include <string>
+
+StateSnapshot make_dashboard_snapshot(int apps) {
+    StateSnapshot snapshot;
+    snapshot.global_stats = DashboardGlobalStats{37.5f, 7864320, 2621440, 4194304, 3145728};
+    snapshot.apps.reserve(apps);
+    for (int i = 0; i < apps; ++i) {
+        DashboardAppView view;
+        view.package_name = "com.example.benchmark.app" + std::to_string(i);
+        view.app_name = "基准应用 " + std::to_string(i);
+        view.user_id = i % 7 == 0 ? 999 : 0;
+        view.display_status = i % 3 == 0 ? "FROZEN" : "RUNNING";
+        view.mem_usage_kb = 40000 + i * 137;
+        view.swap_usage_kb = i * 31;
+        view.cpu_usage_percent = static_cast<float>(i % 100) / 7.0f;
+        view.is_foreground = i == 0;
+        view.is_playing_audio = i % 50 == 1;
+        view.is_audio_exempted = view.is_playing_audio;
+        view.is_whitelisted = i % 11 == 0;
+        snapshot.apps.push_back(std::move(view));
+    }
+    return snapshot;
+}
+
+std::vector<LogEntry> make_log_page(int entries) {
+    static const char* CATEGORIES[] = {"冻结", "解冻", "系统", "报告"};
+    static const char* MESSAGES[] = {"因后台超时被冻结 (Cgroup)", "切换到前台，已解冻", "进入深度 Doze", "过去 1 小时内共冻结 12 个应用"};
+    std::vector<LogEntry> page;
+    page.reserve(entries);
+    for (int i = 0; i < entries; ++i) {
+        LogEntry entry;
+        entry.timestamp_ms = 1767225600000LL + i * 1000LL;
+        entry.level = i % 4 == 0 ? LogLevel::ACTION_FREEZE : LogLevel::INFO;
+        entry.category = CATEGORIES[i % 4];
+        entry.message = MESSAGES[i % 4];
+        entry.package_name = "com.example.app" + std::to_string(i % 37);
+        entry.user_id = i % 9 == 0 ? 999 : 0;
+        entry.seq = static_cast<uint64_t>(i) + 1;
+        page.push_back(std::move(entry));
+    }
+    return page;
+}
+
+std::vector<LogEntry> make_synthetic_logs(size_t entries) {
+    static const char* CATEGORIES[] = {"冻结", "解冻", "唤醒", "节流阀", "审计", "Doze", "电池", "报告", "网络", "定时器"};
+    constexpr int PACKAGES = 200;
+    std::mt19937 rng(20261018);
+    std::vector<LogEntry> generated;
+    generated.reserve(entries);
+    long long timestamp = 1767225600000LL;
+    for (size_t i = 0; i < entries; ++i) {
+        timestamp += 1 + rng() % 50;
+        int roll = static_cast<int>(rng() % 100);
+        LogLevel level = roll == 0 ? LogLevel::ERROR : roll < 10 ? LogLevel::WARN : roll < 40 ? LogLevel::ACTION_FREEZE : LogLevel::INFO;
+        int package = static_cast<int>(rng() % PACKAGES);
+        if (package == 0 && rng() % 5 != 0) package = 1;
+        generated.push_back({
+            .timestamp_ms = timestamp,
+            .level = level,
+            .category = CATEGORIES[rng() % 10],
+            .message = "应用进入后台超过阈值，执行冻结 pid=" + std::to_string(10000 + rng() % 20000) + " adj=" + std::to_string(rng() % 1000),
+            .package_name = rng() % 8 == 0 ? std::string() : "com.example.package" + std::to_string(package),
+            .user_id = static_cast<int>(rng() % 3 == 0 ? -1 : 0),
+            .seq = i + 1
+        });
+    }
+    return generated;
+}
+
+std::string legacy_log_line(const LogEntry& entry) {
+    json line = {{"ts", entry.timestamp_ms}, {"lvl", static_cast<int>(entry.level)}, {"cat", entry.category}, {"msg", entry.message}};
+    if (!entry.package_name.empty()) line["pkg"] = entry.package_name;
+    if (entry.user_id != -1) line["uid"] = entry.user_id;
+    return line.dump() + "\n";
+}
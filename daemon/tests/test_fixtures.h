@@ -0,0 +1,22 @@
+// daemon/tests/test_fixtures.h
+#ifndef CERBERUS_TEST_FIXTURES_H
+#define CERBERUS_TEST_FIXTURES_H
+
+#include "state_manager.h"
+#include "logger.h"
+#include <string>
+#include <vector>
+
+// 多个用例共用的合成数据，内容固定，结果可重复
+
+// apps 个应用的仪表盘快照，含全局统计，字段覆盖各种状态组合
+StateSnapshot make_dashboard_snapshot(int apps);
+// 一页形如真实日志的条目，分类、包名与消息轮换
+std::vector<LogEntry> make_log_page(int entries);
+// 日志存储基准用的大批合成日志：时间戳递增，级别、分类、包名按固定种子随机分布，
+// 第 0 号包只在约千分之一的日志中出现，seq 从 1 开始
+std::vector<LogEntry> make_synthetic_logs(size_t entries);
+// 旧版写入线程写出的一行 JSON（含换行）
+std::string legacy_log_line(const LogEntry& entry);
+
+#endif // CERBERUS_TEST_FIXTURES_H
@@ -0,0 +1,61 @@
+// daemon/tests/test_harness.h
+#ifndef CERBERUS_TEST_HARNESS_H
+#define CERBERUS_TEST_HARNESS_H
+
+#include <nlohmann/json.hpp>
+#include <cstdint>
+#include <sstream>
+#include <string>
+
+using json = nlohmann::json;
+
+// cerberusd_tests 的极简测试框架：TEST_CASE 注册断言测试，BENCHMARK_CASE 注册基准（只在 --bench 时运行）。
+// CHECK 失败时记录位置并继续执行，进程以失败的用例数作为非零退出码
+namespace test_harness {
+
+using TestFn = void (*)();
+
+bool register_case(const char* name, TestFn fn, bool benchmark);
+void report_failure(const char* file, int line, const std::string& message);
+// 基准结果以一行 JSON 输出，名称为当前用例
+void report_benchmark(const json& result);
+// 用例独占的临时目录（已清空），位于 $TMPDIR 或 /data/local/tmp 下
+std::string scratch_dir(const std::string& name);
+// 当前线程累计的堆分配次数，由测试程序替换的全局 operator new 计数
+uint64_t heap_allocations();
+
+template <typename A, typename B>
+void check_equal(const A& actual, const B& expected, const char* actual_text, const char* expected_text, const char* file, int line) {
+    if (actual == expected) return;
+    std::ostringstream message;
+    message << actual_text << " == " << expected_text << " (actual: " << actual << ", expected: " << expected << ")";
+    report_failure(file, line, message.str());
+}
+
+} // namespace test_harness
+
+#define TEST_HARNESS_REGISTER(name, benchmark)                                                 \
+    static void name();                                                                        \
+    static const bool name##_registered = test_harness::register_case(#name, name, benchmark); \
+    static void name()
+
+#define TEST_CASE(name) TEST_HARNESS_REGISTER(name, false)
+#define BENCHMARK_CASE(name) TEST_HARNESS_REGISTER(name, true)
+
+#define CHECK(condition)                                                        \
+    do {                                                                        \
+        if (!(condition)) test_harness::report_failure(__FILE__, __LINE__, #condition); \
+    } while (0)
+
+#define CHECK_EQ(actual, expected) test_harness::check_equal((actual), (expected), #actual, #expected, __FILE__, __LINE__)
+
+// 前置条件不满足时结束当前用例
+#define REQUIRE(condition)                                                      \
+    do {                                                                        \
+        if (!(condition)) {                                                     \
+            test_harness::report_failure(__FILE__, __LINE__, #condition);       \
+            return;                                                             \
+        }                                                                       \
+    } while (0)
+
+#endif // CERBERUS_TEST_HARNESS_H
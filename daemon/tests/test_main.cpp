@@ -0,0 +1,122 @@
+// daemon/tests/test_main.cpp
+#include "test_harness.h"
+#include "uds_server.h"
+#include "main.h"
+#include <sys/stat.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <new>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// --- main.cpp 中定义、被其他模块引用的全局对象，测试程序里没有服务器与探针 ---
+
+std::unique_ptr<UdsServer> g_server;
+std::atomic<int> g_probe_fd = -1;
+std::atomic<int> g_top_app_refresh_tickets = 0;
+
+void broadcast_dashboard_update() {}
+void notify_probe_of_config_change() {}
+void broadcast_doze_event(bool) {}
+
+// --- 堆分配计数：只在测试程序里替换全局分配器，守护进程不承担这份开销 ---
+
+static thread_local uint64_t t_heap_allocations = 0;
+
+void* operator new(std::size_t size) {
+    ++t_heap_allocations;
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+void* operator new[](std::size_t size) {
+    ++t_heap_allocations;
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+
+namespace test_harness {
+
+struct Case {
+    const char* name;
+    TestFn fn;
+    bool benchmark;
+};
+
+static std::vector<Case>& cases() {
+    static std::vector<Case> registry;
+    return registry;
+}
+
+static const char* g_current_case = "";
+static int g_failures = 0;
+
+bool register_case(const char* name, TestFn fn, bool benchmark) {
+    cases().push_back({name, fn, benchmark});
+    return true;
+}
+
+void report_failure(const char* file, int line, const std::string& message) {
+    g_failures++;
+    std::fprintf(stderr, "  FAILED %s:%d: %s\n", file, line, message.c_str());
+}
+
+void report_benchmark(const json& result) {
+    std::printf("  %s %s\n", g_current_case, result.dump().c_str());
+}
+
+std::string scratch_dir(const std::string& name) {
+    const char* base = std::getenv("TMPDIR");
+    std::string dir = std::string(base && *base ? base : "/data/local/tmp") + "/cerberusd_tests/" + name;
+    std::error_code ec;
+    fs::remove_all(dir, ec);
+    fs::create_directories(dir, ec);
+    return dir;
+}
+
+uint64_t heap_allocations() {
+    return t_heap_allocations;
+}
+
+} // namespace test_harness
+
+// 用法: cerberusd_tests [--bench] [名称子串]
+// 不带 --bench 时运行全部断言测试；带 --bench 时只运行基准
+int main(int argc, char** argv) {
+    bool benchmarks = false;
+    std::string filter;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--bench") == 0) benchmarks = true;
+        else filter = argv[i];
+    }
+
+    int failed_cases = 0, ran = 0;
+    for (const auto& test : test_harness::cases()) {
+        if (test.benchmark != benchmarks) continue;
+        if (!filter.empty() && std::string(test.name).find(filter) == std::string::npos) continue;
+        std::printf("[ RUN  ] %s\n", test.name);
+        std::fflush(stdout);
+        test_harness::g_current_case = test.name;
+        int failures_before = test_harness::g_failures;
+        auto start = std::chrono::steady_clock::now();
+        test.fn();
+        auto elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+        bool passed = test_harness::g_failures == failures_before;
+        if (!passed) failed_cases++;
+        ran++;
+        std::printf("[ %s ] %s (%lld ms)\n", passed ? " OK " : "FAIL", test.name, static_cast<long long>(elapsed_ms));
+        std::fflush(stdout);
+    }
+    std::printf("%d/%d passed\n", ran - failed_cases, ran);
+    return failed_cases == 0 ? 0 : 1;
+}
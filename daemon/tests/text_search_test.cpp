@@ -0,0 +1,45 @@
+// daemon/tests/text_search_test.cpp
+#include "test_harness.h"
+#include "text_search.h"
+#include <string>
+#include <vector>
+
+constexpr size_t TEST_BLOOM_BYTES = 512;
+
+// SIMD 路径按 16 字节分段，命中位置要覆盖段首、段尾、跨段与缓冲区末尾
+TEST_CASE(text_search_simd_matches_scalar_at_every_offset) {
+    const std::string needles[] = {"a", "ab", "冻结", "pid=123", "0123456789abcdef0"};
+    size_t mismatches = 0;
+    for (const auto& needle : needles) {
+        for (size_t length = 0; length < 80; ++length) {
+            for (size_t at = 0; at + needle.size() <= length; ++at) {
+                std::string haystack(length, '.');
+                haystack.replace(at, needle.size(), needle);
+                for (size_t from : {size_t{0}, at, at + 1}) {
+                    size_t expected = std::string_view(haystack).find(needle, from);
+                    if (text_search::find_scalar(haystack, needle, from) != expected) ++mismatches;
+                    if (text_search::find_simd(haystack, needle, from) != expected) ++mismatches;
+                }
+            }
+        }
+    }
+    CHECK_EQ(mismatches, 0u);
+    CHECK_EQ(text_search::find_simd("", "a"), text_search::npos);
+    CHECK_EQ(text_search::find_simd("abc", ""), 0u);
+    CHECK_EQ(text_search::find_simd("abc", "abcd"), text_search::npos);
+}
+
+TEST_CASE(text_search_bloom_never_excludes_contained_text) {
+    std::vector<uint8_t> bloom(TEST_BLOOM_BYTES, 0);
+    std::string text = "因 Kernel Signal 9 而解冻 pid=4242";
+    text_search::add_trigrams(text, bloom.data(), bloom.size());
+    for (size_t begin = 0; begin < text.size(); ++begin) {
+        for (size_t length = 1; begin + length <= text.size(); ++length) {
+            auto bits = text_search::trigram_bits(std::string_view(text).substr(begin, length), bloom.size());
+            CHECK(text_search::bloom_may_contain(bloom.data(), bits));
+        }
+    }
+    // 短于 3 字节的关键字没有三字节组，不能排除
+    CHECK(text_search::trigram_bits("ab", bloom.size()).empty());
+    CHECK(!text_search::bloom_may_contain(bloom.data(), text_search::trigram_bits("lowmemorykiller", bloom.size())));
+}
@@ -0,0 +1,188 @@
+// daemon/tests/time_series_database_test.cpp
+#include "test_harness.h"
+#include "time_series_database.h"
+#include <malloc.h>
+#include <chrono>
+#include <climits>
+#include <deque>
+
+// 基准的样本数（约 2 小时）、环的容量与重复次数
+constexpr size_t TIME_SERIES_BENCHMARK_SAMPLES = 3600;
+constexpr size_t TIME_SERIES_BENCHMARK_CAPACITY = 900;
+constexpr int TIME_SERIES_BENCHMARK_QUERY_ITERATIONS = 200;
+constexpr size_t TIME_SERIES_BENCHMARK_CORES = 8;
+// 区间查询取最近 5 分钟（2 秒一个样本）
+constexpr long long TIME_SERIES_BENCHMARK_RANGE_MS = 5 * 60 * 1000;
+
+// 原先的实现：deque<MetricsRecord>，每条记录带一个堆上的 per_core 向量，整体复制后返回
+class LegacyMetricsStore {
+public:
+    explicit LegacyMetricsStore(size_t max_size) : max_size_(max_size) {}
+    void add_record(const MetricsRecord& record) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (records_.size() >= max_size_) records_.pop_front();
+        records_.push_back(record);
+    }
+    std::vector<MetricsRecord> get_all_records() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return std::vector<MetricsRecord>(records_.begin(), records_.end());
+    }
+    std::vector<MetricsRecord> get_records_since(long long timestamp_ms) const {
+        std::vector<MetricsRecord> result;
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& record : records_) {
+            if (record.timestamp_ms >= timestamp_ms) result.push_back(record);
+        }
+        return result;
+    }
+    // 记录本身加上每个 per_core 向量实际占用的堆块；deque 的块表不计
+    size_t memory_bytes() const {
+        size_t bytes = records_.size() * sizeof(MetricsRecord);
+        for (const auto& record : records_) {
+            if (record.per_core_cpu_usage.capacity() > 0) bytes += malloc_usable_size(const_cast<float*>(record.per_core_cpu_usage.data()));
+        }
+        return bytes;
+    }
+
+private:
+    size_t max_size_;
+    std::deque<MetricsRecord> records_;
+    mutable std::mutex mutex_;
+};
+
+static std::vector<MetricsRecord> make_samples(size_t count, size_t cores) {
+    std::vector<MetricsRecord> samples(count);
+    for (size_t i = 0; i < count; ++i) {
+        MetricsRecord& record = samples[i];
+        record.timestamp_ms = 1767225600000LL + static_cast<long long>(i) * 2000;
+        record.total_cpu_usage_percent = static_cast<float>(i % 97) / 3.0f;
+        record.per_core_cpu_usage.resize(cores);
+        for (size_t core = 0; core < cores; ++core) record.per_core_cpu_usage[core] = static_cast<float>((i + core * 7) % 100);
+        record.mem_total_kb = 7864320;
+        record.mem_available_kb = 2621440 + static_cast<long>(i);
+        record.swap_total_kb = 4194304;
+        record.swap_free_kb = 3145728 - static_cast<long>(i);
+        record.battery_level = 80 - static_cast<int>(i % 20);
+        record.battery_temp_celsius = 31.5f;
+        record.battery_power_watt = -1.25f;
+        record.is_charging = i % 50 < 10;
+        record.is_screen_on = i % 7 != 0;
+        record.is_audio_playing = i % 11 == 0;
+    }
+    return samples;
+}
+
+static std::string records_json(const std::vector<MetricsRecord>& records) {
+    JsonWriter writer;
+    writer.begin_array();
+    for (const auto& record : records) record.write_json(writer);
+    writer.end_array();
+    return writer.take();
+}
+
+TEST_CASE(time_series_database_matches_legacy_store) {
+    constexpr size_t capacity = 16;
+    auto db = TimeSeriesDatabase::create(capacity, 4);
+    LegacyMetricsStore legacy(capacity);
+    CHECK(!db->get_latest_record().has_value());
+
+    // 环绕两圈以上，并混入核心数多于与少于矩阵宽度的样本
+    std::vector<MetricsRecord> samples = make_samples(40, 4);
+    samples[30].per_core_cpu_usage.resize(2);
+    samples[35].per_core_cpu_usage.resize(4 + 3, 1.0f);
+    for (const auto& record : samples) {
+        db->add_record(record);
+        MetricsRecord stored = record;
+        if (stored.per_core_cpu_usage.size() > 4) stored.per_core_cpu_usage.resize(4);
+        legacy.add_record(stored);
+    }
+    CHECK_EQ(db->size(), capacity);
+    CHECK_EQ(db->get_latest_record()->timestamp_ms, samples.back().timestamp_ms);
+
+    JsonWriter writer;
+    db->write_records(writer);
+    CHECK_EQ(writer.take(), records_json(legacy.get_all_records()));
+    CHECK_EQ(records_json(db->get_all_records()), records_json(legacy.get_all_records()));
+
+    long long since = samples[33].timestamp_ms;
+    CHECK_EQ(records_json(db->get_records_since(since)), records_json(legacy.get_records_since(since)));
+    JsonWriter limited;
+    db->write_records(limited, since, 3);
+    std::vector<MetricsRecord> newest = legacy.get_records_since(samples[37].timestamp_ms);
+    CHECK_EQ(limited.take(), records_json(newest));
+
+    size_t visited = db->visit_records(LLONG_MIN, SIZE_MAX, [](const MetricsSampleView&) {});
+    CHECK_EQ(visited, capacity);
+}
+
+// 列式存储与原先 deque<MetricsRecord> 的写入、查询开销与内存占用对比
+BENCHMARK_CASE(time_series_benchmark) {
+    std::vector<MetricsRecord> samples = make_samples(TIME_SERIES_BENCHMARK_SAMPLES, TIME_SERIES_BENCHMARK_CORES);
+
+    auto measure = [](int iterations, const auto& fn) {
+        uint64_t allocations_before = test_harness::heap_allocations();
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i) fn(i);
+        auto elapsed_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        uint64_t allocations = test_harness::heap_allocations() - allocations_before;
+        return json{
+            {"ns", static_cast<double>(elapsed_ns) / iterations},
+            {"allocations", static_cast<double>(allocations) / iterations}
+        };
+    };
+
+    LegacyMetricsStore legacy(TIME_SERIES_BENCHMARK_CAPACITY);
+    auto columnar = TimeSeriesDatabase::create(TIME_SERIES_BENCHMARK_CAPACITY, TIME_SERIES_BENCHMARK_CORES);
+    json result = {
+        {"capacity", TIME_SERIES_BENCHMARK_CAPACITY},
+        {"samples", TIME_SERIES_BENCHMARK_SAMPLES},
+        {"cores", TIME_SERIES_BENCHMARK_CORES}
+    };
+    // 写入：前 capacity 个填满环，之后每次都要淘汰最旧的一个
+    const int appends = static_cast<int>(TIME_SERIES_BENCHMARK_SAMPLES);
+    result["append"] = {
+        {"legacy", measure(appends, [&](int i) { legacy.add_record(samples[i]); })},
+        {"columnar", measure(appends, [&](int i) { columnar->add_record(samples[i]); })}
+    };
+
+    size_t sink = 0;
+    std::string legacy_text, columnar_text;
+    result["full_history"] = {
+        {"legacy_copy", measure(TIME_SERIES_BENCHMARK_QUERY_ITERATIONS, [&](int) { sink += legacy.get_all_records().size(); })},
+        {"legacy_copy_json", measure(TIME_SERIES_BENCHMARK_QUERY_ITERATIONS, [&](int) {
+            legacy_text = records_json(legacy.get_all_records());
+        })},
+        {"columnar_visit", measure(TIME_SERIES_BENCHMARK_QUERY_ITERATIONS, [&](int) {
+            columnar->visit_records(LLONG_MIN, SIZE_MAX, [&sink](const MetricsSampleView& sample) { sink += sample.core_count(); });
+        })},
+        {"columnar_json", measure(TIME_SERIES_BENCHMARK_QUERY_ITERATIONS, [&](int) {
+            JsonWriter writer;
+            columnar->write_records(writer);
+            columnar_text = writer.take();
+        })}
+    };
+
+    long long since = samples.back().timestamp_ms - TIME_SERIES_BENCHMARK_RANGE_MS;
+    size_t legacy_range = 0, columnar_range = 0;
+    result["range_5min"] = {
+        {"legacy", measure(TIME_SERIES_BENCHMARK_QUERY_ITERATIONS, [&](int) { legacy_range = legacy.get_records_since(since).size(); })},
+        {"columnar_copy", measure(TIME_SERIES_BENCHMARK_QUERY_ITERATIONS, [&](int) { columnar_range = columnar->get_records_since(since).size(); })},
+        {"columnar_visit", measure(TIME_SERIES_BENCHMARK_QUERY_ITERATIONS, [&](int) {
+            columnar->visit_records(since, SIZE_MAX, [&sink](const MetricsSampleView& sample) { sink += sample.core_count(); });
+        })}
+    };
+    result["range_5min"]["records"] = columnar_range;
+
+    size_t per_sample = sizeof(long long) + 2 * sizeof(float) + TIME_SERIES_BENCHMARK_CORES * sizeof(float) + 2 * sizeof(uint8_t) +
+                        4 * sizeof(long) + sizeof(int16_t) + 2 * sizeof(float);
+    result["memory_bytes"] = {{"legacy", legacy.memory_bytes()}, {"columnar", TIME_SERIES_BENCHMARK_CAPACITY * per_sample}};
+    result["checksum"] = sink;
+
+    CHECK_EQ(columnar_text, legacy_text);
+    CHECK_EQ(columnar_range, legacy_range);
+    CHECK_EQ(columnar_range, static_cast<size_t>(TIME_SERIES_BENCHMARK_RANGE_MS / 2000 + 1));
+    // 列式存储的写入与遍历不分配内存
+    CHECK_EQ(result["append"]["columnar"]["allocations"].get<double>(), 0.0);
+    CHECK_EQ(result["full_history"]["columnar_visit"]["allocations"].get<double>(), 0.0);
+    test_harness::report_benchmark(result);
+}
@@ -0,0 +1,446 @@
+// daemon/tests/uds_server_test.cpp
+#include "test_harness.h"
+#include "uds_server.h"
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// 超长帧测试中客户端至多尝试写入的字节数
+constexpr size_t OVERSIZED_TEST_MAX_BYTES = 4 * MAX_WIRE_FRAME_BYTES;
+// 连续小消息测试的消息数与每条的字节数，总量超过单帧上限
+constexpr int BURST_TEST_MESSAGES = 20000;
+constexpr size_t BURST_TEST_MESSAGE_BYTES = 1024;
+// 停滞测试：停滞时限、其间对正常客户端的广播条数与每条允许的最大送达延迟
+constexpr int STALL_TEST_TIMEOUT_MS = 400;
+constexpr int STALL_TEST_BROADCASTS = 20;
+constexpr int STALL_TEST_MAX_LATENCY_MS = 50;
+// 广播基准：客户端数、广播帧数与相邻两帧的间隔
+constexpr int BROADCAST_BENCHMARK_CLIENTS = 300;
+constexpr int BROADCAST_BENCHMARK_FRAMES = 200;
+constexpr int BROADCAST_BENCHMARK_INTERVAL_US = 2000;
+
+// 在后台线程运行的服务器，析构时停止；监听 scratch 目录下的套接字与随机 TCP 端口
+class RunningServer {
+public:
+    explicit RunningServer(const std::string& name)
+        : path_(test_harness::scratch_dir(name) + "/server.sock"), server_(path_, 0) {}
+    ~RunningServer() {
+        if (thread_.joinable()) {
+            server_.stop();
+            thread_.join();
+        }
+    }
+
+    UdsServer& server() { return server_; }
+
+    // 处理器需在 start 之前设置
+    void start() {
+        thread_ = std::thread([this] { server_.run(); });
+    }
+
+    // 在调用线程上停止服务器并等待事件循环退出
+    void stop() {
+        server_.stop();
+        if (thread_.joinable()) thread_.join();
+    }
+
+    // 连接并等到事件循环接纳了至少一个连接（即事件循环已在运行）；失败返回 -1
+    int connect_client() {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (std::chrono::steady_clock::now() < deadline) {
+            int fd = socket(AF_LOCAL, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            struct sockaddr_un addr {};
+            addr.sun_family = AF_LOCAL;
+            std::strncpy(addr.sun_path, path_.c_str(), sizeof(addr.sun_path) - 1);
+            if (connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) == 0) {
+                while (!server_.has_clients() && std::chrono::steady_clock::now() < deadline) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+                return fd;
+            }
+            close(fd);
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        return -1;
+    }
+
+private:
+    std::string path_;
+    UdsServer server_;
+    std::thread thread_;
+};
+
+template <typename Predicate>
+static bool wait_until(Predicate predicate, std::chrono::milliseconds timeout = std::chrono::seconds(10)) {
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (!predicate()) {
+        if (std::chrono::steady_clock::now() >= deadline) return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+// 从客户端套接字读出 JSON 行，直到读到内容为 sentinel 的一行（不计入 lines）；超时返回 false
+static bool read_lines_until(int fd, const std::string& sentinel, std::vector<std::string>& lines,
+                             std::chrono::milliseconds timeout = std::chrono::seconds(10)) {
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    std::string pending;
+    char chunk[4096];
+    while (true) {
+        size_t newline;
+        while ((newline = pending.find('\n')) != std::string::npos) {
+            std::string line = pending.substr(0, newline);
+            pending.erase(0, newline + 1);
+            if (line == sentinel) return true;
+            lines.push_back(std::move(line));
+        }
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+        if (remaining.count() <= 0) return false;
+        struct pollfd pfd {fd, POLLIN, 0};
+        if (poll(&pfd, 1, static_cast<int>(remaining.count())) <= 0) return false;
+        ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+        if (n <= 0) return false;
+        pending.append(chunk, static_cast<size_t>(n));
+    }
+}
+
+// 不含换行的超长行：服务器应在缓冲超过单帧上限后立即断开，而不是一直读下去
+TEST_CASE(uds_server_disconnects_oversized_line_while_reading) {
+    RunningServer running("uds_server_oversized");
+    std::atomic<int> disconnects{0};
+    running.server().set_disconnect_handler([&disconnects](int) { disconnects++; });
+    running.start();
+    int fd = running.connect_client();
+    REQUIRE(fd != -1);
+
+    std::string chunk(1024 * 1024, 'x');
+    size_t written = 0;
+    bool write_failed = false;
+    while (written < OVERSIZED_TEST_MAX_BYTES) {
+        ssize_t n = send(fd, chunk.data(), chunk.size(), MSG_NOSIGNAL);
+        if (n <= 0) {
+            write_failed = true;
+            break;
+        }
+        written += static_cast<size_t>(n);
+    }
+    close(fd);
+    CHECK(write_failed);
+    // 上限之外只多出一次读入与两端套接字缓冲的量
+    CHECK(written < MAX_WIRE_FRAME_BYTES + 8 * 1024 * 1024);
+    CHECK(wait_until([&] { return disconnects.load() == 1; }));
+}
+
+// 一次唤醒内连续到达、总量超过单帧上限的小消息全部送达，不会被误判为超长帧
+TEST_CASE(uds_server_delivers_bursts_larger_than_a_frame) {
+    RunningServer running("uds_server_burst");
+    std::atomic<int> received{0};
+    std::atomic<int> malformed{0};
+    running.server().set_message_handler([&](int, std::string_view message) {
+        if (message.size() != BURST_TEST_MESSAGE_BYTES - 1) malformed++;
+        received++;
+    });
+    std::atomic<int> disconnects{0};
+    running.server().set_disconnect_handler([&disconnects](int) { disconnects++; });
+    running.start();
+    int fd = running.connect_client();
+    REQUIRE(fd != -1);
+
+    std::string line(BURST_TEST_MESSAGE_BYTES - 1, 'm');
+    line.push_back('\n');
+    std::string batch;
+    for (int i = 0; i < 64; ++i) batch += line;
+    for (int sent = 0; sent < BURST_TEST_MESSAGES; sent += 64) {
+        size_t offset = 0;
+        while (offset < batch.size()) {
+            ssize_t n = send(fd, batch.data() + offset, batch.size() - offset, MSG_NOSIGNAL);
+            REQUIRE(n > 0);
+            offset += static_cast<size_t>(n);
+        }
+    }
+    int expected = (BURST_TEST_MESSAGES + 63) / 64 * 64;
+    CHECK(wait_until([&] { return received.load() == expected; }));
+    CHECK_EQ(malformed.load(), 0);
+    CHECK_EQ(disconnects.load(), 0);
+    close(fd);
+    CHECK(wait_until([&] { return disconnects.load() == 1; }));
+}
+
+// 断开处理器在服务器锁之外调用，可以直接回到服务器上查询、发送
+TEST_CASE(uds_server_disconnect_handler_may_call_back) {
+    RunningServer running("uds_server_disconnect_handler");
+    std::atomic<int> disconnects{0};
+    std::atomic<bool> still_listed{false};
+    UdsServer& server = running.server();
+    server.set_disconnect_handler([&](int client_fd) {
+        if (server.connection_id(client_fd) != 0 || server.subscriptions(client_fd) != 0) still_listed = true;
+        server.send_message(client_fd, "{}");
+        disconnects++;
+    });
+    running.start();
+    int fd = running.connect_client();
+    REQUIRE(fd != -1);
+    close(fd);
+    CHECK(wait_until([&] { return disconnects.load() == 1; }));
+    CHECK(!still_listed.load());
+    CHECK(!server.has_clients());
+}
+
+// 订阅掩码决定每个主题发给谁：探针只订阅 probe_config，默认客户端收不到它；没有订阅者的主题连消息都不构建
+TEST_CASE(uds_server_publishes_only_to_topic_subscribers) {
+    RunningServer running("uds_server_topics");
+    UdsServer& server = running.server();
+    std::mutex roles_mutex;
+    std::map<std::string, int> role_fds;
+    server.set_message_handler([&](int client_fd, std::string_view message) {
+        std::lock_guard<std::mutex> lock(roles_mutex);
+        role_fds[std::string(message)] = client_fd;
+    });
+    running.start();
+    int probe = running.connect_client();
+    int ui = running.connect_client();
+    REQUIRE(probe != -1 && ui != -1);
+    REQUIRE(send(probe, "probe\n", 6, MSG_NOSIGNAL) == 6);
+    REQUIRE(send(ui, "ui\n", 3, MSG_NOSIGNAL) == 3);
+    REQUIRE(wait_until([&] {
+        std::lock_guard<std::mutex> lock(roles_mutex);
+        return role_fds.size() == 2;
+    }));
+    int probe_fd = role_fds["probe"];
+    int ui_fd = role_fds["ui"];
+    server.set_subscriptions(probe_fd, TOPIC_PROBE_CONFIG);
+
+    std::map<uint32_t, int> builds;
+    auto publish = [&](uint32_t topic, const char* type) {
+        return server.publish(topic, [&builds, topic, type] {
+            builds[topic]++;
+            return json{{"type", type}};
+        });
+    };
+    // publish 返回入队的总字节数，恰为一个接收者的一行
+    auto one_line = [](const char* type) { return json{{"type", type}}.dump().size() + 1; };
+    CHECK_EQ(publish(TOPIC_STATS, "stream.stats"), one_line("stream.stats"));
+    CHECK_EQ(publish(TOPIC_DASHBOARD, "stream.dashboard"), one_line("stream.dashboard"));
+    CHECK_EQ(publish(TOPIC_PROBE_CONFIG, "stream.probe_config"), one_line("stream.probe_config"));
+    CHECK_EQ(publish(TOPIC_LOGS, "stream.logs"), 0u);
+    CHECK_EQ(builds[TOPIC_STATS], 1);
+    CHECK_EQ(builds[TOPIC_DASHBOARD], 1);
+    CHECK_EQ(builds[TOPIC_PROBE_CONFIG], 1);
+    CHECK_EQ(builds.count(TOPIC_LOGS), 0u);
+
+    // 同一连接上的帧按入队顺序写出，读到直接发送的结束标记时，之前发布给它的帧都已到达
+    const std::string sentinel = R"({"type":"end"})";
+    REQUIRE(server.send_message(probe_fd, sentinel));
+    REQUIRE(server.send_message(ui_fd, sentinel));
+    std::vector<std::string> probe_lines, ui_lines;
+    REQUIRE(read_lines_until(probe, sentinel, probe_lines));
+    REQUIRE(read_lines_until(ui, sentinel, ui_lines));
+    REQUIRE(probe_lines.size() == 1);
+    CHECK(json::parse(probe_lines[0])["type"] == "stream.probe_config");
+    REQUIRE(ui_lines.size() == 2);
+    CHECK(json::parse(ui_lines[0])["type"] == "stream.stats");
+    CHECK(json::parse(ui_lines[1])["type"] == "stream.dashboard");
+    close(probe);
+    close(ui);
+}
+
+// stop() 从其他线程调用时只唤醒事件循环，剩余客户端的回收与断开处理器都在事件循环线程上进行
+TEST_CASE(uds_server_stop_disconnects_clients_on_event_loop) {
+    RunningServer running("uds_server_stop");
+    UdsServer& server = running.server();
+    std::mutex threads_mutex;
+    std::thread::id loop_thread;
+    std::vector<std::thread::id> disconnect_threads;
+    std::atomic<int> received{0};
+    server.set_message_handler([&](int, std::string_view) {
+        std::lock_guard<std::mutex> lock(threads_mutex);
+        loop_thread = std::this_thread::get_id();
+        received++;
+    });
+    server.set_disconnect_handler([&](int) {
+        std::lock_guard<std::mutex> lock(threads_mutex);
+        disconnect_threads.push_back(std::this_thread::get_id());
+    });
+    running.start();
+    std::vector<int> fds;
+    for (int i = 0; i < 3; ++i) {
+        int fd = running.connect_client();
+        REQUIRE(fd != -1);
+        REQUIRE(send(fd, "{}\n", 3, MSG_NOSIGNAL) == 3);
+        fds.push_back(fd);
+    }
+    REQUIRE(wait_until([&] { return received.load() == 3; }));
+
+    running.stop();
+    CHECK(!server.has_clients());
+    {
+        std::lock_guard<std::mutex> lock(threads_mutex);
+        CHECK_EQ(disconnect_threads.size(), fds.size());
+        for (const auto& id : disconnect_threads) CHECK(id == loop_thread);
+        CHECK(loop_thread != std::this_thread::get_id());
+    }
+    // 服务器一侧已关闭，客户端读到 EOF
+    for (int fd : fds) {
+        char byte;
+        CHECK_EQ(recv(fd, &byte, 1, 0), 0);
+        close(fd);
+    }
+}
+
+// 不再读取的客户端：即使之后没有新消息入队，事件循环也要在停滞时限后回收它；
+// 在此期间另一个正常读取的客户端照常收到每条广播，不受停滞客户端拖累
+TEST_CASE(uds_server_reaps_stalled_clients_without_new_sends) {
+    RunningServer running("uds_server_stall");
+    UdsServer& server = running.server();
+    std::mutex roles_mutex;
+    std::map<std::string, int> role_fds;
+    std::atomic<int> disconnects{0};
+    server.set_stall_timeout(std::chrono::milliseconds(STALL_TEST_TIMEOUT_MS));
+    server.set_message_handler([&](int client_fd, std::string_view message) {
+        std::lock_guard<std::mutex> lock(roles_mutex);
+        role_fds[std::string(message)] = client_fd;
+    });
+    server.set_disconnect_handler([&disconnects](int) { disconnects++; });
+    running.start();
+    int fd = running.connect_client();
+    int reader = running.connect_client();
+    REQUIRE(fd != -1 && reader != -1);
+    REQUIRE(send(fd, "{}\n", 3, MSG_NOSIGNAL) == 3);
+    REQUIRE(send(reader, "[]\n", 3, MSG_NOSIGNAL) == 3);
+    REQUIRE(wait_until([&] {
+        std::lock_guard<std::mutex> lock(roles_mutex);
+        return role_fds.size() == 2;
+    }));
+    int server_fd = role_fds["{}"];
+
+    // 填满套接字缓冲，剩余部分留在服务器的发送队列里
+    std::string payload(256 * 1024, 'p');
+    auto sent_at = std::chrono::steady_clock::now();
+    for (int i = 0; i < 8; ++i) CHECK(server.send_message(server_fd, payload));
+
+    // 停滞客户端仍在连接、发送队列积压时，读取方在限定延迟内收到每条广播
+    std::chrono::steady_clock::duration worst_latency{};
+    for (int i = 0; i < STALL_TEST_BROADCASTS; ++i) {
+        std::string line = json{{"type", "stream.tick"}, {"seq", i}}.dump();
+        std::vector<std::string> skipped;
+        auto broadcast_at = std::chrono::steady_clock::now();
+        server.broadcast_message(line);
+        CHECK(read_lines_until(reader, line, skipped, std::chrono::milliseconds(STALL_TEST_MAX_LATENCY_MS)));
+        CHECK(skipped.empty());
+        worst_latency = std::max(worst_latency, std::chrono::steady_clock::now() - broadcast_at);
+    }
+    CHECK_EQ(disconnects.load(), 0);
+    CHECK(worst_latency < std::chrono::milliseconds(STALL_TEST_MAX_LATENCY_MS));
+
+    CHECK(wait_until([&] { return disconnects.load() == 1; }, std::chrono::seconds(5)));
+    CHECK(std::chrono::steady_clock::now() - sent_at >= std::chrono::milliseconds(STALL_TEST_TIMEOUT_MS));
+    CHECK(server.has_clients());
+    close(fd);
+    close(reader);
+}
+
+// 大量客户端时一次广播送达全部客户端的延迟：每帧带发出时刻，由单独的线程用 epoll 读取所有客户端并记录延迟
+BENCHMARK_CASE(uds_server_broadcast_benchmark) {
+    RunningServer running("uds_server_broadcast");
+    UdsServer& server = running.server();
+    std::atomic<int> hellos{0};
+    server.set_message_handler([&hellos](int, std::string_view) { hellos++; });
+    running.start();
+    std::vector<int> fds;
+    for (int i = 0; i < BROADCAST_BENCHMARK_CLIENTS; ++i) {
+        int fd = running.connect_client();
+        REQUIRE(fd != -1);
+        REQUIRE(send(fd, "{}\n", 3, MSG_NOSIGNAL) == 3);
+        fds.push_back(fd);
+    }
+    REQUIRE(wait_until([&] { return hellos.load() == BROADCAST_BENCHMARK_CLIENTS; }));
+
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    REQUIRE(epoll_fd != -1);
+    for (size_t index = 0; index < fds.size(); ++index) {
+        struct epoll_event ev {};
+        ev.events = EPOLLIN;
+        ev.data.u64 = index;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fds[index], &ev);
+    }
+    const size_t expected_total = fds.size() * BROADCAST_BENCHMARK_FRAMES;
+    std::vector<std::string> pending(fds.size());
+    std::vector<int> next_seq(fds.size(), 0);
+    std::vector<uint32_t> latencies_us;
+    latencies_us.reserve(expected_total);
+    size_t out_of_order = 0;
+    // 读端只做最少的工作（读空套接字、按固定字段取值），避免把测试自身的解析开销计入送达延迟
+    std::thread reader([&] {
+        struct epoll_event events[64];
+        char chunk[16384];
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+        while (latencies_us.size() < expected_total && std::chrono::steady_clock::now() < deadline) {
+            int count = epoll_wait(epoll_fd, events, 64, 100);
+            for (int i = 0; i < count; ++i) {
+                size_t index = events[i].data.u64;
+                std::string& buffer = pending[index];
+                ssize_t n;
+                while ((n = recv(fds[index], chunk, sizeof(chunk), MSG_DONTWAIT)) > 0) buffer.append(chunk, static_cast<size_t>(n));
+                long long received_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count();
+                size_t line_start = 0, newline;
+                while ((newline = buffer.find('\n', line_start)) != std::string::npos) {
+                    const char* line = buffer.c_str() + line_start;
+                    const char* sent_field = std::strstr(line, "\"sent_ns\":");
+                    const char* seq_field = std::strstr(line, "\"seq\":");
+                    line_start = newline + 1;
+                    if (!sent_field || !seq_field) { out_of_order++; continue; }
+                    long long sent_ns = std::strtoll(sent_field + 10, nullptr, 10);
+                    if (std::atoi(seq_field + 6) != next_seq[index]++) out_of_order++;
+                    latencies_us.push_back(static_cast<uint32_t>((received_ns - sent_ns) / 1000));
+                }
+                buffer.erase(0, line_start);
+            }
+        }
+    });
+
+    auto start = std::chrono::steady_clock::now();
+    for (int seq = 0; seq < BROADCAST_BENCHMARK_FRAMES; ++seq) {
+        long long sent_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+        server.broadcast_message(json{{"type", "stream.tick"}, {"seq", seq}, {"sent_ns", sent_ns}}.dump());
+        std::this_thread::sleep_for(std::chrono::microseconds(BROADCAST_BENCHMARK_INTERVAL_US));
+    }
+    reader.join();
+    auto elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    close(epoll_fd);
+
+    CHECK_EQ(latencies_us.size(), expected_total);
+    CHECK_EQ(out_of_order, 0u);
+    size_t complete_clients = 0;
+    for (size_t index = 0; index < fds.size(); ++index) {
+        if (next_seq[index] == BROADCAST_BENCHMARK_FRAMES) complete_clients++;
+        close(fds[index]);
+    }
+    CHECK_EQ(complete_clients, fds.size());
+
+    std::sort(latencies_us.begin(), latencies_us.end());
+    auto at = [&](double q) {
+        return latencies_us.empty() ? 0u : latencies_us[std::min(latencies_us.size() - 1, static_cast<size_t>(q * latencies_us.size()))];
+    };
+    test_harness::report_benchmark({
+        {"clients", BROADCAST_BENCHMARK_CLIENTS},
+        {"frames", BROADCAST_BENCHMARK_FRAMES},
+        {"delivered", latencies_us.size()},
+        {"elapsed_ms", elapsed_ms},
+        {"p50_us", at(0.50)},
+        {"p99_us", at(0.99)},
+        {"max_us", latencies_us.empty() ? 0u : latencies_us.back()}
+    });
+}
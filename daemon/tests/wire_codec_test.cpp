@@ -0,0 +1,232 @@
+// daemon/tests/wire_codec_test.cpp
+#include "test_harness.h"
+#include "test_fixtures.h"
+#include "wire_codec.h"
+#include <chrono>
+#include <cstring>
+#include <random>
+#include <vector>
+
+constexpr WireEncoding ALL_ENCODINGS[] = {WireEncoding::JSON_LINES, WireEncoding::JSON_FRAMED, WireEncoding::MSGPACK, WireEncoding::CBOR};
+constexpr int ENCODING_BENCHMARK_ITERATIONS = 20;
+constexpr int ENCODING_BENCHMARK_APPS = 200;
+constexpr int ENCODING_BENCHMARK_LOG_PAGE = 200;
+// 随机切分测试的轮数与每轮至多的消息数
+constexpr int WIRE_FUZZ_ROUNDS = 400;
+constexpr int WIRE_FUZZ_MAX_MESSAGES = 24;
+
+// 真实形态的载荷：仪表盘推送与一页日志
+static json encoding_samples() {
+    StateSnapshot snapshot = make_dashboard_snapshot(ENCODING_BENCHMARK_APPS);
+    json log_array = json::array();
+    for (const auto& log : make_log_page(ENCODING_BENCHMARK_LOG_PAGE)) log_array.push_back(log.to_json());
+    return {
+        {"dashboard", {{"type", "stream.dashboard_update"}, {"payload", build_dashboard_payload(&snapshot)}}},
+        {"logs", {{"type", "resp.get_logs"}, {"payload", log_array}}}
+    };
+}
+
+// 整帧写入接收缓冲区后切出一条消息
+static bool receive_one(const std::string& frame, WireEncoding encoding, ReceiveBuffer& buffer, std::string_view& payload) {
+    std::memcpy(buffer.prepare(frame.size()), frame.data(), frame.size());
+    buffer.commit(frame.size());
+    return buffer.next_message(encoding, payload) == ReceiveBuffer::Status::MESSAGE;
+}
+
+TEST_CASE(wire_codec_round_trips_every_encoding) {
+    json samples = encoding_samples();
+    for (WireEncoding encoding : ALL_ENCODINGS) {
+        for (const auto& sample : samples) {
+            ReceiveBuffer buffer;
+            std::string_view payload;
+            REQUIRE(receive_one(wire_codec::encode_frame(sample, encoding), encoding, buffer, payload));
+            CHECK(wire_codec::decode_payload(payload, encoding) == sample);
+            CHECK_EQ(buffer.buffered(), 0u);
+        }
+    }
+}
+
+TEST_CASE(wire_codec_text_frame_matches_encoded_frame) {
+    json message = {{"type", "resp.history_stats"}, {"payload", {{"a", 1}, {"b", "中文"}}}};
+    for (WireEncoding encoding : ALL_ENCODINGS) {
+        CHECK(wire_codec::encode_text_frame(message.dump(), encoding) == wire_codec::encode_frame(message, encoding));
+    }
+}
+
+TEST_CASE(wire_codec_negotiates_first_supported_encoding) {
+    CHECK(wire_codec::negotiate(json::array({"zstd", "cbor", "msgpack"})) == WireEncoding::CBOR);
+    CHECK(wire_codec::negotiate(json::array({"zstd"})) == WireEncoding::JSON_LINES);
+    CHECK(wire_codec::negotiate(json("msgpack")) == WireEncoding::JSON_LINES);
+}
+
+// 随机的消息：嵌套的对象与数组，字符串含换行、引号与中文，数值覆盖负数、大整数与小数
+static json random_message(std::mt19937& rng, int depth = 0) {
+    static const char* STRINGS[] = {"", "a", "冻结", "line\nbreak", "quote\"back\\slash", "com.example.app", "\t空白 "};
+    json value = json::object();
+    value["type"] = "fuzz." + std::to_string(rng() % 1000);
+    int fields = static_cast<int>(rng() % 6);
+    for (int i = 0; i < fields; ++i) {
+        std::string key = "k" + std::to_string(i);
+        switch (rng() % 6) {
+            case 0: value[key] = static_cast<int64_t>(rng()) - (1LL << 31); break;
+            case 1: value[key] = (static_cast<uint64_t>(rng()) << 32) | rng(); break;
+            case 2: value[key] = static_cast<double>(static_cast<int>(rng() % 20001) - 10000) / 8.0; break;
+            case 3: value[key] = std::string(STRINGS[rng() % 7]) + std::string(rng() % 300, 'x'); break;
+            case 4: value[key] = rng() % 2 == 0; break;
+            default:
+                if (depth < 3) {
+                    json array = json::array();
+                    for (int j = static_cast<int>(rng() % 4); j > 0; --j) array.push_back(random_message(rng, depth + 1));
+                    value[key] = array;
+                } else {
+                    value[key] = nullptr;
+                }
+                break;
+        }
+    }
+    return value;
+}
+
+// 把 stream 按随机长度分段写入接收缓冲区，每段之后切出全部完整消息并立即解码（视图在下一次 prepare 前有效）。
+// 分段长度偏向 1 至 5 字节，长度前缀帧会在 4 字节前缀内部被切开
+static ReceiveBuffer::Status feed_in_random_chunks(const std::string& stream, WireEncoding encoding, std::mt19937& rng,
+                                                    std::vector<json>& decoded, ReceiveBuffer& buffer) {
+    size_t offset = 0;
+    while (offset < stream.size()) {
+        size_t chunk;
+        switch (rng() % 4) {
+            case 0: chunk = 1; break;
+            case 1: chunk = 2 + rng() % 4; break;
+            case 2: chunk = 1 + rng() % 256; break;
+            default: chunk = 1 + rng() % 8192; break;
+        }
+        chunk = std::min(chunk, stream.size() - offset);
+        std::memcpy(buffer.prepare(chunk), stream.data() + offset, chunk);
+        buffer.commit(chunk);
+        offset += chunk;
+        std::string_view payload;
+        ReceiveBuffer::Status status;
+        while ((status = buffer.next_message(encoding, payload)) == ReceiveBuffer::Status::MESSAGE) {
+            decoded.push_back(wire_codec::decode_payload(payload, encoding));
+        }
+        if (status == ReceiveBuffer::Status::OVERSIZED) return status;
+    }
+    return ReceiveBuffer::Status::NEED_MORE;
+}
+
+static std::string length_prefix(uint32_t length) {
+    return {static_cast<char>(length >> 24), static_cast<char>(length >> 16), static_cast<char>(length >> 8), static_cast<char>(length)};
+}
+
+TEST_CASE(wire_codec_survives_random_splits) {
+    std::mt19937 rng(20261018);
+    for (int round = 0; round < WIRE_FUZZ_ROUNDS; ++round) {
+        WireEncoding encoding = ALL_ENCODINGS[round % 4];
+        std::vector<json> sent;
+        std::string stream;
+        for (int i = 1 + static_cast<int>(rng() % WIRE_FUZZ_MAX_MESSAGES); i > 0; --i) {
+            sent.push_back(random_message(rng));
+            stream += wire_codec::encode_frame(sent.back(), encoding);
+        }
+        ReceiveBuffer buffer;
+        std::vector<json> decoded;
+        CHECK(feed_in_random_chunks(stream, encoding, rng, decoded, buffer) == ReceiveBuffer::Status::NEED_MORE);
+        REQUIRE(decoded.size() == sent.size());
+        for (size_t i = 0; i < sent.size(); ++i) CHECK(decoded[i] == sent[i]);
+        CHECK_EQ(buffer.buffered(), 0u);
+    }
+}
+
+// 截断的帧只会等待更多数据；声明超过上限的长度前缀立即判为超长，不等待也不缓冲消息体
+TEST_CASE(wire_codec_rejects_truncated_and_oversized_frames) {
+    std::mt19937 rng(7);
+    for (WireEncoding encoding : ALL_ENCODINGS) {
+        json message = random_message(rng);
+        std::string frame = wire_codec::encode_frame(message, encoding);
+        for (size_t cut = 1; cut < frame.size(); cut += 1 + frame.size() / 64) {
+            ReceiveBuffer buffer;
+            std::vector<json> decoded;
+            CHECK(feed_in_random_chunks(frame.substr(0, frame.size() - cut), encoding, rng, decoded, buffer) ==
+                  ReceiveBuffer::Status::NEED_MORE);
+            CHECK(decoded.empty());
+        }
+        if (!wire_codec::is_length_prefixed(encoding)) continue;
+        for (uint32_t length : {MAX_WIRE_FRAME_BYTES + 1, 0x7FFFFFFFu, 0xFFFFFFFFu}) {
+            ReceiveBuffer buffer;
+            std::vector<json> decoded;
+            std::string stream = frame + length_prefix(length) + "trailing";
+            CHECK(feed_in_random_chunks(stream, encoding, rng, decoded, buffer) == ReceiveBuffer::Status::OVERSIZED);
+            REQUIRE(decoded.size() == 1);
+            CHECK(decoded[0] == message);
+        }
+    }
+}
+
+// 长度前缀完整但消息体损坏的帧被切出后，解码抛出 json 异常（服务器记录后丢弃），后续帧不受影响
+TEST_CASE(wire_codec_rejects_corrupt_payloads) {
+    std::mt19937 rng(11);
+    for (WireEncoding encoding : ALL_ENCODINGS) {
+        json message = random_message(rng);
+        std::string good = wire_codec::encode_frame(message, encoding);
+        std::string body = wire_codec::is_length_prefixed(encoding) ? good.substr(4) : good.substr(0, good.size() - 1);
+        for (size_t keep : {size_t{0}, size_t{1}, body.size() / 2, body.size() - 1}) {
+            std::string corrupt = body.substr(0, keep);
+            std::string frame = wire_codec::is_length_prefixed(encoding) ? length_prefix(static_cast<uint32_t>(corrupt.size())) + corrupt
+                                                                         : corrupt + "\n";
+            ReceiveBuffer buffer;
+            std::string stream = frame + good;
+            std::memcpy(buffer.prepare(stream.size()), stream.data(), stream.size());
+            buffer.commit(stream.size());
+            std::string_view payload;
+            // 空行在 JSON 行模式下直接跳过
+            if (encoding != WireEncoding::JSON_LINES || keep > 0) {
+                REQUIRE(buffer.next_message(encoding, payload) == ReceiveBuffer::Status::MESSAGE);
+                bool rejected = false;
+                try {
+                    wire_codec::decode_payload(payload, encoding);
+                } catch (const nlohmann::json::exception&) {
+                    rejected = true;
+                }
+                CHECK(rejected);
+            }
+            REQUIRE(buffer.next_message(encoding, payload) == ReceiveBuffer::Status::MESSAGE);
+            CHECK(wire_codec::decode_payload(payload, encoding) == message);
+            CHECK(buffer.next_message(encoding, payload) == ReceiveBuffer::Status::NEED_MORE);
+        }
+    }
+}
+
+// 各编码的帧体积与平均编解码耗时
+BENCHMARK_CASE(wire_codec_encoding_benchmark) {
+    json result = json::object();
+    json samples = encoding_samples();
+    for (auto sample = samples.begin(); sample != samples.end(); ++sample) {
+        json per_encoding = json::object();
+        for (WireEncoding encoding : ALL_ENCODINGS) {
+            std::string frame;
+            auto encode_start = std::chrono::steady_clock::now();
+            for (int i = 0; i < ENCODING_BENCHMARK_ITERATIONS; ++i) frame = wire_codec::encode_frame(sample.value(), encoding);
+            auto encode_end = std::chrono::steady_clock::now();
+
+            ReceiveBuffer buffer;
+            std::string_view payload;
+            REQUIRE(receive_one(frame, encoding, buffer, payload));
+            json decoded;
+            auto decode_start = std::chrono::steady_clock::now();
+            for (int i = 0; i < ENCODING_BENCHMARK_ITERATIONS; ++i) decoded = wire_codec::decode_payload(payload, encoding);
+            auto decode_end = std::chrono::steady_clock::now();
+            CHECK(decoded == sample.value());
+
+            auto avg_us = [](auto begin, auto end) {
+                return std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count() / ENCODING_BENCHMARK_ITERATIONS;
+            };
+            per_encoding[wire_codec::encoding_name(encoding)] = {
+                {"bytes", frame.size()},
+                {"encode_us", avg_us(encode_start, encode_end)},
+                {"decode_us", avg_us(decode_start, decode_end)}
+            };
+        }
+        result[sample.key()] = per_encoding;
+    }
+    test_harness::report_benchmark(result);
+}
@@ -0,0 +1,61 @@
+// daemon/tests/worker_pool_test.cpp
+#include "test_harness.h"
+#include "worker_pool.h"
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <thread>
+
+// 反复启动、停止线程池的轮数；单轮停止超过该时限视为丢失唤醒
+constexpr int WORKER_POOL_STOP_ROUNDS = 2000;
+constexpr auto WORKER_POOL_STOP_TIMEOUT = std::chrono::seconds(5);
+
+TEST_CASE(worker_pool_runs_tasks_and_rejects_when_full) {
+    WorkerPool pool("test", 1, 2);
+    CHECK(!pool.submit([] {}));
+
+    pool.start();
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    std::promise<void> started;
+    CHECK(pool.submit([&started, released] {
+        started.set_value();
+        released.wait();
+    }));
+    started.get_future().wait();
+    // 唯一的工作线程被占用，队列上限为 2
+    std::atomic<int> ran{0};
+    CHECK(pool.submit([&ran] { ran++; }));
+    CHECK(pool.submit([&ran] { ran++; }));
+    CHECK(!pool.submit([&ran] { ran++; }));
+    release.set_value();
+
+    // 停止时已入队的任务执行完毕
+    pool.stop();
+    CHECK_EQ(ran.load(), 2);
+    WorkerPool::Stats stats = pool.get_stats();
+    CHECK_EQ(stats.submitted, 3u);
+    CHECK_EQ(stats.completed, 3u);
+    CHECK_EQ(stats.rejected, 2u);
+    CHECK_EQ(stats.max_queue_depth, 2u);
+    CHECK(!pool.submit([] {}));
+}
+
+// 刚启动的工作线程正处于检查条件与进入等待之间时停止，线程也必须被唤醒退出
+TEST_CASE(worker_pool_stop_never_loses_the_wakeup) {
+    int hung_round = -1;
+    for (int round = 0; round < WORKER_POOL_STOP_ROUNDS && hung_round < 0; ++round) {
+        auto pool = std::make_shared<WorkerPool>("stop_test", 4, 8);
+        pool->start();
+        // 停止放在分离的线程上：卡住时该线程与线程池一起泄漏，用例仍能报告失败
+        std::promise<void> done;
+        std::future<void> stopped = done.get_future();
+        std::thread([pool, done = std::move(done)]() mutable {
+            pool->stop();
+            done.set_value();
+        }).detach();
+        if (stopped.wait_for(WORKER_POOL_STOP_TIMEOUT) != std::future_status::ready) hung_round = round;
+    }
+    CHECK_EQ(hung_round, -1);
+}